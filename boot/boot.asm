@@ -15,44 +15,70 @@ clear_cs:
 
     mov [BOOT_DRIVE], dl
 
-load_kernel:
-    mov ax, 0x1000
-    mov es, ax
-    xor bx, bx
-    
-    mov ah, 0x02
-    mov al, 50
-    mov ch, 0
-    mov cl, 2
-    mov dh, 0
-    mov dl, [BOOT_DRIVE]
-    
-    int 0x13
-    jc reset_and_retry
-    jmp continue_boot
+    call detect_memory
 
-reset_and_retry:
-    mov ah, 0x00
+load_kernel:
+    mov ah, 0x41
+    mov bx, 0x55AA
     mov dl, [BOOT_DRIVE]
     int 0x13
+    jc disk_error
+    cmp bx, 0xAA55
+    jne disk_error
     
-    mov ax, 0x1000
-    mov es, ax
-    xor bx, bx
+    call enable_a20
     
-    mov ah, 0x02
-    mov al, 50
-    mov ch, 0
-    mov cl, 2
-    mov dh, 0
+.next_chunk:
+    mov di, [KERNEL_SECTORS]
+    test di, di
+    jz continue_boot
+    cmp di, CHUNK_SECTORS
+    jbe .read
+    mov di, CHUNK_SECTORS
+.read:
+    mov bp, 3
+.retry:
+    mov [dap_count], di
+    mov si, dap
+    mov ah, 0x42
     mov dl, [BOOT_DRIVE]
     int 0x13
+    jnc .copy
+    xor ah, ah
+    mov dl, [BOOT_DRIVE]
+    int 0x13
+    dec bp
+    jnz .retry
+    jmp disk_error
     
-    jc continue_boot
+.copy:
+    ; a BIOS may reload segment registers inside INT 13h, dropping the 4 GB limit
+    call enter_unreal
+    movzx ecx, di
+    sub [KERNEL_SECTORS], di
+    add [dap_lba], ecx
+    shl ecx, 7
+    mov esi, BOUNCE_BUFFER
+    mov edi, [load_address]
+    a32 rep movsd
+    mov [load_address], edi
+    jmp .next_chunk
+
+disk_error:
+    mov si, disk_error_msg
+.print:
+    lodsb
+    test al, al
+    jz .halt
+    mov ah, 0x0E
+    int 0x10
+    jmp .print
+.halt:
+    cli
+    hlt
+    jmp .halt
 
 continue_boot:
-    call enable_a20
-    
     cli
     lgdt [gdt_descriptor]
     
@@ -62,6 +88,52 @@ continue_boot:
     
     jmp CODE_SEG:protected_mode
 
+enter_unreal:
+    cli
+    push ds
+    push es
+    lgdt [gdt_descriptor]
+    mov eax, cr0
+    or al, 1
+    mov cr0, eax
+    jmp $+2
+    mov bx, DATA_SEG
+    mov ds, bx
+    mov es, bx
+    and al, 0xFE
+    mov cr0, eax
+    pop es
+    pop ds
+    sti
+    ret
+
+detect_memory:
+    mov di, E820_MAP
+    xor ebx, ebx
+    xor bp, bp
+.next:
+    mov eax, 0xE820
+    mov edx, 0x534D4150
+    mov ecx, 24
+    mov dword [di + 20], 1
+    int 0x15
+    jc .done
+    cmp eax, 0x534D4150
+    jne .done
+    mov eax, [di + 8]
+    or eax, [di + 12]
+    jz .skip
+    inc bp
+    add di, 24
+.skip:
+    test ebx, ebx
+    jz .done
+    cmp bp, E820_MAX
+    jb .next
+.done:
+    mov [E820_COUNT], bp
+    ret
+
 enable_a20:
     in al, 0x92
     or al, 2
@@ -84,7 +156,9 @@ protected_mode:
     mov esp, 0x90000
     mov ebp, esp
     
-    call 0x10000
+    mov esi, E820_MAP
+    movzx ecx, word [E820_COUNT]
+    call KERNEL_LOAD_ADDRESS
     
 hang:
     cli
@@ -119,7 +193,34 @@ gdt_descriptor:
 CODE_SEG equ gdt_code - gdt_start
 DATA_SEG equ gdt_data - gdt_start
 
+dap:
+    db 0x10
+    db 0
+dap_count:
+    dw 0
+    dw 0
+    dw BOUNCE_BUFFER >> 4
+dap_lba:
+    dd KERNEL_LBA
+    dd 0
+
+load_address dd KERNEL_LOAD_ADDRESS
+
+disk_error_msg db "Disk read error", 0
+
+KERNEL_LOAD_ADDRESS equ 0x100000
+KERNEL_LBA equ 1
+BOUNCE_BUFFER equ 0x10000
+CHUNK_SECTORS equ 64
+
+E820_COUNT equ 0x8000
+E820_MAP equ 0x8004
+E820_MAX equ 128
+
 BOOT_DRIVE db 0
 
-times 510-($-$$) db 0
-dw 0xAA55
\ No newline at end of file
+times 508-($-$$) db 0
+
+KERNEL_SECTORS:
+    dw 0
+    dw 0xAA55
\ No newline at end of file
@@ -1,12 +1,99 @@
 [BITS 32]
 [EXTERN kernel_main]
+[EXTERN _bss_start]
+[EXTERN _bss_end]
 [GLOBAL _start]
 
+section .text.boot
+
 _start:
     cli
+    cld
+    
+    mov ebx, esi
+    mov ebp, ecx
+    
+    mov edi, _bss_start
+    mov ecx, _bss_end
+    sub ecx, edi
+    xor eax, eax
+    rep stosb
+    
+    mov eax, 0x80000000
+    cpuid
+    cmp eax, 0x80000001
+    jb no_long_mode
+    mov eax, 0x80000001
+    cpuid
+    test edx, 1 << 29
+    jz no_long_mode
+    
+    mov eax, boot_pdpt
+    or eax, 3
+    mov [boot_pml4], eax
+    mov edi, boot_pdpt
+    mov eax, boot_pd
+    or eax, 3
+    mov ecx, 4
+.fill_pdpt:
+    mov [edi], eax
+    add eax, 4096
+    add edi, 8
+    loop .fill_pdpt
+    
+    mov edi, boot_pd
+    mov eax, 0x83
+    xor edx, edx
+    mov ecx, 2048
+.fill_pd:
+    mov [edi], eax
+    mov [edi + 4], edx
+    add eax, 0x200000
+    adc edx, 0
+    add edi, 8
+    loop .fill_pd
+    
+    mov eax, boot_pml4
+    mov cr3, eax
+    
+    mov eax, cr4
+    or eax, (1 << 5) | (1 << 9) | (1 << 10)
+    mov cr4, eax
+    
+    mov ecx, 0xC0000080
+    rdmsr
+    or eax, 1 << 8
+    wrmsr
     
-    mov esp, kernel_stack_top
+    mov eax, cr0
+    and eax, ~(1 << 2)
+    or eax, (1 << 31) | (1 << 1)
+    mov cr0, eax
     
+    lgdt [gdt64_descriptor]
+    jmp dword 0x08:long_mode_start
+
+no_long_mode:
+    mov dword [0xB8000], 0x4F4F4F4E
+    mov dword [0xB8004], 0x4F344F36
+hang32:
+    cli
+    hlt
+    jmp hang32
+
+[BITS 64]
+long_mode_start:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    
+    mov rsp, kernel_stack_top
+    
+    mov edi, ebx
+    mov esi, ebp
     call kernel_main
     
 hang:
@@ -14,8 +101,27 @@ hang:
     hlt
     jmp hang
 
-section .bss
+section .data
 align 16
+gdt64:
+    dq 0
+    dq 0x00AF9A000000FFFF
+    dq 0x00CF92000000FFFF
+gdt64_end:
+
+gdt64_descriptor:
+    dw gdt64_end - gdt64 - 1
+    dq gdt64
+
+section .bss nobits alloc noexec write align=4096
+alignb 4096
+boot_pml4:
+    resb 4096
+boot_pdpt:
+    resb 4096
+boot_pd:
+    resb 4096 * 4
+alignb 16
 kernel_stack_bottom:
     resb 16384
-kernel_stack_top:
\ No newline at end of file
+kernel_stack_top:
@@ -0,0 +1,29 @@
+[BITS 64]
+[EXTERN thread_bootstrap]
+[GLOBAL context_switch]
+[GLOBAL thread_start]
+
+; void context_switch(uint64_t* save_rsp, uint64_t load_rsp)
+; saves the callee-saved registers on the old stack and resumes whatever the new stack holds
+context_switch:
+    push rbp
+    push rbx
+    push r12
+    push r13
+    push r14
+    push r15
+    mov [rdi], rsp
+    mov rsp, rsi
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbx
+    pop rbp
+    ret
+
+; a new thread's first return lands here with its thread pointer in r15
+thread_start:
+    mov rdi, r15
+    call thread_bootstrap
+    ud2
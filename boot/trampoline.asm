@@ -0,0 +1,81 @@
+[BITS 16]
+[GLOBAL trampoline_start]
+[GLOBAL trampoline_end]
+[GLOBAL trampoline_params]
+
+TRAMPOLINE_BASE equ 0x7000
+%define TRAMP(x) ((x) - trampoline_start + TRAMPOLINE_BASE)
+
+; copied below 1 MB by smp_init; a startup IPI enters it in real mode at TRAMPOLINE_BASE
+section .data
+align 16
+trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [TRAMP(tramp_gdt_descriptor)]
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+    jmp dword 0x18:TRAMP(tramp_protected)
+
+[BITS 32]
+tramp_protected:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+
+    mov eax, [TRAMP(params_cr4)]
+    mov cr4, eax
+    mov eax, [TRAMP(params_cr3)]
+    mov cr3, eax
+
+    mov ecx, 0xC0000080
+    rdmsr
+    or eax, 1 << 8
+    wrmsr
+
+    mov eax, [TRAMP(params_cr0)]
+    mov cr0, eax
+    jmp 0x08:TRAMP(tramp_long)
+
+[BITS 64]
+tramp_long:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+
+    mov rsp, [TRAMP(params_stack)]
+    mov rdi, [TRAMP(params_arg)]
+    mov rax, [TRAMP(params_entry)]
+    call rax
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 16
+tramp_gdt:
+    dq 0
+    dq 0x00AF9A000000FFFF
+    dq 0x00CF92000000FFFF
+    dq 0x00CF9A000000FFFF
+tramp_gdt_end:
+
+tramp_gdt_descriptor:
+    dw tramp_gdt_end - tramp_gdt - 1
+    dd TRAMP(tramp_gdt)
+
+; filled in by the boot CPU before each startup IPI
+align 8
+trampoline_params:
+params_cr3:     dq 0
+params_cr4:     dq 0
+params_cr0:     dq 0
+params_stack:   dq 0
+params_entry:   dq 0
+params_arg:     dq 0
+trampoline_end:
@@ -7,57 +7,114 @@ void cmd_fetch(void) {
     terminal_write(" OS:        HaldenOS 1.0.0\n");
     terminal_write(" Kernel:    1.0.0-halden\n");
     terminal_write(" Arch:      x86_64\n");
+    const cpu_info* cpu = cpu_get_info();
     terminal_write(" CPU:       ");
-    terminal_write(cpu_brand_string);
+    terminal_write(cpu->brand);
     terminal_write("\n Cores:     ");
-    char s[16]; uint_to_str(cpu_core_count, s); terminal_write(s);
+    char s[16]; uint_to_str(cpu->cores, s); terminal_write(s);
+    terminal_write(" ("); uint_to_str(cpu->threads, s); terminal_write(s); terminal_write(" threads)");
     terminal_write("\n Memory:    ");
+    uint_to_str((total_memory_kb - pmm_free_kb())/1024, s); terminal_write(s); terminal_write(" MB / ");
     uint_to_str(total_memory_kb/1024, s); terminal_write(s); terminal_write(" MB\n");
     terminal_write(" Disks:     ");
-    uint_to_str(disk_count, s); terminal_write(s); terminal_write(" detected\n");
-    terminal_write(is_virtualized() ? " VM:        Yes\n\n" : " VM:        No\n\n");
+    uint_to_str(block_count(), s); terminal_write(s); terminal_write(" detected\n");
+    terminal_write((cpu->features & CPU_FEATURE_HYPERVISOR) ? " VM:        Yes\n\n" : " VM:        No\n\n");
+}
+
+int shell_path(const char* arg, char* out) {
+    if(!fs_mounted()) {
+        terminal_write("no filesystem mounted\n");
+        return -1;
+    }
+    if(fs_path_resolve(current_directory, arg, out, sizeof(current_directory)) < 0) {
+        terminal_write("path too long\n");
+        return -1;
+    }
+    return 0;
 }
 
 void cmd_ls(const char* arg) {
-    if(!arg || !strlen(arg)) {
-        if(strcmp(current_directory, "/") == 0) {
-            terminal_write("/dev\n/etc\n");
-        } else if(strcmp(current_directory, "/dev") == 0) {
-            for(int i = 0; i < 4; i++) { terminal_write(files[i].name); terminal_write("\n"); }
-        } else if(strcmp(current_directory, "/etc") == 0) {
-            for(int i = 4; i < FILE_COUNT; i++) { terminal_write(files[i].name); terminal_write("\n"); }
-        }
-    } else if(strcmp(arg, "/dev") == 0) {
-        for(int i = 0; i < 4; i++) { terminal_write(files[i].name); terminal_write("\n"); }
-    } else if(strcmp(arg, "/etc") == 0) {
-        for(int i = 4; i < FILE_COUNT; i++) { terminal_write(files[i].name); terminal_write("\n"); }
-    } else {
-        terminal_write("ls: cannot access: No such directory\n");
+    char path[sizeof(current_directory)];
+    char name[FS_NAME_MAX + 1];
+    if(shell_path(arg, path) < 0) return;
+
+    fs_inode* dir = fs_namei(path);
+    if(!dir) {
+        terminal_write("ls: cannot access: No such file or directory\n");
+        return;
     }
+    if(!fs_is_dir(dir)) {
+        terminal_write(arg); terminal_write("\n");
+        fs_iput(dir);
+        return;
+    }
+    uint32_t cookie = 0;
+    int type;
+    while(fs_readdir(dir, &cookie, name, 0, &type) > 0) {
+        terminal_write(name);
+        terminal_write(type == FS_TYPE_DIR ? "/\n" : "\n");
+    }
+    fs_iput(dir);
 }
 
 void cmd_cd(const char* arg) {
-    if(!arg || !strlen(arg) || strcmp(arg, "~") == 0 || strcmp(arg, "/") == 0) {
-        strcpy(current_directory, "/");
-    } else if(strcmp(arg, "/dev") == 0 || strcmp(arg, "dev") == 0) {
-        strcpy(current_directory, "/dev");
-    } else if(strcmp(arg, "/etc") == 0 || strcmp(arg, "etc") == 0) {
-        strcpy(current_directory, "/etc");
-    } else if(strcmp(arg, "..") == 0) {
-        strcpy(current_directory, "/");
-    } else {
-        terminal_write("cd: no such directory\n");
-    }
+    char path[sizeof(current_directory)];
+    if(!arg || !strlen(arg) || strcmp(arg, "~") == 0) arg = "/";
+    if(shell_path(arg, path) < 0) return;
+
+    fs_inode* dir = fs_namei(path);
+    if(!dir || !fs_is_dir(dir)) terminal_write("cd: no such directory\n");
+    else strcpy(current_directory, path);
+    fs_iput(dir);
 }
 
 void cmd_cat(const char* arg) {
-    for(int i = 0; i < FILE_COUNT; i++) {
-        if(strcmp(files[i].name, arg) == 0) {
-            terminal_write(files[i].content); terminal_write("\n");
-            return;
-        }
+    char path[sizeof(current_directory)];
+    if(shell_path(arg, path) < 0) return;
+
+    fs_inode* ip = fs_namei(path);
+    if(!ip || fs_is_dir(ip)) {
+        terminal_write(ip ? "cat: is a directory\n" : "cat: no such file\n");
+        fs_iput(ip);
+        return;
+    }
+    char* buf = (char*)kmalloc(FS_BLOCK_SIZE + 1);
+    uint64_t offset = 0;
+    long n;
+    while(buf && (n = pagecache_read(ip, offset, buf, FS_BLOCK_SIZE)) > 0) {
+        buf[n] = '\0';
+        terminal_write(buf);
+        offset += n;
     }
-    terminal_write("cat: no such file\n");
+    if(offset && buf[(offset - 1) % FS_BLOCK_SIZE] != '\n') terminal_write("\n");
+    kfree(buf);
+    fs_iput(ip);
+}
+
+void cmd_mkdir(const char* arg) {
+    char path[sizeof(current_directory)];
+    if(shell_path(arg, path) < 0) return;
+
+    fs_inode* ip = fs_create(path, FS_TYPE_DIR);
+    if(!ip) terminal_write("mkdir: cannot create directory\n");
+    fs_iput(ip);
+}
+
+void cmd_touch(const char* arg) {
+    char path[sizeof(current_directory)];
+    if(shell_path(arg, path) < 0) return;
+
+    fs_inode* ip = fs_namei(path);
+    if(!ip) ip = fs_create(path, FS_TYPE_FILE);
+    if(!ip) terminal_write("touch: cannot create file\n");
+    fs_iput(ip);
+}
+
+void cmd_rm(const char* arg) {
+    char path[sizeof(current_directory)];
+    if(shell_path(arg, path) < 0) return;
+
+    if(fs_unlink(path) < 0) terminal_write("rm: cannot remove: No such file or non-empty directory\n");
 }
 
 void cmd_pwd(void) { terminal_write(current_directory); terminal_write("\n"); }
@@ -76,57 +133,956 @@ void cmd_uname(const char* arg) {
     else if(strcmp(arg, "-m") == 0) terminal_write("x86_64\n");
 }
 
+void write_padded(uint32_t value, int width) {
+    char s[16];
+    uint_to_str(value, s);
+    for(int i = strlen(s); i < width; i++) terminal_write(" ");
+    terminal_write(s);
+}
+
 void cmd_df(void) {
-    terminal_write("Filesystem  Size  Used  Avail  Use%\n");
-    for(int i = 0; i < disk_count; i++) {
-        if(detected_disks[i].exists) {
-            terminal_write("/dev/"); terminal_write(detected_disks[i].name);
-            terminal_write("   ");
-            char s[16]; uint_to_str(detected_disks[i].size_mb, s);
-            terminal_write(s); terminal_write("M  15%\n");
-        }
-    }
+    terminal_write("Filesystem     Size    Used   Avail  Use%  Mounted on\n");
+    if(!fs_mounted()) return;
+
+    uint32_t st[5];
+    fs_statfs(st);
+    uint32_t used = st[1] - st[2];
+    terminal_write("/dev/"); terminal_write(fs_device_name());
+    for(int i = strlen(fs_device_name()); i < 6; i++) terminal_write(" ");
+    write_padded(st[1] * (st[0] / 1024), 8); terminal_write("K");
+    write_padded(used * (st[0] / 1024), 7); terminal_write("K");
+    write_padded(st[2] * (st[0] / 1024), 7); terminal_write("K");
+    write_padded(st[1] ? (uint32_t)udiv64((uint64_t)used * 100, st[1]) : 0, 5); terminal_write("%  /\n");
 }
 
 void cmd_free(void) {
-    terminal_write("       total    used    free\n");
-    terminal_write("Mem:   ");
-    char s[16]; uint_to_str(total_memory_kb, s); terminal_write(s);
-    terminal_write("   ");
-    uint32_t used = total_memory_kb * 17 / 100;
-    uint_to_str(used, s); terminal_write(s);
-    terminal_write("   ");
-    uint_to_str(total_memory_kb - used, s); terminal_write(s);
+    uint32_t free_kb = pmm_free_kb();
+    uint32_t reserved_kb = pmm_reserved_kb();
+    terminal_write("           total        used        free    reserved\n");
+    terminal_write("Mem:");
+    write_padded(total_memory_kb, 12);
+    write_padded(total_memory_kb - free_kb - reserved_kb, 12);
+    write_padded(free_kb, 12);
+    write_padded(reserved_kb, 12);
     terminal_write("\n");
 }
 
+void cmd_memmap(void) {
+    static const char* types[6] = {"unknown", "usable", "reserved", "ACPI reclaim", "ACPI NVS", "bad"};
+    char s[24];
+    for(uint32_t i = 0; i < pmm_map_count(); i++) {
+        const e820_entry* e = pmm_map_entry(i);
+        uint_to_hex(e->base, s, 16); terminal_write(s); terminal_write("-");
+        uint_to_hex(e->base + e->length - 1, s, 16); terminal_write(s); terminal_write("  ");
+        terminal_write(types[e->type < 6 ? e->type : 0]); terminal_write("\n");
+    }
+}
+
+void cmd_slabinfo(void) {
+    terminal_write("cache            active   total  size  slabs  hit%\n");
+    for(kmem_cache* c = slab_first_cache(); c; c = slab_next_cache(c)) {
+        const char* name;
+        uint32_t st[6];
+        slab_cache_stats(c, &name, st);
+        terminal_write(name);
+        for(int i = strlen(name); i < 14; i++) terminal_write(" ");
+        write_padded(st[0], 8);
+        write_padded(st[1], 8);
+        write_padded(st[2], 6);
+        write_padded(st[3], 7);
+        uint32_t lookups = st[4] + st[5];
+        write_padded(lookups ? (uint32_t)udiv64((uint64_t)st[4] * 100, lookups) : 100, 6);
+        terminal_write("\n");
+    }
+    uint32_t large, pages;
+    slab_large_stats(&large, &pages);
+    terminal_write("large allocations: ");
+    char s[16]; uint_to_str(large, s); terminal_write(s);
+    terminal_write(" ("); uint_to_str(pages * 4, s); terminal_write(s); terminal_write(" KB)\n");
+}
+
+void cmd_vmstat(void) {
+    static const char* labels[7] = {
+        "page faults:       ", "demand faults:     ", "fatal faults:      ",
+        "vmalloc areas:     ", "vmalloc reserved:  ", "vmalloc resident:  ",
+        "identity mapped:   "
+    };
+    uint32_t st[7];
+    char s[16];
+    paging_stats(st);
+    for(int i = 0; i < 7; i++) {
+        terminal_write(labels[i]);
+        uint_to_str(st[i], s); terminal_write(s);
+        terminal_write(i == 6 ? " MB\n" : i >= 4 ? " KB\n" : "\n");
+    }
+}
+
+static void write_cache_size(uint32_t bytes) {
+    char s[16];
+    if(bytes >= 1024 * 1024 && bytes % (1024 * 1024) == 0) {
+        uint_to_str(bytes / (1024 * 1024), s); terminal_write(s); terminal_write(" MiB");
+    } else {
+        uint_to_str(bytes / 1024, s); terminal_write(s); terminal_write(" KiB");
+    }
+}
+
 void cmd_lscpu(void) {
+    const cpu_info* cpu = cpu_get_info();
+    char s[16];
     terminal_write("Architecture:  x86_64\n");
     terminal_write("CPU(s):        ");
-    char s[16]; uint_to_str(cpu_core_count, s); terminal_write(s); terminal_write("\n");
-    terminal_write("Vendor:        "); terminal_write(cpu_vendor_string); terminal_write("\n");
-    terminal_write("Model:         "); terminal_write(cpu_brand_string); terminal_write("\n");
+    uint_to_str(cpu->threads, s); terminal_write(s); terminal_write("\n");
+    uint32_t st[3];
+    smp_stats(st);
+    terminal_write("On-line CPU(s) list: 0");
+    if(st[0] > 1) { terminal_write("-"); uint_to_str(st[0] - 1, s); terminal_write(s); }
+    terminal_write("\n");
+    terminal_write("Vendor:        "); terminal_write(cpu->vendor); terminal_write("\n");
+    terminal_write("Model name:    "); terminal_write(cpu->brand); terminal_write("\n");
+    terminal_write("Family:        "); uint_to_str(cpu->family, s); terminal_write(s);
+    terminal_write("  Model: "); uint_to_str(cpu->model, s); terminal_write(s);
+    terminal_write("  Stepping: "); uint_to_str(cpu->stepping, s); terminal_write(s); terminal_write("\n");
+    terminal_write("Thread(s) per core: "); uint_to_str(cpu->threads_per_core, s); terminal_write(s); terminal_write("\n");
+    terminal_write("Core(s) per socket: "); uint_to_str(cpu->cores_per_package, s); terminal_write(s); terminal_write("\n");
+    terminal_write("Socket(s):     "); uint_to_str(cpu->packages, s); terminal_write(s); terminal_write("\n");
+    for(uint32_t i = 0; i < cpu->cache_count; i++) {
+        const cpu_cache* c = &cpu->caches[i];
+        terminal_write("L"); uint_to_str(c->level, s); terminal_write(s);
+        terminal_write(c->level != 1 ? " cache:      " : c->type == CACHE_INSTRUCTION ? "i cache:     " : "d cache:     ");
+        write_cache_size(c->size);
+        if(c->ways) { terminal_write(", "); uint_to_str(c->ways, s); terminal_write(s); terminal_write("-way"); }
+        terminal_write(", shared by "); uint_to_str(c->shared_by, s); terminal_write(s); terminal_write("\n");
+    }
+    terminal_write("Cache line:    "); uint_to_str(cpu->cache_line, s); terminal_write(s); terminal_write(" bytes\n");
+    terminal_write("Flags:        ");
+    for(uint32_t bit = 0; bit < CPU_FEATURE_COUNT; bit++) {
+        if(cpu->features & (1u << bit)) { terminal_write(" "); terminal_write(cpu_feature_name(bit)); }
+    }
+    terminal_write("\n");
+    const char *copy, *len, *cmp;
+    int erms;
+    string_impls(&copy, &len, &cmp, &erms);
+    terminal_write("String ops:    memcpy "); terminal_write(copy);
+    if(erms) terminal_write("+erms");
+    terminal_write(", strlen "); terminal_write(len);
+    terminal_write(", strcmp "); terminal_write(cmp);
+    if(string_nt_threshold()) {
+        terminal_write(", streaming >= "); write_cache_size((uint32_t)string_nt_threshold());
+    }
+    terminal_write("\n");
+    static const char* save_modes[3] = {"fxsave", "xsave", "xsaveopt"};
+    uint32_t fpu[5];
+    fpu_stats(fpu);
+    terminal_write("FPU context:   "); terminal_write(save_modes[fpu[0]]);
+    terminal_write(", "); uint_to_str(fpu[1], s); terminal_write(s);
+    terminal_write(" bytes, "); uint_to_str(fpu[2], s); terminal_write(s);
+    terminal_write(" threads, "); uint_to_str(fpu[3], s); terminal_write(s);
+    terminal_write(" lazy restores, "); uint_to_str(fpu[4], s); terminal_write(s);
+    terminal_write(" saves\n");
 }
 
 void cmd_lsblk(void) {
-    terminal_write("NAME  SIZE\n");
-    for(int i = 0; i < disk_count; i++) {
-        if(detected_disks[i].exists) {
-            terminal_write(detected_disks[i].name); terminal_write("  ");
-            char s[16]; uint_to_str(detected_disks[i].size_mb, s);
-            terminal_write(s); terminal_write("M\n");
+    char s[16];
+    terminal_write("NAME      SIZE  DRIVER   MODEL\n");
+    for(uint32_t i = 0; i < block_count(); i++) {
+        block_device* dev = block_get(i);
+        uint64_t bytes = block_sectors(dev) * block_sector_size(dev);
+        terminal_write(block_name(dev));
+        write_padded((uint32_t)(bytes >> 20), 13 - strlen(block_name(dev)));
+        terminal_write("M  ");
+        terminal_write(block_driver(dev));
+        terminal_write("  ");
+        terminal_write(block_model(dev));
+        terminal_write("\n");
+    }
+
+    uint32_t st[3];
+    ata_stats(st);
+    terminal_write("ata transfers: ");
+    uint_to_str(st[0], s); terminal_write(s); terminal_write(" dma, ");
+    uint_to_str(st[1], s); terminal_write(s); terminal_write(" pio, ");
+    uint_to_str(st[2], s); terminal_write(s); terminal_write(" dma fallbacks\n");
+}
+
+void cmd_bcache(void) {
+    static const char* labels[10] = {
+        "buffers:           ", "cached blocks:     ", "in use:            ",
+        "dirty:             ", "hits:              ", "misses:            ",
+        "readahead blocks:  ", "readahead hits:    ", "writebacks:        ",
+        "evictions:         "
+    };
+    uint32_t st[10];
+    char s[16];
+    bcache_stats(st);
+    for(int i = 0; i < 10; i++) {
+        terminal_write(labels[i]);
+        uint_to_str(st[i], s); terminal_write(s);
+        terminal_write("\n");
+    }
+    uint32_t lookups = st[4] + st[5];
+    terminal_write("hit rate:          ");
+    uint_to_str(lookups ? (uint32_t)udiv64((uint64_t)st[4] * 100, lookups) : 0, s);
+    terminal_write(s); terminal_write("%\n");
+
+    pagecache_stats(st);
+    terminal_write("page cache:        ");
+    uint_to_str(st[0], s); terminal_write(s); terminal_write(" pages, ");
+    uint_to_str(st[1], s); terminal_write(s); terminal_write(" pinned, ");
+    uint_to_str(st[2], s); terminal_write(s); terminal_write(" hits, ");
+    uint_to_str(st[3], s); terminal_write(s); terminal_write(" misses\n");
+}
+
+void cmd_sync(void) {
+    if((fs_mounted() && fs_sync() < 0) || bcache_sync(0) < 0) terminal_write("sync: write error\n");
+}
+
+const char* parse_uint(const char* s, uint32_t* out) {
+    if(*s < '0' || *s > '9') return 0;
+    uint32_t v = 0;
+    while(*s >= '0' && *s <= '9') v = v * 10 + (uint32_t)(*s++ - '0');
+    *out = v;
+    while(*s == ' ') s++;
+    return s;
+}
+
+const char* parse_ipv4(const char* s, uint32_t* ip) {
+    uint32_t addr = 0, part;
+    for(int i = 0; i < 4; i++) {
+        if(!s || *s < '0' || *s > '9') return 0;
+        part = 0;
+        while(*s >= '0' && *s <= '9') part = part * 10 + (uint32_t)(*s++ - '0');
+        if(part > 255 || (i < 3 && *s++ != '.')) return 0;
+        addr = (addr << 8) | part;
+    }
+    if(*s && *s != ' ') return 0;
+    while(*s == ' ') s++;
+    *ip = addr;
+    return s;
+}
+
+void ipv4_to_str(uint32_t ip, char* out) {
+    for(int i = 3; i >= 0; i--) {
+        uint_to_str((ip >> (i * 8)) & 0xFF, out);
+        out += strlen(out);
+        if(i) *out++ = '.';
+    }
+}
+
+void write_ipv4(uint32_t ip) {
+    char s[16];
+    ipv4_to_str(ip, s);
+    terminal_write(s);
+}
+
+void write_mac(const uint8_t* mac) {
+    char s[8];
+    for(int i = 0; i < 6; i++) {
+        uint_to_hex(mac[i], s, 2); terminal_write(s + 2);
+        if(i < 5) terminal_write(":");
+    }
+}
+
+/* microseconds as "N.NNN ms" */
+void write_usec(uint32_t us) {
+    char s[16];
+    uint_to_str(us / 1000, s); terminal_write(s); terminal_write(".");
+    s[0] = '0' + (us / 100) % 10;
+    s[1] = '0' + (us / 10) % 10;
+    s[2] = '0' + us % 10;
+    s[3] = '\0';
+    terminal_write(s); terminal_write(" ms");
+}
+
+void cmd_ifconfig(const char* arg) {
+    if(!ethernet_is_initialized()) {
+        terminal_write("ifconfig: no supported network device\n");
+        return;
+    }
+    if(arg && strcmp(arg, "up") == 0) ethernet_set_link_status(1);
+    else if(arg && strcmp(arg, "down") == 0) ethernet_set_link_status(0);
+    else if(arg && strcmp(arg, "promisc") == 0) ethernet_set_promiscuous(1);
+    else if(arg && strcmp(arg, "-promisc") == 0) ethernet_set_promiscuous(0);
+    else if(arg && strlen(arg)) {
+        terminal_write("usage: ifconfig [up|down|promisc|-promisc]\n");
+        return;
+    }
+
+    uint8_t mac[6];
+    char s[24];
+    ethernet_get_mac(mac);
+    terminal_write("eth0: e1000 (8086:");
+    uint_to_hex(ethernet_device_id(), s, 4); terminal_write(s + 2);
+    terminal_write(")  ether ");
+    write_mac(mac);
+
+    uint32_t addr, mask, gw;
+    ip_get_config(&addr, &mask, &gw);
+    terminal_write("\n      inet "); write_ipv4(addr);
+    terminal_write("  netmask "); write_ipv4(mask);
+    terminal_write("  gateway "); write_ipv4(gw);
+    terminal_write("\n      link ");
+    if(ethernet_get_link_status()) {
+        uint_to_str(ethernet_get_speed(), s); terminal_write("up "); terminal_write(s);
+        terminal_write(ethernet_is_full_duplex() ? " Mb/s full duplex" : " Mb/s half duplex");
+    } else {
+        terminal_write("down");
+    }
+    terminal_write(ethernet_get_promiscuous() ? "  PROMISC\n" : "\n");
+
+    uint32_t rx, tx, rx_err, tx_err, st[4];
+    ethernet_get_stats(&rx, &tx, &rx_err, &tx_err);
+    ethernet_driver_stats(st);
+    terminal_write("      RX packets "); uint_to_str(rx, s); terminal_write(s);
+    terminal_write("  errors "); uint_to_str(rx_err, s); terminal_write(s);
+    terminal_write("  overruns "); uint_to_str(st[1], s); terminal_write(s);
+    terminal_write("\n      TX packets "); uint_to_str(tx, s); terminal_write(s);
+    terminal_write("  errors "); uint_to_str(tx_err, s); terminal_write(s);
+    terminal_write("  tail writes "); uint_to_str(st[2], s); terminal_write(s);
+    terminal_write("\n      irq "); uint_to_str(st[3], s); terminal_write(s);
+    terminal_write("  interrupts "); uint_to_str(st[0], s); terminal_write(s);
+
+    uint32_t pool[5];
+    ethernet_get_drops(&rx, &tx);
+    pbuf_pool_stats(pool);
+    terminal_write("\n      dropped rx "); uint_to_str(rx, s); terminal_write(s);
+    terminal_write("  tx "); uint_to_str(tx, s); terminal_write(s);
+    terminal_write("\n      pbufs "); uint_to_str(pool[0] - pool[1], s); terminal_write(s);
+    terminal_write("/"); uint_to_str(pool[0], s); terminal_write(s);
+    terminal_write(" in use  peak "); uint_to_str(pool[2], s); terminal_write(s);
+    terminal_write("  alloc failures "); uint_to_str(pool[4], s); terminal_write(s);
+    terminal_write("\n");
+}
+
+void cmd_arp(void) {
+    uint32_t cookie = 0, ip, age, st[4];
+    uint8_t mac[6];
+    int resolved, count = 0;
+    char s[16];
+    terminal_write("Address          HWaddress          Age\n");
+    while(arp_get_entry(&cookie, &ip, mac, &resolved, &age)) {
+        ipv4_to_str(ip, s); terminal_write(s);
+        for(size_t i = strlen(s); i < 17; i++) terminal_write(" ");
+        if(resolved) write_mac(mac);
+        else terminal_write("(incomplete)     ");
+        terminal_write("  "); uint_to_str(age, s); terminal_write(s); terminal_write("s\n");
+        count++;
+    }
+    arp_stats(st);
+    uint_to_str(count, s); terminal_write(s);
+    terminal_write(" entries  requests "); uint_to_str(st[0], s); terminal_write(s);
+    terminal_write("  replies "); uint_to_str(st[1], s); terminal_write(s);
+    terminal_write("  unresolved "); uint_to_str(st[2], s); terminal_write(s);
+    terminal_write("  queue drops "); uint_to_str(st[3], s); terminal_write(s);
+    terminal_write("\n");
+}
+
+void cmd_ping(const char* arg) {
+    uint32_t dst, count = 4;
+    const char* rest = parse_ipv4(arg, &dst);
+    if(!rest || (*rest && !parse_uint(rest, &count))) {
+        terminal_write("usage: ping <a.b.c.d> [count]\n");
+        return;
+    }
+    if(!ethernet_is_initialized()) {
+        terminal_write("ping: network is unreachable\n");
+        return;
+    }
+
+    static uint16_t ping_id = 0x4844;
+    uint16_t id = ping_id++;
+    uint32_t received = 0, min_us = 0xFFFFFFFF, max_us = 0;
+    uint64_t total_us = 0;
+    char s[16];
+    terminal_write("PING "); write_ipv4(dst); terminal_write(" 56 data bytes\n");
+    terminal_flush();
+
+    for(uint32_t seq = 1; seq <= count; seq++) {
+        uint64_t start = ktime_ns();
+        uint64_t rtt;
+        uint8_t ttl;
+        if(icmp_echo_send(dst, id, (uint16_t)seq, 56) < 0 || icmp_echo_wait(1000, &rtt, &ttl) < 0) {
+            terminal_write("Request timeout for icmp_seq "); uint_to_str(seq, s); terminal_write(s);
+            terminal_write("\n");
+        } else {
+            uint32_t us = (uint32_t)(rtt / 1000);
+            received++;
+            total_us += us;
+            if(us < min_us) min_us = us;
+            if(us > max_us) max_us = us;
+            terminal_write("64 bytes from "); write_ipv4(dst);
+            terminal_write(": icmp_seq="); uint_to_str(seq, s); terminal_write(s);
+            terminal_write(" ttl="); uint_to_str(ttl, s); terminal_write(s);
+            terminal_write(" time="); write_usec(us); terminal_write("\n");
         }
+        terminal_flush();
+        uint64_t spent = (ktime_ns() - start) / 1000000;
+        if(seq < count && spent < 1000) msleep(1000 - (uint32_t)spent);
+    }
+
+    terminal_write("--- "); write_ipv4(dst); terminal_write(" ping statistics ---\n");
+    uint_to_str(count, s); terminal_write(s); terminal_write(" packets transmitted, ");
+    uint_to_str(received, s); terminal_write(s); terminal_write(" received, ");
+    uint_to_str(count ? (count - received) * 100 / count : 0, s); terminal_write(s);
+    terminal_write("% packet loss\n");
+    if(received) {
+        terminal_write("rtt min/avg/max = "); write_usec(min_us);
+        terminal_write(" / "); write_usec((uint32_t)(total_us / received));
+        terminal_write(" / "); write_usec(max_us); terminal_write("\n");
     }
 }
 
+/* keeps a window of datagrams in flight against a UDP echo server and reports the echo rate */
+void cmd_udpbench(const char* arg) {
+    uint32_t dst, port, count = 10000, size = 64;
+    const char* rest = parse_ipv4(arg, &dst);
+    if(rest) rest = parse_uint(rest, &port);
+    if(rest && *rest) rest = parse_uint(rest, &count);
+    if(rest && *rest) rest = parse_uint(rest, &size);
+    if(!rest || *rest || port == 0 || port > 65535 || count == 0 || size < 4 || size > 1472) {
+        terminal_write("usage: udpbench <a.b.c.d> <port> [count] [size 4-1472]\n");
+        return;
+    }
+
+    int sock = udp_open(0);
+    if(sock < 0) {
+        terminal_write("udpbench: no free socket\n");
+        return;
+    }
+
+    static uint8_t buf[1472];
+    const uint32_t window = 32;
+    uint32_t sent = 0, received = 0, send_errors = 0;
+    char s[16];
+    for(uint32_t i = 0; i < size; i++) buf[i] = (uint8_t)i;
+    terminal_write("udpbench: "); uint_to_str(count, s); terminal_write(s);
+    terminal_write(" x "); uint_to_str(size, s); terminal_write(s);
+    terminal_write(" bytes to "); write_ipv4(dst); terminal_write(":");
+    uint_to_str(port, s); terminal_write(s); terminal_write("\n");
+    terminal_flush();
+
+    uint64_t start = ktime_ns();
+    while(received < count) {
+        ethernet_tx_batch_begin();
+        while(sent < count && sent - received < window) {
+            *(uint32_t*)buf = sent;
+            if(udp_sendto(sock, dst, (uint16_t)port, buf, (uint16_t)size) < 0) send_errors++;
+            sent++;
+        }
+        ethernet_tx_batch_end();
+        /* a full second without an echo means the rest were lost */
+        if(udp_recvfrom(sock, buf, sizeof(buf), 0, 0, 1000) < 0) break;
+        received++;
+    }
+    uint64_t elapsed_us = (ktime_ns() - start) / 1000;
+    udp_close(sock);
+    if(!elapsed_us) elapsed_us = 1;
+
+    uint32_t pps = (uint32_t)((uint64_t)received * 1000000 / elapsed_us);
+    uint32_t kbps = (uint32_t)((uint64_t)received * size * 8 * 1000 / elapsed_us);
+    terminal_write("sent "); uint_to_str(sent, s); terminal_write(s);
+    terminal_write("  echoed "); uint_to_str(received, s); terminal_write(s);
+    terminal_write("  lost "); uint_to_str(sent - received, s); terminal_write(s);
+    terminal_write("  send errors "); uint_to_str(send_errors, s); terminal_write(s);
+    terminal_write("\ntime "); write_usec((uint32_t)elapsed_us);
+    terminal_write("  "); uint_to_str(pps, s); terminal_write(s);
+    terminal_write(" pps  "); uint_to_str(kbps, s); terminal_write(s);
+    terminal_write(" kbit/s\n");
+}
+
 void cmd_ps(void) {
-    terminal_write("PID  CMD\n  1  init\n  2  bash\n");
+    static const char* states[4] = {"R", "S", "D", "Z"};
+    uint32_t cookie = 0, tid, prio, cpu, st[5];
+    uint64_t cpu_ns;
+    int state;
+    char name[16], s[16];
+    terminal_write("  TID  PRI  CPU  S        TIME  CMD\n");
+    while(sched_thread_info(&cookie, &tid, name, &state, &prio, &cpu, &cpu_ns)) {
+        uint_to_str(tid, s);
+        for(size_t i = strlen(s); i < 5; i++) terminal_write(" ");
+        terminal_write(s);
+        uint_to_str(prio, s);
+        for(size_t i = strlen(s); i < 5; i++) terminal_write(" ");
+        terminal_write(s);
+        uint_to_str(cpu, s);
+        for(size_t i = strlen(s); i < 5; i++) terminal_write(" ");
+        terminal_write(s);
+        terminal_write("  "); terminal_write(state >= 0 && state < 4 ? states[state] : "?");
+        uint_to_str((uint32_t)(cpu_ns / 1000000), s);
+        for(size_t i = strlen(s); i < 10; i++) terminal_write(" ");
+        terminal_write(s); terminal_write("ms  ");
+        terminal_write(name); terminal_write("\n");
+    }
+    sched_stats(st);
+    uint_to_str(st[0], s); terminal_write(s);
+    terminal_write(" threads  "); uint_to_str(st[1], s); terminal_write(s);
+    terminal_write(" runnable");
+    terminal_write("  switches "); uint_to_str(st[2], s); terminal_write(s);
+    terminal_write("  preemptions "); uint_to_str(st[3], s); terminal_write(s);
+    terminal_write("  stolen "); uint_to_str(st[4], s); terminal_write(s);
+    terminal_write("\n");
+    work_stats(st);
+    uint_to_str(st[0], s); terminal_write(s);
+    terminal_write(" workers  submitted "); uint_to_str(st[1], s); terminal_write(s);
+    terminal_write("  executed "); uint_to_str(st[2], s); terminal_write(s);
+    terminal_write("  stolen "); uint_to_str(st[3], s); terminal_write(s);
+    terminal_write("\n");
+}
+
+void cmd_kill(const char* arg) {
+    uint32_t tid;
+    const char* rest = parse_uint(arg, &tid);
+    if(!rest || *rest) {
+        terminal_write("usage: kill <tid>\n");
+        return;
+    }
+    if(thread_kill(tid) < 0) terminal_write("kill: no such thread or not killable\n");
+}
+
+void write_two_digits(uint32_t value) {
+    char s[3];
+    s[0] = '0' + (value / 10) % 10;
+    s[1] = '0' + value % 10;
+    s[2] = '\0';
+    terminal_write(s);
+}
+
+void cmd_uptime(void) {
+    uint32_t secs = timer_uptime_seconds();
+    char s[16];
+    terminal_write("up ");
+    uint_to_str(secs / 86400, s); terminal_write(s);
+    terminal_write(secs / 86400 == 1 ? " day, " : " days, ");
+    write_two_digits((secs / 3600) % 24); terminal_write(":");
+    write_two_digits((secs / 60) % 60); terminal_write(":");
+    write_two_digits(secs % 60); terminal_write("\n");
+}
+
+void cmd_date(void) {
+    static const char* days[7] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+    static const char* months[12] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    rtc_time t;
+    rtc_read(&t);
+    char s[16];
+    terminal_write(days[rtc_days_since_epoch(t.year, t.month, t.day) % 7]);
+    terminal_write(" ");
+    terminal_write(months[(t.month - 1) % 12]);
+    terminal_write(" ");
+    write_two_digits(t.day); terminal_write(" ");
+    write_two_digits(t.hour); terminal_write(":");
+    write_two_digits(t.minute); terminal_write(":");
+    write_two_digits(t.second); terminal_write(" UTC ");
+    uint_to_str(t.year, s); terminal_write(s); terminal_write("\n");
 }
 
 void cmd_env(void) {
     terminal_write("PATH=/bin\nHOME=/root\nSHELL=/bin/bash\nUSER=root\n");
 }
 
+#define PERF_TOP_ROWS 16
+#define PERF_BATCH 256
+
+/* samples land in per-CPU rings; each refresh bins everything drained since the last one by function */
+static uint32_t perf_collect(uint32_t* counts, uint64_t* batch) {
+    uint32_t total = 0, n, st[3];
+    smp_stats(st);
+    for(uint32_t i = 0; i <= ksym_total(); i++) counts[i] = 0;
+    for(uint32_t cpu = 0; cpu < st[0]; cpu++) {
+        while((n = profile_drain(cpu, batch, PERF_BATCH)) > 0) {
+            for(uint32_t i = 0; i < n; i++) {
+                int index = ksym_index(batch[i]);
+                counts[index < 0 ? ksym_total() : (uint32_t)index]++;
+            }
+            total += n;
+        }
+    }
+    return total;
+}
+
+static void perf_show(uint32_t* counts, uint32_t total, uint32_t elapsed) {
+    static const char* sources[3] = {"off", "timer tick", "cycles NMI"};
+    uint32_t st[4];
+    char s[16];
+    profile_stats(st);
+    terminal_clear();
+    terminal_write("perf top: "); uint_to_str(total, s); terminal_write(s);
+    terminal_write(" samples, source "); terminal_write(sources[st[0] < 3 ? st[0] : 0]);
+    terminal_write(" at "); uint_to_str(st[1], s); terminal_write(s);
+    terminal_write(" Hz per CPU, dropped "); uint_to_str(st[3], s); terminal_write(s);
+    terminal_write(", "); uint_to_str(elapsed, s); terminal_write(s);
+    terminal_write(" s (any key stops)\n\n");
+    terminal_write("Overhead   Samples  Symbol\n");
+    /* repeated selection of the largest bucket; the counts are consumed as they are printed */
+    for(int row = 0; row < PERF_TOP_ROWS && total; row++) {
+        uint32_t best = 0;
+        for(uint32_t i = 1; i <= ksym_total(); i++) {
+            if(counts[i] > counts[best]) best = i;
+        }
+        if(!counts[best]) break;
+        uint32_t hundredths = (uint32_t)((uint64_t)counts[best] * 10000 / total);
+        write_padded(hundredths / 100, 5); terminal_write(".");
+        s[0] = '0' + (hundredths / 10) % 10;
+        s[1] = '0' + hundredths % 10;
+        s[2] = '\0';
+        terminal_write(s); terminal_write("%");
+        write_padded(counts[best], 10); terminal_write("  ");
+        terminal_write(best == ksym_total() ? "[unknown]" : ksym_name((int)best));
+        terminal_write("\n");
+        counts[best] = 0;
+    }
+    terminal_flush();
+}
+
+static int perf_key_pressed(void) {
+    uint8_t scancode;
+    char c;
+    while(keyboard_poll(&scancode)) {
+        if(!(scancode & 0x80)) return 1;
+    }
+    return serial_poll(&c);
+}
+
+void cmd_perf(const char* arg) {
+    uint32_t seconds = 10;
+    if(strncmp(arg, "top", 3) != 0 || (arg[3] && (arg[3] != ' ' || !parse_uint(arg + 4, &seconds)))) {
+        terminal_write("usage: perf top [seconds]\n");
+        return;
+    }
+    if(!ksym_total()) {
+        terminal_write("perf: kernel was built without a symbol table\n");
+        return;
+    }
+    uint32_t* counts = (uint32_t*)kmalloc((ksym_total() + 1) * sizeof(uint32_t));
+    uint64_t* batch = (uint64_t*)kmalloc(PERF_BATCH * sizeof(uint64_t));
+    if(!counts || !batch || profile_start() < 0) {
+        terminal_write("perf: out of memory\n");
+        if(counts) kfree(counts);
+        if(batch) kfree(batch);
+        return;
+    }
+
+    int stopped = 0;
+    for(uint32_t elapsed = 1; elapsed <= seconds && !stopped; elapsed++) {
+        for(int i = 0; i < 10 && !stopped; i++) {
+            msleep(100);
+            stopped = perf_key_pressed();
+        }
+        uint32_t total = perf_collect(counts, batch);
+        perf_show(counts, total, elapsed);
+    }
+    profile_stop();
+    kfree(counts);
+    kfree(batch);
+}
+
+#define TRACE_DUMP_MAX 64
+#define TRACE_BOOT_PHASES 32
+
+static void write_packed(uint64_t packed) {
+    char s[9];
+    int i = 0;
+    for(; i < 8 && ((packed >> (i * 8)) & 0xFF); i++) s[i] = (char)((packed >> (i * 8)) & 0xFF);
+    s[i] = '\0';
+    terminal_write(s);
+}
+
+static void write_name_padded(const char* name, int width) {
+    terminal_write(name);
+    for(int i = strlen(name); i < width; i++) terminal_write(" ");
+}
+
+static void trace_boot(void) {
+    const char* names[TRACE_BOOT_PHASES];
+    uint64_t tsc[TRACE_BOOT_PHASES];
+    uint32_t n = trace_boot_timeline(names, tsc, TRACE_BOOT_PHASES);
+    if(!n) {
+        terminal_write("trace: no boot phases recorded\n");
+        return;
+    }
+    terminal_write("PHASE               START        TIME\n");
+    for(uint32_t i = 0; i < n; i++) {
+        write_name_padded(names[i], 16);
+        write_usec((uint32_t)(trace_cycles_to_ns(tsc[i] - tsc[0]) / 1000));
+        if(i + 1 < n) {
+            terminal_write("  ");
+            write_usec((uint32_t)(trace_cycles_to_ns(tsc[i + 1] - tsc[i]) / 1000));
+        }
+        terminal_write("\n");
+    }
+}
+
+#define TRACE_PAIR_SLOTS 32
+
+/* a thread with a command or a disk request in flight, and when each began */
+typedef struct {
+    uint32_t tid;
+    uint64_t cmd_start;
+    uint64_t io_start;
+} trace_pending;
+
+/* the slot for tid, claiming an empty one if needed; 0 when more threads are mid-way than there are slots */
+static trace_pending* trace_pending_slot(trace_pending* slots, uint32_t tid) {
+    trace_pending* free_slot = 0;
+    for(uint32_t i = 0; i < TRACE_PAIR_SLOTS; i++) {
+        if(slots[i].cmd_start || slots[i].io_start) {
+            if(slots[i].tid == tid) return &slots[i];
+        } else if(!free_slot) free_slot = &slots[i];
+    }
+    if(free_slot) free_slot->tid = tid;
+    return free_slot;
+}
+
+/*
+ * A thread can sleep between its begin and end events and resume on another CPU, so all
+ * rings are merged by timestamp and the events are paired by the thread id they carry.
+ */
+static void trace_summary(void) {
+    uint32_t st[4], counts[16] = {0}, smp[3];
+    uint32_t pos[SMP_MAX_CPUS], end[SMP_MAX_CPUS];
+    trace_pending slots[TRACE_PAIR_SLOTS];
+    char s[16];
+    trace_stats(st);
+    smp_stats(smp);
+    terminal_write("tracepoints "); terminal_write(st[0] ? "compiled in" : "compiled out");
+    terminal_write(", recording "); terminal_write(st[1] ? "on" : "off");
+    terminal_write(", "); uint_to_str(st[2], s); terminal_write(s);
+    terminal_write(" events, "); uint_to_str(st[3], s); terminal_write(s);
+    terminal_write(" per CPU ring\n");
+
+    uint32_t cpus = smp[0] < SMP_MAX_CPUS ? smp[0] : SMP_MAX_CPUS;
+    trace_entry* buf = (trace_entry*)kmalloc(cpus * st[3] * sizeof(trace_entry));
+    if(!buf) {
+        terminal_write("trace: out of memory\n");
+        return;
+    }
+    uint32_t n = 0;
+    for(uint32_t cpu = 0; cpu < cpus; cpu++) {
+        pos[cpu] = n;
+        n += trace_read(cpu, buf + n, st[3]);
+        end[cpu] = n;
+    }
+    memset(slots, 0, sizeof(slots));
+
+    uint32_t cmds = 0, ios = 0;
+    uint64_t cmd_total = 0, cmd_max = 0, io_total = 0, io_max = 0, slowest = 0;
+    while(1) {
+        trace_entry* e = 0;
+        uint32_t from = 0;
+        for(uint32_t cpu = 0; cpu < cpus; cpu++) {
+            if(pos[cpu] < end[cpu] && (!e || buf[pos[cpu]].tsc < e->tsc)) {
+                e = &buf[pos[cpu]];
+                from = cpu;
+            }
+        }
+        if(!e) break;
+        pos[from]++;
+        if(e->event < 16) counts[e->event]++;
+
+        int begin = e->event == TRACE_CMD_BEGIN || e->event == TRACE_ATA_READ || e->event == TRACE_ATA_WRITE;
+        int finish = e->event == TRACE_CMD_END || e->event == TRACE_ATA_DONE;
+        if(!begin && !finish) continue;
+        uint32_t tid = e->event == TRACE_CMD_BEGIN || e->event == TRACE_CMD_END ? (uint32_t)e->arg1 : (uint32_t)(e->arg1 >> 32);
+        trace_pending* p = trace_pending_slot(slots, tid);
+        if(!p) continue;
+        if(e->event == TRACE_CMD_BEGIN) p->cmd_start = e->tsc;
+        else if(begin) p->io_start = e->tsc;
+        else if(e->event == TRACE_CMD_END && p->cmd_start) {
+            uint64_t t = e->tsc - p->cmd_start;
+            cmds++;
+            cmd_total += t;
+            if(t > cmd_max) { cmd_max = t; slowest = e->arg0; }
+            p->cmd_start = 0;
+        } else if(e->event == TRACE_ATA_DONE && p->io_start) {
+            uint64_t t = e->tsc - p->io_start;
+            ios++;
+            io_total += t;
+            if(t > io_max) io_max = t;
+            p->io_start = 0;
+        }
+    }
+    kfree(buf);
+
+    for(uint32_t i = 1; i < 16; i++) {
+        if(!counts[i]) continue;
+        terminal_write("  "); write_name_padded(trace_event_name(i), 12);
+        write_padded(counts[i], 8); terminal_write("\n");
+    }
+    if(cmds) {
+        terminal_write("commands: "); uint_to_str(cmds, s); terminal_write(s);
+        terminal_write(", avg "); write_usec((uint32_t)(trace_cycles_to_ns(cmd_total / cmds) / 1000));
+        terminal_write(", max "); write_usec((uint32_t)(trace_cycles_to_ns(cmd_max) / 1000));
+        terminal_write(" ("); write_packed(slowest); terminal_write(")\n");
+    }
+    if(ios) {
+        terminal_write("disk requests: "); uint_to_str(ios, s); terminal_write(s);
+        terminal_write(", avg "); write_usec((uint32_t)(trace_cycles_to_ns(io_total / ios) / 1000));
+        terminal_write(", max "); write_usec((uint32_t)(trace_cycles_to_ns(io_max) / 1000));
+        terminal_write("\n");
+    }
+}
+
+/* the newest count events of all CPUs merged by timestamp; the TSCs are assumed to be in sync */
+static void trace_dump(uint32_t count) {
+    uint32_t smp[3];
+    const char* names[1];
+    uint64_t boot_tsc = 0;
+    char s[16];
+    smp_stats(smp);
+    if(count > TRACE_DUMP_MAX) count = TRACE_DUMP_MAX;
+    trace_boot_timeline(names, &boot_tsc, 1);
+
+    trace_entry* buf = (trace_entry*)kmalloc(smp[0] * count * sizeof(trace_entry));
+    if(!buf) {
+        terminal_write("trace: out of memory\n");
+        return;
+    }
+    uint32_t n = 0;
+    for(uint32_t cpu = 0; cpu < smp[0]; cpu++) n += trace_read(cpu, buf + n, count);
+    for(uint32_t i = 1; i < n; i++) {
+        trace_entry e = buf[i];
+        uint32_t j = i;
+        for(; j > 0 && buf[j - 1].tsc > e.tsc; j--) buf[j] = buf[j - 1];
+        buf[j] = e;
+    }
+
+    terminal_write("          TIME  CPU  EVENT        ARGS\n");
+    for(uint32_t i = n > count ? n - count : 0; i < n; i++) {
+        trace_entry* e = &buf[i];
+        uint32_t us = (uint32_t)(trace_cycles_to_ns(e->tsc - boot_tsc) / 1000);
+        uint_to_str(us / 1000, s);
+        for(int k = strlen(s); k < 10; k++) terminal_write(" ");
+        terminal_write(s); terminal_write(".");
+        s[0] = '0' + (us / 100) % 10; s[1] = '0' + (us / 10) % 10; s[2] = '0' + us % 10; s[3] = '\0';
+        terminal_write(s);
+        write_padded(e->cpu, 5); terminal_write("  ");
+        write_name_padded(trace_event_name(e->event), 13);
+        if(e->event == TRACE_BOOT) terminal_write((const char*)e->arg0);
+        else if(e->event == TRACE_CMD_BEGIN || e->event == TRACE_CMD_END) write_packed(e->arg0);
+        else {
+            uint_to_str((uint32_t)e->arg0, s); terminal_write(s); terminal_write(" ");
+            uint_to_str((uint32_t)e->arg1, s); terminal_write(s);
+        }
+        terminal_write("\n");
+    }
+    kfree(buf);
+}
+
+void cmd_trace(const char* arg) {
+    uint32_t count = 20;
+    if(strcmp(arg, "") == 0 || strcmp(arg, "summary") == 0) trace_summary();
+    else if(strcmp(arg, "boot") == 0) trace_boot();
+    else if(strcmp(arg, "dump") == 0) trace_dump(count);
+    else if(strncmp(arg, "dump ", 5) == 0 && parse_uint(arg + 5, &count)) trace_dump(count);
+    else if(strcmp(arg, "clear") == 0) trace_clear();
+    else if(strcmp(arg, "on") == 0) trace_set_enabled(1);
+    else if(strcmp(arg, "off") == 0) trace_set_enabled(0);
+    else terminal_write("usage: trace [summary|boot|dump [count]|clear|on|off]\n");
+}
+
+void cmd_console(const char* arg) {
+    static const char* modes[3] = { "vga", "serial", "both" };
+    static const char* labels[6] = {
+        "tx bytes:          ", "tx dropped:        ", "tx interrupts:     ",
+        "rx bytes:          ", "rx dropped:        ", "tx queued:         "
+    };
+    if(*arg) {
+        if(console_set_mode(arg) < 0) terminal_write("usage: console [vga|serial|both] (serial needs COM1)\n");
+        return;
+    }
+    terminal_write("output:            ");
+    terminal_write(modes[console_mode()]);
+    terminal_write("\n");
+    if(!serial_is_present()) {
+        terminal_write("COM1:              not present\n");
+        return;
+    }
+    terminal_write("COM1:              16550, 115200 8N1, IRQ 4\n");
+    uint32_t st[6];
+    char s[16];
+    serial_stats(st);
+    for(int i = 0; i < 6; i++) {
+        terminal_write(labels[i]);
+        uint_to_str(st[i], s); terminal_write(s);
+        terminal_write("\n");
+    }
+}
+
+#define BENCH_MAX 32
+
+/* tenths, right-aligned in width columns */
+static void write_tenths(uint64_t tenths, int width) {
+    char s[16];
+    uint_to_str(tenths / 10 > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)(tenths / 10), s);
+    for(int i = strlen(s) + 2; i < width; i++) terminal_write(" ");
+    terminal_write(s);
+    s[0] = '.';
+    s[1] = '0' + tenths % 10;
+    s[2] = '\0';
+    terminal_write(s);
+}
+
+/* one line per case between "# bench" and "# end", so the host harness can cut them out of the serial log */
+void cmd_bench(const char* arg) {
+    uint32_t index[BENCH_MAX], ops[BENCH_MAX];
+    uint64_t cycles[BENCH_MAX];
+    int ok[BENCH_MAX];
+    uint32_t n = 0, smp[3];
+    char s[16];
+
+    for(uint32_t i = 0; i < bench_count() && n < BENCH_MAX; i++) {
+        if(strncmp(bench_name(i), arg, strlen(arg)) == 0) index[n++] = i;
+    }
+    if(!n) {
+        terminal_write("usage: bench [name prefix]\n");
+        return;
+    }
+    terminal_write("bench: running "); uint_to_str(n, s); terminal_write(s);
+    terminal_write(" cases\n");
+    terminal_flush();
+    for(uint32_t i = 0; i < n; i++) ok[i] = bench_run(index[i], &ops[i], &cycles[i]) == 0;
+
+    uint64_t khz = timer_tsc_khz();
+    smp_stats(smp);
+    terminal_write("# bench tsc_khz="); uint_to_str((uint32_t)khz, s); terminal_write(s);
+    terminal_write(" cpus="); uint_to_str(smp[0], s); terminal_write(s);
+    terminal_write("\n");
+    terminal_write("name              unit       ops    cycles/op        ns/op\n");
+    for(uint32_t i = 0; i < n; i++) {
+        write_name_padded(bench_name(index[i]), 18);
+        write_name_padded(bench_unit(index[i]), 7);
+        if(!ok[i]) {
+            terminal_write("      -      skipped\n");
+            continue;
+        }
+        uint64_t tenths = cycles[i] * 10 / ops[i];
+        write_padded(ops[i], 7);
+        write_tenths(tenths, 13);
+        write_tenths(khz ? tenths * 1000000 / khz : 0, 13);
+        terminal_write("\n");
+    }
+    terminal_write("# end\n");
+}
+
+/* QEMU's isa-debug-exit device first (the exit status becomes code * 2 + 1), then the ACPI sleep ports QEMU and Bochs use */
+void cmd_poweroff(const char* arg) {
+    uint32_t code = 0;
+    const char* rest = *arg ? parse_uint(arg, &code) : arg;
+    if(!rest || *rest || code > 255) {
+        terminal_write("usage: poweroff [exit code 0-255]\n");
+        return;
+    }
+    if(fs_mounted()) fs_sync();
+    terminal_write("powering off\n");
+    terminal_flush();
+    serial_drain();
+    if(cpu_has(CPU_FEATURE_HYPERVISOR)) {
+        outb(0xF4, (uint8_t)code);
+        outw(0x604, 0x2000);
+        outw(0xB004, 0x2000);
+    }
+    terminal_write("poweroff: no supported power-off device\n");
+}
+
 void cmd_help(void) {
     terminal_write("Commands:\n");
     terminal_write(" fetch     - System info\n");
@@ -134,18 +1090,39 @@ void cmd_help(void) {
     terminal_write(" cd [dir]  - Change directory\n");
     terminal_write(" pwd       - Working directory\n");
     terminal_write(" cat       - Display file\n");
+    terminal_write(" mkdir     - Create directory\n");
+    terminal_write(" touch     - Create empty file\n");
+    terminal_write(" rm        - Remove file or empty directory\n");
     terminal_write(" echo      - Print text\n");
     terminal_write(" uname     - System info\n");
     terminal_write(" df        - Disk usage\n");
     terminal_write(" free      - Memory usage\n");
     terminal_write(" lscpu     - CPU info\n");
     terminal_write(" lsblk     - Block devices\n");
-    terminal_write(" ps        - Processes\n");
+    terminal_write(" memmap    - Physical memory map\n");
+    terminal_write(" slabinfo  - Slab allocator statistics\n");
+    terminal_write(" vmstat    - Paging and vmalloc statistics\n");
+    terminal_write(" bcache    - Buffer cache statistics\n");
+    terminal_write(" sync      - Write back dirty buffers\n");
+    terminal_write(" ifconfig  - Network interface\n");
+    terminal_write(" arp       - ARP cache\n");
+    terminal_write(" ping      - ping <ip> [count]\n");
+    terminal_write(" udpbench  - UDP echo throughput: udpbench <ip> <port> [count] [size]\n");
+    terminal_write(" ps        - Kernel threads\n");
+    terminal_write(" perf      - Hottest kernel functions: perf top [seconds]\n");
+    terminal_write(" trace     - Event trace: trace [summary|boot|dump [n]|clear|on|off]\n");
+    terminal_write(" kill      - Stop a thread: kill <tid>\n");
+    terminal_write(" console   - Console output: console [vga|serial|both]\n");
+    terminal_write(" bench     - Microbenchmarks in TSC cycles: bench [name prefix]\n");
+    terminal_write(" poweroff  - Power off (exits QEMU): poweroff [code]\n");
     terminal_write(" env       - Environment\n");
+    terminal_write(" date      - Current date\n");
+    terminal_write(" uptime    - System uptime\n");
     terminal_write(" clear     - Clear screen\n");
 }
 
 void process_command(const char* cmd) {
+    TRACE(TRACE_CMD_BEGIN, trace_pack_string(cmd), thread_current_tid());
     if(strcmp(cmd, "fetch") == 0) cmd_fetch();
     else if(strcmp(cmd, "ls") == 0) cmd_ls(0);
     else if(strncmp(cmd, "ls ", 3) == 0) cmd_ls(cmd + 3);
@@ -153,6 +1130,9 @@ void process_command(const char* cmd) {
     else if(strncmp(cmd, "cd ", 3) == 0) cmd_cd(cmd + 3);
     else if(strcmp(cmd, "pwd") == 0) cmd_pwd();
     else if(strncmp(cmd, "cat ", 4) == 0) cmd_cat(cmd + 4);
+    else if(strncmp(cmd, "mkdir ", 6) == 0) cmd_mkdir(cmd + 6);
+    else if(strncmp(cmd, "touch ", 6) == 0) cmd_touch(cmd + 6);
+    else if(strncmp(cmd, "rm ", 3) == 0) cmd_rm(cmd + 3);
     else if(strncmp(cmd, "echo ", 5) == 0) cmd_echo(cmd + 5);
     else if(strcmp(cmd, "whoami") == 0) cmd_whoami();
     else if(strcmp(cmd, "hostname") == 0) cmd_hostname();
@@ -162,11 +1142,30 @@ void process_command(const char* cmd) {
     else if(strcmp(cmd, "free") == 0) cmd_free();
     else if(strcmp(cmd, "lscpu") == 0) cmd_lscpu();
     else if(strcmp(cmd, "lsblk") == 0) cmd_lsblk();
+    else if(strcmp(cmd, "memmap") == 0) cmd_memmap();
+    else if(strcmp(cmd, "slabinfo") == 0) cmd_slabinfo();
+    else if(strcmp(cmd, "vmstat") == 0) cmd_vmstat();
+    else if(strcmp(cmd, "bcache") == 0) cmd_bcache();
+    else if(strcmp(cmd, "sync") == 0) cmd_sync();
+    else if(strcmp(cmd, "ifconfig") == 0) cmd_ifconfig(0);
+    else if(strncmp(cmd, "ifconfig ", 9) == 0) cmd_ifconfig(cmd + 9);
+    else if(strcmp(cmd, "arp") == 0) cmd_arp();
+    else if(strncmp(cmd, "ping ", 5) == 0) cmd_ping(cmd + 5);
+    else if(strncmp(cmd, "udpbench ", 9) == 0) cmd_udpbench(cmd + 9);
     else if(strcmp(cmd, "ps") == 0) cmd_ps();
+    else if(strncmp(cmd, "trace", 5) == 0 && (cmd[5] == ' ' || cmd[5] == '\0')) cmd_trace(cmd[5] ? cmd + 6 : "");
+    else if(strncmp(cmd, "perf", 4) == 0 && (cmd[4] == ' ' || cmd[4] == '\0')) cmd_perf(cmd[4] ? cmd + 5 : "");
+    else if(strncmp(cmd, "kill ", 5) == 0) cmd_kill(cmd + 5);
+    else if(strncmp(cmd, "bench", 5) == 0 && (cmd[5] == ' ' || cmd[5] == '\0')) cmd_bench(cmd[5] ? cmd + 6 : "");
+    else if(strncmp(cmd, "poweroff", 8) == 0 && (cmd[8] == ' ' || cmd[8] == '\0')) cmd_poweroff(cmd[8] ? cmd + 9 : "");
+    else if(strncmp(cmd, "console", 7) == 0 && (cmd[7] == ' ' || cmd[7] == '\0')) cmd_console(cmd[7] ? cmd + 8 : "");
     else if(strcmp(cmd, "env") == 0) cmd_env();
+    else if(strcmp(cmd, "date") == 0) cmd_date();
+    else if(strcmp(cmd, "uptime") == 0) cmd_uptime();
     else if(strcmp(cmd, "help") == 0) cmd_help();
     else if(strcmp(cmd, "clear") == 0) terminal_clear();
     else if(strcmp(cmd, "") != 0) {
         terminal_write("bash: command not found\n");
     }
+    TRACE(TRACE_CMD_END, trace_pack_string(cmd), thread_current_tid());
 }
\ No newline at end of file
@@ -0,0 +1,595 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define TRACE_ATA_READ      4
+#define TRACE_ATA_WRITE     5
+#define TRACE_ATA_DONE      6
+
+#ifdef CONFIG_TRACE
+#define TRACE(event, arg0, arg1) trace_event(event, arg0, arg1)
+#else
+#define TRACE(event, arg0, arg1) do { } while (0)
+#endif
+
+/* the upper half names the thread, since it may finish the request on another CPU than it began it */
+#define ATA_TRACE_ARG(value) (((uint64_t)thread_current_tid() << 32) | (uint32_t)(value))
+
+#define ATA_PRIMARY_IO      0x1F0
+#define ATA_PRIMARY_CTRL    0x3F6
+#define ATA_PRIMARY_IRQ     14
+#define ATA_SECONDARY_IO    0x170
+#define ATA_SECONDARY_CTRL  0x376
+#define ATA_SECONDARY_IRQ   15
+
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_SECCOUNT    2
+#define ATA_REG_LBA0        3
+#define ATA_REG_LBA1        4
+#define ATA_REG_LBA2        5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_STATUS      7
+#define ATA_REG_COMMAND     7
+
+#define ATA_SR_ERR          0x01
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_DF           0x20
+#define ATA_SR_BSY          0x80
+
+#define ATA_CMD_READ_PIO        0x20
+#define ATA_CMD_READ_PIO_EXT    0x24
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_PIO       0x30
+#define ATA_CMD_WRITE_PIO_EXT   0x34
+#define ATA_CMD_WRITE_DMA_EXT   0x35
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_FLUSH           0xE7
+#define ATA_CMD_FLUSH_EXT       0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+
+#define BM_COMMAND          0
+#define BM_STATUS           2
+#define BM_PRDT             4
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08
+#define BM_SR_ERR           0x02
+#define BM_SR_IRQ           0x04
+#define BM_SR_DRIVE0_DMA    0x20
+#define BM_SR_DRIVE1_DMA    0x40
+
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE    0x01
+
+#define ATA_SECTOR_SIZE     512
+#define ATA_MAX_SECTORS     256
+#define ATA_LBA28_LIMIT     0x10000000UL
+#define ATA_MAX_DRIVES      4
+#define ATA_TIMEOUT_NS      2000000000UL
+#define ATA_IDENTIFY_NS     100000000UL
+#define PAGE_SIZE           4096
+#define PRD_MAX             (PAGE_SIZE / 8)
+#define PRD_EOT             0x8000
+#define DMA_LIMIT           0x100000000UL
+
+typedef struct {
+    uint32_t addr;
+    uint16_t bytes;
+    uint16_t flags;
+} __attribute__((packed)) prd_entry;
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef struct {
+    thread* owner;
+    wait_queue wait;
+} mutex;
+
+typedef struct {
+    uint16_t io;
+    uint16_t ctrl;
+    uint16_t bmide;
+    uint8_t irq;
+    uint8_t selected;
+    volatile int irq_fired;
+    volatile uint8_t irq_status;
+    volatile uint8_t bm_status;
+    wait_queue wait;
+    prd_entry* prdt;
+    mutex lock;
+} ata_channel;
+
+typedef struct {
+    volatile int done;
+    wait_queue wait;
+} completion;
+
+typedef struct work {
+    void (*fn)(void* arg);
+    void* arg;
+    completion done;
+} work;
+
+typedef struct {
+    ata_channel* channel;
+    uint8_t slave;
+    uint8_t lba48;
+    uint8_t dma;
+    uint64_t sectors;
+    char model[41];
+} ata_drive;
+
+typedef struct {
+    int (*read)(void* data, uint64_t lba, uint32_t count, void* buf);
+    int (*write)(void* data, uint64_t lba, uint32_t count, const void* buf);
+    int (*flush)(void* data);
+} block_ops;
+
+/* IDENTIFY results for one channel, filled in by its probe work item */
+typedef struct {
+    work item;
+    ata_channel* channel;
+    uint8_t present[2];
+    ata_drive found[2];
+} channel_probe;
+
+typedef struct block_device block_device;
+typedef void (*irq_handler)(void* frame);
+
+uint32_t pci_read_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset);
+void pci_write_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset, uint32_t value);
+int pci_find(uint8_t class, uint8_t subclass, uint32_t* cookie, uint8_t* bus, uint8_t* device, uint8_t* func);
+void irq_register_handler(uint8_t irq, irq_handler handler);
+block_device* block_register(const char* name, const char* model, const char* driver,
+                             uint64_t sectors, uint32_t sector_size,
+                             const block_ops* ops, void* data);
+void* alloc_page(void);
+void free_page(void* addr);
+uint64_t paging_virt_to_phys(uint64_t virt);
+uint64_t ktime_ns(void);
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns);
+void wait_queue_wake(wait_queue* wq);
+void mutex_lock(mutex* m);
+void mutex_unlock(mutex* m);
+void work_init(work* w, void (*fn)(void* arg), void* arg);
+int work_submit(work* w);
+void work_join(work* w);
+void trace_event(uint32_t event, uint64_t arg0, uint64_t arg1);
+uint32_t thread_current_tid(void);
+
+static ata_channel channels[2];
+static channel_probe probes[2];
+static ata_drive drives[ATA_MAX_DRIVES];
+static int drive_count = 0;
+static uint32_t dma_transfers = 0;
+static uint32_t pio_transfers = 0;
+static uint32_t dma_fallbacks = 0;
+static int ata_initialized = 0;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline void insw(uint16_t port, void* buf, uint32_t count) {
+    asm volatile("rep insw" : "+D"(buf), "+c"(count) : "d"(port) : "memory");
+}
+
+static inline void outsw(uint16_t port, const void* buf, uint32_t count) {
+    asm volatile("rep outsw" : "+S"(buf), "+c"(count) : "d"(port) : "memory");
+}
+
+static void ata_irq(ata_channel* ch) {
+    if (ch->bmide) {
+        ch->bm_status = inb(ch->bmide + BM_STATUS);
+        outb(ch->bmide + BM_STATUS, ch->bm_status | BM_SR_IRQ | BM_SR_ERR);
+    }
+    ch->irq_status = inb(ch->io + ATA_REG_STATUS);
+    ch->irq_fired = 1;
+    wait_queue_wake(&ch->wait);
+}
+
+static void ata_primary_irq(void* frame) {
+    ata_irq(&channels[0]);
+}
+
+static void ata_secondary_irq(void* frame) {
+    ata_irq(&channels[1]);
+}
+
+static void ata_shared_irq(void* frame) {
+    for (int i = 0; i < 2; i++) {
+        if (!channels[i].bmide || (inb(channels[i].bmide + BM_STATUS) & BM_SR_IRQ)) ata_irq(&channels[i]);
+    }
+}
+
+static void ata_delay(ata_channel* ch) {
+    for (int i = 0; i < 4; i++) inb(ch->ctrl);
+}
+
+static int ata_wait_not_busy(ata_channel* ch, uint64_t timeout_ns) {
+    uint64_t deadline = ktime_ns() + timeout_ns;
+    uint8_t status = inb(ch->ctrl);
+    while (status & ATA_SR_BSY) {
+        if (ktime_ns() >= deadline) return -1;
+        asm volatile("pause");
+        status = inb(ch->ctrl);
+    }
+    return status;
+}
+
+static int ata_wait_drq(ata_channel* ch) {
+    uint64_t deadline = ktime_ns() + ATA_TIMEOUT_NS;
+    while (1) {
+        uint8_t status = inb(ch->ctrl);
+        if (!(status & ATA_SR_BSY)) {
+            if (status & (ATA_SR_ERR | ATA_SR_DF)) return -1;
+            if (status & ATA_SR_DRQ) return 0;
+        }
+        if (ktime_ns() >= deadline) return -1;
+        asm volatile("pause");
+    }
+}
+
+/* blocks the calling thread until the channel IRQ fires; polls instead when called with IF clear */
+static int ata_wait_irq(ata_channel* ch) {
+    uint64_t deadline = ktime_ns() + ATA_TIMEOUT_NS;
+    unsigned long flags;
+    asm volatile("pushf; pop %0" : "=r"(flags));
+
+    while (1) {
+        asm volatile("cli");
+        if (ch->irq_fired) {
+            ch->irq_fired = 0;
+            if (flags & 0x200) asm volatile("sti");
+            return (ch->irq_status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+        }
+        if (ktime_ns() >= deadline) {
+            if (flags & 0x200) asm volatile("sti");
+            return -1;
+        }
+        if (flags & 0x200) {
+            wait_queue_sleep(&ch->wait, deadline);
+        } else if (!(inb(ch->ctrl) & ATA_SR_BSY)) {
+            ata_irq(ch);
+        }
+    }
+}
+
+static void ata_select(ata_channel* ch, uint8_t value) {
+    outb(ch->io + ATA_REG_DRIVE, value);
+    if ((value & 0x10) != (ch->selected & 0x10)) ata_delay(ch);
+    ch->selected = value;
+}
+
+static void ata_setup(ata_drive* d, uint64_t lba, uint32_t count, int lba48) {
+    ata_channel* ch = d->channel;
+
+    if (lba48) {
+        ata_select(ch, 0x40 | (d->slave << 4));
+        outb(ch->io + ATA_REG_SECCOUNT, (count >> 8) & 0xFF);
+        outb(ch->io + ATA_REG_LBA0, (lba >> 24) & 0xFF);
+        outb(ch->io + ATA_REG_LBA1, (lba >> 32) & 0xFF);
+        outb(ch->io + ATA_REG_LBA2, (lba >> 40) & 0xFF);
+    } else {
+        ata_select(ch, 0xE0 | (d->slave << 4) | ((lba >> 24) & 0x0F));
+    }
+    outb(ch->io + ATA_REG_SECCOUNT, count & 0xFF);
+    outb(ch->io + ATA_REG_LBA0, lba & 0xFF);
+    outb(ch->io + ATA_REG_LBA1, (lba >> 8) & 0xFF);
+    outb(ch->io + ATA_REG_LBA2, (lba >> 16) & 0xFF);
+}
+
+static int ata_pio(ata_drive* d, uint64_t lba, uint32_t count, void* buf, int write, int lba48) {
+    ata_channel* ch = d->channel;
+    uint16_t* words = (uint16_t*)buf;
+
+    if (ata_wait_not_busy(ch, ATA_TIMEOUT_NS) < 0) return -1;
+    ata_setup(d, lba, count, lba48);
+    ch->irq_fired = 0;
+    if (write) outb(ch->io + ATA_REG_COMMAND, lba48 ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO);
+    else outb(ch->io + ATA_REG_COMMAND, lba48 ? ATA_CMD_READ_PIO_EXT : ATA_CMD_READ_PIO);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (write) {
+            if (ata_wait_drq(ch) < 0) return -1;
+            outsw(ch->io + ATA_REG_DATA, words, ATA_SECTOR_SIZE / 2);
+            if (ata_wait_irq(ch) < 0) return -1;
+        } else {
+            if (ata_wait_irq(ch) < 0) return -1;
+            insw(ch->io + ATA_REG_DATA, words, ATA_SECTOR_SIZE / 2);
+        }
+        words += ATA_SECTOR_SIZE / 2;
+    }
+    pio_transfers++;
+    return 0;
+}
+
+static int ata_build_prdt(ata_channel* ch, const void* buf, uint32_t bytes) {
+    uint64_t virt = (uint64_t)buf;
+    int n = 0;
+
+    if (virt & 1) return -1;
+    while (bytes) {
+        uint32_t chunk = PAGE_SIZE - (virt & (PAGE_SIZE - 1));
+        if (chunk > bytes) chunk = bytes;
+
+        uint64_t phys = paging_virt_to_phys(virt);
+        if (!phys || phys + chunk > DMA_LIMIT || n >= PRD_MAX) return -1;
+
+        ch->prdt[n].addr = (uint32_t)phys;
+        ch->prdt[n].bytes = (uint16_t)chunk;
+        ch->prdt[n].flags = 0;
+        n++;
+        virt += chunk;
+        bytes -= chunk;
+    }
+    ch->prdt[n - 1].flags = PRD_EOT;
+    return 0;
+}
+
+static int ata_dma(ata_drive* d, uint64_t lba, uint32_t count, void* buf, int write, int lba48) {
+    ata_channel* ch = d->channel;
+    uint16_t bm = ch->bmide;
+
+    if (ata_build_prdt(ch, buf, count * ATA_SECTOR_SIZE) < 0) return -1;
+
+    outb(bm + BM_COMMAND, 0);
+    outl(bm + BM_PRDT, (uint32_t)(uint64_t)ch->prdt);
+    outb(bm + BM_STATUS, inb(bm + BM_STATUS) | BM_SR_IRQ | BM_SR_ERR);
+
+    if (ata_wait_not_busy(ch, ATA_TIMEOUT_NS) < 0) return -1;
+    ata_setup(d, lba, count, lba48);
+    ch->irq_fired = 0;
+    if (write) outb(ch->io + ATA_REG_COMMAND, lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA);
+    else outb(ch->io + ATA_REG_COMMAND, lba48 ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    outb(bm + BM_COMMAND, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+    int rc = ata_wait_irq(ch);
+    outb(bm + BM_COMMAND, 0);
+    if (rc < 0 || (ch->bm_status & BM_SR_ERR)) return -1;
+
+    dma_transfers++;
+    return 0;
+}
+
+static int ata_transfer(ata_drive* d, uint64_t lba, uint32_t count, void* buf, int write) {
+    uint8_t* p = (uint8_t*)buf;
+
+    while (count) {
+        uint32_t n = count > ATA_MAX_SECTORS ? ATA_MAX_SECTORS : count;
+        int lba48 = lba + n > ATA_LBA28_LIMIT;
+        int rc = -1;
+
+        if (lba48 && !d->lba48) return -1;
+        if (d->dma) {
+            rc = ata_dma(d, lba, n, p, write, lba48);
+            if (rc < 0) dma_fallbacks++;
+        }
+        if (rc < 0 && ata_pio(d, lba, n, p, write, lba48) < 0) return -1;
+
+        lba += n;
+        count -= n;
+        p += n * ATA_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+/* the channel lock keeps raw block users from interleaving commands with the buffer cache's */
+static int ata_read(void* data, uint64_t lba, uint32_t count, void* buf) {
+    ata_drive* d = (ata_drive*)data;
+    TRACE(TRACE_ATA_READ, lba, ATA_TRACE_ARG(count));
+    mutex_lock(&d->channel->lock);
+    int rc = ata_transfer(d, lba, count, buf, 0);
+    mutex_unlock(&d->channel->lock);
+    TRACE(TRACE_ATA_DONE, lba, ATA_TRACE_ARG(rc));
+    return rc;
+}
+
+static int ata_write(void* data, uint64_t lba, uint32_t count, const void* buf) {
+    ata_drive* d = (ata_drive*)data;
+    TRACE(TRACE_ATA_WRITE, lba, ATA_TRACE_ARG(count));
+    mutex_lock(&d->channel->lock);
+    int rc = ata_transfer(d, lba, count, (void*)buf, 1);
+    mutex_unlock(&d->channel->lock);
+    TRACE(TRACE_ATA_DONE, lba, ATA_TRACE_ARG(rc));
+    return rc;
+}
+
+static int ata_flush(void* data) {
+    ata_drive* d = (ata_drive*)data;
+    ata_channel* ch = d->channel;
+    int rc = -1;
+
+    mutex_lock(&ch->lock);
+    if (ata_wait_not_busy(ch, ATA_TIMEOUT_NS) == 0) {
+        ata_select(ch, 0xE0 | (d->slave << 4));
+        ch->irq_fired = 0;
+        outb(ch->io + ATA_REG_COMMAND, d->lba48 ? ATA_CMD_FLUSH_EXT : ATA_CMD_FLUSH);
+        rc = ata_wait_irq(ch);
+    }
+    mutex_unlock(&ch->lock);
+    return rc;
+}
+
+static const block_ops ata_ops = { ata_read, ata_write, ata_flush };
+
+static void ata_copy_model(char* model, const uint16_t* identify) {
+    int len = 0;
+    for (int i = 27; i <= 46; i++) {
+        model[len++] = (char)(identify[i] >> 8);
+        model[len++] = (char)(identify[i] & 0xFF);
+    }
+    while (len > 0 && model[len - 1] == ' ') len--;
+    model[len] = '\0';
+}
+
+static int ata_identify(ata_channel* ch, uint8_t slave, uint16_t* identify) {
+    ata_select(ch, 0xA0 | (slave << 4));
+    outb(ch->io + ATA_REG_SECCOUNT, 0);
+    outb(ch->io + ATA_REG_LBA0, 0);
+    outb(ch->io + ATA_REG_LBA1, 0);
+    outb(ch->io + ATA_REG_LBA2, 0);
+    ch->irq_fired = 0;
+    outb(ch->io + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+
+    uint8_t status = inb(ch->ctrl);
+    if (status == 0 || status == 0xFF) return -1;
+    if (ata_wait_not_busy(ch, ATA_IDENTIFY_NS) < 0) return -1;
+    if (inb(ch->io + ATA_REG_LBA1) || inb(ch->io + ATA_REG_LBA2)) return -1;
+    if (ata_wait_drq(ch) < 0) return -1;
+
+    insw(ch->io + ATA_REG_DATA, identify, 256);
+    inb(ch->io + ATA_REG_STATUS);
+    ch->irq_fired = 0;
+    return 0;
+}
+
+/* master and slave share the channel's registers, so only the two channels probe in parallel */
+static void ata_probe_channel(void* arg) {
+    channel_probe* probe = (channel_probe*)arg;
+    ata_channel* ch = probe->channel;
+    uint16_t identify[256];
+
+    for (uint8_t slave = 0; slave < 2; slave++) {
+        probe->present[slave] = 0;
+        if (ata_identify(ch, slave, identify) < 0) continue;
+
+        ata_drive* d = &probe->found[slave];
+        d->channel = ch;
+        d->slave = slave;
+        d->lba48 = (identify[83] & (1 << 10)) != 0;
+        d->dma = ch->prdt && (identify[49] & (1 << 8));
+        if (d->lba48) {
+            d->sectors = (uint64_t)identify[100] | ((uint64_t)identify[101] << 16) |
+                         ((uint64_t)identify[102] << 32) | ((uint64_t)identify[103] << 48);
+        } else {
+            d->sectors = (uint64_t)identify[60] | ((uint64_t)identify[61] << 16);
+        }
+        if (d->sectors == 0) continue;
+        ata_copy_model(d->model, identify);
+
+        if (d->dma) {
+            outb(ch->bmide + BM_STATUS, inb(ch->bmide + BM_STATUS) | (slave ? BM_SR_DRIVE1_DMA : BM_SR_DRIVE0_DMA));
+        }
+        probe->present[slave] = 1;
+    }
+}
+
+/* registration waits for both probes so sda, sdb, ... follow channel and slave order */
+static void ata_register_drives(void) {
+    for (int i = 0; i < 2; i++) {
+        for (int slave = 0; slave < 2 && drive_count < ATA_MAX_DRIVES; slave++) {
+            if (!probes[i].present[slave]) continue;
+
+            ata_drive* d = &drives[drive_count];
+            *d = probes[i].found[slave];
+            char name[4] = { 's', 'd', (char)('a' + drive_count), '\0' };
+            block_register(name, d->model, d->dma ? "ata-dma" : "ata-pio",
+                           d->sectors, ATA_SECTOR_SIZE, &ata_ops, d);
+            drive_count++;
+        }
+    }
+}
+
+static void ata_find_controller(void) {
+    uint32_t cookie = 0;
+    uint8_t bus, device, func;
+    if (!pci_find(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &cookie, &bus, &device, &func)) return;
+
+    uint32_t class_code = pci_read_config(bus, device, func, 0x08);
+    uint8_t prog_if = (class_code >> 8) & 0xFF;
+    uint8_t line = pci_read_config(bus, device, func, 0x3C) & 0xFF;
+
+    if (prog_if & 0x01) {
+        channels[0].io = pci_read_config(bus, device, func, 0x10) & 0xFFFC;
+        channels[0].ctrl = (pci_read_config(bus, device, func, 0x14) & 0xFFFC) + 2;
+        if (line < 16) channels[0].irq = line;
+    }
+    if (prog_if & 0x04) {
+        channels[1].io = pci_read_config(bus, device, func, 0x18) & 0xFFFC;
+        channels[1].ctrl = (pci_read_config(bus, device, func, 0x1C) & 0xFFFC) + 2;
+        if (line < 16) channels[1].irq = line;
+    }
+
+    uint32_t bar4 = pci_read_config(bus, device, func, 0x20);
+    if ((prog_if & 0x80) && (bar4 & 1)) {
+        uint32_t command = pci_read_config(bus, device, func, 0x04) & 0xFFFF;
+        pci_write_config(bus, device, func, 0x04, command | 0x05);
+        channels[0].bmide = bar4 & 0xFFFC;
+        channels[1].bmide = (bar4 & 0xFFFC) + 8;
+    }
+}
+
+int ata_init(void) {
+    if (ata_initialized) return drive_count;
+
+    channels[0].io = ATA_PRIMARY_IO;
+    channels[0].ctrl = ATA_PRIMARY_CTRL;
+    channels[0].irq = ATA_PRIMARY_IRQ;
+    channels[1].io = ATA_SECONDARY_IO;
+    channels[1].ctrl = ATA_SECONDARY_CTRL;
+    channels[1].irq = ATA_SECONDARY_IRQ;
+    ata_find_controller();
+
+    if (channels[0].irq == channels[1].irq) {
+        irq_register_handler(channels[0].irq, ata_shared_irq);
+    } else {
+        irq_register_handler(channels[0].irq, ata_primary_irq);
+        irq_register_handler(channels[1].irq, ata_secondary_irq);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        ata_channel* ch = &channels[i];
+        ch->selected = 0xFF;
+        outb(ch->ctrl, 0);
+
+        if (ch->bmide) {
+            ch->prdt = (prd_entry*)alloc_page();
+            if ((uint64_t)ch->prdt + PAGE_SIZE > DMA_LIMIT) {
+                free_page(ch->prdt);
+                ch->prdt = 0;
+            }
+        }
+        probes[i].channel = ch;
+        work_init(&probes[i].item, ata_probe_channel, &probes[i]);
+        if (work_submit(&probes[i].item) == -2) ata_probe_channel(&probes[i]);
+    }
+    for (int i = 0; i < 2; i++) work_join(&probes[i].item);
+    ata_register_drives();
+
+    ata_initialized = 1;
+    return drive_count;
+}
+
+/* reissues IDENTIFY DEVICE to a registered drive, sda first */
+int ata_identify_drive(uint32_t index, uint16_t* identify) {
+    if (index >= (uint32_t)drive_count) return -1;
+    ata_drive* d = &drives[index];
+    mutex_lock(&d->channel->lock);
+    int rc = ata_identify(d->channel, d->slave, identify);
+    mutex_unlock(&d->channel->lock);
+    return rc;
+}
+
+void ata_stats(uint32_t* stats) {
+    stats[0] = dma_transfers;
+    stats[1] = pio_transfers;
+    stats[2] = dma_fallbacks;
+}
@@ -1,13 +1,119 @@
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define TRACE_NET_IRQ       7
+#define TRACE_NET_TX        8
+#define TRACE_NET_RX        9
+
+#ifdef CONFIG_TRACE
+#define TRACE(event, arg0, arg1) trace_event(event, arg0, arg1)
+#else
+#define TRACE(event, arg0, arg1) do { } while (0)
+#endif
+
+#define E1000_VENDOR        0x8086
+#define E1000_MMIO_SIZE     0x20000
+
+#define E1000_CTRL          0x0000
+#define E1000_STATUS        0x0008
+#define E1000_EERD          0x0014
+#define E1000_ICR           0x00C0
+#define E1000_ITR           0x00C4
+#define E1000_IMS           0x00D0
+#define E1000_IMC           0x00D8
+#define E1000_RCTL          0x0100
+#define E1000_TCTL          0x0400
+#define E1000_TIPG          0x0410
+#define E1000_RDBAL         0x2800
+#define E1000_RDBAH         0x2804
+#define E1000_RDLEN         0x2808
+#define E1000_RDH           0x2810
+#define E1000_RDT           0x2818
+#define E1000_TDBAL         0x3800
+#define E1000_TDBAH         0x3804
+#define E1000_TDLEN         0x3808
+#define E1000_TDH           0x3810
+#define E1000_TDT           0x3818
+#define E1000_MTA           0x5200
+#define E1000_RAL           0x5400
+#define E1000_RAH           0x5404
+
+#define CTRL_FD             (1 << 0)
+#define CTRL_ASDE           (1 << 5)
+#define CTRL_SLU            (1 << 6)
+#define CTRL_RST            (1 << 26)
+#define STATUS_FD           (1 << 0)
+#define STATUS_LU           (1 << 1)
+#define EERD_START          (1 << 0)
+#define EERD_DONE           (1 << 4)
+#define RAH_AV              (1u << 31)
+
+#define RCTL_EN             (1 << 1)
+#define RCTL_UPE            (1 << 3)
+#define RCTL_MPE            (1 << 4)
+#define RCTL_BAM            (1 << 15)
+#define RCTL_SECRC          (1 << 26)
+#define TCTL_EN             (1 << 1)
+#define TCTL_PSP            (1 << 3)
+#define TCTL_CT             (0x10 << 4)
+#define TCTL_COLD           (0x40 << 12)
+#define TIPG_DEFAULT        0x0060200A
+
+#define ICR_LSC             (1 << 2)
+#define ICR_RXDMT0          (1 << 4)
+#define ICR_RXO             (1 << 6)
+#define ICR_RXT0            (1 << 7)
+
+#define TXD_CMD_EOP         (1 << 0)
+#define TXD_CMD_IFCS        (1 << 1)
+#define TXD_CMD_RS          (1 << 3)
+#define TXD_STAT_DD         (1 << 0)
+#define RXD_STAT_DD         (1 << 0)
+#define RXD_STAT_EOP        (1 << 1)
+
+#define RX_RING_SIZE        256
+#define TX_RING_SIZE        256
+#define RX_REFILL_BATCH     16
+#define TX_BATCH            16
+#define ITR_INTERVAL        976
+#define PAGE_SIZE           4096
+#define ETH_HEADER_LEN      14
+#define ETH_MTU             1500
+#define ETH_MAX_FRAME       1522
+#define TX_MAX_SEGMENTS     8
+#define EEPROM_TIMEOUT_NS   10000000UL
+#define RESET_TIMEOUT_NS    10000000UL
+
+typedef struct pbuf {
+    struct pbuf* next;
+    uint8_t* payload;
+    uint16_t len;
+    uint16_t tot_len;
+    uint16_t refcount;
+    uint16_t flags;
+    uint8_t* buffer;
+} pbuf;
+
+typedef struct {
+    uint64_t addr;
+    uint16_t length;
+    uint16_t checksum;
+    uint8_t status;
+    uint8_t errors;
+    uint16_t special;
+} __attribute__((packed)) rx_desc;
 
 typedef struct {
-    uint8_t dest_mac[6];
-    uint8_t src_mac[6];
-    uint16_t ethertype;
-    uint8_t payload[1500];
-} __attribute__((packed)) ethernet_frame;
+    uint64_t addr;
+    uint16_t length;
+    uint8_t cso;
+    uint8_t cmd;
+    uint8_t status;
+    uint8_t css;
+    uint16_t special;
+} __attribute__((packed)) tx_desc;
 
 typedef struct {
     uint8_t mac_address[6];
@@ -18,57 +124,208 @@ typedef struct {
     uint32_t tx_packets;
     uint32_t rx_errors;
     uint32_t tx_errors;
+    uint32_t rx_dropped;
+    uint32_t tx_dropped;
 } nic_status;
 
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef void (*irq_handler)(void* frame);
+
+uint32_t pci_read_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset);
+void pci_write_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset, uint32_t value);
+int pci_find(uint8_t class, uint8_t subclass, uint32_t* cookie, uint8_t* bus, uint8_t* device, uint8_t* func);
+void irq_register_handler(uint8_t irq, irq_handler handler);
+void* paging_map_mmio(uint64_t phys, uint64_t size);
+void* alloc_page(void);
+uint64_t ktime_ns(void);
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns);
+void wait_queue_wake(wait_queue* wq);
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+int pbuf_init(void);
+pbuf* pbuf_alloc(uint16_t len);
+void pbuf_free(pbuf* p);
+int pbuf_header(pbuf* p, int delta);
+uint16_t pbuf_copy_out(const pbuf* p, uint16_t offset, void* buf, uint16_t len);
+uint16_t pbuf_copy_in(pbuf* p, uint16_t offset, const void* buf, uint16_t len);
+void trace_event(uint32_t event, uint64_t arg0, uint64_t arg1);
+
 static nic_status nic_info = {0};
 static int ethernet_initialized = 0;
+static volatile uint32_t* mmio = 0;
+static uint8_t nic_irq = 0;
+static uint16_t nic_device_id = 0;
+static rx_desc* rx_ring = 0;
+static tx_desc* tx_ring = 0;
+static pbuf* rx_pbufs[RX_RING_SIZE];
+static pbuf* tx_pbufs[TX_RING_SIZE];
+static uint32_t rx_next = 0;
+static uint32_t rx_unreturned = 0;
+static uint32_t tx_next = 0;
+static uint32_t tx_clean = 0;
+static uint32_t tx_unflushed = 0;
+static int tx_batch_depth = 0;
+static volatile uint32_t rx_irq_count = 0;
+static wait_queue rx_wait;
+static spinlock tx_lock;
+static spinlock rx_lock;
+static uint32_t irq_count = 0;
+static uint32_t rx_overruns = 0;
+static uint32_t tx_flushes = 0;
+
+static inline uint32_t reg_read(uint32_t reg) {
+    return mmio[reg / 4];
+}
 
-static inline void outl(uint16_t port, uint32_t val) {
-    asm volatile("outl %0, %1" : : "a"(val), "Nd"(port));
+static inline void reg_write(uint32_t reg, uint32_t value) {
+    mmio[reg / 4] = value;
 }
 
-static inline uint32_t inl(uint16_t port) {
-    uint32_t ret;
-    asm volatile("inl %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
 }
 
-uint32_t pci_read_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset) {
-    uint32_t address = (uint32_t)((bus << 16) | (device << 11) | (func << 8) | (offset & 0xFC) | 0x80000000);
-    
-    outl(0xCF8, address);
-    
-    return inl(0xCFC);
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
 }
 
-void pci_write_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset, uint32_t value) {
-    uint32_t address = (uint32_t)((bus << 16) | (device << 11) | (func << 8) | (offset & 0xFC) | 0x80000000);
-    
-    outl(0xCF8, address);
-    outl(0xCFC, value);
+/* 8254x parts that share the 82540EM register layout and EERD format */
+static int e1000_supported(uint16_t device_id) {
+    switch (device_id) {
+        case 0x100E: case 0x100F: case 0x1004: case 0x1015: case 0x1016: case 0x1017:
+            return 1;
+        default:
+            return 0;
+    }
 }
 
 int ethernet_detect_controller(void) {
-    for (uint8_t bus = 0; bus < 8; bus++) {
-        for (uint8_t device = 0; device < 32; device++) {
-            uint32_t vendor_device = pci_read_config(bus, device, 0, 0);
-            
-            if (vendor_device == 0xFFFFFFFF || vendor_device == 0) {
-                continue;
-            }
-            
-            uint32_t class_code = pci_read_config(bus, device, 0, 0x08);
-            uint8_t class = (class_code >> 24) & 0xFF;
-            uint8_t subclass = (class_code >> 16) & 0xFF;
-            
-            if (class == 0x02 && subclass == 0x00) {
-                uint16_t vendor = vendor_device & 0xFFFF;
-                uint16_t device_id = (vendor_device >> 16) & 0xFFFF;
-                
-                return 1;
-            }
+    uint32_t cookie = 0;
+    uint8_t bus, device, func;
+    while (pci_find(0x02, 0x00, &cookie, &bus, &device, &func)) {
+        uint32_t vendor_device = pci_read_config(bus, device, func, 0);
+        uint16_t vendor = vendor_device & 0xFFFF;
+        uint16_t device_id = (vendor_device >> 16) & 0xFFFF;
+        if (vendor != E1000_VENDOR || !e1000_supported(device_id)) continue;
+
+        uint32_t bar0 = pci_read_config(bus, device, func, 0x10);
+        if (bar0 & 1) continue;
+        uint64_t phys = bar0 & ~0xFUL;
+        if ((bar0 & 0x6) == 0x4) phys |= (uint64_t)pci_read_config(bus, device, func, 0x14) << 32;
+
+        uint32_t command = pci_read_config(bus, device, func, 0x04) & 0xFFFF;
+        pci_write_config(bus, device, func, 0x04, command | 0x06);
+
+        mmio = (volatile uint32_t*)paging_map_mmio(phys, E1000_MMIO_SIZE);
+        if (!mmio) return 0;
+        nic_irq = pci_read_config(bus, device, func, 0x3C) & 0xFF;
+        nic_device_id = device_id;
+        return 1;
+    }
+    return 0;
+}
+
+static int eeprom_read(uint8_t word, uint16_t* value) {
+    uint64_t deadline = ktime_ns() + EEPROM_TIMEOUT_NS;
+    reg_write(E1000_EERD, ((uint32_t)word << 8) | EERD_START);
+    while (!(reg_read(E1000_EERD) & EERD_DONE)) {
+        if (ktime_ns() >= deadline) return -1;
+        asm volatile("pause");
+    }
+    *value = (uint16_t)(reg_read(E1000_EERD) >> 16);
+    return 0;
+}
+
+static void read_mac(void) {
+    uint16_t words[3];
+    if (eeprom_read(0, &words[0]) == 0 && eeprom_read(1, &words[1]) == 0 && eeprom_read(2, &words[2]) == 0) {
+        for (int i = 0; i < 3; i++) {
+            nic_info.mac_address[i * 2] = words[i] & 0xFF;
+            nic_info.mac_address[i * 2 + 1] = words[i] >> 8;
         }
+        return;
+    }
+
+    /* no EEPROM: keep whatever the firmware left in receive address 0 */
+    uint32_t low = reg_read(E1000_RAL);
+    uint32_t high = reg_read(E1000_RAH);
+    for (int i = 0; i < 4; i++) nic_info.mac_address[i] = (low >> (i * 8)) & 0xFF;
+    nic_info.mac_address[4] = high & 0xFF;
+    nic_info.mac_address[5] = (high >> 8) & 0xFF;
+}
+
+static void write_mac(void) {
+    const uint8_t* mac = nic_info.mac_address;
+    reg_write(E1000_RAL, mac[0] | (mac[1] << 8) | (mac[2] << 16) | ((uint32_t)mac[3] << 24));
+    reg_write(E1000_RAH, mac[4] | (mac[5] << 8) | RAH_AV);
+}
+
+static void update_link(void) {
+    uint32_t status = reg_read(E1000_STATUS);
+    static const int speeds[4] = {10, 100, 1000, 1000};
+    nic_info.link_up = (status & STATUS_LU) != 0;
+    nic_info.duplex_full = (status & STATUS_FD) != 0;
+    nic_info.speed_mbps = speeds[(status >> 6) & 3];
+}
+
+static void ethernet_irq(void* frame) {
+    uint32_t cause = reg_read(E1000_ICR);
+    TRACE(TRACE_NET_IRQ, cause, 0);
+    irq_count++;
+    if (cause & ICR_LSC) update_link();
+    if (cause & ICR_RXO) rx_overruns++;
+    if (cause & (ICR_RXT0 | ICR_RXDMT0 | ICR_RXO)) {
+        rx_irq_count++;
+        wait_queue_wake(&rx_wait);
+    }
+}
+
+/* receive descriptors point straight at pool buffers; without RCTL.LPE the NIC writes at most 1522 bytes */
+static int rings_init(void) {
+    rx_ring = (rx_desc*)alloc_page();
+    tx_ring = (tx_desc*)alloc_page();
+    if (!rx_ring || !tx_ring || pbuf_init() < 0) return -1;
+
+    for (int i = 0; i < RX_RING_SIZE; i++) {
+        rx_pbufs[i] = pbuf_alloc(ETH_MAX_FRAME);
+        if (!rx_pbufs[i]) return -1;
+        rx_ring[i].addr = (uint64_t)rx_pbufs[i]->payload;
+        rx_ring[i].status = 0;
     }
+    for (int i = 0; i < TX_RING_SIZE; i++) {
+        tx_pbufs[i] = 0;
+        tx_ring[i].addr = 0;
+        tx_ring[i].cmd = 0;
+        tx_ring[i].status = TXD_STAT_DD;
+    }
+
+    reg_write(E1000_RDBAL, (uint32_t)(uint64_t)rx_ring);
+    reg_write(E1000_RDBAH, (uint32_t)((uint64_t)rx_ring >> 32));
+    reg_write(E1000_RDLEN, RX_RING_SIZE * sizeof(rx_desc));
+    reg_write(E1000_RDH, 0);
+    reg_write(E1000_RDT, RX_RING_SIZE - 1);
+    reg_write(E1000_RCTL, RCTL_EN | RCTL_BAM | RCTL_SECRC);
+
+    reg_write(E1000_TDBAL, (uint32_t)(uint64_t)tx_ring);
+    reg_write(E1000_TDBAH, (uint32_t)((uint64_t)tx_ring >> 32));
+    reg_write(E1000_TDLEN, TX_RING_SIZE * sizeof(tx_desc));
+    reg_write(E1000_TDH, 0);
+    reg_write(E1000_TDT, 0);
+    reg_write(E1000_TIPG, TIPG_DEFAULT);
+    reg_write(E1000_TCTL, TCTL_EN | TCTL_PSP | TCTL_CT | TCTL_COLD);
     return 0;
 }
 
@@ -76,26 +333,37 @@ int ethernet_init(void) {
     if (ethernet_initialized) {
         return 0;
     }
-    
+
     if (!ethernet_detect_controller()) {
         return -1;
     }
-    
-    nic_info.mac_address[0] = 0x52;
-    nic_info.mac_address[1] = 0x54;
-    nic_info.mac_address[2] = 0x00;
-    nic_info.mac_address[3] = 0x12;
-    nic_info.mac_address[4] = 0x34;
-    nic_info.mac_address[5] = 0x56;
-    
-    nic_info.link_up = 0;
-    nic_info.speed_mbps = 1000;
-    nic_info.duplex_full = 1;
+
+    reg_write(E1000_IMC, 0xFFFFFFFF);
+    reg_write(E1000_CTRL, reg_read(E1000_CTRL) | CTRL_RST);
+    uint64_t deadline = ktime_ns() + RESET_TIMEOUT_NS;
+    while ((reg_read(E1000_CTRL) & CTRL_RST) && ktime_ns() < deadline) asm volatile("pause");
+    reg_write(E1000_IMC, 0xFFFFFFFF);
+    reg_read(E1000_ICR);
+
+    read_mac();
+    write_mac();
+    for (int i = 0; i < 128; i++) reg_write(E1000_MTA + i * 4, 0);
+    reg_write(E1000_CTRL, (reg_read(E1000_CTRL) | CTRL_SLU | CTRL_ASDE) & ~CTRL_RST);
+
+    if (rings_init() < 0) {
+        return -1;
+    }
+
     nic_info.rx_packets = 0;
     nic_info.tx_packets = 0;
     nic_info.rx_errors = 0;
     nic_info.tx_errors = 0;
-    
+    update_link();
+
+    reg_write(E1000_ITR, ITR_INTERVAL);
+    irq_register_handler(nic_irq, ethernet_irq);
+    reg_write(E1000_IMS, ICR_LSC | ICR_RXDMT0 | ICR_RXO | ICR_RXT0);
+
     ethernet_initialized = 1;
     return 0;
 }
@@ -110,17 +378,23 @@ void ethernet_set_mac(const uint8_t* mac) {
     for (int i = 0; i < 6; i++) {
         nic_info.mac_address[i] = mac[i];
     }
+    if (ethernet_initialized) write_mac();
 }
 
 int ethernet_get_link_status(void) {
+    if (ethernet_initialized) update_link();
     return nic_info.link_up;
 }
 
+/* forces the link down by clearing Set Link Up, or lets autonegotiation bring it back */
 void ethernet_set_link_status(int up) {
-    nic_info.link_up = up;
+    if (!ethernet_initialized) return;
+    uint32_t ctrl = reg_read(E1000_CTRL);
+    reg_write(E1000_CTRL, up ? (ctrl | CTRL_SLU) : (ctrl & ~CTRL_SLU));
+    update_link();
 }
 
-void ethernet_get_stats(uint32_t* rx_packets, uint32_t* tx_packets, 
+void ethernet_get_stats(uint32_t* rx_packets, uint32_t* tx_packets,
                         uint32_t* rx_errors, uint32_t* tx_errors) {
     if (rx_packets) *rx_packets = nic_info.rx_packets;
     if (tx_packets) *tx_packets = nic_info.tx_packets;
@@ -128,28 +402,210 @@ void ethernet_get_stats(uint32_t* rx_packets, uint32_t* tx_packets,
     if (tx_errors) *tx_errors = nic_info.tx_errors;
 }
 
-int ethernet_send_frame(const uint8_t* dest_mac, const uint8_t* data, uint16_t length) {
-    if (!ethernet_initialized || !nic_info.link_up) {
+static void tx_reclaim(void) {
+    while (tx_clean != tx_next && (tx_ring[tx_clean].status & TXD_STAT_DD)) {
+        if (tx_pbufs[tx_clean]) {
+            pbuf_free(tx_pbufs[tx_clean]);
+            tx_pbufs[tx_clean] = 0;
+        }
+        tx_clean = (tx_clean + 1) % TX_RING_SIZE;
+    }
+}
+
+static void tx_flush(void) {
+    if (!tx_unflushed) return;
+    asm volatile("sfence" : : : "memory");
+    reg_write(E1000_TDT, tx_next);
+    tx_unflushed = 0;
+    tx_flushes++;
+}
+
+/* frames queued between begin and end share one tail write, like terminal_defer_begin/end */
+/* netd and the shell can both be inside a batch, so the depth only changes under tx_lock */
+void ethernet_tx_batch_begin(void) {
+    unsigned long flags = spin_lock_irqsave(&tx_lock);
+    tx_batch_depth++;
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+void ethernet_tx_batch_end(void) {
+    unsigned long flags = spin_lock_irqsave(&tx_lock);
+    if (tx_batch_depth > 0 && --tx_batch_depth == 0) tx_flush();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+/* queues a complete frame, one descriptor per chain segment; the driver owns p afterwards */
+int ethernet_transmit(pbuf* p) {
+    TRACE(TRACE_NET_TX, p->tot_len, 0);
+    if (!ethernet_initialized || !nic_info.link_up || p->tot_len > ETH_MAX_FRAME) {
+        nic_info.tx_dropped++;
+        pbuf_free(p);
         return -1;
     }
-    
-    if (length > 1500) {
-        return -2;
+
+    uint32_t segments = 0;
+    for (pbuf* q = p; q; q = q->next) {
+        if (q->len) segments++;
+    }
+
+    unsigned long flags = spin_lock_irqsave(&tx_lock);
+    tx_reclaim();
+    uint32_t free_slots = (tx_clean + TX_RING_SIZE - tx_next - 1) % TX_RING_SIZE;
+    if (segments == 0 || segments > TX_MAX_SEGMENTS || segments > free_slots) {
+        tx_flush();
+        nic_info.tx_dropped++;
+        spin_unlock_irqrestore(&tx_lock, flags);
+        pbuf_free(p);
+        return -1;
     }
-    
+
+    uint32_t last = tx_next;
+    for (pbuf* q = p; q; q = q->next) {
+        if (!q->len) continue;
+        tx_desc* d = &tx_ring[tx_next];
+        d->addr = (uint64_t)q->payload;
+        d->length = q->len;
+        d->cso = 0;
+        d->css = 0;
+        d->special = 0;
+        d->status = 0;
+        d->cmd = TXD_CMD_IFCS;
+        last = tx_next;
+        tx_next = (tx_next + 1) % TX_RING_SIZE;
+        tx_unflushed++;
+    }
+    tx_ring[last].cmd |= TXD_CMD_EOP | TXD_CMD_RS;
+    tx_pbufs[last] = p;
     nic_info.tx_packets++;
+
+    if (tx_batch_depth == 0 || tx_unflushed >= TX_BATCH) tx_flush();
+    spin_unlock_irqrestore(&tx_lock, flags);
     return 0;
 }
 
-int ethernet_recv_frame(uint8_t* src_mac, uint8_t* data, uint16_t* length) {
+/* prepends the Ethernet header in the pbuf's headroom and transmits it */
+int ethernet_output(pbuf* p, const uint8_t* dest_mac, uint16_t ethertype) {
+    if (pbuf_header(p, ETH_HEADER_LEN) < 0) {
+        nic_info.tx_dropped++;
+        pbuf_free(p);
+        return -1;
+    }
+    uint8_t* h = p->payload;
+    for (int i = 0; i < 6; i++) {
+        h[i] = dest_mac[i];
+        h[6 + i] = nic_info.mac_address[i];
+    }
+    h[12] = ethertype >> 8;
+    h[13] = ethertype & 0xFF;
+    return ethernet_transmit(p);
+}
+
+int ethernet_send_frame(const uint8_t* dest_mac, uint16_t ethertype, const uint8_t* data, uint16_t length) {
     if (!ethernet_initialized || !nic_info.link_up) {
         return -1;
     }
-    
-    return -1;
+
+    if (length > ETH_MTU) {
+        return -2;
+    }
+
+    pbuf* p = pbuf_alloc(length);
+    if (!p) {
+        nic_info.tx_dropped++;
+        return -1;
+    }
+    pbuf_copy_in(p, 0, data, length);
+    return ethernet_output(p, dest_mac, ethertype);
+}
+
+static void rx_return(void) {
+    if (!rx_unreturned) return;
+    asm volatile("sfence" : : : "memory");
+    reg_write(E1000_RDT, (rx_next + RX_RING_SIZE - 1) % RX_RING_SIZE);
+    rx_unreturned = 0;
+}
+
+/* hands the next good frame (header included) to the caller and puts a fresh pool buffer in its slot */
+pbuf* ethernet_recv(void) {
+    if (!ethernet_initialized) {
+        return 0;
+    }
+
+    unsigned long flags = spin_lock_irqsave(&rx_lock);
+    while (rx_ring[rx_next].status & RXD_STAT_DD) {
+        rx_desc* d = &rx_ring[rx_next];
+        pbuf* p = rx_pbufs[rx_next];
+        pbuf* fresh = 0;
+        int ok = (d->status & RXD_STAT_EOP) && !d->errors && d->length >= ETH_HEADER_LEN &&
+                 d->length <= ETH_MAX_FRAME;
+
+        if (!ok) {
+            nic_info.rx_errors++;
+        } else if (!(fresh = pbuf_alloc(ETH_MAX_FRAME))) {
+            nic_info.rx_dropped++;
+        } else {
+            p->len = d->length;
+            p->tot_len = d->length;
+            rx_pbufs[rx_next] = fresh;
+            d->addr = (uint64_t)fresh->payload;
+            nic_info.rx_packets++;
+        }
+
+        d->status = 0;
+        rx_next = (rx_next + 1) % RX_RING_SIZE;
+        /* descriptors go back to the NIC in groups to save tail writes */
+        if (++rx_unreturned >= RX_REFILL_BATCH || !(rx_ring[rx_next].status & RXD_STAT_DD)) rx_return();
+        if (fresh) {
+            spin_unlock_irqrestore(&rx_lock, flags);
+            TRACE(TRACE_NET_RX, p->len, 0);
+            return p;
+        }
+    }
+    rx_return();
+    spin_unlock_irqrestore(&rx_lock, flags);
+    return 0;
+}
+
+int ethernet_recv_frame(uint8_t* src_mac, uint16_t* ethertype, uint8_t* data, uint16_t* length) {
+    pbuf* p = ethernet_recv();
+    if (!p) {
+        return -1;
+    }
+
+    uint8_t* h = p->payload;
+    for (int i = 0; i < 6; i++) src_mac[i] = h[6 + i];
+    *ethertype = (uint16_t)((h[12] << 8) | h[13]);
+    uint16_t payload = p->len - ETH_HEADER_LEN;
+    if (payload > ETH_MTU) payload = ETH_MTU;
+    *length = pbuf_copy_out(p, ETH_HEADER_LEN, data, payload);
+    pbuf_free(p);
+    return 0;
+}
+
+/* blocks until a receive interrupt arrives or timeout_ms passes; returns 1 if frames may be waiting */
+int ethernet_wait_rx(uint32_t timeout_ms) {
+    if (!ethernet_initialized) return 0;
+    uint64_t deadline = ktime_ns() + (uint64_t)timeout_ms * 1000000;
+    uint32_t seen = rx_irq_count;
+    unsigned long flags = irq_save();
+
+    while (!(rx_ring[rx_next].status & RXD_STAT_DD)) {
+        if (rx_irq_count != seen || ktime_ns() >= deadline) break;
+        if (flags & 0x200) wait_queue_sleep(&rx_wait, deadline);
+        else asm volatile("pause");
+    }
+    irq_restore(flags);
+    return (rx_ring[rx_next].status & RXD_STAT_DD) != 0;
 }
 
 void ethernet_set_promiscuous(int enable) {
+    if (!ethernet_initialized) return;
+    uint32_t rctl = reg_read(E1000_RCTL);
+    reg_write(E1000_RCTL, enable ? (rctl | RCTL_UPE | RCTL_MPE) : (rctl & ~(RCTL_UPE | RCTL_MPE)));
+}
+
+int ethernet_get_promiscuous(void) {
+    return ethernet_initialized && (reg_read(E1000_RCTL) & RCTL_UPE) != 0;
 }
 
 int ethernet_is_initialized(void) {
@@ -158,11 +614,13 @@ int ethernet_is_initialized(void) {
 
 void ethernet_reset(void) {
     if (!ethernet_initialized) return;
-    
+
     nic_info.rx_packets = 0;
     nic_info.tx_packets = 0;
     nic_info.rx_errors = 0;
     nic_info.tx_errors = 0;
+    nic_info.rx_dropped = 0;
+    nic_info.tx_dropped = 0;
 }
 
 int ethernet_get_speed(void) {
@@ -171,4 +629,20 @@ int ethernet_get_speed(void) {
 
 int ethernet_is_full_duplex(void) {
     return nic_info.duplex_full;
-}
\ No newline at end of file
+}
+
+uint16_t ethernet_device_id(void) {
+    return nic_device_id;
+}
+
+void ethernet_get_drops(uint32_t* rx_dropped, uint32_t* tx_dropped) {
+    if (rx_dropped) *rx_dropped = nic_info.rx_dropped;
+    if (tx_dropped) *tx_dropped = nic_info.tx_dropped;
+}
+
+void ethernet_driver_stats(uint32_t* stats) {
+    stats[0] = irq_count;
+    stats[1] = rx_overruns;
+    stats[2] = tx_flushes;
+    stats[3] = nic_irq;
+}
@@ -0,0 +1,106 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define KBD_DATA_PORT       0x60
+#define KBD_STATUS_PORT     0x64
+#define KBD_COMMAND_PORT    0x64
+#define KBD_STATUS_OUTPUT   0x01
+#define KBD_STATUS_INPUT    0x02
+#define KBD_IRQ             1
+#define KBD_RING_SIZE       256
+#define TRACE_KBD_IRQ       10
+
+#ifdef CONFIG_TRACE
+#define TRACE(event, arg0, arg1) trace_event(event, arg0, arg1)
+#else
+#define TRACE(event, arg0, arg1) do { } while (0)
+#endif
+
+typedef void (*irq_handler)(void* frame);
+
+void irq_register_handler(uint8_t irq, irq_handler handler);
+void console_input_wake(void);
+void trace_event(uint32_t event, uint64_t arg0, uint64_t arg1);
+
+static volatile uint8_t kbd_ring[KBD_RING_SIZE];
+static volatile uint32_t kbd_head = 0;
+static volatile uint32_t kbd_tail = 0;
+static uint32_t kbd_dropped = 0;
+static int keyboard_initialized = 0;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static void kbd_wait_input_clear(void) {
+    for (int i = 0; i < 100000; i++) {
+        if (!(inb(KBD_STATUS_PORT) & KBD_STATUS_INPUT)) return;
+    }
+}
+
+static void keyboard_irq(void* frame) {
+    uint8_t scancode = inb(KBD_DATA_PORT);
+    uint32_t head = kbd_head;
+    TRACE(TRACE_KBD_IRQ, scancode, 0);
+
+    if (head - kbd_tail >= KBD_RING_SIZE) {
+        kbd_dropped++;
+        return;
+    }
+
+    kbd_ring[head & (KBD_RING_SIZE - 1)] = scancode;
+    asm volatile("" ::: "memory");
+    kbd_head = head + 1;
+    console_input_wake();
+}
+
+int keyboard_poll(uint8_t* scancode) {
+    uint32_t tail = kbd_tail;
+
+    if (tail == kbd_head) {
+        return 0;
+    }
+
+    asm volatile("" ::: "memory");
+    *scancode = kbd_ring[tail & (KBD_RING_SIZE - 1)];
+    asm volatile("" ::: "memory");
+    kbd_tail = tail + 1;
+    return 1;
+}
+
+uint32_t keyboard_get_dropped(void) {
+    return kbd_dropped;
+}
+
+int keyboard_init(void) {
+    if (keyboard_initialized) {
+        return 0;
+    }
+
+    while (inb(KBD_STATUS_PORT) & KBD_STATUS_OUTPUT) {
+        inb(KBD_DATA_PORT);
+    }
+
+    kbd_wait_input_clear();
+    outb(KBD_COMMAND_PORT, 0x20);
+    for (int i = 0; i < 100000 && !(inb(KBD_STATUS_PORT) & KBD_STATUS_OUTPUT); i++);
+    uint8_t config = inb(KBD_DATA_PORT);
+
+    config |= 0x01;
+    kbd_wait_input_clear();
+    outb(KBD_COMMAND_PORT, 0x60);
+    kbd_wait_input_clear();
+    outb(KBD_DATA_PORT, config);
+
+    irq_register_handler(KBD_IRQ, keyboard_irq);
+    keyboard_initialized = 1;
+    return 0;
+}
@@ -0,0 +1,113 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+
+#define CMOS_ADDRESS    0x70
+#define CMOS_DATA       0x71
+#define RTC_SECONDS     0x00
+#define RTC_MINUTES     0x02
+#define RTC_HOURS       0x04
+#define RTC_DAY         0x07
+#define RTC_MONTH       0x08
+#define RTC_YEAR        0x09
+#define RTC_CENTURY     0x32
+#define RTC_STATUS_A    0x0A
+#define RTC_STATUS_B    0x0B
+
+typedef struct {
+    uint32_t second;
+    uint32_t minute;
+    uint32_t hour;
+    uint32_t day;
+    uint32_t month;
+    uint32_t year;
+} rtc_time;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static uint8_t cmos_read(uint8_t reg) {
+    outb(CMOS_ADDRESS, reg);
+    return inb(CMOS_DATA);
+}
+
+static int rtc_update_in_progress(void) {
+    return (cmos_read(RTC_STATUS_A) & 0x80) != 0;
+}
+
+static void rtc_read_raw(rtc_time* t, uint8_t* century) {
+    while (rtc_update_in_progress());
+
+    t->second = cmos_read(RTC_SECONDS);
+    t->minute = cmos_read(RTC_MINUTES);
+    t->hour = cmos_read(RTC_HOURS);
+    t->day = cmos_read(RTC_DAY);
+    t->month = cmos_read(RTC_MONTH);
+    t->year = cmos_read(RTC_YEAR);
+    *century = cmos_read(RTC_CENTURY);
+}
+
+static uint32_t bcd_to_bin(uint32_t value) {
+    return (value & 0x0F) + ((value >> 4) * 10);
+}
+
+void rtc_read(rtc_time* t) {
+    rtc_time last;
+    uint8_t century, last_century;
+
+    rtc_read_raw(t, &century);
+    do {
+        last = *t;
+        last_century = century;
+        rtc_read_raw(t, &century);
+    } while (last.second != t->second || last.minute != t->minute ||
+             last.hour != t->hour || last.day != t->day ||
+             last.month != t->month || last.year != t->year ||
+             last_century != century);
+
+    uint8_t status_b = cmos_read(RTC_STATUS_B);
+
+    if (!(status_b & 0x04)) {
+        t->second = bcd_to_bin(t->second);
+        t->minute = bcd_to_bin(t->minute);
+        t->hour = bcd_to_bin(t->hour & 0x7F) | (t->hour & 0x80);
+        t->day = bcd_to_bin(t->day);
+        t->month = bcd_to_bin(t->month);
+        t->year = bcd_to_bin(t->year);
+        century = bcd_to_bin(century);
+    }
+
+    if (!(status_b & 0x02) && (t->hour & 0x80)) {
+        t->hour = ((t->hour & 0x7F) + 12) % 24;
+    }
+
+    if (century >= 19 && century <= 30) {
+        t->year += century * 100;
+    } else {
+        t->year += (t->year < 70) ? 2000 : 1900;
+    }
+}
+
+uint32_t rtc_days_since_epoch(uint32_t year, uint32_t month, uint32_t day) {
+    int y = (int)year - (month <= 2);
+    int era = y / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t mp = (month + 9) % 12;
+    uint32_t doy = (153 * mp + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (uint32_t)(era * 146097 + (int)doe - 719468);
+}
+
+uint32_t rtc_epoch_seconds(void) {
+    rtc_time t;
+    rtc_read(&t);
+    return rtc_days_since_epoch(t.year, t.month, t.day) * 86400 +
+           t.hour * 3600 + t.minute * 60 + t.second;
+}
@@ -0,0 +1,218 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define COM1_PORT           0x3F8
+#define COM1_IRQ            4
+#define SERIAL_BAUD         115200
+#define SERIAL_FIFO_DEPTH   16
+#define SERIAL_TX_SIZE      16384
+#define SERIAL_RX_SIZE      256
+
+#define UART_DATA           0
+#define UART_DLL            0
+#define UART_DLM            1
+#define UART_IER            1
+#define UART_IIR            2
+#define UART_FCR            2
+#define UART_LCR            3
+#define UART_MCR            4
+#define UART_LSR            5
+#define UART_MSR            6
+
+#define IER_RX              0x01
+#define IER_THRE            0x02
+#define IER_LINE            0x04
+#define IIR_NONE            0x01
+#define IIR_ID_MASK         0x0E
+#define IIR_THRE            0x02
+#define IIR_RX              0x04
+#define IIR_LINE            0x06
+#define IIR_TIMEOUT         0x0C
+#define FCR_ENABLE_CLEAR    0x07
+#define FCR_TRIGGER_14      0xC0
+#define LCR_8N1             0x03
+#define LCR_DLAB            0x80
+#define MCR_DTR_RTS_OUT2    0x0B
+#define MCR_LOOPBACK        0x1E
+#define LSR_DATA            0x01
+#define LSR_THRE            0x20
+#define LSR_TEMT            0x40
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef void (*irq_handler)(void* frame);
+
+void irq_register_handler(uint8_t irq, irq_handler handler);
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+void console_input_wake(void);
+
+static uint8_t tx_ring[SERIAL_TX_SIZE];
+static uint32_t tx_head = 0;
+static uint32_t tx_tail = 0;
+static volatile uint8_t rx_ring[SERIAL_RX_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static spinlock tx_lock;
+static int serial_present = 0;
+static uint32_t tx_bytes = 0;
+static uint32_t tx_dropped = 0;
+static uint32_t rx_bytes = 0;
+static uint32_t rx_dropped = 0;
+static uint32_t tx_interrupts = 0;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+/* an empty holding register means the FIFO is empty too, so a whole FIFO's worth fits; caller holds tx_lock */
+static void tx_fill(void) {
+    if (!(inb(COM1_PORT + UART_LSR) & LSR_THRE)) return;
+    for (int i = 0; i < SERIAL_FIFO_DEPTH && tx_tail != tx_head; i++) {
+        outb(COM1_PORT + UART_DATA, tx_ring[tx_tail & (SERIAL_TX_SIZE - 1)]);
+        tx_tail++;
+    }
+}
+
+static void rx_drain(void) {
+    while (inb(COM1_PORT + UART_LSR) & LSR_DATA) {
+        uint8_t c = inb(COM1_PORT + UART_DATA);
+        uint32_t head = rx_head;
+        if (head - rx_tail >= SERIAL_RX_SIZE) {
+            rx_dropped++;
+            continue;
+        }
+        rx_ring[head & (SERIAL_RX_SIZE - 1)] = c;
+        asm volatile("" ::: "memory");
+        rx_head = head + 1;
+        rx_bytes++;
+    }
+    console_input_wake();
+}
+
+static void serial_irq(void* frame) {
+    uint8_t iir;
+    while (!((iir = inb(COM1_PORT + UART_IIR)) & IIR_NONE)) {
+        switch (iir & IIR_ID_MASK) {
+            case IIR_RX:
+            case IIR_TIMEOUT:
+                rx_drain();
+                break;
+            case IIR_THRE: {
+                unsigned long flags = spin_lock_irqsave(&tx_lock);
+                tx_interrupts++;
+                tx_fill();
+                spin_unlock_irqrestore(&tx_lock, flags);
+                break;
+            }
+            case IIR_LINE:
+                inb(COM1_PORT + UART_LSR);
+                break;
+            default:
+                inb(COM1_PORT + UART_MSR);
+                break;
+        }
+    }
+}
+
+/* COM1 at 115200 8N1 with both FIFOs on; -1 when the port is missing */
+int serial_init(void) {
+    if (serial_present) return 0;
+
+    outb(COM1_PORT + UART_IER, 0);
+    outb(COM1_PORT + UART_LCR, LCR_DLAB);
+    outb(COM1_PORT + UART_DLL, (uint8_t)(115200 / SERIAL_BAUD));
+    outb(COM1_PORT + UART_DLM, 0);
+    outb(COM1_PORT + UART_LCR, LCR_8N1);
+    outb(COM1_PORT + UART_FCR, FCR_ENABLE_CLEAR | FCR_TRIGGER_14);
+
+    /* a byte sent in loopback mode must come straight back, otherwise nothing is there */
+    outb(COM1_PORT + UART_MCR, MCR_LOOPBACK);
+    outb(COM1_PORT + UART_DATA, 0xAE);
+    for (int i = 0; i < 1000 && !(inb(COM1_PORT + UART_LSR) & LSR_DATA); i++);
+    if (inb(COM1_PORT + UART_DATA) != 0xAE) {
+        outb(COM1_PORT + UART_MCR, 0);
+        return -1;
+    }
+
+    outb(COM1_PORT + UART_MCR, MCR_DTR_RTS_OUT2);
+    while (inb(COM1_PORT + UART_LSR) & LSR_DATA) inb(COM1_PORT + UART_DATA);
+    serial_present = 1;
+    irq_register_handler(COM1_IRQ, serial_irq);
+    outb(COM1_PORT + UART_IER, IER_RX | IER_THRE | IER_LINE);
+    return 0;
+}
+
+int serial_is_present(void) {
+    return serial_present;
+}
+
+/* queues len bytes and returns at once; whatever does not fit in the ring is dropped and counted */
+void serial_write(const char* buf, uint32_t len) {
+    if (!serial_present) return;
+    unsigned long flags = spin_lock_irqsave(&tx_lock);
+    uint32_t space = SERIAL_TX_SIZE - (tx_head - tx_tail);
+    if (len > space) {
+        tx_dropped += len - space;
+        len = space;
+    }
+    for (uint32_t i = 0; i < len; i++) tx_ring[(tx_head + i) & (SERIAL_TX_SIZE - 1)] = (uint8_t)buf[i];
+    tx_head += len;
+    tx_bytes += len;
+    tx_fill();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+/* waits until everything queued has been handed to the UART, e.g. before powering off */
+void serial_drain(void) {
+    if (!serial_present) return;
+    while (1) {
+        unsigned long flags = spin_lock_irqsave(&tx_lock);
+        tx_fill();
+        int empty = tx_tail == tx_head;
+        spin_unlock_irqrestore(&tx_lock, flags);
+        if (empty) break;
+        asm volatile("pause");
+    }
+    while (!(inb(COM1_PORT + UART_LSR) & LSR_TEMT));
+}
+
+/* empties the ring by polling, for when interrupts will never come back on */
+void serial_sync(void) {
+    if (!serial_present) return;
+    while (tx_tail != tx_head) {
+        while (!(inb(COM1_PORT + UART_LSR) & LSR_THRE));
+        tx_fill();
+    }
+}
+
+int serial_poll(char* c) {
+    uint32_t tail = rx_tail;
+    if (tail == rx_head) return 0;
+    asm volatile("" ::: "memory");
+    *c = (char)rx_ring[tail & (SERIAL_RX_SIZE - 1)];
+    asm volatile("" ::: "memory");
+    rx_tail = tail + 1;
+    return 1;
+}
+
+/* bytes queued, bytes dropped, transmit interrupts, bytes received, bytes dropped on receive, bytes still to send */
+void serial_stats(uint32_t* stats) {
+    stats[0] = tx_bytes;
+    stats[1] = tx_dropped;
+    stats[2] = tx_interrupts;
+    stats[3] = rx_bytes;
+    stats[4] = rx_dropped;
+    stats[5] = tx_head - tx_tail;
+}
@@ -5,98 +5,335 @@
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
-typedef unsigned int size_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
 
-typedef struct {
-    uint8_t character;
-    uint8_t color;
-} vga_char;
+#define VGA_ALL_ROWS ((1u << VGA_HEIGHT) - 1)
 
-static vga_char* vga_buffer = (vga_char*)VGA_MEMORY;
+static volatile uint16_t* vga_buffer = (volatile uint16_t*)VGA_MEMORY;
+static uint16_t console_shadow[VGA_HEIGHT * VGA_WIDTH] __attribute__((aligned(16)));
+static size_t console_top = 0;
+static uint32_t console_dirty = 0;
+static int console_defer = 0;
+static unsigned short cursor_hw_pos = 0xFFFF;
 static size_t terminal_row = 0;
 static size_t terminal_column = 0;
 static uint8_t terminal_color = 0x0F;
+static char serial_stage[128];
+static uint32_t serial_staged = 0;
+static int console_vga = 1;
+static int console_serial = 0;
+
+typedef struct {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi;
+} __attribute__((packed)) e820_entry;
 
 typedef struct {
-    char name[32];
-    uint32_t size_mb;
-    int exists;
-} disk_info;
+    uint32_t second;
+    uint32_t minute;
+    uint32_t hour;
+    uint32_t day;
+    uint32_t month;
+    uint32_t year;
+} rtc_time;
+
+#define FS_BLOCK_SIZE 4096
+#define FS_NAME_MAX 52
+#define FS_TYPE_FILE 1
+#define FS_TYPE_DIR 2
+
+#define INPUT_BUFFER_SIZE 256
+#define SMP_MAX_CPUS 16
+
+typedef struct thread thread;
 
 typedef struct {
-    char name[64];
-    char path[128];
-    char content[512];
-} file_entry;
-
-file_entry files[] = {
-    {"boot.asm", "/dev/boot.asm", "[BITS 16]\n[ORG 0x7C00]\nstart:\n    cli"},
-    {"kernel.c", "/dev/kernel.c", "#include <stdint.h>\nvoid kernel_main(void) {}"},
-    {"linker.ld", "/dev/linker.ld", "OUTPUT_FORMAT(elf64-x86-64)\nENTRY(_start)"},
-    {"Makefile", "/dev/Makefile", "AS = nasm\nCC = x86_64-elf-gcc"},
-    {"os-release", "/etc/os-release", "NAME=\"HaldenOS\"\nVERSION=\"1.0.0\"\nID=haldenos"},
-    {"hostname", "/etc/hostname", "halden-system"},
-    {"passwd", "/etc/passwd", "root:x:0:0:root:/root:/bin/bash"},
-    {"hosts", "/etc/hosts", "127.0.0.1   localhost"},
-};
-
-#define FILE_COUNT 8
-
-disk_info detected_disks[16];
-int disk_count = 0;
+    thread* head;
+    int pending;
+} wait_queue;
+
+static wait_queue console_input;
+
+#define TRACE_BOOT 1
+#define TRACE_CMD_BEGIN 2
+#define TRACE_CMD_END 3
+#define TRACE_ATA_READ 4
+#define TRACE_ATA_WRITE 5
+#define TRACE_ATA_DONE 6
+
+#ifdef CONFIG_TRACE
+#define TRACE(event, arg0, arg1) trace_event(event, arg0, arg1)
+#define TRACE_PHASE(name) trace_boot_phase(name)
+#else
+#define TRACE(event, arg0, arg1) do { } while (0)
+#define TRACE_PHASE(name) do { } while (0)
+#endif
+
+#define CPU_MAX_CACHES 8
+#define CPU_FEATURE_COUNT 24
+#define CPU_FEATURE_HYPERVISOR (1 << 14)
+#define CACHE_INSTRUCTION 2
+
+typedef struct {
+    uint8_t level;
+    uint8_t type;
+    uint16_t line_size;
+    uint16_t ways;
+    uint16_t shared_by;
+    uint32_t sets;
+    uint32_t size;
+} cpu_cache;
+
+typedef struct {
+    char vendor[13];
+    char brand[49];
+    uint8_t vendor_id;
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+    uint32_t features;
+    uint32_t smt_shift;
+    uint32_t package_shift;
+    uint32_t threads_per_core;
+    uint32_t cores_per_package;
+    uint32_t packages;
+    uint32_t cores;
+    uint32_t threads;
+    uint32_t cache_line;
+    uint32_t cache_count;
+    cpu_cache caches[CPU_MAX_CACHES];
+} cpu_info;
+
+typedef struct {
+    uint64_t tsc;
+    uint32_t event;
+    uint32_t cpu;
+    uint64_t arg0;
+    uint64_t arg1;
+} trace_entry;
+
 uint32_t total_memory_kb = 0;
-char cpu_vendor_string[13] = {0};
-char cpu_brand_string[49] = {0};
-int cpu_core_count = 0;
 char current_directory[128] = "/";
 
 void terminal_clear(void);
 void terminal_write(const char* str);
 void terminal_putchar(char c);
+void terminal_flush(void);
+void terminal_backspace(void);
+void terminal_defer_begin(void);
+void terminal_defer_end(void);
 void update_cursor(void);
 unsigned char inb(unsigned short port);
 void outb(unsigned short port, unsigned char val);
 unsigned short inw(unsigned short port);
+void outw(unsigned short port, unsigned short val);
 size_t strlen(const char* str);
 int strcmp(const char* s1, const char* s2);
 void strcpy(char* dest, const char* src);
 int strncmp(const char* s1, const char* s2, size_t n);
+void* memcpy(void* dest, const void* src, size_t n);
+void* memset(void* dest, int c, size_t n);
+void string_init(void);
+int fpu_init(void);
+void fpu_stats(uint32_t* stats);
+void string_impls(const char** copy, const char** len, const char** cmp, int* erms);
+size_t string_nt_threshold(void);
+void cpu_init(void);
+const cpu_info* cpu_get_info(void);
+const char* cpu_feature_name(uint32_t bit);
 void uint_to_str(uint32_t num, char* str);
 void process_command(const char* cmd);
+char console_read_char(void);
+int console_mode(void);
+int console_set_mode(const char* mode);
+uint32_t bench_count(void);
+const char* bench_name(uint32_t index);
+const char* bench_unit(uint32_t index);
+int bench_run(uint32_t index, uint32_t* ops, uint64_t* cycles);
 char scancode_to_char(unsigned char scancode);
+void interrupts_init(void);
+void interrupts_enable(void);
+int keyboard_init(void);
+int serial_init(void);
+int serial_is_present(void);
+void serial_write(const char* buf, uint32_t len);
+int serial_poll(char* c);
+void serial_stats(uint32_t* stats);
+void serial_drain(void);
+int fw_cfg_read_file(const char* name, void* buf, uint32_t max);
+int cpu_has(uint32_t feature);
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns);
+void wait_queue_wake(wait_queue* wq);
+int timer_init(void);
+void udelay(uint32_t us);
+void msleep(uint32_t ms);
+uint64_t ktime_ns(void);
+uint32_t timer_uptime_seconds(void);
+uint32_t timer_tsc_khz(void);
+uint64_t udiv64(uint64_t dividend, uint64_t divisor);
+void rtc_read(rtc_time* t);
+void pmm_init(e820_entry* map, uint32_t count);
+uint32_t pmm_total_kb(void);
+uint32_t pmm_free_kb(void);
+uint32_t pmm_reserved_kb(void);
+uint32_t pmm_map_count(void);
+const e820_entry* pmm_map_entry(uint32_t index);
+uint64_t pmm_memory_top(void);
+int paging_init(uint64_t memory_top);
+void paging_stats(uint32_t* stats);
+void* vmalloc(size_t size);
+void vfree(void* ptr);
+typedef struct kmem_cache kmem_cache;
+void slab_init(void);
+kmem_cache* slab_first_cache(void);
+kmem_cache* slab_next_cache(kmem_cache* cache);
+void slab_cache_stats(kmem_cache* cache, const char** name, uint32_t* stats);
+void slab_large_stats(uint32_t* allocations, uint32_t* pages);
+void* kmalloc(size_t size);
+void* kzalloc(size_t size);
+void kfree(void* ptr);
+uint32_t rtc_days_since_epoch(uint32_t year, uint32_t month, uint32_t day);
+typedef struct block_device block_device;
+int ata_init(void);
+void ata_stats(uint32_t* stats);
+uint32_t block_count(void);
+block_device* block_get(uint32_t index);
+const char* block_name(block_device* dev);
+const char* block_model(block_device* dev);
+const char* block_driver(block_device* dev);
+uint64_t block_sectors(block_device* dev);
+uint32_t block_sector_size(block_device* dev);
+void block_stats(block_device* dev, uint32_t* stats);
+int bcache_init(void);
+int bcache_sync(block_device* dev);
+void bcache_stats(uint32_t* stats);
+typedef struct fs_inode fs_inode;
+int fs_mount(void);
+int fs_mounted(void);
+const char* fs_device_name(void);
+fs_inode* fs_namei(const char* path);
+fs_inode* fs_create(const char* path, int type);
+void fs_iput(fs_inode* ip);
+int fs_is_dir(fs_inode* ip);
+long pagecache_read(fs_inode* ip, uint64_t offset, void* buf, uint64_t len);
+void pagecache_stats(uint32_t* stats);
+int fs_unlink(const char* path);
+int fs_readdir(fs_inode* dir, uint32_t* cookie, char* name, uint32_t* ino, int* type);
+int fs_path_resolve(const char* base, const char* path, char* out, uint32_t size);
+void fs_statfs(uint32_t* stats);
+int fs_sync(void);
+int ethernet_init(void);
+int ethernet_is_initialized(void);
+void ethernet_get_mac(uint8_t* mac);
+int ethernet_get_link_status(void);
+void ethernet_set_link_status(int up);
+void ethernet_get_stats(uint32_t* rx_packets, uint32_t* tx_packets, uint32_t* rx_errors, uint32_t* tx_errors);
+void ethernet_set_promiscuous(int enable);
+int ethernet_get_promiscuous(void);
+int ethernet_get_speed(void);
+int ethernet_is_full_duplex(void);
+uint16_t ethernet_device_id(void);
+void ethernet_driver_stats(uint32_t* stats);
+void ethernet_get_drops(uint32_t* rx_dropped, uint32_t* tx_dropped);
+void pbuf_pool_stats(uint32_t* stats);
+int net_init(void);
+void ip_get_config(uint32_t* addr, uint32_t* netmask, uint32_t* gateway);
+int icmp_echo_send(uint32_t dst, uint16_t id, uint16_t seq, uint16_t size);
+int icmp_echo_wait(uint32_t timeout_ms, uint64_t* rtt_ns, uint8_t* ttl);
+int arp_get_entry(uint32_t* cookie, uint32_t* ip, uint8_t* mac, int* resolved, uint32_t* age_s);
+void arp_stats(uint32_t* stats);
+int udp_open(uint16_t port);
+void udp_close(int s);
+int udp_sendto(int s, uint32_t dst, uint16_t dport, const void* data, uint16_t len);
+int udp_recvfrom(int s, void* buf, uint16_t size, uint32_t* src, uint16_t* sport, uint32_t timeout_ms);
+void ethernet_tx_batch_begin(void);
+void ethernet_tx_batch_end(void);
+int sched_init(const char* boot_name);
+int sched_thread_info(uint32_t* cookie, uint32_t* tid, char* name, int* state, uint32_t* prio, uint32_t* cpu, uint64_t* cpu_ns);
+void sched_stats(uint32_t* stats);
+int thread_kill(uint32_t tid);
+uint32_t thread_current_tid(void);
+void smp_early_init(void);
+int smp_init(void);
+void smp_stats(uint32_t* stats);
+int workqueue_init(void);
+void work_stats(uint32_t* stats);
+int keyboard_poll(uint8_t* scancode);
+void trace_event(uint32_t event, uint64_t arg0, uint64_t arg1);
+void trace_boot_phase(const char* name);
+uint64_t trace_pack_string(const char* s);
+uint32_t trace_read(uint32_t cpu, trace_entry* out, uint32_t max);
+uint32_t trace_boot_timeline(const char** names, uint64_t* tsc, uint32_t max);
+const char* trace_event_name(uint32_t event);
+uint64_t trace_cycles_to_ns(uint64_t cycles);
+void trace_set_enabled(int enable);
+void trace_clear(void);
+void trace_stats(uint32_t* stats);
+int profile_start(void);
+void profile_stop(void);
+uint32_t profile_drain(uint32_t cpu, uint64_t* rips, uint32_t max);
+void profile_stats(uint32_t* stats);
+int ksym_index(uint64_t addr);
+uint32_t ksym_total(void);
+const char* ksym_name(int index);
+
+static inline uint16_t* console_row(size_t row) {
+    size_t physical = console_top + row;
+    if(physical >= VGA_HEIGHT) physical -= VGA_HEIGHT;
+    return &console_shadow[physical * VGA_WIDTH];
+}
+
+static inline void console_fill_row(uint16_t* row, uint16_t cell) {
+    uint64_t quad = cell * 0x0001000100010001ULL;
+    uint64_t* words = (uint64_t*)row;
+    for(size_t x = 0; x < VGA_WIDTH / 4; x++) words[x] = quad;
+}
+
+static inline void vga_copy_row(volatile uint16_t* dest, const uint16_t* src) {
+    size_t count = VGA_WIDTH / 4;
+    asm volatile("rep movsq" : "+D"(dest), "+S"(src), "+c"(count) : : "memory");
+}
+
+static void serial_stage_flush(void) {
+    if(serial_staged) serial_write(serial_stage, serial_staged);
+    serial_staged = 0;
+}
+
+/* serial terminals want CR LF */
+static inline void serial_stage_char(char c) {
+    if(serial_staged + 2 > sizeof(serial_stage)) serial_stage_flush();
+    if(c == '\n') serial_stage[serial_staged++] = '\r';
+    serial_stage[serial_staged++] = c;
+}
 
 void terminal_clear(void) {
-    for(size_t y = 0; y < VGA_HEIGHT; y++) {
-        for(size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = y * VGA_WIDTH + x;
-            vga_buffer[index].character = ' ';
-            vga_buffer[index].color = terminal_color;
-        }
-    }
+    uint16_t blank = ((uint16_t)terminal_color << 8) | ' ';
+    for(size_t y = 0; y < VGA_HEIGHT; y++) console_fill_row(&console_shadow[y * VGA_WIDTH], blank);
+    console_top = 0;
+    console_dirty = VGA_ALL_ROWS;
     terminal_row = 0;
     terminal_column = 0;
+    if(!console_defer) terminal_flush();
 }
 
 void terminal_scroll(void) {
-    for(size_t y = 1; y < VGA_HEIGHT; y++) {
-        for(size_t x = 0; x < VGA_WIDTH; x++) {
-            vga_buffer[(y-1)*VGA_WIDTH+x] = vga_buffer[y*VGA_WIDTH+x];
-        }
-    }
-    for(size_t x = 0; x < VGA_WIDTH; x++) {
-        vga_buffer[(VGA_HEIGHT-1)*VGA_WIDTH+x].character = ' ';
-        vga_buffer[(VGA_HEIGHT-1)*VGA_WIDTH+x].color = terminal_color;
-    }
+    console_top = (console_top + 1 == VGA_HEIGHT) ? 0 : console_top + 1;
+    console_fill_row(console_row(VGA_HEIGHT - 1), ((uint16_t)terminal_color << 8) | ' ');
+    console_dirty = VGA_ALL_ROWS;
     terminal_row = VGA_HEIGHT - 1;
 }
 
 void terminal_putchar(char c) {
+    if(console_serial) serial_stage_char(c);
     if(c == '\n') {
         terminal_column = 0;
         terminal_row++;
     } else {
-        vga_buffer[terminal_row*VGA_WIDTH+terminal_column].character = c;
-        vga_buffer[terminal_row*VGA_WIDTH+terminal_column].color = terminal_color;
+        console_row(terminal_row)[terminal_column] = ((uint16_t)terminal_color << 8) | (uint8_t)c;
+        console_dirty |= 1u << terminal_row;
         terminal_column++;
     }
     if(terminal_column >= VGA_WIDTH) {
@@ -104,21 +341,134 @@ void terminal_putchar(char c) {
         terminal_row++;
     }
     if(terminal_row >= VGA_HEIGHT) terminal_scroll();
-    update_cursor();
+}
+
+void terminal_backspace(void) {
+    if(console_serial) {
+        serial_stage_char('\b');
+        serial_stage_char(' ');
+        serial_stage_char('\b');
+    }
+    if(terminal_column == 0) {
+        if(terminal_row == 0) return;
+        terminal_row--;
+        terminal_column = VGA_WIDTH;
+    }
+    terminal_column--;
+    console_row(terminal_row)[terminal_column] = ((uint16_t)terminal_color << 8) | ' ';
+    console_dirty |= 1u << terminal_row;
 }
 
 void terminal_write(const char* str) {
     for(size_t i = 0; str[i] != '\0'; i++) terminal_putchar(str[i]);
+    if(!console_defer) terminal_flush();
+}
+
+void terminal_flush(void) {
+    if(console_serial) serial_stage_flush();
+    uint32_t dirty = console_dirty;
+    console_dirty = 0;
+    if(!console_vga) return;
+    for(size_t y = 0; dirty; y++, dirty >>= 1) {
+        if(dirty & 1) vga_copy_row(&vga_buffer[y * VGA_WIDTH], console_row(y));
+    }
+    update_cursor();
+}
+
+void terminal_defer_begin(void) {
+    console_defer++;
+}
+
+void terminal_defer_end(void) {
+    if(console_defer > 0 && --console_defer == 0) terminal_flush();
 }
 
 void update_cursor(void) {
     unsigned short pos = terminal_row * VGA_WIDTH + terminal_column;
+    if(pos == cursor_hw_pos) return;
+    cursor_hw_pos = pos;
     outb(0x3D4, 0x0F);
     outb(0x3D5, (uint8_t)(pos & 0xFF));
     outb(0x3D4, 0x0E);
     outb(0x3D5, (uint8_t)((pos >> 8) & 0xFF));
 }
 
+/* called from the keyboard and serial interrupts */
+void console_input_wake(void) {
+    wait_queue_wake(&console_input);
+}
+
+/* next character typed on the keyboard or received on COM1, blocking until there is one */
+char console_read_char(void) {
+    static int extended = 0;
+    static int escape = 0;
+    static int last_cr = 0;
+    uint8_t scancode;
+    char c;
+
+    while(1) {
+        asm volatile("cli");
+        if(keyboard_poll(&scancode)) {
+            asm volatile("sti");
+            if(scancode == 0xE0) { extended = 1; continue; }
+            if(extended) { extended = 0; continue; }
+            if(scancode & 0x80) continue;
+            c = scancode_to_char(scancode);
+            if(c) return c;
+        } else if(serial_poll(&c)) {
+            asm volatile("sti");
+            /* swallow ANSI escape sequences such as the arrow keys */
+            if(escape == 1) { escape = c == '[' ? 2 : 0; continue; }
+            if(escape == 2) { if(c >= 0x40 && c <= 0x7E) escape = 0; continue; }
+            if(c == 0x1B) { escape = 1; continue; }
+            if(c == '\n' && last_cr) { last_cr = 0; continue; }
+            last_cr = c == '\r';
+            if(c == '\r' || c == '\n') return '\n';
+            if(c == 0x7F || c == '\b') return '\b';
+            if(c >= ' ' && c < 0x7F) return c;
+        } else {
+            wait_queue_sleep(&console_input, 0);
+        }
+    }
+}
+
+/* 0 for the screen only, 1 for COM1 only, 2 for both */
+int console_mode(void) {
+    return console_vga ? (console_serial ? 2 : 0) : 1;
+}
+
+int console_set_mode(const char* mode) {
+    int vga = 1, serial = 1;
+    if(strcmp(mode, "vga") == 0) serial = 0;
+    else if(strcmp(mode, "serial") == 0) vga = 0;
+    else if(strcmp(mode, "both") != 0) return -1;
+    if(serial && !serial_is_present()) return -1;
+
+    terminal_flush();
+    console_serial = serial;
+    console_vga = vga;
+    if(vga) {
+        console_dirty = VGA_ALL_ROWS;
+        terminal_flush();
+    }
+    return 0;
+}
+
+/* mirrors the console to COM1 when there is one; -fw_cfg name=opt/halden/console,string=serial|vga|both picks */
+static void console_init(void) {
+    char option[16];
+    int len = -1;
+
+    if(serial_init() < 0) return;
+    console_serial = 1;
+    if(cpu_has(CPU_FEATURE_HYPERVISOR)) len = fw_cfg_read_file("opt/halden/console", option, sizeof(option) - 1);
+    if(len < 0) return;
+    while(len > 0 && (option[len - 1] == '\n' || option[len - 1] == '\r' || option[len - 1] == ' ')) len--;
+    option[len] = '\0';
+    if(strcmp(option, "serial") == 0) terminal_write("console: output redirected to COM1\n");
+    if(console_set_mode(option) < 0) terminal_write("console: unknown mode, using both\n");
+}
+
 unsigned char inb(unsigned short port) {
     unsigned char ret;
     asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
@@ -135,25 +485,18 @@ unsigned short inw(unsigned short port) {
     return ret;
 }
 
-size_t strlen(const char* str) {
-    size_t len = 0;
-    while(str[len]) len++;
-    return len;
-}
-
-int strcmp(const char* s1, const char* s2) {
-    while(*s1 && (*s1 == *s2)) { s1++; s2++; }
-    return *(unsigned char*)s1 - *(unsigned char*)s2;
+void outw(unsigned short port, unsigned short val) {
+    asm volatile("outw %0, %1" : : "a"(val), "Nd"(port));
 }
 
-void strcpy(char* dest, const char* src) {
-    while((*dest++ = *src++));
-}
-
-int strncmp(const char* s1, const char* s2, size_t n) {
-    while(n && *s1 && (*s1 == *s2)) { s1++; s2++; n--; }
-    if(n == 0) return 0;
-    return *(unsigned char*)s1 - *(unsigned char*)s2;
+void uint_to_hex(uint64_t num, char* str, int digits) {
+    str[0] = '0';
+    str[1] = 'x';
+    for(int i = 0; i < digits; i++) {
+        uint8_t nibble = (num >> ((digits - 1 - i) * 4)) & 0xF;
+        str[2 + i] = nibble < 10 ? '0' + nibble : 'a' + nibble - 10;
+    }
+    str[2 + digits] = '\0';
 }
 
 void uint_to_str(uint32_t num, char* str) {
@@ -182,80 +525,93 @@ uint32_t get_memory_kb(void) {
     return kb + 1024;
 }
 
-void get_cpu_vendor(char* vendor) {
-    uint32_t ebx, edx, ecx;
-    asm volatile("cpuid" : "=b"(ebx), "=d"(edx), "=c"(ecx) : "a"(0));
-    for(int i = 0; i < 4; i++) vendor[i] = (char)((ebx >> (i*8)) & 0xFF);
-    for(int i = 0; i < 4; i++) vendor[i+4] = (char)((edx >> (i*8)) & 0xFF);
-    for(int i = 0; i < 4; i++) vendor[i+8] = (char)((ecx >> (i*8)) & 0xFF);
-    vendor[12] = '\0';
-}
+static e820_entry fallback_map[2];
 
-void get_cpu_brand(char* brand) {
-    uint32_t eax, ebx, ecx, edx;
-    int idx = 0;
-    for(uint32_t func = 0x80000002; func <= 0x80000004; func++) {
-        asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(func));
-        for(int i = 0; i < 4; i++) brand[idx++] = (char)((eax >> (i*8)) & 0xFF);
-        for(int i = 0; i < 4; i++) brand[idx++] = (char)((ebx >> (i*8)) & 0xFF);
-        for(int i = 0; i < 4; i++) brand[idx++] = (char)((ecx >> (i*8)) & 0xFF);
-        for(int i = 0; i < 4; i++) brand[idx++] = (char)((edx >> (i*8)) & 0xFF);
+void memory_init(e820_entry* map, uint32_t count) {
+    if(count == 0) {
+        uint32_t kb = get_memory_kb();
+        fallback_map[0].base = 0;
+        fallback_map[0].length = 0x9FC00;
+        fallback_map[0].type = 1;
+        fallback_map[1].base = 0x100000;
+        fallback_map[1].length = (uint64_t)(kb - 1024) * 1024;
+        fallback_map[1].type = 1;
+        map = fallback_map;
+        count = 2;
     }
-    brand[idx] = '\0';
+    pmm_init(map, count);
+    slab_init();
+    paging_init(pmm_memory_top());
+    total_memory_kb = pmm_total_kb();
 }
 
-int get_cpu_cores(void) {
-    uint32_t eax, ebx, ecx, edx;
-    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
-    return ((ebx >> 16) & 0xFF);
-}
+#include "commands/main.c"
 
-int is_virtualized(void) {
-    uint32_t eax, ebx, ecx, edx;
-    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
-    return (ecx & (1 << 31)) != 0;
-}
+/* runs the ;-separated commands in -fw_cfg name=opt/halden/autorun,string=... before the prompt */
+static void shell_autorun(void) {
+    char script[INPUT_BUFFER_SIZE];
+    int len = -1;
+    if(cpu_has(CPU_FEATURE_HYPERVISOR)) len = fw_cfg_read_file("opt/halden/autorun", script, sizeof(script) - 1);
+    if(len <= 0) return;
+    script[len] = '\0';
 
-void detect_disks(void) {
-    disk_count = 0;
-    for(int drive = 0; drive < 4; drive++) {
-        unsigned char status;
-        if(drive < 2) {
-            outb(0x1F6, 0xA0 | (drive << 4));
-            outb(0x1F7, 0xEC);
-            for(volatile int i = 0; i < 10000; i++);
-            status = inb(0x1F7);
-        } else {
-            outb(0x176, 0xA0 | ((drive-2) << 4));
-            outb(0x177, 0xEC);
-            for(volatile int i = 0; i < 10000; i++);
-            status = inb(0x177);
-        }
-        if(status == 0 || status == 0xFF || !(status & 0x08)) continue;
-        
-        unsigned short identify[256];
-        unsigned short port = (drive < 2) ? 0x1F0 : 0x170;
-        for(int i = 0; i < 256; i++) identify[i] = inw(port);
-        
-        detected_disks[disk_count].name[0] = 's';
-        detected_disks[disk_count].name[1] = 'd';
-        detected_disks[disk_count].name[2] = 'a' + disk_count;
-        detected_disks[disk_count].name[3] = '\0';
-        detected_disks[disk_count].size_mb = (((uint32_t)identify[61] << 16) | identify[60]) / 2048;
-        detected_disks[disk_count].exists = 1;
-        disk_count++;
+    char* cmd = script;
+    while(*cmd) {
+        char* end = cmd;
+        while(*end && *end != ';' && *end != '\n') end++;
+        char next = *end;
+        *end = '\0';
+        while(*cmd == ' ') cmd++;
+        for(char* p = end; p > cmd && p[-1] == ' '; p--) p[-1] = '\0';
+        terminal_write("bash# ");
+        terminal_write(cmd);
+        terminal_write("\n");
+        terminal_defer_begin();
+        process_command(cmd);
+        terminal_defer_end();
+        if(!next) break;
+        cmd = end + 1;
     }
 }
 
-#include "commands/main.c"
-
-void kernel_main(void) {
+void kernel_main(e820_entry* memory_map, uint32_t memory_map_count) {
+    smp_early_init();
+    TRACE_PHASE("cpu_init");
+    cpu_init();
+    TRACE_PHASE("terminal_clear");
     terminal_clear();
-    total_memory_kb = get_memory_kb();
-    get_cpu_vendor(cpu_vendor_string);
-    get_cpu_brand(cpu_brand_string);
-    cpu_core_count = get_cpu_cores();
-    detect_disks();
+    TRACE_PHASE("interrupts_init");
+    interrupts_init();
+    TRACE_PHASE("console_init");
+    console_init();
+    TRACE_PHASE("memory_init");
+    memory_init(memory_map, memory_map_count);
+    TRACE_PHASE("fpu_init");
+    fpu_init();
+    TRACE_PHASE("string_init");
+    string_init();
+    TRACE_PHASE("sched_init");
+    sched_init("bash");
+    TRACE_PHASE("timer_init");
+    timer_init();
+    TRACE_PHASE("keyboard_init");
+    keyboard_init();
+    interrupts_enable();
+    TRACE_PHASE("smp_init");
+    smp_init();
+    TRACE_PHASE("workqueue_init");
+    workqueue_init();
+    TRACE_PHASE("ata_init");
+    ata_init();
+    TRACE_PHASE("bcache_init");
+    bcache_init();
+    TRACE_PHASE("fs_mount");
+    fs_mount();
+    TRACE_PHASE("ethernet_init");
+    ethernet_init();
+    TRACE_PHASE("net_init");
+    net_init();
+    TRACE_PHASE("banner");
     
     terminal_write("  _   _    _    _     ____  _____ _   _ \n");
     terminal_write(" | | | |  / \\  | |   |  _ \\| ____| \\ | |\n");
@@ -263,48 +619,44 @@ void kernel_main(void) {
     terminal_write(" |  _  |/ ___ \\| |___| |_| | |___| |\\  |\n");
     terminal_write(" |_| |_/_/   \\_\\_____|____/|_____|_| \\_|\n\n");
     
-    for(volatile int i = 0; i < 5000000; i++);
+    msleep(250);
     terminal_write("kernel is loading...\n");
-    for(volatile int i = 0; i < 3000000; i++);
+    msleep(150);
     terminal_write("welcome to halden\n\n");
-    for(volatile int i = 0; i < 2000000; i++);
+    msleep(100);
     
     terminal_write("HaldenOS V1.0.0 - 64-bit\n");
     terminal_write("Type 'fetch' or 'help' for information\n\n");
+    TRACE_PHASE("shell");
+    shell_autorun();
     
-    char input_buffer[256];
+    char* input_buffer = (char*)kmalloc(INPUT_BUFFER_SIZE);
     int buffer_pos = 0;
-    unsigned char last_scancode = 0;
     
     while(1) {
         terminal_write("bash# ");
         buffer_pos = 0;
         
         while(1) {
-            if(!(inb(0x64) & 0x01)) continue;
-            unsigned char scancode = inb(0x60);
-            if(scancode == last_scancode) continue;
-            last_scancode = scancode;
-            if(scancode & 0x80) continue;
-            
-            char c = scancode_to_char(scancode);
+            char c = console_read_char();
             if(c == '\n') {
                 terminal_putchar('\n');
                 input_buffer[buffer_pos] = '\0';
+                terminal_defer_begin();
                 process_command(input_buffer);
+                terminal_defer_end();
                 break;
             } else if(c == '\b') {
                 if(buffer_pos > 0) {
                     buffer_pos--;
-                    terminal_column--;
-                    vga_buffer[terminal_row*VGA_WIDTH+terminal_column].character = ' ';
-                    update_cursor();
+                    terminal_backspace();
+                    terminal_flush();
                 }
-            } else if(c != 0 && buffer_pos < 255) {
+            } else if(c != 0 && buffer_pos < INPUT_BUFFER_SIZE - 1) {
                 input_buffer[buffer_pos++] = c;
                 terminal_putchar(c);
+                terminal_flush();
             }
-            for(volatile int i = 0; i < 10000; i++);
         }
     }
 }
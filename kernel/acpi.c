@@ -0,0 +1,205 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define PAGE_SIZE           4096
+#define ACPI_MAX_CPUS       64
+#define BDA_EBDA_SEGMENT    0x40E
+#define BIOS_AREA_START     0xE0000
+#define BIOS_AREA_END       0x100000
+
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_LAPIC_OVERRIDE 5
+#define LAPIC_ENABLED       (1 << 0)
+#define LAPIC_ONLINE_CAPABLE (1 << 1)
+
+typedef struct {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp;
+
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header;
+
+typedef struct {
+    acpi_header header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) madt_entry;
+
+typedef struct {
+    madt_entry entry;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__((packed)) madt_lapic;
+
+typedef struct {
+    madt_entry entry;
+    uint8_t ioapic_id;
+    uint8_t reserved;
+    uint32_t address;
+    uint32_t gsi_base;
+} __attribute__((packed)) madt_ioapic;
+
+typedef struct {
+    madt_entry entry;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed)) madt_lapic_override;
+
+int paging_map_page(uint64_t virt, uint64_t phys, uint64_t flags);
+uint64_t paging_unmap_page(uint64_t virt);
+uint64_t paging_virt_to_phys(uint64_t virt);
+void* paging_map_mmio(uint64_t phys, uint64_t size);
+
+static uint8_t cpu_apic_ids[ACPI_MAX_CPUS];
+static uint32_t cpu_count = 0;
+static uint32_t ioapic_count = 0;
+static uint64_t lapic_base = 0;
+static int acpi_found = 0;
+
+static int checksum_ok(const void* data, uint32_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum += bytes[i];
+    return sum == 0;
+}
+
+static int signature_is(const char* sig, const char* want, int length) {
+    for (int i = 0; i < length; i++) {
+        if (sig[i] != want[i]) return 0;
+    }
+    return 1;
+}
+
+/* firmware tables may sit outside the RAM that paging_init mapped */
+static int ensure_mapped(uint64_t phys, uint64_t length) {
+    uint64_t start = phys & ~(uint64_t)(PAGE_SIZE - 1);
+    for (uint64_t page = start; page < phys + length; page += PAGE_SIZE) {
+        if (!paging_virt_to_phys(page) && !paging_map_mmio(page, PAGE_SIZE)) return -1;
+    }
+    return 0;
+}
+
+static acpi_header* map_table(uint64_t phys) {
+    if (!phys || ensure_mapped(phys, sizeof(acpi_header)) < 0) return 0;
+    acpi_header* h = (acpi_header*)phys;
+    if (h->length < sizeof(acpi_header) || ensure_mapped(phys, h->length) < 0) return 0;
+    return checksum_ok(h, h->length) ? h : 0;
+}
+
+static acpi_rsdp* scan_rsdp(uint64_t start, uint64_t end) {
+    for (uint64_t addr = start; addr + sizeof(acpi_rsdp) <= end; addr += 16) {
+        if (!paging_virt_to_phys(addr & ~(uint64_t)(PAGE_SIZE - 1))) continue;
+        acpi_rsdp* rsdp = (acpi_rsdp*)addr;
+        if (signature_is(rsdp->signature, "RSD PTR ", 8) && checksum_ok(rsdp, 20)) return rsdp;
+    }
+    return 0;
+}
+
+/* the first KB of the EBDA, then the BIOS ROM area, per the ACPI spec */
+static acpi_rsdp* find_rsdp(void) {
+    /* page 0 is left unmapped to catch null pointers, so map it just long enough to read the BDA */
+    uint16_t segment;
+    paging_map_page(0, 0, 0);
+    asm volatile("movw (%1), %0" : "=r"(segment) : "r"((uint64_t)BDA_EBDA_SEGMENT) : "memory");
+    paging_unmap_page(0);
+    uint64_t ebda = (uint64_t)segment << 4;
+
+    acpi_rsdp* rsdp = 0;
+    if (ebda >= 0x80000 && ebda < 0xA0000) rsdp = scan_rsdp(ebda, ebda + 1024);
+    if (!rsdp) rsdp = scan_rsdp(BIOS_AREA_START, BIOS_AREA_END);
+    return rsdp;
+}
+
+static acpi_header* find_table(acpi_rsdp* rsdp, const char* signature) {
+    int wide = rsdp->revision >= 2 && rsdp->xsdt_address;
+    acpi_header* root = map_table(wide ? rsdp->xsdt_address : rsdp->rsdt_address);
+    if (!root) return 0;
+
+    uint32_t entry_size = wide ? 8 : 4;
+    uint32_t count = (root->length - sizeof(acpi_header)) / entry_size;
+    uint8_t* entries = (uint8_t*)root + sizeof(acpi_header);
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t phys = wide ? *(uint64_t*)(entries + i * 8) : *(uint32_t*)(entries + i * 4);
+        acpi_header* h = map_table(phys);
+        if (h && signature_is(h->signature, signature, 4)) return h;
+    }
+    return 0;
+}
+
+static void parse_madt(acpi_madt* madt) {
+    lapic_base = madt->lapic_address;
+    uint8_t* p = (uint8_t*)madt + sizeof(acpi_madt);
+    uint8_t* end = (uint8_t*)madt + madt->header.length;
+
+    while (p + sizeof(madt_entry) <= end) {
+        madt_entry* e = (madt_entry*)p;
+        if (e->length < sizeof(madt_entry) || p + e->length > end) break;
+
+        if (e->type == MADT_LAPIC && e->length >= sizeof(madt_lapic)) {
+            madt_lapic* l = (madt_lapic*)e;
+            if ((l->flags & (LAPIC_ENABLED | LAPIC_ONLINE_CAPABLE)) && cpu_count < ACPI_MAX_CPUS) {
+                cpu_apic_ids[cpu_count++] = l->apic_id;
+            }
+        } else if (e->type == MADT_IOAPIC && e->length >= sizeof(madt_ioapic)) {
+            ioapic_count++;
+        } else if (e->type == MADT_LAPIC_OVERRIDE && e->length >= sizeof(madt_lapic_override)) {
+            lapic_base = ((madt_lapic_override*)e)->address;
+        }
+        p += e->length;
+    }
+}
+
+int acpi_init(void) {
+    if (acpi_found) return 0;
+
+    acpi_rsdp* rsdp = find_rsdp();
+    if (!rsdp) return -1;
+    acpi_madt* madt = (acpi_madt*)find_table(rsdp, "APIC");
+    if (!madt || madt->header.length < sizeof(acpi_madt)) return -1;
+
+    parse_madt(madt);
+    acpi_found = cpu_count > 0 && lapic_base != 0;
+    return acpi_found ? 0 : -1;
+}
+
+uint32_t acpi_cpu_count(void) {
+    return cpu_count;
+}
+
+uint32_t acpi_cpu_apic_id(uint32_t index) {
+    return index < cpu_count ? cpu_apic_ids[index] : 0;
+}
+
+uint64_t acpi_lapic_base(void) {
+    return lapic_base;
+}
+
+uint32_t acpi_ioapic_count(void) {
+    return ioapic_count;
+}
@@ -0,0 +1,153 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define PAGE_SIZE               4096
+#define MSR_APIC_BASE           0x1B
+#define APIC_BASE_ENABLE        (1 << 11)
+
+#define LAPIC_ID                0x020
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_ICR_LOW           0x300
+#define LAPIC_ICR_HIGH          0x310
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_PERF          0x340
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_TIMER_INITIAL     0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+
+#define LAPIC_SVR_ENABLE        (1 << 8)
+#define LVT_MASKED              (1 << 16)
+#define LVT_TIMER_PERIODIC      (1 << 17)
+#define LVT_EXTINT              0x700
+#define LVT_NMI                 0x400
+#define ICR_INIT                0x4500
+#define ICR_STARTUP             0x4600
+#define ICR_PENDING             (1 << 12)
+#define TIMER_DIVIDE_16         0x3
+#define CALIBRATE_US            10000
+
+#define VECTOR_TIMER            48
+#define VECTOR_SPURIOUS         63
+
+void* paging_map_mmio(uint64_t phys, uint64_t size);
+void udelay(uint32_t us);
+void mdelay(uint32_t ms);
+uint32_t timer_hz(void);
+
+static volatile uint32_t* lapic = 0;
+static uint32_t timer_ticks_per_period = 0;
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+static void lapic_enable(void) {
+    wrmsr(MSR_APIC_BASE, rdmsr(MSR_APIC_BASE) | APIC_BASE_ENABLE);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | VECTOR_SPURIOUS);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_LINT1, LVT_NMI);
+}
+
+/* counts how far the timer runs down in a known TSC-timed interval */
+static void calibrate_timer(void) {
+    lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+    udelay(CALIBRATE_US);
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+
+    uint64_t per_second = (uint64_t)elapsed * (1000000 / CALIBRATE_US);
+    timer_ticks_per_period = (uint32_t)(per_second / timer_hz());
+    if (timer_ticks_per_period == 0) timer_ticks_per_period = 1;
+}
+
+/* the boot CPU keeps the 8259 behind LINT0 and its PIT tick; call after timer_init */
+int lapic_init(uint64_t base) {
+    if (lapic) return 0;
+    if (!base || !paging_map_mmio(base, PAGE_SIZE)) return -1;
+
+    lapic = (volatile uint32_t*)base;
+    lapic_enable();
+    lapic_write(LAPIC_LVT_LINT0, LVT_EXTINT);
+    calibrate_timer();
+    return 0;
+}
+
+/* application processors take no legacy interrupts and tick from their own timer */
+void lapic_ap_init(void) {
+    lapic_enable();
+    lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);
+    lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, VECTOR_TIMER | LVT_TIMER_PERIODIC);
+    lapic_write(LAPIC_TIMER_INITIAL, timer_ticks_per_period);
+}
+
+uint32_t lapic_id(void) {
+    return lapic ? lapic_read(LAPIC_ID) >> 24 : 0;
+}
+
+void lapic_eoi(void) {
+    if (lapic) lapic_write(LAPIC_EOI, 0);
+}
+
+static void send_icr(uint32_t apic_id, uint32_t command) {
+    unsigned long flags = irq_save();
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) asm volatile("pause");
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) asm volatile("pause");
+    irq_restore(flags);
+}
+
+/* routes this CPU's performance counter overflow to NMI; delivery masks the entry again */
+int lapic_perf_nmi(int enable) {
+    if (!lapic) return -1;
+    lapic_write(LAPIC_LVT_PERF, enable ? LVT_NMI : LVT_MASKED);
+    return 0;
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    if (lapic) send_icr(apic_id, vector);
+}
+
+/* INIT-SIPI-SIPI; the processor starts in real mode at page * 4096 */
+void lapic_start_ap(uint32_t apic_id, uint8_t page) {
+    if (!lapic) return;
+    send_icr(apic_id, ICR_INIT);
+    mdelay(10);
+    for (int i = 0; i < 2; i++) {
+        send_icr(apic_id, ICR_STARTUP | page);
+        udelay(200);
+    }
+}
@@ -0,0 +1,483 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define BCACHE_BLOCK_SIZE       4096
+#define BCACHE_BUFFERS          256
+#define BCACHE_HASH_SIZE        128
+#define BCACHE_READAHEAD_MAX    8
+#define BCACHE_READAHEAD_ORDER  3
+#define BCACHE_RA_STREAMS       8
+#define BCACHE_DIRTY_EXPIRE_MS  5000
+#define BCACHE_SCAN_INTERVAL_MS 1000
+#define BCACHE_FLUSHD_PRIO      24
+
+#define BUF_VALID               (1 << 0)
+#define BUF_DIRTY               (1 << 1)
+#define BUF_READAHEAD           (1 << 2)
+
+typedef struct block_device block_device;
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef struct {
+    thread* owner;
+    wait_queue wait;
+} mutex;
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef struct buffer {
+    block_device* dev;
+    uint64_t block;
+    uint8_t* data;
+    uint32_t refcount;
+    uint32_t flags;
+    uint64_t dirtied_ms;
+    struct buffer* hash_next;
+    struct buffer* lru_prev;
+    struct buffer* lru_next;
+} buffer;
+
+typedef struct {
+    block_device* dev;
+    uint64_t next_block;
+    uint32_t run;
+    uint32_t window;
+} readahead_stream;
+
+int block_read(block_device* dev, uint64_t lba, uint32_t count, void* buf);
+int block_write(block_device* dev, uint64_t lba, uint32_t count, const void* buf);
+int block_flush(block_device* dev);
+uint32_t block_count(void);
+block_device* block_get(uint32_t index);
+uint64_t block_sectors(block_device* dev);
+uint32_t block_sector_size(block_device* dev);
+void* alloc_pages(uint32_t order);
+void* alloc_page(void);
+void* kzalloc(size_t size);
+uint64_t ktime_ns(void);
+void msleep(uint32_t ms);
+void mutex_lock(mutex* m);
+void mutex_unlock(mutex* m);
+int thread_create(const char* name, void (*entry)(void* arg), void* arg, uint32_t prio);
+int thread_should_stop(void);
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+
+static buffer* buffers = 0;
+static buffer* hash_table[BCACHE_HASH_SIZE];
+static buffer* lru_head = 0;
+static buffer* lru_tail = 0;
+static readahead_stream streams[BCACHE_RA_STREAMS];
+static uint8_t* readahead_buffer = 0;
+static uint32_t buffer_count = 0;
+static uint32_t dirty_count = 0;
+static uint32_t hits = 0;
+static uint32_t misses = 0;
+static uint32_t readahead_blocks = 0;
+static uint32_t readahead_hits = 0;
+static uint32_t writebacks = 0;
+static uint32_t evictions = 0;
+static uint64_t last_scan_ms = 0;
+/* the mutex serialises misses, claims and writeback; lru_lock guards the hash and LRU links */
+static mutex bcache_lock;
+static spinlock lru_lock;
+
+static uint64_t now_ms(void) {
+    return ktime_ns() / 1000000;
+}
+
+static uint32_t hash_index(block_device* dev, uint64_t block) {
+    uint64_t key = ((uint64_t)dev >> 4) ^ (block * 0x9E3779B97F4A7C15UL);
+    return (uint32_t)(key >> 32) & (BCACHE_HASH_SIZE - 1);
+}
+
+static uint32_t sectors_per_block(block_device* dev) {
+    return BCACHE_BLOCK_SIZE / block_sector_size(dev);
+}
+
+static int block_in_range(block_device* dev, uint64_t block) {
+    return (block + 1) * sectors_per_block(dev) <= block_sectors(dev);
+}
+
+static void lru_unlink(buffer* b) {
+    if (b->lru_prev) b->lru_prev->lru_next = b->lru_next;
+    else lru_head = b->lru_next;
+    if (b->lru_next) b->lru_next->lru_prev = b->lru_prev;
+    else lru_tail = b->lru_prev;
+    b->lru_prev = 0;
+    b->lru_next = 0;
+}
+
+static void lru_push_front(buffer* b) {
+    b->lru_prev = 0;
+    b->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = b;
+    lru_head = b;
+    if (!lru_tail) lru_tail = b;
+}
+
+static void hash_remove(buffer* b) {
+    buffer** link = &hash_table[hash_index(b->dev, b->block)];
+    while (*link && *link != b) link = &(*link)->hash_next;
+    if (*link) *link = b->hash_next;
+    b->hash_next = 0;
+}
+
+static void hash_insert(buffer* b) {
+    uint32_t index = hash_index(b->dev, b->block);
+    b->hash_next = hash_table[index];
+    hash_table[index] = b;
+}
+
+static buffer* hash_lookup(block_device* dev, uint64_t block) {
+    buffer* b = hash_table[hash_index(dev, block)];
+    while (b && (b->dev != dev || b->block != block)) b = b->hash_next;
+    return b;
+}
+
+static int buffer_writeback(buffer* b) {
+    if (!(b->flags & BUF_DIRTY)) return 0;
+
+    uint32_t spb = sectors_per_block(b->dev);
+    if (block_write(b->dev, b->block * spb, spb, b->data) < 0) return -1;
+
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    b->flags &= ~BUF_DIRTY;
+    dirty_count--;
+    writebacks++;
+    spin_unlock_irqrestore(&lru_lock, flags);
+    return 0;
+}
+
+/* takes the least recently used idle buffer, writing it back first if dirty */
+static buffer* buffer_evict(void) {
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    buffer* b = lru_tail;
+    while (b && b->refcount) b = b->lru_prev;
+    if (!b) {
+        spin_unlock_irqrestore(&lru_lock, flags);
+        return 0;
+    }
+    b->refcount = 1;
+    spin_unlock_irqrestore(&lru_lock, flags);
+
+    if (buffer_writeback(b) < 0) {
+        b->refcount = 0;
+        return 0;
+    }
+
+    flags = spin_lock_irqsave(&lru_lock);
+    if (b->dev) {
+        hash_remove(b);
+        evictions++;
+    }
+    b->dev = 0;
+    b->flags = 0;
+    spin_unlock_irqrestore(&lru_lock, flags);
+    return b;
+}
+
+static buffer* buffer_claim(block_device* dev, uint64_t block, uint32_t buffer_flags) {
+    buffer* b = buffer_evict();
+    if (!b) return 0;
+
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    b->dev = dev;
+    b->block = block;
+    b->flags = buffer_flags;
+    hash_insert(b);
+    lru_unlink(b);
+    lru_push_front(b);
+    spin_unlock_irqrestore(&lru_lock, flags);
+    return b;
+}
+
+static readahead_stream* stream_for(block_device* dev) {
+    readahead_stream* idle = &streams[0];
+    for (int i = 0; i < BCACHE_RA_STREAMS; i++) {
+        if (streams[i].dev == dev) return &streams[i];
+        if (!streams[i].dev) idle = &streams[i];
+    }
+    idle->dev = dev;
+    idle->next_block = 0;
+    idle->run = 0;
+    idle->window = 0;
+    return idle;
+}
+
+static void readahead(block_device* dev, uint64_t start, uint32_t count) {
+    uint32_t spb = sectors_per_block(dev);
+    uint32_t n = 0;
+
+    while (n < count && block_in_range(dev, start + n) && !hash_lookup(dev, start + n)) n++;
+    if (n == 0) return;
+    if (block_read(dev, start * spb, n * spb, readahead_buffer) < 0) return;
+
+    for (uint32_t i = 0; i < n; i++) {
+        buffer* b = buffer_claim(dev, start + i, BUF_VALID | BUF_READAHEAD);
+        if (!b) break;
+
+        uint64_t* dst = (uint64_t*)b->data;
+        const uint64_t* src = (const uint64_t*)(readahead_buffer + i * BCACHE_BLOCK_SIZE);
+        for (int w = 0; w < BCACHE_BLOCK_SIZE / 8; w++) dst[w] = src[w];
+
+        b->refcount = 0;
+        readahead_blocks++;
+    }
+}
+
+/* sequential reads grow the window 2, 4, 8 blocks; a seek resets it */
+static void readahead_update(block_device* dev, uint64_t block) {
+    readahead_stream* s = stream_for(dev);
+
+    if (block == s->next_block) {
+        s->run++;
+    } else {
+        s->run = 0;
+        s->window = 0;
+    }
+    s->next_block = block + 1;
+
+    if (s->run >= 1 && readahead_buffer) {
+        s->window = s->window ? s->window * 2 : 2;
+        if (s->window > BCACHE_READAHEAD_MAX) s->window = BCACHE_READAHEAD_MAX;
+        if (!hash_lookup(dev, block + 1)) readahead(dev, block + 1, s->window);
+    }
+}
+
+static void writeback_expired(void) {
+    uint64_t now = now_ms();
+    if (now - last_scan_ms < BCACHE_SCAN_INTERVAL_MS) return;
+    last_scan_ms = now;
+
+    for (uint32_t i = 0; i < buffer_count && dirty_count; i++) {
+        buffer* b = &buffers[i];
+        if ((b->flags & BUF_DIRTY) && !b->refcount && now - b->dirtied_ms >= BCACHE_DIRTY_EXPIRE_MS) {
+            b->refcount = 1;
+            buffer_writeback(b);
+            b->refcount = 0;
+        }
+    }
+}
+
+buffer* bread(block_device* dev, uint64_t block) {
+    if (!buffers || !dev || !block_in_range(dev, block)) return 0;
+
+    mutex_lock(&bcache_lock);
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    buffer* b = hash_lookup(dev, block);
+    if (b) {
+        uint32_t prefetched = b->flags & BUF_READAHEAD;
+        b->refcount++;
+        hits++;
+        if (prefetched) {
+            b->flags &= ~BUF_READAHEAD;
+            readahead_hits++;
+        }
+        lru_unlink(b);
+        lru_push_front(b);
+        spin_unlock_irqrestore(&lru_lock, flags);
+
+        if (prefetched) {
+            readahead_update(dev, block);
+        } else {
+            readahead_stream* s = stream_for(dev);
+            if (block == s->next_block) s->next_block = block + 1;
+        }
+        mutex_unlock(&bcache_lock);
+        return b;
+    }
+    misses++;
+    spin_unlock_irqrestore(&lru_lock, flags);
+
+    writeback_expired();
+    b = buffer_claim(dev, block, 0);
+    if (!b) {
+        mutex_unlock(&bcache_lock);
+        return 0;
+    }
+
+    uint32_t spb = sectors_per_block(dev);
+    if (block_read(dev, block * spb, spb, b->data) < 0) {
+        flags = spin_lock_irqsave(&lru_lock);
+        hash_remove(b);
+        b->dev = 0;
+        b->refcount = 0;
+        spin_unlock_irqrestore(&lru_lock, flags);
+        mutex_unlock(&bcache_lock);
+        return 0;
+    }
+    b->flags |= BUF_VALID;
+
+    readahead_update(dev, block);
+    mutex_unlock(&bcache_lock);
+    return b;
+}
+
+/* returns a zeroed buffer for a block that is about to be overwritten */
+buffer* bget(block_device* dev, uint64_t block) {
+    if (!buffers || !dev || !block_in_range(dev, block)) return 0;
+
+    mutex_lock(&bcache_lock);
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    buffer* b = hash_lookup(dev, block);
+    if (b) {
+        b->refcount++;
+        hits++;
+        lru_unlink(b);
+        lru_push_front(b);
+        spin_unlock_irqrestore(&lru_lock, flags);
+        mutex_unlock(&bcache_lock);
+        return b;
+    }
+    spin_unlock_irqrestore(&lru_lock, flags);
+
+    b = buffer_claim(dev, block, BUF_VALID);
+    if (b) {
+        uint64_t* words = (uint64_t*)b->data;
+        for (int i = 0; i < BCACHE_BLOCK_SIZE / 8; i++) words[i] = 0;
+    }
+    mutex_unlock(&bcache_lock);
+    return b;
+}
+
+void brelse(buffer* b) {
+    if (!b) return;
+
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    if (b->refcount) b->refcount--;
+    spin_unlock_irqrestore(&lru_lock, flags);
+}
+
+void bdirty(buffer* b) {
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    if (!(b->flags & BUF_DIRTY)) {
+        b->flags |= BUF_DIRTY;
+        b->dirtied_ms = now_ms();
+        dirty_count++;
+    }
+    spin_unlock_irqrestore(&lru_lock, flags);
+}
+
+void* bdata(buffer* b) {
+    return b->data;
+}
+
+uint64_t bblock(buffer* b) {
+    return b->block;
+}
+
+int bwrite(buffer* b) {
+    bdirty(b);
+    mutex_lock(&bcache_lock);
+    int rc = buffer_writeback(b);
+    mutex_unlock(&bcache_lock);
+    return rc;
+}
+
+static int sync_locked(block_device* dev) {
+    int rc = 0;
+
+    for (uint32_t i = 0; i < buffer_count; i++) {
+        buffer* b = &buffers[i];
+        if ((b->flags & BUF_DIRTY) && (!dev || b->dev == dev)) {
+            if (buffer_writeback(b) < 0) rc = -1;
+        }
+    }
+    if (dev) {
+        if (block_flush(dev) < 0) rc = -1;
+    } else {
+        for (uint32_t i = 0; i < block_count(); i++) {
+            if (block_flush(block_get(i)) < 0) rc = -1;
+        }
+    }
+    return rc;
+}
+
+int bcache_sync(block_device* dev) {
+    mutex_lock(&bcache_lock);
+    int rc = sync_locked(dev);
+    mutex_unlock(&bcache_lock);
+    return rc;
+}
+
+void bcache_invalidate(block_device* dev) {
+    mutex_lock(&bcache_lock);
+    sync_locked(dev);
+
+    unsigned long flags = spin_lock_irqsave(&lru_lock);
+    for (uint32_t i = 0; i < buffer_count; i++) {
+        buffer* b = &buffers[i];
+        if (b->dev == dev && !b->refcount) {
+            hash_remove(b);
+            b->dev = 0;
+            b->flags = 0;
+            lru_unlink(b);
+            b->lru_next = 0;
+            b->lru_prev = lru_tail;
+            if (lru_tail) lru_tail->lru_next = b;
+            else lru_head = b;
+            lru_tail = b;
+        }
+    }
+    spin_unlock_irqrestore(&lru_lock, flags);
+    mutex_unlock(&bcache_lock);
+}
+
+/* writes back expired dirty buffers even when nothing is reading */
+static void kflushd(void* arg) {
+    while (!thread_should_stop()) {
+        msleep(BCACHE_SCAN_INTERVAL_MS);
+        mutex_lock(&bcache_lock);
+        writeback_expired();
+        mutex_unlock(&bcache_lock);
+    }
+}
+
+int bcache_init(void) {
+    if (buffers) return 0;
+
+    buffers = (buffer*)kzalloc(BCACHE_BUFFERS * sizeof(buffer));
+    if (!buffers) return -1;
+
+    for (uint32_t i = 0; i < BCACHE_BUFFERS; i++) {
+        buffers[i].data = (uint8_t*)alloc_page();
+        if (!buffers[i].data) break;
+        lru_push_front(&buffers[i]);
+        buffer_count++;
+    }
+    readahead_buffer = (uint8_t*)alloc_pages(BCACHE_READAHEAD_ORDER);
+    thread_create("kflushd", kflushd, 0, BCACHE_FLUSHD_PRIO);
+    return 0;
+}
+
+void bcache_stats(uint32_t* stats) {
+    uint32_t in_use = 0;
+    uint32_t cached = 0;
+
+    for (uint32_t i = 0; i < buffer_count; i++) {
+        if (buffers[i].refcount) in_use++;
+        if (buffers[i].dev) cached++;
+    }
+    stats[0] = buffer_count;
+    stats[1] = cached;
+    stats[2] = in_use;
+    stats[3] = dirty_count;
+    stats[4] = hits;
+    stats[5] = misses;
+    stats[6] = readahead_blocks;
+    stats[7] = readahead_hits;
+    stats[8] = writebacks;
+    stats[9] = evictions;
+}
@@ -0,0 +1,341 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define BENCH_REPEATS       3
+#define BENCH_THREAD_PRIO   16
+#define BENCH_BUFFER_SIZE   65536
+#define BENCH_LINE_WIDTH    80
+#define BENCH_DISK_SPAN     2048
+#define SECTOR_SIZE         512
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef struct block_device block_device;
+
+/* one case: ops operations per run, the best of BENCH_REPEATS runs is kept */
+typedef struct {
+    const char* name;
+    const char* unit;
+    uint32_t ops;
+    int console;
+    int (*setup)(void);
+    uint64_t (*run)(uint32_t ops);
+} bench_case;
+
+void terminal_putchar(char c);
+void terminal_write(const char* str);
+void terminal_flush(void);
+void terminal_clear(void);
+int console_mode(void);
+int console_set_mode(const char* mode);
+void* memcpy(void* dest, const void* src, size_t n);
+void* memset(void* dest, int c, size_t n);
+size_t strlen(const char* str);
+int strcmp(const char* s1, const char* s2);
+uint32_t pci_read_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset);
+int ata_identify_drive(uint32_t index, uint16_t* identify);
+block_device* block_get(uint32_t index);
+uint64_t block_sectors(block_device* dev);
+int block_read(block_device* dev, uint64_t lba, uint32_t count, void* buf);
+void* kmalloc(size_t size);
+void kfree(void* ptr);
+void* alloc_page(void);
+void free_page(void* addr);
+void* vmalloc(size_t size);
+void vfree(void* ptr);
+uint64_t ktime_ns(void);
+int thread_create(const char* name, void (*entry)(void* arg), void* arg, uint32_t prio);
+void thread_yield(void);
+int thread_wait(int* status);
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns);
+void wait_queue_wake(wait_queue* wq);
+
+static uint8_t* buf_a;
+static uint8_t* buf_b;
+static char line[BENCH_LINE_WIDTH + 1];
+static wait_queue ping;
+static wait_queue pong;
+static volatile int partner_stop;
+static volatile uint64_t sink;
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi) : : "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static int need_buffers(void) {
+    if (!buf_a) buf_a = (uint8_t*)kmalloc(BENCH_BUFFER_SIZE);
+    if (!buf_b) buf_b = (uint8_t*)kmalloc(BENCH_BUFFER_SIZE);
+    if (!buf_a || !buf_b) return -1;
+    memset(buf_a, 'a', BENCH_BUFFER_SIZE);
+    memset(buf_b, 'a', BENCH_BUFFER_SIZE);
+    buf_a[255] = '\0';
+    buf_b[255] = '\0';
+    return 0;
+}
+
+static int need_disk(void) {
+    block_device* dev = block_get(0);
+    if (!dev || block_sectors(dev) < BENCH_DISK_SPAN) return -1;
+    return need_buffers();
+}
+
+/* shadow console writes only, one flush per line */
+static uint64_t run_console_char(uint32_t ops) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        terminal_putchar((char)('!' + i % 90));
+        if (i % BENCH_LINE_WIDTH == BENCH_LINE_WIDTH - 1) terminal_flush();
+    }
+    terminal_flush();
+    return rdtsc() - start;
+}
+
+/* a full-width line at the bottom of the screen: one scroll and a whole-screen copy each */
+static uint64_t run_console_line(uint32_t ops) {
+    for (int i = 0; i < BENCH_LINE_WIDTH - 1; i++) line[i] = (char)('0' + i % 10);
+    line[BENCH_LINE_WIDTH - 1] = '\n';
+    line[BENCH_LINE_WIDTH] = '\0';
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        terminal_write(line);
+        terminal_flush();
+    }
+    return rdtsc() - start;
+}
+
+static uint64_t run_console_scroll(uint32_t ops) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        terminal_putchar('\n');
+        terminal_flush();
+    }
+    return rdtsc() - start;
+}
+
+static uint64_t run_copy(uint32_t ops, size_t size) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) memcpy(buf_b, buf_a, size);
+    return rdtsc() - start;
+}
+
+static uint64_t run_memcpy_64(uint32_t ops) { return run_copy(ops, 64); }
+static uint64_t run_memcpy_4k(uint32_t ops) { return run_copy(ops, 4096); }
+static uint64_t run_memcpy_64k(uint32_t ops) { return run_copy(ops, BENCH_BUFFER_SIZE); }
+
+static uint64_t run_memset_4k(uint32_t ops) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) memset(buf_b, (int)i, 4096);
+    return rdtsc() - start;
+}
+
+static uint64_t run_strlen_255(uint32_t ops) {
+    size_t total = 0;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) total += strlen((const char*)buf_a);
+    uint64_t cycles = rdtsc() - start;
+    sink = total;
+    return cycles;
+}
+
+static uint64_t run_strcmp_255(uint32_t ops) {
+    int total = 0;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) total += strcmp((const char*)buf_a, (const char*)buf_b);
+    uint64_t cycles = rdtsc() - start;
+    sink = (uint64_t)total;
+    return cycles;
+}
+
+/* the host bridge's vendor and device ID, one CF8/CFC pair per read */
+static uint64_t run_pci_read(uint32_t ops) {
+    uint32_t total = 0;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) total += pci_read_config(0, 0, 0, 0);
+    uint64_t cycles = rdtsc() - start;
+    sink = total;
+    return cycles;
+}
+
+static uint64_t run_ata_identify(uint32_t ops) {
+    uint16_t identify[256];
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        if (ata_identify_drive(0, identify) < 0) return 0;
+    }
+    return rdtsc() - start;
+}
+
+/* raw sda reads below the buffer cache, stepping through the first megabyte */
+static uint64_t run_disk_read(uint32_t ops, uint32_t sectors) {
+    block_device* dev = block_get(0);
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        uint64_t lba = (uint64_t)i * sectors % BENCH_DISK_SPAN;
+        if (block_read(dev, lba, sectors, buf_b) < 0) return 0;
+    }
+    return rdtsc() - start;
+}
+
+static uint64_t run_disk_read_4k(uint32_t ops) { return run_disk_read(ops, 4096 / SECTOR_SIZE); }
+static uint64_t run_disk_read_64k(uint32_t ops) { return run_disk_read(ops, BENCH_BUFFER_SIZE / SECTOR_SIZE); }
+
+static uint64_t run_kmalloc(uint32_t ops, size_t size) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        void* p = kmalloc(size);
+        if (!p) return 0;
+        kfree(p);
+    }
+    return rdtsc() - start;
+}
+
+static uint64_t run_kmalloc_64(uint32_t ops) { return run_kmalloc(ops, 64); }
+static uint64_t run_kmalloc_4k(uint32_t ops) { return run_kmalloc(ops, 4096); }
+
+static uint64_t run_alloc_page(uint32_t ops) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        void* p = alloc_page();
+        if (!p) return 0;
+        free_page(p);
+    }
+    return rdtsc() - start;
+}
+
+/* every page faulted in, then the unmap and its TLB shootdown */
+static uint64_t run_vmalloc_64k(uint32_t ops) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        uint8_t* p = (uint8_t*)vmalloc(BENCH_BUFFER_SIZE);
+        if (!p) return 0;
+        for (uint32_t off = 0; off < BENCH_BUFFER_SIZE; off += 4096) p[off] = 1;
+        vfree(p);
+    }
+    return rdtsc() - start;
+}
+
+static uint64_t run_ktime(uint32_t ops) {
+    uint64_t total = 0;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) total += ktime_ns();
+    uint64_t cycles = rdtsc() - start;
+    sink = total;
+    return cycles;
+}
+
+static uint64_t run_yield(uint32_t ops) {
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) thread_yield();
+    return rdtsc() - start;
+}
+
+static void partner(void* arg) {
+    while (!partner_stop) {
+        asm volatile("cli");
+        wait_queue_sleep(&ping, 0);
+        asm volatile("sti");
+        wait_queue_wake(&pong);
+    }
+}
+
+/* one round trip wakes the partner thread and sleeps until it wakes us back: two switches */
+static uint64_t run_wake_pingpong(uint32_t ops) {
+    partner_stop = 0;
+    ping.pending = 0;
+    pong.pending = 0;
+    int tid = thread_create("bench", partner, 0, BENCH_THREAD_PRIO);
+    if (tid < 0) return 0;
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < ops; i++) {
+        wait_queue_wake(&ping);
+        asm volatile("cli");
+        wait_queue_sleep(&pong, 0);
+        asm volatile("sti");
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    partner_stop = 1;
+    wait_queue_wake(&ping);
+    int reaped;
+    while ((reaped = thread_wait(0)) >= 0 && reaped != tid);
+    return cycles;
+}
+
+static const bench_case cases[] = {
+    { "console_char",     "char",   8000,   1, 0,            run_console_char },
+    { "console_line",     "line",   1000,   1, 0,            run_console_line },
+    { "console_scroll",   "scroll", 1000,   1, 0,            run_console_scroll },
+    { "memcpy_64",        "copy",   200000, 0, need_buffers, run_memcpy_64 },
+    { "memcpy_4k",        "copy",   20000,  0, need_buffers, run_memcpy_4k },
+    { "memcpy_64k",       "copy",   1000,   0, need_buffers, run_memcpy_64k },
+    { "memset_4k",        "fill",   20000,  0, need_buffers, run_memset_4k },
+    { "strlen_255",       "call",   100000, 0, need_buffers, run_strlen_255 },
+    { "strcmp_255",       "call",   100000, 0, need_buffers, run_strcmp_255 },
+    { "pci_config_read",  "read",   20000,  0, 0,            run_pci_read },
+    { "ata_identify",     "cmd",    100,    0, need_disk,    run_ata_identify },
+    { "disk_read_4k",     "read",   256,    0, need_disk,    run_disk_read_4k },
+    { "disk_read_64k",    "read",   32,     0, need_disk,    run_disk_read_64k },
+    { "kmalloc_64",       "pair",   200000, 0, 0,            run_kmalloc_64 },
+    { "kmalloc_4k",       "pair",   50000,  0, 0,            run_kmalloc_4k },
+    { "alloc_page",       "pair",   50000,  0, 0,            run_alloc_page },
+    { "vmalloc_64k",      "pair",   500,    0, 0,            run_vmalloc_64k },
+    { "ktime_ns",         "call",   100000, 0, 0,            run_ktime },
+    { "thread_yield",     "yield",  20000,  0, 0,            run_yield },
+    { "wake_pingpong",    "trip",   5000,   0, 0,            run_wake_pingpong },
+};
+
+#define BENCH_CASES (sizeof(cases) / sizeof(cases[0]))
+
+uint32_t bench_count(void) {
+    return BENCH_CASES;
+}
+
+const char* bench_name(uint32_t index) {
+    return index < BENCH_CASES ? cases[index].name : 0;
+}
+
+const char* bench_unit(uint32_t index) {
+    return index < BENCH_CASES ? cases[index].unit : 0;
+}
+
+/* runs one case and stores its operation count and best total; -1 when it cannot run here */
+int bench_run(uint32_t index, uint32_t* ops, uint64_t* cycles) {
+    if (index >= BENCH_CASES) return -1;
+    const bench_case* c = &cases[index];
+    if (c->setup && c->setup() < 0) return -1;
+
+    /* console cases draw on the screen only, so the serial log stays readable */
+    static const char* modes[3] = { "vga", "serial", "both" };
+    int mode = console_mode();
+    if (c->console) console_set_mode("vga");
+
+    uint64_t best = 0;
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        uint64_t t = c->run(c->ops);
+        if (!t) {
+            best = 0;
+            break;
+        }
+        if (!best || t < best) best = t;
+    }
+
+    if (c->console) {
+        terminal_clear();
+        console_set_mode(modes[mode]);
+    }
+    if (!best) return -1;
+    *ops = c->ops;
+    *cycles = best;
+    return 0;
+}
@@ -0,0 +1,132 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define BLOCK_MAX_DEVICES   8
+#define BLOCK_NAME_LEN      8
+#define BLOCK_MODEL_LEN     41
+
+typedef struct {
+    int (*read)(void* data, uint64_t lba, uint32_t count, void* buf);
+    int (*write)(void* data, uint64_t lba, uint32_t count, const void* buf);
+    int (*flush)(void* data);
+} block_ops;
+
+typedef struct block_device {
+    char name[BLOCK_NAME_LEN];
+    char model[BLOCK_MODEL_LEN];
+    const char* driver;
+    uint64_t sectors;
+    uint32_t sector_size;
+    const block_ops* ops;
+    void* data;
+    uint32_t read_ops;
+    uint32_t write_ops;
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+    uint32_t errors;
+} block_device;
+
+static block_device devices[BLOCK_MAX_DEVICES];
+static uint32_t device_count = 0;
+
+static void copy_string(char* dest, const char* src, uint32_t size) {
+    uint32_t i = 0;
+    if (src) {
+        for (; src[i] && i < size - 1; i++) dest[i] = src[i];
+    }
+    dest[i] = '\0';
+}
+
+block_device* block_register(const char* name, const char* model, const char* driver,
+                             uint64_t sectors, uint32_t sector_size,
+                             const block_ops* ops, void* data) {
+    if (device_count >= BLOCK_MAX_DEVICES || !ops || !ops->read) return 0;
+
+    block_device* dev = &devices[device_count++];
+    copy_string(dev->name, name, BLOCK_NAME_LEN);
+    copy_string(dev->model, model, BLOCK_MODEL_LEN);
+    dev->driver = driver;
+    dev->sectors = sectors;
+    dev->sector_size = sector_size;
+    dev->ops = ops;
+    dev->data = data;
+    return dev;
+}
+
+uint32_t block_count(void) {
+    return device_count;
+}
+
+block_device* block_get(uint32_t index) {
+    return (index < device_count) ? &devices[index] : 0;
+}
+
+block_device* block_find(const char* name) {
+    for (uint32_t i = 0; i < device_count; i++) {
+        const char* a = devices[i].name;
+        const char* b = name;
+        while (*a && *a == *b) { a++; b++; }
+        if (*a == *b) return &devices[i];
+    }
+    return 0;
+}
+
+int block_read(block_device* dev, uint64_t lba, uint32_t count, void* buf) {
+    if (!dev || count == 0 || lba + count > dev->sectors || lba + count < lba) return -1;
+
+    if (dev->ops->read(dev->data, lba, count, buf) < 0) {
+        dev->errors++;
+        return -1;
+    }
+    dev->read_ops++;
+    dev->sectors_read += count;
+    return 0;
+}
+
+int block_write(block_device* dev, uint64_t lba, uint32_t count, const void* buf) {
+    if (!dev || count == 0 || lba + count > dev->sectors || lba + count < lba) return -1;
+    if (!dev->ops->write) return -1;
+
+    if (dev->ops->write(dev->data, lba, count, buf) < 0) {
+        dev->errors++;
+        return -1;
+    }
+    dev->write_ops++;
+    dev->sectors_written += count;
+    return 0;
+}
+
+int block_flush(block_device* dev) {
+    if (!dev) return -1;
+    return dev->ops->flush ? dev->ops->flush(dev->data) : 0;
+}
+
+const char* block_name(block_device* dev) {
+    return dev->name;
+}
+
+const char* block_model(block_device* dev) {
+    return dev->model;
+}
+
+const char* block_driver(block_device* dev) {
+    return dev->driver ? dev->driver : "";
+}
+
+uint64_t block_sectors(block_device* dev) {
+    return dev->sectors;
+}
+
+uint32_t block_sector_size(block_device* dev) {
+    return dev->sector_size;
+}
+
+void block_stats(block_device* dev, uint32_t* stats) {
+    stats[0] = dev->read_ops;
+    stats[1] = (uint32_t)dev->sectors_read;
+    stats[2] = dev->write_ops;
+    stats[3] = (uint32_t)dev->sectors_written;
+    stats[4] = dev->errors;
+}
@@ -0,0 +1,365 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define CPU_MAX_CACHES      8
+#define CPU_DEFAULT_LINE    64
+
+#define CPU_VENDOR_OTHER    0
+#define CPU_VENDOR_INTEL    1
+#define CPU_VENDOR_AMD      2
+
+#define CPU_FEATURE_SSE         (1 << 0)
+#define CPU_FEATURE_SSE2        (1 << 1)
+#define CPU_FEATURE_SSE3        (1 << 2)
+#define CPU_FEATURE_SSSE3       (1 << 3)
+#define CPU_FEATURE_SSE4_1      (1 << 4)
+#define CPU_FEATURE_SSE4_2      (1 << 5)
+#define CPU_FEATURE_AVX         (1 << 6)
+#define CPU_FEATURE_AVX2        (1 << 7)
+#define CPU_FEATURE_FMA         (1 << 8)
+#define CPU_FEATURE_XSAVE       (1 << 9)
+#define CPU_FEATURE_ERMS        (1 << 10)
+#define CPU_FEATURE_HT          (1 << 11)
+#define CPU_FEATURE_TURBO       (1 << 12)
+#define CPU_FEATURE_X2APIC      (1 << 13)
+#define CPU_FEATURE_HYPERVISOR  (1 << 14)
+#define CPU_FEATURE_SSE4A       (1 << 15)
+#define CPU_FEATURE_XOP         (1 << 16)
+#define CPU_FEATURE_FMA4        (1 << 17)
+#define CPU_FEATURE_TBM         (1 << 18)
+#define CPU_FEATURE_SVM         (1 << 19)
+#define CPU_FEATURE_VMX         (1 << 20)
+#define CPU_FEATURE_3DNOW       (1 << 21)
+#define CPU_FEATURE_3DNOWEXT    (1 << 22)
+#define CPU_FEATURE_TOPOEXT     (1 << 23)
+#define CPU_FEATURE_COUNT       24
+
+#define CACHE_DATA          1
+#define CACHE_INSTRUCTION   2
+#define CACHE_UNIFIED       3
+
+#define TOPO_LEVEL_SMT      1
+
+typedef struct {
+    uint8_t level;
+    uint8_t type;
+    uint16_t line_size;
+    uint16_t ways;
+    uint16_t shared_by;
+    uint32_t sets;
+    uint32_t size;
+} cpu_cache;
+
+/* filled once by cpu_init; topology counts are refined by cpu_count_topology once the MADT is known */
+typedef struct {
+    char vendor[13];
+    char brand[49];
+    uint8_t vendor_id;
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+    uint32_t features;
+    uint32_t smt_shift;
+    uint32_t package_shift;
+    uint32_t threads_per_core;
+    uint32_t cores_per_package;
+    uint32_t packages;
+    uint32_t cores;
+    uint32_t threads;
+    uint32_t cache_line;
+    uint32_t cache_count;
+    cpu_cache caches[CPU_MAX_CACHES];
+} cpu_info;
+
+uint32_t acpi_cpu_count(void);
+uint32_t acpi_cpu_apic_id(uint32_t index);
+
+static cpu_info info;
+static uint32_t max_leaf = 0;
+static uint32_t max_ext_leaf = 0;
+
+static const char* feature_names[CPU_FEATURE_COUNT] = {
+    "sse", "sse2", "sse3", "ssse3", "sse4_1", "sse4_2", "avx", "avx2",
+    "fma", "xsave", "erms", "ht", "turbo", "x2apic", "hypervisor", "sse4a",
+    "xop", "fma4", "tbm", "svm", "vmx", "3dnow", "3dnowext", "topoext"
+};
+
+static inline void cpuid(uint32_t leaf, uint32_t sub, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    asm volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(sub));
+}
+
+/* bits needed to hold count distinct ids */
+static uint32_t id_bits(uint32_t count) {
+    uint32_t bits = 0;
+    while ((1u << bits) < count) bits++;
+    return bits;
+}
+
+static void put_reg(char* dst, uint32_t reg) {
+    for (int i = 0; i < 4; i++) dst[i] = (char)((reg >> (i * 8)) & 0xFF);
+}
+
+static void detect_identity(void) {
+    uint32_t a, b, c, d;
+    cpuid(0, 0, &max_leaf, &b, &c, &d);
+    put_reg(info.vendor, b);
+    put_reg(info.vendor + 4, d);
+    put_reg(info.vendor + 8, c);
+    info.vendor[12] = '\0';
+    if (b == 0x756e6547 && d == 0x49656e69 && c == 0x6c65746e) info.vendor_id = CPU_VENDOR_INTEL;
+    else if (b == 0x68747541 && d == 0x69746e65 && c == 0x444d4163) info.vendor_id = CPU_VENDOR_AMD;
+
+    cpuid(0x80000000, 0, &max_ext_leaf, &b, &c, &d);
+    if (max_ext_leaf >= 0x80000004) {
+        for (uint32_t i = 0; i < 3; i++) {
+            cpuid(0x80000002 + i, 0, &a, &b, &c, &d);
+            put_reg(info.brand + i * 16, a);
+            put_reg(info.brand + i * 16 + 4, b);
+            put_reg(info.brand + i * 16 + 8, c);
+            put_reg(info.brand + i * 16 + 12, d);
+        }
+    }
+    info.brand[48] = '\0';
+
+    /* extended family and model only apply to family 0xF, and to family 6 on Intel */
+    cpuid(1, 0, &a, &b, &c, &d);
+    uint32_t base_family = (a >> 8) & 0xF;
+    uint32_t base_model = (a >> 4) & 0xF;
+    info.stepping = a & 0xF;
+    info.family = base_family == 0xF ? base_family + ((a >> 20) & 0xFF) : base_family;
+    info.model = (base_family == 0xF || base_family == 0x6) ? (((a >> 16) & 0xF) << 4) | base_model : base_model;
+}
+
+static void detect_features(void) {
+    uint32_t a, b, c, d;
+    cpuid(1, 0, &a, &b, &c, &d);
+    if (d & (1 << 25)) info.features |= CPU_FEATURE_SSE;
+    if (d & (1 << 26)) info.features |= CPU_FEATURE_SSE2;
+    if (d & (1 << 28)) info.features |= CPU_FEATURE_HT;
+    if (c & (1 << 0))  info.features |= CPU_FEATURE_SSE3;
+    if (c & (1 << 5))  info.features |= CPU_FEATURE_VMX;
+    if (c & (1 << 9))  info.features |= CPU_FEATURE_SSSE3;
+    if (c & (1 << 12)) info.features |= CPU_FEATURE_FMA;
+    if (c & (1 << 19)) info.features |= CPU_FEATURE_SSE4_1;
+    if (c & (1 << 20)) info.features |= CPU_FEATURE_SSE4_2;
+    if (c & (1 << 21)) info.features |= CPU_FEATURE_X2APIC;
+    if (c & (1 << 26)) info.features |= CPU_FEATURE_XSAVE;
+    if (c & (1 << 28)) info.features |= CPU_FEATURE_AVX;
+    if (c & (1u << 31)) info.features |= CPU_FEATURE_HYPERVISOR;
+
+    if (max_leaf >= 6) {
+        cpuid(6, 0, &a, &b, &c, &d);
+        if (a & (1 << 1)) info.features |= CPU_FEATURE_TURBO;
+    }
+    if (max_leaf >= 7) {
+        cpuid(7, 0, &a, &b, &c, &d);
+        if (b & (1 << 5)) info.features |= CPU_FEATURE_AVX2;
+        if (b & (1 << 9)) info.features |= CPU_FEATURE_ERMS;
+    }
+    if (max_ext_leaf >= 0x80000001) {
+        cpuid(0x80000001, 0, &a, &b, &c, &d);
+        if (c & (1 << 2))  info.features |= CPU_FEATURE_SVM;
+        if (c & (1 << 6))  info.features |= CPU_FEATURE_SSE4A;
+        if (c & (1 << 11)) info.features |= CPU_FEATURE_XOP;
+        if (c & (1 << 16)) info.features |= CPU_FEATURE_FMA4;
+        if (c & (1 << 21)) info.features |= CPU_FEATURE_TBM;
+        if (c & (1 << 22)) info.features |= CPU_FEATURE_TOPOEXT;
+        if (d & (1u << 31)) info.features |= CPU_FEATURE_3DNOW;
+        if (d & (1 << 30)) info.features |= CPU_FEATURE_3DNOWEXT;
+    }
+    if (info.vendor_id == CPU_VENDOR_AMD && max_ext_leaf >= 0x80000007) {
+        cpuid(0x80000007, 0, &a, &b, &c, &d);
+        if (d & (1 << 9)) info.features |= CPU_FEATURE_TURBO;
+    }
+}
+
+static void add_cache(uint32_t level, uint32_t type, uint32_t size, uint32_t line, uint32_t ways, uint32_t sets, uint32_t shared_by) {
+    if (info.cache_count >= CPU_MAX_CACHES || !size) return;
+    cpu_cache* cache = &info.caches[info.cache_count++];
+    cache->level = (uint8_t)level;
+    cache->type = (uint8_t)type;
+    cache->size = size;
+    cache->line_size = (uint16_t)line;
+    cache->ways = (uint16_t)ways;
+    cache->sets = sets;
+    cache->shared_by = (uint16_t)(shared_by ? shared_by : 1);
+}
+
+/* Intel leaf 4 and AMD leaf 0x8000001D share one layout: one subleaf per cache until type 0 */
+static int enumerate_caches(uint32_t leaf) {
+    for (uint32_t i = 0; i < CPU_MAX_CACHES; i++) {
+        uint32_t a, b, c, d;
+        cpuid(leaf, i, &a, &b, &c, &d);
+        uint32_t type = a & 0x1F;
+        if (type == 0) break;
+
+        uint32_t line = (b & 0xFFF) + 1;
+        uint32_t partitions = ((b >> 12) & 0x3FF) + 1;
+        uint32_t ways = ((b >> 22) & 0x3FF) + 1;
+        uint32_t sets = c + 1;
+        add_cache((a >> 5) & 0x7, type, ways * partitions * line * sets, line, ways, sets, ((a >> 14) & 0xFFF) + 1);
+    }
+    return info.cache_count > 0;
+}
+
+/* pre-TOPOEXT AMD parts only report sizes; L3 is shared by the whole package */
+static void legacy_amd_caches(void) {
+    uint32_t a, b, c, d;
+    if (max_ext_leaf >= 0x80000005) {
+        cpuid(0x80000005, 0, &a, &b, &c, &d);
+        add_cache(1, CACHE_DATA, (c >> 24) * 1024, c & 0xFF, (c >> 16) & 0xFF, 0, 1);
+        add_cache(1, CACHE_INSTRUCTION, (d >> 24) * 1024, d & 0xFF, (d >> 16) & 0xFF, 0, 1);
+    }
+    if (max_ext_leaf >= 0x80000006) {
+        cpuid(0x80000006, 0, &a, &b, &c, &d);
+        add_cache(2, CACHE_UNIFIED, (c >> 16) * 1024, c & 0xFF, 0, 0, info.threads_per_core);
+        add_cache(3, CACHE_UNIFIED, ((d >> 18) & 0x3FFF) * 512 * 1024, d & 0xFF, 0, 0,
+                  info.threads_per_core * info.cores_per_package);
+    }
+}
+
+static void detect_caches(void) {
+    int found = 0;
+    if (info.vendor_id == CPU_VENDOR_AMD) {
+        if ((info.features & CPU_FEATURE_TOPOEXT) && max_ext_leaf >= 0x8000001D) found = enumerate_caches(0x8000001D);
+        if (!found) legacy_amd_caches();
+    } else if (max_leaf >= 4) {
+        enumerate_caches(4);
+    }
+
+    info.cache_line = 0;
+    for (uint32_t i = 0; i < info.cache_count; i++) {
+        if (info.caches[i].level == 1 && info.caches[i].type != CACHE_INSTRUCTION) info.cache_line = info.caches[i].line_size;
+    }
+    if (!info.cache_line) {
+        uint32_t a, b, c, d;
+        cpuid(1, 0, &a, &b, &c, &d);
+        info.cache_line = ((b >> 8) & 0xFF) * 8;
+    }
+    if (!info.cache_line) info.cache_line = CPU_DEFAULT_LINE;
+}
+
+/* x2APIC topology leaves: each subleaf gives the APIC ID shift to the next level up */
+static int topology_from_leaf(uint32_t leaf) {
+    uint32_t a, b, c, d;
+    if (max_leaf < leaf) return 0;
+    cpuid(leaf, 0, &a, &b, &c, &d);
+    if (b == 0) return 0;
+
+    uint32_t threads_per_package = 1;
+    for (uint32_t sub = 0; sub < 8; sub++) {
+        cpuid(leaf, sub, &a, &b, &c, &d);
+        uint32_t type = (c >> 8) & 0xFF;
+        if (type == 0) break;
+        if (type == TOPO_LEVEL_SMT) {
+            info.smt_shift = a & 0x1F;
+            info.threads_per_core = b & 0xFFFF;
+        }
+        info.package_shift = a & 0x1F;
+        threads_per_package = b & 0xFFFF;
+    }
+    if (!info.threads_per_core) info.threads_per_core = 1;
+    info.cores_per_package = threads_per_package / info.threads_per_core;
+    return 1;
+}
+
+static void detect_topology(void) {
+    uint32_t a, b, c, d;
+    info.threads_per_core = 0;
+
+    if (topology_from_leaf(0x1F) || topology_from_leaf(0xB)) {
+        /* leaf 0xB is authoritative when present */
+    } else if (info.vendor_id == CPU_VENDOR_AMD && max_ext_leaf >= 0x80000008) {
+        cpuid(0x80000008, 0, &a, &b, &c, &d);
+        uint32_t threads_per_package = (c & 0xFF) + 1;
+        info.package_shift = (c >> 12) & 0xF;
+        if (!info.package_shift) info.package_shift = id_bits(threads_per_package);
+        info.threads_per_core = 1;
+        if ((info.features & CPU_FEATURE_TOPOEXT) && max_ext_leaf >= 0x8000001E) {
+            cpuid(0x8000001E, 0, &a, &b, &c, &d);
+            info.threads_per_core = ((b >> 8) & 0xFF) + 1;
+        }
+        info.smt_shift = id_bits(info.threads_per_core);
+        info.cores_per_package = threads_per_package / info.threads_per_core;
+    } else {
+        /* legacy: leaf 1 counts logical processors per package, leaf 4 the cores */
+        cpuid(1, 0, &a, &b, &c, &d);
+        uint32_t threads_per_package = (d & (1 << 28)) ? (b >> 16) & 0xFF : 1;
+        if (!threads_per_package) threads_per_package = 1;
+        uint32_t cores = 1;
+        if (info.vendor_id == CPU_VENDOR_INTEL && max_leaf >= 4) {
+            cpuid(4, 0, &a, &b, &c, &d);
+            cores = ((a >> 26) & 0x3F) + 1;
+        }
+        if (cores > threads_per_package) cores = threads_per_package;
+        info.threads_per_core = threads_per_package / cores;
+        info.cores_per_package = cores;
+        info.smt_shift = id_bits(info.threads_per_core);
+        info.package_shift = id_bits(threads_per_package);
+    }
+
+    if (!info.threads_per_core) info.threads_per_core = 1;
+    if (!info.cores_per_package) info.cores_per_package = 1;
+    info.packages = 1;
+    info.cores = info.cores_per_package;
+    info.threads = info.cores * info.threads_per_core;
+}
+
+/* CPUID only; safe before memory_init so the slab allocator can use the real line size */
+void cpu_init(void) {
+    detect_identity();
+    detect_features();
+    detect_topology();
+    detect_caches();
+}
+
+static int count_distinct(uint32_t shift) {
+    uint32_t n = acpi_cpu_count();
+    int distinct = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t id = acpi_cpu_apic_id(i) >> shift;
+        uint32_t j = 0;
+        while (j < i && (acpi_cpu_apic_id(j) >> shift) != id) j++;
+        if (j == i) distinct++;
+    }
+    return distinct;
+}
+
+/* CPUID describes one package; the MADT lists every processor, so count over its APIC IDs */
+void cpu_count_topology(void) {
+    if (!acpi_cpu_count()) return;
+    info.threads = acpi_cpu_count();
+    info.cores = count_distinct(info.smt_shift);
+    info.packages = count_distinct(info.package_shift);
+}
+
+const cpu_info* cpu_get_info(void) {
+    return &info;
+}
+
+int cpu_has(uint32_t feature) {
+    return (info.features & feature) != 0;
+}
+
+const char* cpu_feature_name(uint32_t bit) {
+    return bit < CPU_FEATURE_COUNT ? feature_names[bit] : 0;
+}
+
+uint32_t cpu_cache_line(void) {
+    return info.cache_line ? info.cache_line : CPU_DEFAULT_LINE;
+}
+
+/* data or unified cache size at level, 0 when there is none */
+uint32_t cpu_cache_size(uint32_t level) {
+    for (uint32_t i = 0; i < info.cache_count; i++) {
+        if (info.caches[i].level == level && info.caches[i].type != CACHE_INSTRUCTION) return info.caches[i].size;
+    }
+    return 0;
+}
+
+/* logical CPUs with the same APIC ID above the SMT bits share a core */
+uint32_t cpu_core_id(uint32_t apic_id) {
+    return apic_id >> info.smt_shift;
+}
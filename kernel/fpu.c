@@ -0,0 +1,276 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define SMP_MAX_CPUS        16
+#define FPU_NO_CPU          0xFFFFFFFF
+#define FXSAVE_SIZE         512
+#define FPU_ALIGN           64
+#define MXCSR_DEFAULT       0x1F80
+
+#define CR0_MP              (1 << 1)
+#define CR0_EM              (1 << 2)
+#define CR0_TS              (1 << 3)
+#define CR0_NE              (1 << 5)
+#define CR4_OSXSAVE         (1 << 18)
+
+#define CPUID_XSAVE         (1 << 26)
+#define CPUID_AVX           (1 << 28)
+#define CPUID_XSAVEOPT      (1 << 0)
+#define XCR0_X87            (1 << 0)
+#define XCR0_SSE            (1 << 1)
+#define XCR0_AVX            (1 << 2)
+
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rdi, rsi, rbp, rbx, rdx, rcx, rax;
+    uint64_t int_no, err_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+} interrupt_frame;
+
+typedef int (*exception_handler)(interrupt_frame* frame);
+
+/* embedded in each thread; area stays unallocated until the thread first touches the FPU */
+typedef struct {
+    void* area;
+    uint32_t cpu;
+} fpu_context;
+
+typedef struct kmem_cache kmem_cache;
+
+void exception_register_handler(uint8_t vector, exception_handler handler);
+kmem_cache* kmem_cache_create(const char* name, uint32_t size, uint32_t align, uint32_t flags);
+void* kmem_cache_alloc(kmem_cache* cache);
+void kmem_cache_free(kmem_cache* cache, void* obj);
+
+/*
+ * Lazy switching: a thread's registers are saved when it is switched out after using
+ * them, but only restored on its first FPU instruction afterwards (#NM with CR0.TS set).
+ * owner[cpu] is whose state the registers hold; if a thread comes back to the CPU it last
+ * restored on and nobody has loaded anything there since, it runs with TS clear.
+ */
+static fpu_context* owner[SMP_MAX_CPUS];
+static fpu_context* running[SMP_MAX_CPUS];
+static volatile uint8_t in_kernel_fpu[SMP_MAX_CPUS];
+static kmem_cache* fpu_cache = 0;
+static void* init_area = 0;
+static uint32_t area_size = FXSAVE_SIZE;
+static uint64_t xcr0 = 0;
+static int use_xsave = 0;
+static int use_xsaveopt = 0;
+static int fpu_ready = 0;
+static uint32_t fpu_restores = 0;
+static uint32_t fpu_saves = 0;
+static uint32_t fpu_contexts = 0;
+
+static inline void cpuid(uint32_t leaf, uint32_t sub, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    asm volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(sub));
+}
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint32_t this_cpu(void) {
+    uint32_t id;
+    asm volatile("movl %%gs:8, %0" : "=r"(id));
+    return id;
+}
+
+static inline unsigned long read_cr0(void) {
+    unsigned long cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    return cr0;
+}
+
+static inline void clts(void) {
+    asm volatile("clts" : : : "memory");
+}
+
+/* writing CR0 serializes, so skip it when TS is already set */
+static inline void stts(void) {
+    unsigned long cr0 = read_cr0();
+    if (!(cr0 & CR0_TS)) asm volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_TS) : "memory");
+}
+
+static inline void xsetbv(uint32_t index, uint64_t value) {
+    asm volatile("xsetbv" : : "c"(index), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static void fpu_save(void* area) {
+    if (use_xsaveopt) {
+        asm volatile("xsaveopt64 (%0)" : : "r"(area), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+    } else if (use_xsave) {
+        asm volatile("xsave64 (%0)" : : "r"(area), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+    } else {
+        asm volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+    }
+    fpu_saves++;
+}
+
+static void fpu_restore(const void* area) {
+    if (use_xsave) {
+        asm volatile("xrstor64 (%0)" : : "r"(area), "a"(0xFFFFFFFF), "d"(0xFFFFFFFF) : "memory");
+    } else {
+        asm volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+    }
+}
+
+/* XRSTOR faults on a non-zero reserved header, so areas start zeroed; memset could recurse into the FPU */
+static void* alloc_area(void) {
+    uint64_t* area = (uint64_t*)kmem_cache_alloc(fpu_cache);
+    if (area) {
+        for (uint32_t i = 0; i < area_size / 8; i++) area[i] = 0;
+    }
+    return area;
+}
+
+static void cpu_setup(void) {
+    unsigned long cr0 = read_cr0();
+    cr0 &= ~(unsigned long)CR0_EM;
+    cr0 |= CR0_MP | CR0_NE;
+    asm volatile("mov %0, %%cr0" : : "r"(cr0));
+    if (xcr0) xsetbv(0, xcr0);
+}
+
+/* first FPU instruction since TS was set: load this thread's state, or a clean one on first use */
+static int device_not_available(interrupt_frame* frame) {
+    uint32_t cpu = this_cpu();
+    fpu_context* ctx = running[cpu];
+    if (!fpu_ready || !ctx || in_kernel_fpu[cpu]) return 0;
+
+    if (!ctx->area) {
+        ctx->area = alloc_area();
+        if (!ctx->area) return 0;
+        __atomic_fetch_add(&fpu_contexts, 1, __ATOMIC_RELAXED);
+        clts();
+        fpu_restore(init_area);
+    } else {
+        clts();
+        if (owner[cpu] != ctx || ctx->cpu != cpu) fpu_restore(ctx->area);
+    }
+    owner[cpu] = ctx;
+    ctx->cpu = cpu;
+    __atomic_fetch_add(&fpu_restores, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/* enables XSAVE with the x87, SSE and AVX components on the boot CPU; call after slab_init */
+int fpu_init(void) {
+    uint32_t a, b, c, d, max, ecx1;
+    cpuid(0, 0, &max, &b, &c, &d);
+    cpuid(1, 0, &a, &b, &ecx1, &d);
+
+    if ((ecx1 & CPUID_XSAVE) && max >= 0xD) {
+        cpuid(0xD, 0, &a, &b, &c, &d);
+        xcr0 = XCR0_X87 | XCR0_SSE;
+        if ((ecx1 & CPUID_AVX) && (a & XCR0_AVX)) xcr0 |= XCR0_AVX;
+
+        unsigned long cr4;
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        asm volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_OSXSAVE));
+        use_xsave = 1;
+    }
+    cpu_setup();
+    if (use_xsave) {
+        /* EBX now reports the area size for exactly the components enabled in XCR0 */
+        cpuid(0xD, 0, &a, &b, &c, &d);
+        area_size = b;
+        cpuid(0xD, 1, &a, &b, &c, &d);
+        use_xsaveopt = (a & CPUID_XSAVEOPT) != 0;
+    }
+
+    fpu_cache = kmem_cache_create("fpu_state", area_size, FPU_ALIGN, 0);
+    if (!fpu_cache) return -1;
+    init_area = alloc_area();
+    if (!init_area) return -1;
+
+    uint32_t mxcsr = MXCSR_DEFAULT;
+    asm volatile("clts; fninit; ldmxcsr %0" : : "m"(mxcsr));
+    fpu_save(init_area);
+    fpu_saves = 0;
+
+    exception_register_handler(7, device_not_available);
+    fpu_ready = 1;
+    return 0;
+}
+
+/* application processors inherit CR4 through the trampoline, but XCR0 is per-CPU */
+void fpu_ap_init(void) {
+    cpu_setup();
+}
+
+void fpu_init_context(fpu_context* ctx) {
+    ctx->area = 0;
+    ctx->cpu = FPU_NO_CPU;
+}
+
+/* the thread is gone, so its state can only still be cached as some CPU's owner */
+void fpu_free_context(fpu_context* ctx) {
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        fpu_context* expected = ctx;
+        __atomic_compare_exchange_n(&owner[i], &expected, 0, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    if (ctx->area) {
+        kmem_cache_free(fpu_cache, ctx->area);
+        __atomic_fetch_sub(&fpu_contexts, 1, __ATOMIC_RELAXED);
+        ctx->area = 0;
+    }
+}
+
+/* called by schedule with interrupts off; prev is null when a CPU adopts its first thread */
+void fpu_switch(fpu_context* prev, fpu_context* next) {
+    if (!fpu_ready) return;
+    uint32_t cpu = this_cpu();
+
+    /* TS clear means prev's state was loaded during this slice and may have changed */
+    if (prev && owner[cpu] == prev && !(read_cr0() & CR0_TS)) fpu_save(prev->area);
+    running[cpu] = next;
+    if (owner[cpu] == next && next->cpu == cpu) clts();
+    else stts();
+}
+
+/*
+ * Makes the vector registers usable by kernel code until kernel_fpu_end, with interrupts
+ * off. Returns 0 when this CPU is already inside such a section, e.g. a fault taken in
+ * the middle of one, and the caller should fall back to general registers.
+ */
+int kernel_fpu_begin(unsigned long* flags) {
+    if (!fpu_ready) return 0;
+    *flags = irq_save();
+    uint32_t cpu = this_cpu();
+    if (in_kernel_fpu[cpu]) {
+        irq_restore(*flags);
+        return 0;
+    }
+    in_kernel_fpu[cpu] = 1;
+
+    fpu_context* live = owner[cpu];
+    if (live && live == running[cpu] && !(read_cr0() & CR0_TS)) fpu_save(live->area);
+    owner[cpu] = 0;
+    clts();
+    return 1;
+}
+
+/* the interrupted thread's state was saved above, so its next FPU use reloads it */
+void kernel_fpu_end(unsigned long flags) {
+    stts();
+    in_kernel_fpu[this_cpu()] = 0;
+    irq_restore(flags);
+}
+
+void fpu_stats(uint32_t* stats) {
+    stats[0] = use_xsaveopt ? 2 : use_xsave;
+    stats[1] = area_size;
+    stats[2] = fpu_contexts;
+    stats[3] = fpu_restores;
+    stats[4] = fpu_saves;
+}
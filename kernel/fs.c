@@ -0,0 +1,1066 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define FS_MAGIC            0x46444C48
+#define FS_VERSION          1
+#define FS_BLOCK_SIZE       4096
+#define FS_LBA              2048
+#define FS_ROOT_INO         1
+#define FS_NAME_MAX         52
+#define FS_PATH_MAX         256
+#define FS_INLINE_EXTENTS   8
+#define FS_INODE_SIZE       128
+#define FS_INODES_PER_BLOCK (FS_BLOCK_SIZE / FS_INODE_SIZE)
+#define FS_DIRENT_SIZE      64
+#define FS_DIRENTS_PER_BLOCK (FS_BLOCK_SIZE / FS_DIRENT_SIZE)
+#define FS_BITS_PER_BLOCK   (FS_BLOCK_SIZE * 8)
+#define FS_EXTENTS_PER_BLOCK (FS_BLOCK_SIZE / 8)
+
+#define FS_TYPE_FREE        0
+#define FS_TYPE_FILE        1
+#define FS_TYPE_DIR         2
+
+#define DIRENT_EMPTY        0
+#define DIRENT_USED         1
+#define DIRENT_DELETED      2
+
+#define ICACHE_HASH         256
+#define ICACHE_MAX          512
+#define DCACHE_HASH         512
+#define DCACHE_MAX          2048
+
+#define SLAB_HWCACHE_ALIGN  (1 << 0)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t inode_count;
+    uint32_t bitmap_start;
+    uint32_t bitmap_blocks;
+    uint32_t inode_start;
+    uint32_t inode_blocks;
+    uint32_t data_start;
+    uint32_t root_inode;
+    uint32_t free_blocks;
+    uint32_t free_inodes;
+} fs_superblock;
+
+typedef struct {
+    uint32_t start;
+    uint32_t length;
+} fs_extent;
+
+typedef struct {
+    uint16_t type;
+    uint16_t links;
+    uint32_t parent;
+    uint64_t size;
+    uint32_t mtime;
+    uint32_t extent_count;
+    fs_extent extents[FS_INLINE_EXTENTS];
+    uint32_t extent_block;
+    uint32_t dir_entries;
+    uint32_t dir_tombstones;
+    uint8_t reserved[28];
+} __attribute__((packed)) fs_inode_disk;
+
+typedef struct {
+    uint32_t ino;
+    uint32_t hash;
+    uint8_t state;
+    uint8_t type;
+    uint8_t name_len;
+    char name[FS_NAME_MAX + 1];
+} __attribute__((packed)) fs_dirent;
+
+typedef struct fs_inode {
+    uint32_t ino;
+    uint32_t refcount;
+    fs_inode_disk d;
+    uint32_t hint_index;
+    uint32_t hint_logical;
+    struct fs_inode* hash_next;
+    struct fs_inode* lru_prev;
+    struct fs_inode* lru_next;
+} fs_inode;
+
+typedef struct fs_dentry {
+    uint32_t parent;
+    uint32_t ino;
+    uint32_t hash;
+    uint8_t name_len;
+    char name[FS_NAME_MAX + 1];
+    struct fs_dentry* hash_next;
+    struct fs_dentry* lru_prev;
+    struct fs_dentry* lru_next;
+} fs_dentry;
+
+typedef struct block_device block_device;
+typedef struct buffer buffer;
+typedef struct kmem_cache kmem_cache;
+
+uint32_t block_count(void);
+block_device* block_get(uint32_t index);
+uint64_t block_sectors(block_device* dev);
+const char* block_name(block_device* dev);
+buffer* bread(block_device* dev, uint64_t block);
+buffer* bget(block_device* dev, uint64_t block);
+void brelse(buffer* b);
+void bdirty(buffer* b);
+void* bdata(buffer* b);
+int bcache_sync(block_device* dev);
+kmem_cache* kmem_cache_create(const char* name, uint32_t size, uint32_t align, uint32_t flags);
+void* kmem_cache_alloc(kmem_cache* cache);
+void kmem_cache_free(kmem_cache* cache, void* obj);
+void* vmalloc(size_t size);
+void vfree(void* ptr);
+void* memcpy(void* dest, const void* src, size_t n);
+void* memset(void* dest, int c, size_t n);
+uint32_t rtc_epoch_seconds(void);
+uint32_t timer_uptime_seconds(void);
+void pagecache_invalidate(uint32_t ino);
+
+static block_device* fs_dev = 0;
+static uint64_t fs_base = 0;
+static fs_superblock sb;
+static uint32_t boot_epoch = 0;
+static uint32_t inode_hint = 1;
+static kmem_cache* inode_cache = 0;
+static kmem_cache* dentry_cache = 0;
+static fs_inode* icache[ICACHE_HASH];
+static fs_inode* ilru_head = 0;
+static fs_inode* ilru_tail = 0;
+static uint32_t icache_count = 0;
+static fs_dentry* dcache[DCACHE_HASH];
+static fs_dentry* dlru_head = 0;
+static fs_dentry* dlru_tail = 0;
+static uint32_t dcache_count = 0;
+static uint32_t dcache_hits = 0;
+static uint32_t dcache_misses = 0;
+static const uint8_t zero_block[FS_BLOCK_SIZE];
+
+static uint32_t fs_now(void) {
+    return boot_epoch + timer_uptime_seconds();
+}
+
+static uint32_t name_hash(const char* name, uint32_t len) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int name_equal(const char* a, const char* b, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+static buffer* fs_bread(uint32_t block) {
+    return bread(fs_dev, fs_base + block);
+}
+
+static void sb_write(void) {
+    buffer* b = fs_bread(0);
+    if (!b) return;
+    memcpy(bdata(b), &sb, sizeof(sb));
+    bdirty(b);
+    brelse(b);
+}
+
+static uint32_t bitmap_alloc(uint32_t goal) {
+    if (!sb.free_blocks) return 0;
+    if (goal < sb.data_start || goal >= sb.block_count) goal = sb.data_start;
+
+    uint32_t block = goal;
+    uint32_t scanned = 0;
+    while (scanned < sb.block_count) {
+        buffer* b = fs_bread(sb.bitmap_start + block / FS_BITS_PER_BLOCK);
+        if (!b) return 0;
+        uint64_t* words = (uint64_t*)bdata(b);
+
+        while (block < sb.block_count && scanned < sb.block_count) {
+            uint32_t bit = block % FS_BITS_PER_BLOCK;
+            uint64_t word = words[bit / 64];
+            if (word == ~0UL) {
+                uint32_t skip = 64 - (bit % 64);
+                block += skip;
+                scanned += skip;
+            } else if (word & (1UL << (bit % 64))) {
+                block++;
+                scanned++;
+            } else {
+                words[bit / 64] = word | (1UL << (bit % 64));
+                bdirty(b);
+                brelse(b);
+                sb.free_blocks--;
+                sb_write();
+                return block;
+            }
+            if (block % FS_BITS_PER_BLOCK == 0) break;
+        }
+        brelse(b);
+        if (block >= sb.block_count) block = sb.data_start;
+    }
+    return 0;
+}
+
+static void bitmap_free(uint32_t block) {
+    if (block < sb.data_start || block >= sb.block_count) return;
+
+    buffer* b = fs_bread(sb.bitmap_start + block / FS_BITS_PER_BLOCK);
+    if (!b) return;
+    uint64_t* words = (uint64_t*)bdata(b);
+    uint32_t bit = block % FS_BITS_PER_BLOCK;
+    if (words[bit / 64] & (1UL << (bit % 64))) {
+        words[bit / 64] &= ~(1UL << (bit % 64));
+        bdirty(b);
+        sb.free_blocks++;
+    }
+    brelse(b);
+    sb_write();
+}
+
+static int inode_load(uint32_t ino, fs_inode_disk* d) {
+    buffer* b = fs_bread(sb.inode_start + (ino - 1) / FS_INODES_PER_BLOCK);
+    if (!b) return -1;
+    memcpy(d, (uint8_t*)bdata(b) + ((ino - 1) % FS_INODES_PER_BLOCK) * FS_INODE_SIZE, sizeof(*d));
+    brelse(b);
+    return 0;
+}
+
+static void inode_write(fs_inode* ip) {
+    buffer* b = fs_bread(sb.inode_start + (ip->ino - 1) / FS_INODES_PER_BLOCK);
+    if (!b) return;
+    memcpy((uint8_t*)bdata(b) + ((ip->ino - 1) % FS_INODES_PER_BLOCK) * FS_INODE_SIZE, &ip->d, sizeof(ip->d));
+    bdirty(b);
+    brelse(b);
+}
+
+static void ilru_unlink(fs_inode* ip) {
+    if (ip->lru_prev) ip->lru_prev->lru_next = ip->lru_next;
+    else if (ilru_head == ip) ilru_head = ip->lru_next;
+    if (ip->lru_next) ip->lru_next->lru_prev = ip->lru_prev;
+    else if (ilru_tail == ip) ilru_tail = ip->lru_prev;
+    ip->lru_prev = 0;
+    ip->lru_next = 0;
+}
+
+static void icache_remove(fs_inode* ip) {
+    fs_inode** link = &icache[ip->ino & (ICACHE_HASH - 1)];
+    while (*link && *link != ip) link = &(*link)->hash_next;
+    if (*link) *link = ip->hash_next;
+    ilru_unlink(ip);
+    icache_count--;
+    kmem_cache_free(inode_cache, ip);
+}
+
+fs_inode* fs_iget(uint32_t ino) {
+    if (!fs_dev || ino == 0 || ino > sb.inode_count) return 0;
+
+    fs_inode* ip = icache[ino & (ICACHE_HASH - 1)];
+    while (ip && ip->ino != ino) ip = ip->hash_next;
+    if (ip) {
+        if (ip->refcount++ == 0) ilru_unlink(ip);
+        return ip;
+    }
+
+    while (icache_count >= ICACHE_MAX && ilru_tail) icache_remove(ilru_tail);
+
+    ip = (fs_inode*)kmem_cache_alloc(inode_cache);
+    if (!ip) return 0;
+    if (inode_load(ino, &ip->d) < 0 || ip->d.type == FS_TYPE_FREE) {
+        kmem_cache_free(inode_cache, ip);
+        return 0;
+    }
+    ip->ino = ino;
+    ip->refcount = 1;
+    ip->hint_index = 0;
+    ip->hint_logical = 0;
+    ip->lru_prev = 0;
+    ip->lru_next = 0;
+    ip->hash_next = icache[ino & (ICACHE_HASH - 1)];
+    icache[ino & (ICACHE_HASH - 1)] = ip;
+    icache_count++;
+    return ip;
+}
+
+static int extent_get(fs_inode* ip, uint32_t index, fs_extent* e) {
+    if (index < FS_INLINE_EXTENTS) {
+        *e = ip->d.extents[index];
+        return 0;
+    }
+    buffer* b = fs_bread(ip->d.extent_block);
+    if (!b) return -1;
+    *e = ((fs_extent*)bdata(b))[index - FS_INLINE_EXTENTS];
+    brelse(b);
+    return 0;
+}
+
+static int extent_set(fs_inode* ip, uint32_t index, const fs_extent* e) {
+    if (index < FS_INLINE_EXTENTS) {
+        ip->d.extents[index] = *e;
+        return 0;
+    }
+    buffer* b = fs_bread(ip->d.extent_block);
+    if (!b) return -1;
+    ((fs_extent*)bdata(b))[index - FS_INLINE_EXTENTS] = *e;
+    bdirty(b);
+    brelse(b);
+    return 0;
+}
+
+static uint32_t inode_blocks(fs_inode* ip) {
+    return (uint32_t)((ip->d.size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE);
+}
+
+static uint32_t inode_allocated(fs_inode* ip) {
+    uint32_t total = 0;
+    fs_extent e;
+    for (uint32_t i = 0; i < ip->d.extent_count; i++) {
+        if (extent_get(ip, i, &e) < 0) break;
+        total += e.length;
+    }
+    return total;
+}
+
+/* sequential access resumes from the extent that served the previous lookup */
+static uint32_t inode_bmap(fs_inode* ip, uint32_t fblock) {
+    uint32_t index = 0;
+    uint32_t logical = 0;
+    fs_extent e;
+
+    if (ip->hint_index < ip->d.extent_count && fblock >= ip->hint_logical) {
+        index = ip->hint_index;
+        logical = ip->hint_logical;
+    }
+    for (; index < ip->d.extent_count; index++) {
+        if (extent_get(ip, index, &e) < 0) return 0;
+        if (fblock < logical + e.length) {
+            ip->hint_index = index;
+            ip->hint_logical = logical;
+            return e.start + (fblock - logical);
+        }
+        logical += e.length;
+    }
+    return 0;
+}
+
+static uint32_t inode_append_block(fs_inode* ip) {
+    fs_extent last = { 0, 0 };
+    uint32_t goal = sb.data_start;
+
+    if (ip->d.extent_count) {
+        if (extent_get(ip, ip->d.extent_count - 1, &last) < 0) return 0;
+        goal = last.start + last.length;
+    }
+
+    uint32_t block = bitmap_alloc(goal);
+    if (!block) return 0;
+
+    buffer* b = bget(fs_dev, fs_base + block);
+    if (b) {
+        memset(bdata(b), 0, FS_BLOCK_SIZE);
+        bdirty(b);
+        brelse(b);
+    }
+
+    if (ip->d.extent_count && block == last.start + last.length) {
+        last.length++;
+        extent_set(ip, ip->d.extent_count - 1, &last);
+        return block;
+    }
+
+    if (ip->d.extent_count >= FS_INLINE_EXTENTS + FS_EXTENTS_PER_BLOCK) {
+        bitmap_free(block);
+        return 0;
+    }
+    if (ip->d.extent_count == FS_INLINE_EXTENTS && !ip->d.extent_block) {
+        uint32_t overflow = bitmap_alloc(block + 1);
+        if (!overflow) {
+            bitmap_free(block);
+            return 0;
+        }
+        buffer* ob = bget(fs_dev, fs_base + overflow);
+        if (ob) {
+            memset(bdata(ob), 0, FS_BLOCK_SIZE);
+            bdirty(ob);
+            brelse(ob);
+        }
+        ip->d.extent_block = overflow;
+    }
+
+    fs_extent e = { block, 1 };
+    extent_set(ip, ip->d.extent_count, &e);
+    ip->d.extent_count++;
+    return block;
+}
+
+static void inode_free_blocks(fs_inode* ip, uint32_t keep) {
+    uint32_t total = inode_allocated(ip);
+    fs_extent e;
+
+    while (total > keep && ip->d.extent_count) {
+        uint32_t index = ip->d.extent_count - 1;
+        if (extent_get(ip, index, &e) < 0) break;
+
+        uint32_t drop = total - keep;
+        if (drop > e.length) drop = e.length;
+        for (uint32_t i = 0; i < drop; i++) bitmap_free(e.start + e.length - 1 - i);
+        e.length -= drop;
+        total -= drop;
+
+        if (e.length == 0) {
+            ip->d.extent_count--;
+            e.start = 0;
+        }
+        extent_set(ip, index, &e);
+    }
+    if (ip->d.extent_count <= FS_INLINE_EXTENTS && ip->d.extent_block) {
+        bitmap_free(ip->d.extent_block);
+        ip->d.extent_block = 0;
+    }
+    ip->hint_index = 0;
+    ip->hint_logical = 0;
+}
+
+static void inode_release(fs_inode* ip) {
+    pagecache_invalidate(ip->ino);
+    inode_free_blocks(ip, 0);
+    memset(&ip->d, 0, sizeof(ip->d));
+    inode_write(ip);
+    sb.free_inodes++;
+    sb_write();
+    if (ip->ino < inode_hint) inode_hint = ip->ino;
+}
+
+void fs_iput(fs_inode* ip) {
+    if (!ip || !ip->refcount) return;
+    if (--ip->refcount) return;
+
+    if (ip->d.links == 0) {
+        inode_release(ip);
+        icache_remove(ip);
+        return;
+    }
+    ip->lru_prev = 0;
+    ip->lru_next = ilru_head;
+    if (ilru_head) ilru_head->lru_prev = ip;
+    ilru_head = ip;
+    if (!ilru_tail) ilru_tail = ip;
+}
+
+static fs_inode* inode_alloc(uint16_t type, uint32_t parent) {
+    if (!sb.free_inodes) return 0;
+
+    for (uint32_t n = 0; n < sb.inode_count; n++) {
+        uint32_t ino = inode_hint + n;
+        if (ino > sb.inode_count) ino -= sb.inode_count;
+
+        fs_inode_disk d;
+        if (inode_load(ino, &d) < 0) return 0;
+        if (d.type != FS_TYPE_FREE) continue;
+
+        buffer* b = fs_bread(sb.inode_start + (ino - 1) / FS_INODES_PER_BLOCK);
+        if (!b) return 0;
+        fs_inode_disk* slot = (fs_inode_disk*)((uint8_t*)bdata(b) + ((ino - 1) % FS_INODES_PER_BLOCK) * FS_INODE_SIZE);
+        memset(slot, 0, sizeof(*slot));
+        slot->type = type;
+        slot->links = 1;
+        slot->parent = parent;
+        slot->mtime = fs_now();
+        bdirty(b);
+        brelse(b);
+
+        sb.free_inodes--;
+        sb_write();
+        inode_hint = ino + 1;
+        return fs_iget(ino);
+    }
+    return 0;
+}
+
+long fs_read(fs_inode* ip, uint64_t offset, void* buf, uint64_t len) {
+    uint8_t* out = (uint8_t*)buf;
+    uint64_t done = 0;
+
+    if (offset >= ip->d.size) return 0;
+    if (len > ip->d.size - offset) len = ip->d.size - offset;
+
+    while (done < len) {
+        uint32_t boff = (uint32_t)(offset % FS_BLOCK_SIZE);
+        uint32_t n = FS_BLOCK_SIZE - boff;
+        if (n > len - done) n = (uint32_t)(len - done);
+
+        uint32_t block = inode_bmap(ip, (uint32_t)(offset / FS_BLOCK_SIZE));
+        if (!block) return done ? (long)done : -1;
+        buffer* b = fs_bread(block);
+        if (!b) return done ? (long)done : -1;
+        memcpy(out + done, (uint8_t*)bdata(b) + boff, n);
+        brelse(b);
+
+        done += n;
+        offset += n;
+    }
+    return (long)done;
+}
+
+long fs_write(fs_inode* ip, uint64_t offset, const void* buf, uint64_t len) {
+    const uint8_t* in = (const uint8_t*)buf;
+    uint64_t done = 0;
+
+    if (len == 0) return 0;
+    uint32_t needed = (uint32_t)((offset + len + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE);
+    uint32_t have = inode_allocated(ip);
+    while (have < needed) {
+        if (!inode_append_block(ip)) break;
+        have++;
+    }
+    if (have < needed) {
+        uint64_t limit = (uint64_t)have * FS_BLOCK_SIZE;
+        if (offset >= limit) {
+            inode_write(ip);
+            return -1;
+        }
+        len = limit - offset;
+    }
+
+    while (done < len) {
+        uint32_t boff = (uint32_t)(offset % FS_BLOCK_SIZE);
+        uint32_t n = FS_BLOCK_SIZE - boff;
+        if (n > len - done) n = (uint32_t)(len - done);
+
+        uint32_t block = inode_bmap(ip, (uint32_t)(offset / FS_BLOCK_SIZE));
+        if (!block) break;
+        buffer* b = (n == FS_BLOCK_SIZE) ? bget(fs_dev, fs_base + block) : fs_bread(block);
+        if (!b) break;
+        memcpy((uint8_t*)bdata(b) + boff, in + done, n);
+        bdirty(b);
+        brelse(b);
+
+        done += n;
+        offset += n;
+    }
+
+    if (offset > ip->d.size) ip->d.size = offset;
+    ip->d.mtime = fs_now();
+    inode_write(ip);
+    return done ? (long)done : -1;
+}
+
+int fs_truncate(fs_inode* ip, uint64_t size) {
+    if (ip->d.type != FS_TYPE_FILE) return -1;
+    if (size > ip->d.size) {
+        while (ip->d.size < size) {
+            uint64_t n = size - ip->d.size;
+            if (n > FS_BLOCK_SIZE) n = FS_BLOCK_SIZE;
+            if (fs_write(ip, ip->d.size, zero_block, n) < 0) return -1;
+        }
+        return 0;
+    }
+
+    ip->d.size = size;
+    inode_free_blocks(ip, inode_blocks(ip));
+    if (size % FS_BLOCK_SIZE) {
+        uint32_t block = inode_bmap(ip, (uint32_t)(size / FS_BLOCK_SIZE));
+        buffer* b = block ? fs_bread(block) : 0;
+        if (b) {
+            memset((uint8_t*)bdata(b) + size % FS_BLOCK_SIZE, 0, FS_BLOCK_SIZE - size % FS_BLOCK_SIZE);
+            bdirty(b);
+            brelse(b);
+        }
+    }
+    ip->d.mtime = fs_now();
+    inode_write(ip);
+    return 0;
+}
+
+static uint32_t dir_slots(fs_inode* dir) {
+    return (uint32_t)(dir->d.size / FS_DIRENT_SIZE);
+}
+
+/* open addressing over the directory's slots; returns the matching slot or -1 with an insert slot */
+static int dir_find(fs_inode* dir, const char* name, uint32_t len, uint32_t hash,
+                    uint32_t* insert_slot, fs_dirent* found) {
+    uint32_t slots = dir_slots(dir);
+    uint32_t slot = hash & (slots - 1);
+    uint32_t first_free = 0xFFFFFFFF;
+    buffer* b = 0;
+    uint32_t cached_block = 0xFFFFFFFF;
+
+    for (uint32_t probe = 0; probe < slots; probe++) {
+        uint32_t fblock = slot / FS_DIRENTS_PER_BLOCK;
+        if (fblock != cached_block) {
+            if (b) brelse(b);
+            uint32_t block = inode_bmap(dir, fblock);
+            b = block ? fs_bread(block) : 0;
+            if (!b) return -1;
+            cached_block = fblock;
+        }
+
+        fs_dirent* de = (fs_dirent*)bdata(b) + (slot % FS_DIRENTS_PER_BLOCK);
+        if (de->state == DIRENT_EMPTY) {
+            if (first_free == 0xFFFFFFFF) first_free = slot;
+            break;
+        }
+        if (de->state == DIRENT_DELETED) {
+            if (first_free == 0xFFFFFFFF) first_free = slot;
+        } else if (de->hash == hash && de->name_len == len && name_equal(de->name, name, len)) {
+            if (found) memcpy(found, de, sizeof(*de));
+            if (insert_slot) *insert_slot = slot;
+            brelse(b);
+            return (int)slot;
+        }
+        slot = (slot + 1) & (slots - 1);
+    }
+    if (b) brelse(b);
+    if (insert_slot) *insert_slot = first_free;
+    return -1;
+}
+
+static int dir_slot_write(fs_inode* dir, uint32_t slot, const fs_dirent* de) {
+    uint32_t block = inode_bmap(dir, slot / FS_DIRENTS_PER_BLOCK);
+    buffer* b = block ? fs_bread(block) : 0;
+    if (!b) return -1;
+    memcpy((fs_dirent*)bdata(b) + (slot % FS_DIRENTS_PER_BLOCK), de, sizeof(*de));
+    bdirty(b);
+    brelse(b);
+    return 0;
+}
+
+static int dir_insert_raw(fs_inode* dir, const fs_dirent* de) {
+    uint32_t slot;
+    if (dir_find(dir, de->name, de->name_len, de->hash, &slot, 0) >= 0) return -1;
+    if (slot == 0xFFFFFFFF) return -1;
+    return dir_slot_write(dir, slot, de);
+}
+
+static int dir_build_table(fs_inode* table, uint32_t slots, const fs_dirent* live, uint32_t count) {
+    for (uint32_t i = 0; i < slots / FS_DIRENTS_PER_BLOCK; i++) {
+        if (!inode_append_block(table)) return -1;
+    }
+    table->d.size = (uint64_t)slots * FS_DIRENT_SIZE;
+    for (uint32_t i = 0; i < count; i++) {
+        if (dir_insert_raw(table, &live[i]) < 0) return -1;
+    }
+    return 0;
+}
+
+/* rehashes every live entry into a table sized for a load factor of at most 1/2 */
+static int dir_rehash(fs_inode* dir) {
+    uint32_t old_slots = dir_slots(dir);
+    uint32_t count = 0;
+    uint32_t slots = FS_DIRENTS_PER_BLOCK;
+    while (slots < (dir->d.dir_entries + 1) * 2) slots *= 2;
+
+    fs_dirent* live = (fs_dirent*)vmalloc((dir->d.dir_entries + 1) * sizeof(fs_dirent));
+    if (!live) return -1;
+
+    for (uint32_t fblock = 0; fblock < old_slots / FS_DIRENTS_PER_BLOCK; fblock++) {
+        uint32_t block = inode_bmap(dir, fblock);
+        buffer* b = block ? fs_bread(block) : 0;
+        if (!b) {
+            vfree(live);
+            return -1;
+        }
+        fs_dirent* de = (fs_dirent*)bdata(b);
+        for (uint32_t i = 0; i < FS_DIRENTS_PER_BLOCK; i++) {
+            if (de[i].state == DIRENT_USED && count <= dir->d.dir_entries) live[count++] = de[i];
+        }
+        brelse(b);
+    }
+
+    /* the new table is built in blocks owned by a scratch inode, so a failure leaves dir untouched */
+    fs_inode table;
+    memset(&table, 0, sizeof(table));
+    table.ino = dir->ino;
+    table.d.type = dir->d.type;
+    if (dir_build_table(&table, slots, live, count) < 0) {
+        inode_free_blocks(&table, 0);
+        vfree(live);
+        return -1;
+    }
+    vfree(live);
+
+    inode_free_blocks(dir, 0);
+    dir->d.size = table.d.size;
+    dir->d.extent_count = table.d.extent_count;
+    memcpy(dir->d.extents, table.d.extents, sizeof(dir->d.extents));
+    dir->d.extent_block = table.d.extent_block;
+    dir->d.dir_entries = count;
+    dir->d.dir_tombstones = 0;
+    inode_write(dir);
+    return 0;
+}
+
+static int dir_add(fs_inode* dir, const char* name, uint32_t len, uint32_t ino, uint8_t type) {
+    uint32_t slots = dir_slots(dir);
+    if (slots == 0 || (dir->d.dir_entries + dir->d.dir_tombstones + 1) * 4 > slots * 3) {
+        if (dir_rehash(dir) < 0) return -1;
+    }
+
+    fs_dirent de;
+    memset(&de, 0, sizeof(de));
+    de.ino = ino;
+    de.hash = name_hash(name, len);
+    de.state = DIRENT_USED;
+    de.type = type;
+    de.name_len = (uint8_t)len;
+    memcpy(de.name, name, len);
+
+    uint32_t slot;
+    if (dir_find(dir, name, len, de.hash, &slot, 0) >= 0 || slot == 0xFFFFFFFF) return -1;
+
+    fs_dirent old;
+    uint32_t block = inode_bmap(dir, slot / FS_DIRENTS_PER_BLOCK);
+    buffer* b = block ? fs_bread(block) : 0;
+    if (!b) return -1;
+    memcpy(&old, (fs_dirent*)bdata(b) + (slot % FS_DIRENTS_PER_BLOCK), sizeof(old));
+    brelse(b);
+
+    if (dir_slot_write(dir, slot, &de) < 0) return -1;
+    if (old.state == DIRENT_DELETED) dir->d.dir_tombstones--;
+    dir->d.dir_entries++;
+    dir->d.mtime = fs_now();
+    inode_write(dir);
+    return 0;
+}
+
+static int dir_remove(fs_inode* dir, uint32_t slot) {
+    fs_dirent de;
+    memset(&de, 0, sizeof(de));
+    de.state = DIRENT_DELETED;
+    if (dir_slot_write(dir, slot, &de) < 0) return -1;
+
+    dir->d.dir_entries--;
+    dir->d.dir_tombstones++;
+    dir->d.mtime = fs_now();
+    inode_write(dir);
+    return 0;
+}
+
+static uint32_t dcache_index(uint32_t parent, uint32_t hash) {
+    return (hash ^ (parent * 0x9E3779B1u)) & (DCACHE_HASH - 1);
+}
+
+static void dlru_unlink(fs_dentry* de) {
+    if (de->lru_prev) de->lru_prev->lru_next = de->lru_next;
+    else dlru_head = de->lru_next;
+    if (de->lru_next) de->lru_next->lru_prev = de->lru_prev;
+    else dlru_tail = de->lru_prev;
+}
+
+static void dlru_push_front(fs_dentry* de) {
+    de->lru_prev = 0;
+    de->lru_next = dlru_head;
+    if (dlru_head) dlru_head->lru_prev = de;
+    dlru_head = de;
+    if (!dlru_tail) dlru_tail = de;
+}
+
+static fs_dentry* dcache_lookup(uint32_t parent, const char* name, uint32_t len, uint32_t hash) {
+    fs_dentry* de = dcache[dcache_index(parent, hash)];
+    while (de) {
+        if (de->parent == parent && de->hash == hash && de->name_len == len && name_equal(de->name, name, len)) {
+            dlru_unlink(de);
+            dlru_push_front(de);
+            return de;
+        }
+        de = de->hash_next;
+    }
+    return 0;
+}
+
+static void dcache_remove(fs_dentry* de) {
+    fs_dentry** link = &dcache[dcache_index(de->parent, de->hash)];
+    while (*link && *link != de) link = &(*link)->hash_next;
+    if (*link) *link = de->hash_next;
+    dlru_unlink(de);
+    dcache_count--;
+    kmem_cache_free(dentry_cache, de);
+}
+
+static void dcache_set(uint32_t parent, const char* name, uint32_t len, uint32_t hash, uint32_t ino) {
+    fs_dentry* de = dcache_lookup(parent, name, len, hash);
+    if (de) {
+        de->ino = ino;
+        return;
+    }
+
+    if (dcache_count >= DCACHE_MAX && dlru_tail) dcache_remove(dlru_tail);
+    de = (fs_dentry*)kmem_cache_alloc(dentry_cache);
+    if (!de) return;
+
+    de->parent = parent;
+    de->ino = ino;
+    de->hash = hash;
+    de->name_len = (uint8_t)len;
+    memcpy(de->name, name, len);
+    de->name[len] = '\0';
+    uint32_t index = dcache_index(parent, hash);
+    de->hash_next = dcache[index];
+    dcache[index] = de;
+    dlru_push_front(de);
+    dcache_count++;
+}
+
+/* resolves one name in a directory through the dentry cache; negative entries cache misses */
+static uint32_t dir_lookup(fs_inode* dir, const char* name, uint32_t len) {
+    uint32_t hash = name_hash(name, len);
+    fs_dentry* cached = dcache_lookup(dir->ino, name, len, hash);
+    if (cached) {
+        dcache_hits++;
+        return cached->ino;
+    }
+
+    dcache_misses++;
+    fs_dirent found;
+    uint32_t ino = 0;
+    if (dir_slots(dir) && dir_find(dir, name, len, hash, 0, &found) >= 0) ino = found.ino;
+    dcache_set(dir->ino, name, len, hash, ino);
+    return ino;
+}
+
+static const char* next_component(const char* path, uint32_t* len) {
+    while (*path == '/') path++;
+    *len = 0;
+    while (path[*len] && path[*len] != '/') (*len)++;
+    return path;
+}
+
+fs_inode* fs_namei(const char* path) {
+    if (!fs_dev || !path) return 0;
+
+    fs_inode* ip = fs_iget(FS_ROOT_INO);
+    uint32_t len;
+    const char* name = next_component(path, &len);
+
+    while (ip && len) {
+        uint32_t next = 0;
+        if (ip->d.type != FS_TYPE_DIR || len > FS_NAME_MAX) {
+            fs_iput(ip);
+            return 0;
+        }
+        if (len == 1 && name[0] == '.') {
+            next = ip->ino;
+        } else if (len == 2 && name[0] == '.' && name[1] == '.') {
+            next = ip->d.parent ? ip->d.parent : FS_ROOT_INO;
+        } else {
+            next = dir_lookup(ip, name, len);
+        }
+        fs_iput(ip);
+        ip = next ? fs_iget(next) : 0;
+        name = next_component(name + len, &len);
+    }
+    return ip;
+}
+
+static fs_inode* namei_parent(const char* path, const char** name, uint32_t* len) {
+    const char* last = path;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/' && p[1] && p[1] != '/') last = p + 1;
+    }
+    *name = last;
+    *len = 0;
+    while (last[*len] && last[*len] != '/') (*len)++;
+    if (*len == 0 || *len > FS_NAME_MAX) return 0;
+    if ((*len == 1 && last[0] == '.') || (*len == 2 && last[0] == '.' && last[1] == '.')) return 0;
+
+    char parent[FS_PATH_MAX];
+    uint32_t plen = (uint32_t)(last - path);
+    if (plen >= FS_PATH_MAX) return 0;
+    memcpy(parent, path, plen);
+    parent[plen] = '\0';
+    return fs_namei(parent);
+}
+
+fs_inode* fs_create(const char* path, int type) {
+    const char* name;
+    uint32_t len;
+    fs_inode* dir = namei_parent(path, &name, &len);
+    if (!dir) return 0;
+    if (dir->d.type != FS_TYPE_DIR || dir_lookup(dir, name, len)) {
+        fs_iput(dir);
+        return 0;
+    }
+
+    fs_inode* ip = inode_alloc(type == FS_TYPE_DIR ? FS_TYPE_DIR : FS_TYPE_FILE, dir->ino);
+    if (!ip) {
+        fs_iput(dir);
+        return 0;
+    }
+    if (dir_add(dir, name, len, ip->ino, (uint8_t)ip->d.type) < 0) {
+        ip->d.links = 0;
+        fs_iput(ip);
+        fs_iput(dir);
+        return 0;
+    }
+    dcache_set(dir->ino, name, len, name_hash(name, len), ip->ino);
+    fs_iput(dir);
+    return ip;
+}
+
+int fs_unlink(const char* path) {
+    const char* name;
+    uint32_t len;
+    fs_inode* dir = namei_parent(path, &name, &len);
+    if (!dir) return -1;
+
+    uint32_t hash = name_hash(name, len);
+    fs_dirent found;
+    int slot = (dir->d.type == FS_TYPE_DIR && dir_slots(dir)) ? dir_find(dir, name, len, hash, 0, &found) : -1;
+    if (slot < 0) {
+        fs_iput(dir);
+        return -1;
+    }
+
+    fs_inode* ip = fs_iget(found.ino);
+    if (!ip || (ip->d.type == FS_TYPE_DIR && ip->d.dir_entries)) {
+        fs_iput(ip);
+        fs_iput(dir);
+        return -1;
+    }
+
+    dir_remove(dir, (uint32_t)slot);
+    dcache_set(dir->ino, name, len, hash, 0);
+    ip->d.links--;
+    inode_write(ip);
+    fs_iput(ip);
+    fs_iput(dir);
+    return 0;
+}
+
+int fs_readdir(fs_inode* dir, uint32_t* cookie, char* name, uint32_t* ino, int* type) {
+    if (dir->d.type != FS_TYPE_DIR) return -1;
+
+    uint32_t slots = dir_slots(dir);
+    while (*cookie < slots) {
+        uint32_t slot = (*cookie)++;
+        uint32_t block = inode_bmap(dir, slot / FS_DIRENTS_PER_BLOCK);
+        buffer* b = block ? fs_bread(block) : 0;
+        if (!b) return -1;
+
+        fs_dirent* de = (fs_dirent*)bdata(b) + (slot % FS_DIRENTS_PER_BLOCK);
+        if (de->state == DIRENT_USED) {
+            memcpy(name, de->name, de->name_len);
+            name[de->name_len] = '\0';
+            if (ino) *ino = de->ino;
+            if (type) *type = de->type;
+            brelse(b);
+            return 1;
+        }
+        brelse(b);
+    }
+    return 0;
+}
+
+/* collapses "." and ".." against base and writes an absolute path */
+int fs_path_resolve(const char* base, const char* path, char* out, uint32_t size) {
+    uint32_t pos = 0;
+    const char* parts[2] = { (path && path[0] == '/') ? "" : base, path ? path : "" };
+
+    out[pos++] = '/';
+    for (int p = 0; p < 2; p++) {
+        uint32_t len;
+        const char* name = next_component(parts[p], &len);
+        while (len) {
+            if (len == 2 && name[0] == '.' && name[1] == '.') {
+                if (pos > 1) pos--;
+                while (pos > 1 && out[pos - 1] != '/') pos--;
+            } else if (!(len == 1 && name[0] == '.')) {
+                if (pos + len + 2 > size) return -1;
+                memcpy(out + pos, name, len);
+                pos += len;
+                out[pos++] = '/';
+            }
+            name = next_component(name + len, &len);
+        }
+    }
+    if (pos > 1) pos--;
+    out[pos] = '\0';
+    return 0;
+}
+
+uint32_t fs_ino(fs_inode* ip) {
+    return ip->ino;
+}
+
+int fs_is_dir(fs_inode* ip) {
+    return ip->d.type == FS_TYPE_DIR;
+}
+
+uint64_t fs_size(fs_inode* ip) {
+    return ip->d.size;
+}
+
+uint32_t fs_mtime(fs_inode* ip) {
+    return ip->d.mtime;
+}
+
+int fs_mounted(void) {
+    return fs_dev != 0;
+}
+
+const char* fs_device_name(void) {
+    return fs_dev ? block_name(fs_dev) : "";
+}
+
+void fs_statfs(uint32_t* stats) {
+    stats[0] = FS_BLOCK_SIZE;
+    stats[1] = sb.block_count;
+    stats[2] = sb.free_blocks;
+    stats[3] = sb.inode_count;
+    stats[4] = sb.free_inodes;
+}
+
+void fs_cache_stats(uint32_t* stats) {
+    stats[0] = icache_count;
+    stats[1] = dcache_count;
+    stats[2] = dcache_hits;
+    stats[3] = dcache_misses;
+}
+
+int fs_sync(void) {
+    if (!fs_dev) return -1;
+    sb_write();
+    return bcache_sync(fs_dev);
+}
+
+int fs_mount(void) {
+    if (fs_dev) return 0;
+
+    for (uint32_t i = 0; i < block_count(); i++) {
+        block_device* dev = block_get(i);
+        uint64_t base = (uint64_t)FS_LBA * 512 / FS_BLOCK_SIZE;
+        if (block_sectors(dev) < (base + 1) * (FS_BLOCK_SIZE / 512)) continue;
+
+        buffer* b = bread(dev, base);
+        if (!b) continue;
+        fs_superblock* disk = (fs_superblock*)bdata(b);
+        if (disk->magic != FS_MAGIC || disk->version != FS_VERSION || disk->block_size != FS_BLOCK_SIZE ||
+            (base + disk->block_count) * (FS_BLOCK_SIZE / 512) > block_sectors(dev)) {
+            brelse(b);
+            continue;
+        }
+        memcpy(&sb, disk, sizeof(sb));
+        brelse(b);
+
+        if (!inode_cache) inode_cache = kmem_cache_create("fs_inode", sizeof(fs_inode), 0, SLAB_HWCACHE_ALIGN);
+        if (!dentry_cache) dentry_cache = kmem_cache_create("dentry", sizeof(fs_dentry), 0, SLAB_HWCACHE_ALIGN);
+        if (!inode_cache || !dentry_cache) return -1;
+
+        fs_dev = dev;
+        fs_base = base;
+        boot_epoch = rtc_epoch_seconds() - timer_uptime_seconds();
+        return 0;
+    }
+    return -1;
+}
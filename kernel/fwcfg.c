@@ -0,0 +1,76 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define FW_CFG_PORT_SEL     0x510
+#define FW_CFG_PORT_DATA    0x511
+#define FW_CFG_SIGNATURE    0x0000
+#define FW_CFG_FILE_DIR     0x0019
+#define FW_CFG_NAME_MAX     56
+
+static int fw_cfg_state = 0;
+
+static inline void outw(uint16_t port, uint16_t val) {
+    asm volatile("outw %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static void fw_cfg_read(void* buf, uint32_t len) {
+    uint8_t* out = (uint8_t*)buf;
+    for (uint32_t i = 0; i < len; i++) out[i] = inb(FW_CFG_PORT_DATA);
+}
+
+/* the directory is big-endian */
+static uint32_t read_be32(void) {
+    uint8_t b[4];
+    fw_cfg_read(b, 4);
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+static uint16_t read_be16(void) {
+    uint8_t b[2];
+    fw_cfg_read(b, 2);
+    return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+/* QEMU's firmware configuration device; an absent one reads back as all ones */
+int fw_cfg_present(void) {
+    if (!fw_cfg_state) {
+        char sig[4];
+        outw(FW_CFG_PORT_SEL, FW_CFG_SIGNATURE);
+        fw_cfg_read(sig, 4);
+        fw_cfg_state = (sig[0] == 'Q' && sig[1] == 'E' && sig[2] == 'M' && sig[3] == 'U') ? 1 : -1;
+    }
+    return fw_cfg_state > 0;
+}
+
+/* copies up to max bytes of the named file (-fw_cfg name=...) into buf, returning its length or -1 */
+int fw_cfg_read_file(const char* name, void* buf, uint32_t max) {
+    if (!fw_cfg_present()) return -1;
+
+    outw(FW_CFG_PORT_SEL, FW_CFG_FILE_DIR);
+    uint32_t count = read_be32();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t size = read_be32();
+        uint16_t select = read_be16();
+        char entry[FW_CFG_NAME_MAX];
+        read_be16();
+        fw_cfg_read(entry, FW_CFG_NAME_MAX);
+
+        int n = 0;
+        while (n < FW_CFG_NAME_MAX - 1 && name[n] && entry[n] == name[n]) n++;
+        if (name[n] || entry[n]) continue;
+
+        if (size > max) size = max;
+        outw(FW_CFG_PORT_SEL, select);
+        fw_cfg_read(buf, size);
+        return (int)size;
+    }
+    return -1;
+}
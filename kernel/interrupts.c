@@ -0,0 +1,259 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define IDT_ENTRIES     256
+#define KERNEL_CODE_SEG 0x08
+#define IDT_GATE_INT    0x8E
+
+#define PIC1_CMD        0x20
+#define PIC1_DATA       0x21
+#define PIC2_CMD        0xA0
+#define PIC2_DATA       0xA1
+#define PIC_EOI         0x20
+#define IRQ_BASE        32
+#define IRQ_COUNT       16
+#define LOCAL_BASE      48
+#define LOCAL_COUNT     16
+#define LOCAL_SPURIOUS  63
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t ist;
+    uint8_t type_attr;
+    uint16_t offset_mid;
+    uint32_t offset_high;
+    uint32_t zero;
+} __attribute__((packed)) idt_entry;
+
+typedef struct {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed)) idt_pointer;
+
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rdi, rsi, rbp, rbx, rdx, rcx, rax;
+    uint64_t int_no, err_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+} interrupt_frame;
+
+typedef void (*irq_handler)(interrupt_frame* frame);
+typedef int (*exception_handler)(interrupt_frame* frame);
+
+extern uint64_t isr_stub_table[];
+
+void terminal_write(const char* str);
+void terminal_flush(void);
+void serial_sync(void);
+void sched_irq_exit(void);
+void lapic_eoi(void);
+const char* ksym_lookup(uint64_t addr, uint64_t* offset);
+
+static idt_entry idt[IDT_ENTRIES];
+static idt_pointer idt_ptr;
+static irq_handler irq_handlers[IRQ_COUNT];
+static exception_handler exception_handlers[IRQ_BASE];
+static irq_handler local_handlers[LOCAL_COUNT];
+static uint32_t irq_counts[IRQ_COUNT];
+
+static const char* exception_names[32] = {
+    "divide error", "debug", "NMI", "breakpoint", "overflow", "bound range",
+    "invalid opcode", "device not available", "double fault", "coprocessor overrun",
+    "invalid TSS", "segment not present", "stack fault", "general protection",
+    "page fault", "reserved", "x87 FPU error", "alignment check", "machine check",
+    "SIMD exception", "virtualization", "control protection", "reserved", "reserved",
+    "reserved", "reserved", "reserved", "reserved", "hypervisor injection",
+    "VMM communication", "security", "reserved"
+};
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void io_wait(void) {
+    outb(0x80, 0);
+}
+
+static void write_hex(uint64_t value) {
+    char buf[19];
+    buf[0] = '0';
+    buf[1] = 'x';
+    for (int i = 0; i < 16; i++) {
+        uint8_t nibble = (value >> ((15 - i) * 4)) & 0xF;
+        buf[2 + i] = nibble < 10 ? '0' + nibble : 'a' + nibble - 10;
+    }
+    buf[18] = '\0';
+    terminal_write(buf);
+}
+
+void idt_set_gate(uint8_t vector, uint64_t handler, uint8_t type_attr) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = KERNEL_CODE_SEG;
+    idt[vector].ist = 0;
+    idt[vector].type_attr = type_attr;
+    idt[vector].offset_mid = (handler >> 16) & 0xFFFF;
+    idt[vector].offset_high = (handler >> 32) & 0xFFFFFFFF;
+    idt[vector].zero = 0;
+}
+
+void idt_set_ist(uint8_t vector, uint8_t ist) {
+    idt[vector].ist = ist;
+}
+
+void pic_remap(void) {
+    uint8_t mask1 = inb(PIC1_DATA);
+    uint8_t mask2 = inb(PIC2_DATA);
+
+    outb(PIC1_CMD, 0x11); io_wait();
+    outb(PIC2_CMD, 0x11); io_wait();
+    outb(PIC1_DATA, IRQ_BASE); io_wait();
+    outb(PIC2_DATA, IRQ_BASE + 8); io_wait();
+    outb(PIC1_DATA, 0x04); io_wait();
+    outb(PIC2_DATA, 0x02); io_wait();
+    outb(PIC1_DATA, 0x01); io_wait();
+    outb(PIC2_DATA, 0x01); io_wait();
+
+    outb(PIC1_DATA, mask1 | 0xFB);
+    outb(PIC2_DATA, mask2 | 0xFF);
+}
+
+void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        outb(PIC2_CMD, PIC_EOI);
+    }
+    outb(PIC1_CMD, PIC_EOI);
+}
+
+void irq_set_mask(uint8_t irq, int masked) {
+    uint16_t port = (irq < 8) ? PIC1_DATA : PIC2_DATA;
+    uint8_t line = irq & 7;
+    uint8_t value = inb(port);
+
+    if (masked) {
+        value |= (1 << line);
+    } else {
+        value &= ~(1 << line);
+    }
+    outb(port, value);
+}
+
+void irq_register_handler(uint8_t irq, irq_handler handler) {
+    if (irq >= IRQ_COUNT) return;
+
+    irq_handlers[irq] = handler;
+    irq_set_mask(irq, handler == 0);
+}
+
+void exception_register_handler(uint8_t vector, exception_handler handler) {
+    if (vector < IRQ_BASE) {
+        exception_handlers[vector] = handler;
+    }
+}
+
+/* vectors 48-63 belong to the local APIC: its timer and inter-processor interrupts */
+void local_register_handler(uint8_t vector, irq_handler handler) {
+    if (vector >= LOCAL_BASE && vector < LOCAL_BASE + LOCAL_COUNT) {
+        local_handlers[vector - LOCAL_BASE] = handler;
+    }
+}
+
+uint32_t irq_get_count(uint8_t irq) {
+    return (irq < IRQ_COUNT) ? irq_counts[irq] : 0;
+}
+
+static void exception_panic(interrupt_frame* frame) {
+    terminal_write("\nkernel panic: ");
+    terminal_write(exception_names[frame->int_no]);
+    terminal_write("\n  rip=");
+    write_hex(frame->rip);
+    uint64_t offset;
+    const char* symbol = ksym_lookup(frame->rip, &offset);
+    if (symbol) {
+        terminal_write(" <");
+        terminal_write(symbol);
+        terminal_write("+");
+        write_hex(offset);
+        terminal_write(">");
+    }
+    terminal_write(" err=");
+    write_hex(frame->err_code);
+    terminal_write("\n");
+    terminal_flush();
+    serial_sync();
+
+    while (1) {
+        asm volatile("cli; hlt");
+    }
+}
+
+void interrupt_dispatch(interrupt_frame* frame) {
+    if (frame->int_no < IRQ_BASE) {
+        if (exception_handlers[frame->int_no] && exception_handlers[frame->int_no](frame)) {
+            return;
+        }
+        exception_panic(frame);
+        return;
+    }
+
+    if (frame->int_no >= LOCAL_BASE) {
+        if (frame->int_no == LOCAL_SPURIOUS) return;
+        if (local_handlers[frame->int_no - LOCAL_BASE]) {
+            local_handlers[frame->int_no - LOCAL_BASE](frame);
+        }
+        lapic_eoi();
+        sched_irq_exit();
+        return;
+    }
+
+    uint8_t irq = frame->int_no - IRQ_BASE;
+
+    /* IRQ7/IRQ15 without an in-service bit are spurious and get no EOI */
+    if (irq == 7 || irq == 15) {
+        outb(irq == 7 ? PIC1_CMD : PIC2_CMD, 0x0B);
+        if (!(inb(irq == 7 ? PIC1_CMD : PIC2_CMD) & 0x80)) {
+            if (irq == 15) outb(PIC1_CMD, PIC_EOI);
+            return;
+        }
+    }
+
+    irq_counts[irq]++;
+    if (irq_handlers[irq]) {
+        irq_handlers[irq](frame);
+    }
+    pic_send_eoi(irq);
+    sched_irq_exit();
+}
+
+void interrupts_init(void) {
+    for (int i = 0; i < LOCAL_BASE + LOCAL_COUNT; i++) {
+        idt_set_gate(i, isr_stub_table[i], IDT_GATE_INT);
+    }
+
+    idt_ptr.limit = sizeof(idt) - 1;
+    idt_ptr.base = (uint64_t)&idt;
+    asm volatile("lidt %0" : : "m"(idt_ptr));
+
+    pic_remap();
+}
+
+/* application processors share the boot CPU's table */
+void interrupts_load(void) {
+    asm volatile("lidt %0" : : "m"(idt_ptr));
+}
+
+void interrupts_enable(void) {
+    asm volatile("sti");
+}
+
+void interrupts_disable(void) {
+    asm volatile("cli");
+}
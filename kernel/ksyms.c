@@ -0,0 +1,40 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+/* generated into build/symtab.c by the two-pass link in the Makefile, sorted by address */
+extern const uint32_t ksym_count;
+extern const uint64_t ksym_addrs[];
+extern const uint32_t ksym_name_offsets[];
+extern const char ksym_names[];
+extern char _text_end[];
+
+/* index of the function containing addr, or -1 when it is outside the kernel's code */
+int ksym_index(uint64_t addr) {
+    if (!ksym_count || addr < ksym_addrs[0] || addr >= (uint64_t)_text_end) return -1;
+
+    uint32_t lo = 0, hi = ksym_count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ksym_addrs[mid] <= addr) lo = mid;
+        else hi = mid;
+    }
+    return (int)lo;
+}
+
+uint32_t ksym_total(void) {
+    return ksym_count;
+}
+
+const char* ksym_name(int index) {
+    if (index < 0 || (uint32_t)index >= ksym_count) return "?";
+    return ksym_names + ksym_name_offsets[index];
+}
+
+/* name of the function containing addr, with *offset set to addr's distance from its start */
+const char* ksym_lookup(uint64_t addr, uint64_t* offset) {
+    int index = ksym_index(addr);
+    if (offset) *offset = index < 0 ? 0 : addr - ksym_addrs[index];
+    return index < 0 ? 0 : ksym_name(index);
+}
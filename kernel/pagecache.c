@@ -0,0 +1,262 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define PAGE_SIZE           4096
+#define PCACHE_MAX_PAGES    1024
+#define PCACHE_HASH_SIZE    512
+
+typedef struct fs_inode fs_inode;
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef struct cached_page {
+    uint32_t ino;
+    uint32_t index;
+    uint8_t* data;
+    uint32_t refcount;
+    struct cached_page* hash_next;
+    struct cached_page* lru_prev;
+    struct cached_page* lru_next;
+} cached_page;
+
+void* alloc_page(void);
+void free_page(void* addr);
+void* kzalloc(size_t size);
+void kfree(void* ptr);
+void* memcpy(void* dest, const void* src, size_t n);
+void* memset(void* dest, int c, size_t n);
+uint32_t fs_ino(fs_inode* ip);
+uint64_t fs_size(fs_inode* ip);
+long fs_read(fs_inode* ip, uint64_t offset, void* buf, uint64_t len);
+long fs_write(fs_inode* ip, uint64_t offset, const void* buf, uint64_t len);
+int fs_truncate(fs_inode* ip, uint64_t size);
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+
+static cached_page* hash_table[PCACHE_HASH_SIZE];
+static cached_page* lru_head = 0;
+static cached_page* lru_tail = 0;
+static uint32_t page_count = 0;
+static uint32_t pinned_count = 0;
+static uint32_t hits = 0;
+static uint32_t misses = 0;
+static uint32_t evictions = 0;
+static spinlock pcache_lock;
+
+static uint32_t hash_index(uint32_t ino, uint32_t index) {
+    return ((ino * 0x9E3779B1u) ^ index) & (PCACHE_HASH_SIZE - 1);
+}
+
+static void lru_unlink(cached_page* p) {
+    if (p->lru_prev) p->lru_prev->lru_next = p->lru_next;
+    else if (lru_head == p) lru_head = p->lru_next;
+    if (p->lru_next) p->lru_next->lru_prev = p->lru_prev;
+    else if (lru_tail == p) lru_tail = p->lru_prev;
+    p->lru_prev = 0;
+    p->lru_next = 0;
+}
+
+static void lru_push_front(cached_page* p) {
+    p->lru_prev = 0;
+    p->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = p;
+    lru_head = p;
+    if (!lru_tail) lru_tail = p;
+}
+
+static cached_page* lookup(uint32_t ino, uint32_t index) {
+    cached_page* p = hash_table[hash_index(ino, index)];
+    while (p && (p->ino != ino || p->index != index)) p = p->hash_next;
+    return p;
+}
+
+static void page_drop(cached_page* p) {
+    cached_page** link = &hash_table[hash_index(p->ino, p->index)];
+    while (*link && *link != p) link = &(*link)->hash_next;
+    if (*link) *link = p->hash_next;
+    lru_unlink(p);
+    free_page(p->data);
+    kfree(p);
+    page_count--;
+}
+
+static void page_pin(cached_page* p) {
+    if (p->refcount++ == 0) {
+        lru_unlink(p);
+        pinned_count++;
+    }
+}
+
+/* returns the page holding [index * PAGE_SIZE, +PAGE_SIZE) of the file, pinned */
+cached_page* pagecache_get(fs_inode* ip, uint32_t index) {
+    uint32_t ino = fs_ino(ip);
+    unsigned long flags = spin_lock_irqsave(&pcache_lock);
+    cached_page* p = lookup(ino, index);
+    if (p) {
+        hits++;
+        page_pin(p);
+        spin_unlock_irqrestore(&pcache_lock, flags);
+        return p;
+    }
+    misses++;
+    while (page_count >= PCACHE_MAX_PAGES && lru_tail) {
+        page_drop(lru_tail);
+        evictions++;
+    }
+    spin_unlock_irqrestore(&pcache_lock, flags);
+
+    p = (cached_page*)kzalloc(sizeof(cached_page));
+    if (!p) return 0;
+    p->data = (uint8_t*)alloc_page();
+    if (!p->data) {
+        kfree(p);
+        return 0;
+    }
+
+    long n = fs_read(ip, (uint64_t)index * PAGE_SIZE, p->data, PAGE_SIZE);
+    if (n < 0) n = 0;
+    memset(p->data + n, 0, PAGE_SIZE - n);
+
+    flags = spin_lock_irqsave(&pcache_lock);
+    cached_page* raced = lookup(ino, index);
+    if (raced) {
+        page_pin(raced);
+        spin_unlock_irqrestore(&pcache_lock, flags);
+        free_page(p->data);
+        kfree(p);
+        return raced;
+    }
+    p->ino = ino;
+    p->index = index;
+    p->refcount = 1;
+    uint32_t bucket = hash_index(ino, index);
+    p->hash_next = hash_table[bucket];
+    hash_table[bucket] = p;
+    page_count++;
+    pinned_count++;
+    spin_unlock_irqrestore(&pcache_lock, flags);
+    return p;
+}
+
+void pagecache_put(cached_page* p) {
+    if (!p) return;
+    unsigned long flags = spin_lock_irqsave(&pcache_lock);
+    if (p->refcount && --p->refcount == 0) {
+        pinned_count--;
+        lru_push_front(p);
+    }
+    spin_unlock_irqrestore(&pcache_lock, flags);
+}
+
+void* pagecache_data(cached_page* p) {
+    return p->data;
+}
+
+long pagecache_read(fs_inode* ip, uint64_t offset, void* buf, uint64_t len) {
+    uint64_t size = fs_size(ip);
+    uint8_t* out = (uint8_t*)buf;
+    uint64_t done = 0;
+
+    if (offset >= size) return 0;
+    if (len > size - offset) len = size - offset;
+
+    while (done < len) {
+        uint32_t poff = (uint32_t)(offset % PAGE_SIZE);
+        uint64_t n = PAGE_SIZE - poff;
+        if (n > len - done) n = len - done;
+
+        cached_page* p = pagecache_get(ip, (uint32_t)(offset / PAGE_SIZE));
+        if (!p) return done ? (long)done : -1;
+        memcpy(out + done, p->data + poff, n);
+        pagecache_put(p);
+
+        done += n;
+        offset += n;
+    }
+    return (long)done;
+}
+
+/* writes go through to the filesystem; pages already cached are updated in place */
+long pagecache_write(fs_inode* ip, uint64_t offset, const void* buf, uint64_t len) {
+    long written = fs_write(ip, offset, buf, len);
+    if (written <= 0) return written;
+
+    uint32_t ino = fs_ino(ip);
+    const uint8_t* in = (const uint8_t*)buf;
+    uint64_t done = 0;
+    while (done < (uint64_t)written) {
+        uint32_t poff = (uint32_t)(offset % PAGE_SIZE);
+        uint64_t n = PAGE_SIZE - poff;
+        if (n > (uint64_t)written - done) n = (uint64_t)written - done;
+
+        unsigned long flags = spin_lock_irqsave(&pcache_lock);
+        cached_page* p = lookup(ino, (uint32_t)(offset / PAGE_SIZE));
+        if (p) memcpy(p->data + poff, in + done, n);
+        spin_unlock_irqrestore(&pcache_lock, flags);
+
+        done += n;
+        offset += n;
+    }
+    return written;
+}
+
+/* writes a page modified through a shared mapping back to the file */
+int pagecache_writeback(fs_inode* ip, cached_page* p) {
+    uint64_t offset = (uint64_t)p->index * PAGE_SIZE;
+    uint64_t size = fs_size(ip);
+    if (offset >= size) return 0;
+
+    uint64_t n = size - offset;
+    if (n > PAGE_SIZE) n = PAGE_SIZE;
+    return fs_write(ip, offset, p->data, n) < 0 ? -1 : 0;
+}
+
+int pagecache_truncate(fs_inode* ip, uint64_t size) {
+    if (fs_truncate(ip, size) < 0) return -1;
+
+    uint32_t ino = fs_ino(ip);
+    uint32_t first = (uint32_t)((size + PAGE_SIZE - 1) / PAGE_SIZE);
+    unsigned long flags = spin_lock_irqsave(&pcache_lock);
+    for (uint32_t i = 0; i < PCACHE_HASH_SIZE; i++) {
+        cached_page* p = hash_table[i];
+        while (p) {
+            cached_page* next = p->hash_next;
+            if (p->ino == ino) {
+                if (p->index >= first && p->refcount == 0) page_drop(p);
+                else if (p->index >= first) memset(p->data, 0, PAGE_SIZE);
+                else if (p->index == first - 1 && size % PAGE_SIZE) memset(p->data + size % PAGE_SIZE, 0, PAGE_SIZE - size % PAGE_SIZE);
+            }
+            p = next;
+        }
+    }
+    spin_unlock_irqrestore(&pcache_lock, flags);
+    return 0;
+}
+
+/* called when an inode number is released so a reused number never sees stale pages */
+void pagecache_invalidate(uint32_t ino) {
+    unsigned long flags = spin_lock_irqsave(&pcache_lock);
+    for (uint32_t i = 0; i < PCACHE_HASH_SIZE; i++) {
+        cached_page* p = hash_table[i];
+        while (p) {
+            cached_page* next = p->hash_next;
+            if (p->ino == ino && p->refcount == 0) page_drop(p);
+            p = next;
+        }
+    }
+    spin_unlock_irqrestore(&pcache_lock, flags);
+}
+
+void pagecache_stats(uint32_t* stats) {
+    stats[0] = page_count;
+    stats[1] = pinned_count;
+    stats[2] = hits;
+    stats[3] = misses;
+    stats[4] = evictions;
+}
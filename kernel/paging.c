@@ -0,0 +1,442 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long uintptr_t;
+typedef unsigned long size_t;
+
+#define PAGE_SIZE           4096
+#define LARGE_PAGE_SIZE     0x200000
+#define ENTRIES             512
+#define PAGE_PRESENT        (1 << 0)
+#define PAGE_WRITE          (1 << 1)
+#define PAGE_WRITE_THROUGH  (1 << 3)
+#define PAGE_CACHE_DISABLE  (1 << 4)
+#define PAGE_LARGE          (1 << 7)
+#define PAGE_GLOBAL         (1 << 8)
+#define ADDRESS_MASK        0x000FFFFFFFFFF000UL
+
+#define VMALLOC_START       0xFFFFC90000000000UL
+#define VMALLOC_END         0xFFFFE90000000000UL
+#define VM_AREA_MAX         256
+#define VM_GUARD            (1 << 0)
+#define VM_MAPPED           (1 << 1)
+#define VM_FREEING          (1 << 2)
+
+#define BOOT_IDENTITY_LIMIT 0x100000000UL
+#define BOOT_STASH_MAX      32
+#define BOOT_STACK_START    0x80000
+#define BOOT_STACK_END      0x9F000
+
+#define E820_USABLE         1
+#define E820_ACPI_RECLAIM   3
+#define E820_ACPI_NVS       4
+
+#define PF_PRESENT          (1 << 0)
+#define PF_WRITE            (1 << 1)
+
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rdi, rsi, rbp, rbx, rdx, rcx, rax;
+    uint64_t int_no, err_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+} interrupt_frame;
+
+typedef struct {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi;
+} __attribute__((packed)) e820_entry;
+
+typedef struct {
+    uint64_t start;
+    uint64_t size;
+    uint32_t flags;
+    int used;
+} vm_area;
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef int (*exception_handler)(interrupt_frame* frame);
+
+void* alloc_page(void);
+void free_page(void* addr);
+uint32_t pmm_map_count(void);
+const e820_entry* pmm_map_entry(uint32_t index);
+void exception_register_handler(uint8_t vector, exception_handler handler);
+void terminal_write(const char* str);
+void smp_flush_tlb_others(void);
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+
+static uint64_t pml4[ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static uint64_t low_page_table[ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static vm_area vm_areas[VM_AREA_MAX];
+static uint32_t vmalloc_mapped_pages = 0;
+static uint32_t identity_large_pages = 0;
+static uint32_t fault_count = 0;
+static uint32_t demand_fault_count = 0;
+static uint32_t fatal_fault_count = 0;
+static int paging_enabled = 0;
+/* guards the page tables below VMALLOC_END as well as the area list */
+static spinlock vm_lock;
+
+static inline void invlpg(uint64_t addr) {
+    asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+static void zero_page(void* page) {
+    uint64_t* words = (uint64_t*)page;
+    for (int i = 0; i < PAGE_SIZE / 8; i++) words[i] = 0;
+}
+
+static void write_hex(uint64_t value) {
+    char buf[19];
+    buf[0] = '0';
+    buf[1] = 'x';
+    for (int i = 0; i < 16; i++) {
+        uint8_t nibble = (value >> ((15 - i) * 4)) & 0xF;
+        buf[2 + i] = nibble < 10 ? '0' + nibble : 'a' + nibble - 10;
+    }
+    buf[18] = '\0';
+    terminal_write(buf);
+}
+
+static void* alloc_table_page(void) {
+    void* stash[BOOT_STASH_MAX];
+    int stashed = 0;
+    void* page = alloc_page();
+
+    /* before CR3 switches, new tables must sit inside the boot loader's 4 GB map */
+    while (!paging_enabled && page && (uint64_t)page >= BOOT_IDENTITY_LIMIT && stashed < BOOT_STASH_MAX) {
+        stash[stashed++] = page;
+        page = alloc_page();
+    }
+    while (stashed > 0) free_page(stash[--stashed]);
+    if (!paging_enabled && (uint64_t)page >= BOOT_IDENTITY_LIMIT) {
+        free_page(page);
+        return 0;
+    }
+    return page;
+}
+
+static uint64_t* next_table(uint64_t* entry, int create) {
+    if (*entry & PAGE_PRESENT) {
+        if (!(*entry & PAGE_LARGE)) return (uint64_t*)(*entry & ADDRESS_MASK);
+        if (!create) return 0;
+
+        uint64_t* table = (uint64_t*)alloc_table_page();
+        if (!table) return 0;
+        uint64_t base = *entry & ADDRESS_MASK & ~(uint64_t)(LARGE_PAGE_SIZE - 1);
+        uint64_t flags = *entry & (PAGE_WRITE | PAGE_WRITE_THROUGH | PAGE_CACHE_DISABLE | PAGE_GLOBAL);
+        for (int i = 0; i < ENTRIES; i++) {
+            table[i] = (base + (uint64_t)i * PAGE_SIZE) | flags | PAGE_PRESENT;
+        }
+        *entry = (uint64_t)table | PAGE_PRESENT | PAGE_WRITE;
+        identity_large_pages--;
+        return table;
+    }
+    if (!create) return 0;
+
+    uint64_t* table = (uint64_t*)alloc_table_page();
+    if (!table) return 0;
+    zero_page(table);
+    *entry = (uint64_t)table | PAGE_PRESENT | PAGE_WRITE;
+    return table;
+}
+
+static uint64_t* get_pde(uint64_t virt, int create) {
+    uint64_t* pdpt = next_table(&pml4[(virt >> 39) & 0x1FF], create);
+    if (!pdpt) return 0;
+    uint64_t* pd = next_table(&pdpt[(virt >> 30) & 0x1FF], create);
+    if (!pd) return 0;
+    return &pd[(virt >> 21) & 0x1FF];
+}
+
+static uint64_t* get_pte(uint64_t virt, int create) {
+    uint64_t* pde = get_pde(virt, create);
+    if (!pde) return 0;
+    uint64_t* pt = next_table(pde, create);
+    if (!pt) return 0;
+    return &pt[(virt >> 12) & 0x1FF];
+}
+
+int paging_map_page(uint64_t virt, uint64_t phys, uint64_t flags) {
+    uint64_t* pte = get_pte(virt, 1);
+    if (!pte) return -1;
+
+    *pte = (phys & ADDRESS_MASK) | flags | PAGE_PRESENT;
+    invlpg(virt);
+    return 0;
+}
+
+uint64_t paging_unmap_page(uint64_t virt) {
+    uint64_t* pte = get_pte(virt, 0);
+    if (!pte) return 0;
+
+    uint64_t entry = *pte;
+    *pte = 0;
+    invlpg(virt);
+    return (entry & PAGE_PRESENT) ? (entry & ADDRESS_MASK) : 0;
+}
+
+uint64_t paging_virt_to_phys(uint64_t virt) {
+    uint64_t* pde = get_pde(virt, 0);
+    if (!pde || !(*pde & PAGE_PRESENT)) return 0;
+    if (*pde & PAGE_LARGE) return (*pde & ADDRESS_MASK & ~(uint64_t)(LARGE_PAGE_SIZE - 1)) | (virt & (LARGE_PAGE_SIZE - 1));
+
+    uint64_t pte = ((uint64_t*)(*pde & ADDRESS_MASK))[(virt >> 12) & 0x1FF];
+    if (!(pte & PAGE_PRESENT)) return 0;
+    return (pte & ADDRESS_MASK) | (virt & (PAGE_SIZE - 1));
+}
+
+void* paging_map_mmio(uint64_t phys, uint64_t size) {
+    uint64_t start = phys & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t end = (phys + size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    unsigned long flags = spin_lock_irqsave(&vm_lock);
+
+    for (uint64_t addr = start; addr < end; addr += PAGE_SIZE) {
+        if (paging_map_page(addr, addr, PAGE_WRITE | PAGE_CACHE_DISABLE | PAGE_WRITE_THROUGH) < 0) {
+            spin_unlock_irqrestore(&vm_lock, flags);
+            return 0;
+        }
+    }
+    spin_unlock_irqrestore(&vm_lock, flags);
+    return (void*)phys;
+}
+
+static vm_area* find_area(uint64_t addr) {
+    for (int i = 0; i < VM_AREA_MAX; i++) {
+        if (vm_areas[i].used && addr >= vm_areas[i].start &&
+            addr < vm_areas[i].start + vm_areas[i].size) {
+            return &vm_areas[i];
+        }
+    }
+    return 0;
+}
+
+static uint64_t reserve_range(uint64_t size, uint32_t flags) {
+    uint64_t candidate = VMALLOC_START;
+    unsigned long irq = spin_lock_irqsave(&vm_lock);
+
+    while (candidate + size <= VMALLOC_END && candidate + size > candidate) {
+        vm_area* overlap = 0;
+        for (int i = 0; i < VM_AREA_MAX; i++) {
+            vm_area* a = &vm_areas[i];
+            if (a->used && candidate < a->start + a->size && a->start < candidate + size) {
+                overlap = a;
+                break;
+            }
+        }
+        if (!overlap) {
+            for (int i = 0; i < VM_AREA_MAX; i++) {
+                if (!vm_areas[i].used) {
+                    vm_areas[i].start = candidate;
+                    vm_areas[i].size = size;
+                    vm_areas[i].flags = flags;
+                    vm_areas[i].used = 1;
+                    spin_unlock_irqrestore(&vm_lock, irq);
+                    return candidate;
+                }
+            }
+            break;
+        }
+        candidate = overlap->start + overlap->size;
+    }
+
+    spin_unlock_irqrestore(&vm_lock, irq);
+    return 0;
+}
+
+void* vmalloc(size_t size) {
+    if (size == 0) return 0;
+    size = (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    return (void*)reserve_range(size, 0);
+}
+
+void* vmm_alloc_stack(size_t size) {
+    size = (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    uint64_t base = reserve_range(size + PAGE_SIZE, VM_GUARD);
+    return base ? (void*)(base + PAGE_SIZE + size) : 0;
+}
+
+/* other CPUs may still hold the translations, so frames are freed only after they flush */
+void vfree(void* ptr) {
+    unsigned long irq = spin_lock_irqsave(&vm_lock);
+    vm_area* area = find_area((uint64_t)ptr);
+
+    if (!area || (area->flags & VM_FREEING)) {
+        spin_unlock_irqrestore(&vm_lock, irq);
+        return;
+    }
+
+    area->flags |= VM_FREEING;
+    for (uint64_t addr = area->start; addr < area->start + area->size; addr += PAGE_SIZE) {
+        uint64_t* pte = get_pte(addr, 0);
+        if (pte && (*pte & PAGE_PRESENT)) {
+            *pte &= ~(uint64_t)PAGE_PRESENT;
+            invlpg(addr);
+        }
+    }
+    spin_unlock_irqrestore(&vm_lock, irq);
+
+    smp_flush_tlb_others();
+
+    irq = spin_lock_irqsave(&vm_lock);
+    for (uint64_t addr = area->start; addr < area->start + area->size; addr += PAGE_SIZE) {
+        uint64_t* pte = get_pte(addr, 0);
+        if (!pte || !*pte) continue;
+        uint64_t phys = *pte & ADDRESS_MASK;
+        *pte = 0;
+        if (!(area->flags & VM_MAPPED)) {
+            free_page((void*)phys);
+            vmalloc_mapped_pages--;
+        }
+    }
+    area->used = 0;
+    spin_unlock_irqrestore(&vm_lock, irq);
+}
+
+/* maps caller-owned frames into one contiguous range; vunmap leaves the frames alone */
+void* vmap_pages(const uint64_t* phys, uint32_t count, int writable) {
+    if (count == 0) return 0;
+    uint64_t base = reserve_range((uint64_t)count * PAGE_SIZE, VM_MAPPED);
+    if (!base) return 0;
+
+    unsigned long irq = spin_lock_irqsave(&vm_lock);
+    for (uint32_t i = 0; i < count; i++) {
+        if (paging_map_page(base + (uint64_t)i * PAGE_SIZE, phys[i], writable ? PAGE_WRITE : 0) < 0) {
+            spin_unlock_irqrestore(&vm_lock, irq);
+            vfree((void*)base);
+            return 0;
+        }
+    }
+    spin_unlock_irqrestore(&vm_lock, irq);
+    return (void*)base;
+}
+
+void vunmap(void* addr) {
+    vfree(addr);
+}
+
+void vmm_free_stack(void* top) {
+    vfree((uint8_t*)top - 1);
+}
+
+static int page_fault_handler(interrupt_frame* frame) {
+    uint64_t addr;
+    asm volatile("mov %%cr2, %0" : "=r"(addr));
+
+    fault_count++;
+
+    if (!(frame->err_code & PF_PRESENT) && addr >= VMALLOC_START && addr < VMALLOC_END) {
+        uint64_t page = addr & ~(uint64_t)(PAGE_SIZE - 1);
+        const char* reason = 0;
+        unsigned long irq = spin_lock_irqsave(&vm_lock);
+        vm_area* area = find_area(addr);
+
+        if (!area) {
+            reason = "unmapped heap address ";
+        } else if (area->flags & VM_MAPPED) {
+            reason = "beyond mapped pages at ";
+        } else if (area->flags & VM_FREEING) {
+            reason = "use after vfree at ";
+        } else if ((area->flags & VM_GUARD) && addr < area->start + PAGE_SIZE) {
+            reason = "stack overflow at ";
+        } else if (!paging_virt_to_phys(page)) {
+            /* another CPU may have faulted the page in while this one waited for the lock */
+            void* frame_page = alloc_page();
+            if (frame_page) zero_page(frame_page);
+            if (frame_page && paging_map_page(page, (uint64_t)frame_page, PAGE_WRITE) == 0) {
+                vmalloc_mapped_pages++;
+                demand_fault_count++;
+            } else {
+                if (frame_page) free_page(frame_page);
+                reason = "out of memory at ";
+            }
+        }
+        spin_unlock_irqrestore(&vm_lock, irq);
+
+        if (!reason) return 1;
+        terminal_write("\npage fault: ");
+        terminal_write(reason);
+    } else if (addr < PAGE_SIZE) {
+        terminal_write("\npage fault: null pointer dereference at ");
+    } else {
+        terminal_write("\npage fault: ");
+        terminal_write((frame->err_code & PF_PRESENT) ? "protection violation at " : "unmapped address ");
+    }
+
+    fatal_fault_count++;
+    write_hex(addr);
+    terminal_write((frame->err_code & PF_WRITE) ? " (write)" : " (read)");
+    return 0;
+}
+
+static int range_is_memory(uint64_t start, uint64_t end) {
+    for (uint32_t i = 0; i < pmm_map_count(); i++) {
+        const e820_entry* e = pmm_map_entry(i);
+        if (e->type != E820_USABLE && e->type != E820_ACPI_RECLAIM && e->type != E820_ACPI_NVS) continue;
+        if (e->base < end && e->base + e->length > start) return 1;
+    }
+    return 0;
+}
+
+int paging_init(uint64_t memory_top) {
+    if (paging_enabled) return 0;
+
+    for (uint32_t i = 0; i < ENTRIES; i++) {
+        low_page_table[i] = ((uint64_t)i * PAGE_SIZE) | PAGE_PRESENT | PAGE_WRITE | PAGE_GLOBAL;
+    }
+    low_page_table[0] = 0;
+    for (uint64_t addr = BOOT_STACK_START; addr < BOOT_STACK_END; addr += PAGE_SIZE) {
+        low_page_table[addr / PAGE_SIZE] = 0;
+    }
+
+    uint64_t* pde = get_pde(0, 1);
+    if (!pde) return -1;
+    *pde = (uint64_t)low_page_table | PAGE_PRESENT | PAGE_WRITE;
+
+    for (uint64_t addr = LARGE_PAGE_SIZE; addr < memory_top; addr += LARGE_PAGE_SIZE) {
+        if (!range_is_memory(addr, addr + LARGE_PAGE_SIZE)) continue;
+        pde = get_pde(addr, 1);
+        if (!pde) return -1;
+        *pde = addr | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE | PAGE_GLOBAL;
+        identity_large_pages++;
+    }
+
+    exception_register_handler(14, page_fault_handler);
+
+    unsigned long cr0, cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 7);
+    asm volatile("mov %0, %%cr3" : : "r"(pml4) : "memory");
+    asm volatile("mov %0, %%cr4" : : "r"(cr4));
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= (1 << 16);
+    asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+
+    paging_enabled = 1;
+    return 0;
+}
+
+void paging_stats(uint32_t* stats) {
+    uint32_t areas = 0, reserved = 0;
+    for (int i = 0; i < VM_AREA_MAX; i++) {
+        if (vm_areas[i].used) {
+            areas++;
+            reserved += (uint32_t)(vm_areas[i].size / 1024);
+        }
+    }
+    stats[0] = fault_count;
+    stats[1] = demand_fault_count;
+    stats[2] = fatal_fault_count;
+    stats[3] = areas;
+    stats[4] = reserved;
+    stats[5] = vmalloc_mapped_pages * (PAGE_SIZE / 1024);
+    stats[6] = identity_large_pages * (LARGE_PAGE_SIZE / 1024 / 1024);
+}
@@ -0,0 +1,150 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define PCI_MAX_BUSES       8
+#define PCI_MAX_DEVICES     64
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef struct {
+    volatile int done;
+    wait_queue wait;
+} completion;
+
+typedef struct work {
+    void (*fn)(void* arg);
+    void* arg;
+    completion done;
+} work;
+
+typedef struct {
+    uint8_t bus;
+    uint8_t device;
+    uint8_t func;
+    uint8_t class;
+    uint8_t subclass;
+} pci_function;
+
+typedef struct {
+    work item;
+    uint32_t count;
+    pci_function found[PCI_MAX_DEVICES];
+} bus_scan;
+
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+void work_init(work* w, void (*fn)(void* arg), void* arg);
+int work_submit(work* w);
+void work_join(work* w);
+
+static spinlock pci_lock;
+static pci_function functions[PCI_MAX_DEVICES];
+static uint32_t function_count = 0;
+static int pci_scanned = 0;
+static bus_scan scans[PCI_MAX_BUSES];
+
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline uint32_t config_address(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset) {
+    return (uint32_t)((bus << 16) | (device << 11) | (func << 8) | (offset & 0xFC) | 0x80000000);
+}
+
+/* CF8 and CFC are one shared pair of ports, so the address write and data access must not interleave */
+uint32_t pci_read_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset) {
+    unsigned long flags = spin_lock_irqsave(&pci_lock);
+    outl(PCI_CONFIG_ADDRESS, config_address(bus, device, func, offset));
+    uint32_t value = inl(PCI_CONFIG_DATA);
+    spin_unlock_irqrestore(&pci_lock, flags);
+    return value;
+}
+
+void pci_write_config(uint8_t bus, uint8_t device, uint8_t func, uint8_t offset, uint32_t value) {
+    unsigned long flags = spin_lock_irqsave(&pci_lock);
+    outl(PCI_CONFIG_ADDRESS, config_address(bus, device, func, offset));
+    outl(PCI_CONFIG_DATA, value);
+    spin_unlock_irqrestore(&pci_lock, flags);
+}
+
+static void scan_bus(void* arg) {
+    bus_scan* scan = (bus_scan*)arg;
+    uint8_t bus = (uint8_t)(scan - scans);
+
+    for (uint8_t device = 0; device < 32; device++) {
+        for (uint8_t func = 0; func < 8; func++) {
+            uint32_t id = pci_read_config(bus, device, func, 0x00);
+            if ((id & 0xFFFF) == 0xFFFF) {
+                if (func == 0) break;
+                continue;
+            }
+
+            uint32_t class_code = pci_read_config(bus, device, func, 0x08);
+            if (scan->count < PCI_MAX_DEVICES) {
+                pci_function* f = &scan->found[scan->count++];
+                f->bus = bus;
+                f->device = device;
+                f->func = func;
+                f->class = (class_code >> 24) & 0xFF;
+                f->subclass = (class_code >> 16) & 0xFF;
+            }
+
+            if (func == 0 && !(pci_read_config(bus, device, 0, 0x0C) & 0x00800000)) break;
+        }
+    }
+}
+
+/* one work item per bus; the table is merged in bus order so lookups stay deterministic */
+int pci_scan(void) {
+    if (pci_scanned) return (int)function_count;
+
+    for (uint32_t bus = 0; bus < PCI_MAX_BUSES; bus++) {
+        scans[bus].count = 0;
+        work_init(&scans[bus].item, scan_bus, &scans[bus]);
+        if (work_submit(&scans[bus].item) == -2) scan_bus(&scans[bus]);
+    }
+    for (uint32_t bus = 0; bus < PCI_MAX_BUSES; bus++) {
+        work_join(&scans[bus].item);
+        for (uint32_t i = 0; i < scans[bus].count && function_count < PCI_MAX_DEVICES; i++) {
+            functions[function_count++] = scans[bus].found[i];
+        }
+    }
+
+    pci_scanned = 1;
+    return (int)function_count;
+}
+
+/* walks the functions of one class in bus order; start with *cookie = 0 */
+int pci_find(uint8_t class, uint8_t subclass, uint32_t* cookie, uint8_t* bus, uint8_t* device, uint8_t* func) {
+    pci_scan();
+    while (*cookie < function_count) {
+        pci_function* f = &functions[(*cookie)++];
+        if (f->class == class && f->subclass == subclass) {
+            *bus = f->bus;
+            *device = f->device;
+            *func = f->func;
+            return 1;
+        }
+    }
+    return 0;
+}
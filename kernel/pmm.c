@@ -0,0 +1,305 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long uintptr_t;
+
+#define PAGE_SIZE           4096
+#define PAGE_SHIFT          12
+#define MAX_ORDER           11
+#define LOW_MEMORY_END      0x100000
+#define ADDRESS_LIMIT       0x100000000000ULL
+
+#define E820_USABLE         1
+#define E820_ACPI_RECLAIM   3
+#define E820_ACPI_NVS       4
+
+#define PAGE_RESERVED       (1 << 0)
+#define PAGE_FREE           (1 << 1)
+#define PAGE_SLAB           (1 << 2)
+
+typedef struct {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi;
+} __attribute__((packed)) e820_entry;
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef struct page {
+    uint16_t flags;
+    uint8_t order;
+    uint8_t reserved;
+    struct page* next;
+    struct page* prev;
+    void* private_data;
+} page;
+
+typedef struct {
+    page* head;
+    uint32_t count;
+} free_area;
+
+extern char _kernel_end[];
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+
+static page* page_array = 0;
+static uint32_t page_count = 0;
+static free_area free_areas[MAX_ORDER];
+static uint32_t total_usable_pages = 0;
+static uint32_t managed_pages = 0;
+static uint32_t free_page_count = 0;
+static e820_entry* memory_map = 0;
+static uint32_t memory_map_count = 0;
+static spinlock pmm_lock;
+
+page* pfn_to_page(uint32_t pfn) {
+    return (pfn < page_count) ? &page_array[pfn] : 0;
+}
+
+uint32_t page_to_pfn(page* p) {
+    return (uint32_t)(p - page_array);
+}
+
+page* virt_to_page(const void* addr) {
+    return pfn_to_page((uint32_t)((uintptr_t)addr >> PAGE_SHIFT));
+}
+
+static void free_list_add(page* p, uint8_t order) {
+    p->flags = PAGE_FREE;
+    p->order = order;
+    p->prev = 0;
+    p->next = free_areas[order].head;
+    if (p->next) p->next->prev = p;
+    free_areas[order].head = p;
+    free_areas[order].count++;
+}
+
+static void free_list_remove(page* p, uint8_t order) {
+    if (p->prev) p->prev->next = p->next;
+    else free_areas[order].head = p->next;
+    if (p->next) p->next->prev = p->prev;
+    p->next = 0;
+    p->prev = 0;
+    p->flags &= ~PAGE_FREE;
+    free_areas[order].count--;
+}
+
+static void buddy_free(uint32_t pfn, uint8_t order) {
+    while (order < MAX_ORDER - 1) {
+        uint32_t buddy_pfn = pfn ^ (1u << order);
+        if (buddy_pfn + (1u << order) > page_count) break;
+
+        page* buddy = &page_array[buddy_pfn];
+        if (!(buddy->flags & PAGE_FREE) || buddy->order != order) break;
+
+        free_list_remove(buddy, order);
+        pfn &= ~(1u << order);
+        order++;
+    }
+    free_list_add(&page_array[pfn], order);
+}
+
+void* alloc_pages(uint32_t order) {
+    uint32_t current = order;
+
+    if (order >= MAX_ORDER) return 0;
+
+    unsigned long flags = spin_lock_irqsave(&pmm_lock);
+    while (current < MAX_ORDER && !free_areas[current].head) current++;
+    if (current == MAX_ORDER) {
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return 0;
+    }
+
+    page* p = free_areas[current].head;
+    free_list_remove(p, current);
+    uint32_t pfn = page_to_pfn(p);
+
+    while (current > order) {
+        current--;
+        free_list_add(&page_array[pfn + (1u << current)], current);
+    }
+
+    p->flags = 0;
+    p->order = order;
+    p->private_data = 0;
+    free_page_count -= 1u << order;
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return (void*)((uintptr_t)pfn << PAGE_SHIFT);
+}
+
+void free_pages(void* addr, uint32_t order) {
+    uint32_t pfn = (uint32_t)((uintptr_t)addr >> PAGE_SHIFT);
+
+    if (!addr || pfn >= page_count || order >= MAX_ORDER) return;
+
+    unsigned long flags = spin_lock_irqsave(&pmm_lock);
+    if (!(page_array[pfn].flags & (PAGE_FREE | PAGE_RESERVED))) {
+        free_page_count += 1u << order;
+        buddy_free(pfn, order);
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+void* alloc_page(void) {
+    return alloc_pages(0);
+}
+
+void free_page(void* addr) {
+    free_pages(addr, 0);
+}
+
+static int range_reserved(uint32_t pfn, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (page_array[pfn + i].flags != PAGE_RESERVED) return 0;
+    }
+    return 1;
+}
+
+static void release_range(uint64_t start, uint64_t end) {
+    uint32_t pfn = (uint32_t)((start + PAGE_SIZE - 1) >> PAGE_SHIFT);
+    uint32_t end_pfn = (uint32_t)(end >> PAGE_SHIFT);
+
+    while (pfn < end_pfn) {
+        uint8_t order = MAX_ORDER - 1;
+        while (order > 0 && ((pfn & ((1u << order) - 1)) || pfn + (1u << order) > end_pfn ||
+                             !range_reserved(pfn, 1u << order))) {
+            order--;
+        }
+        if (!range_reserved(pfn, 1)) {
+            pfn++;
+            continue;
+        }
+        for (uint32_t i = 0; i < (1u << order); i++) {
+            page_array[pfn + i].flags = 0;
+        }
+        managed_pages += 1u << order;
+        free_page_count += 1u << order;
+        buddy_free(pfn, order);
+        pfn += 1u << order;
+    }
+}
+
+static void clamp_region(const e820_entry* e, uint64_t* start, uint64_t* end) {
+    *start = e->base;
+    *end = e->base + e->length;
+    if (*end > ADDRESS_LIMIT) *end = ADDRESS_LIMIT;
+    if (*start > *end) *start = *end;
+}
+
+void pmm_init(e820_entry* map, uint32_t count) {
+    uint64_t highest = 0;
+    uint64_t low_end = ((uintptr_t)_kernel_end + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+
+    if (low_end < LOW_MEMORY_END) low_end = LOW_MEMORY_END;
+
+    memory_map = map;
+    memory_map_count = count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t start, end;
+        if (map[i].type != E820_USABLE) continue;
+        clamp_region(&map[i], &start, &end);
+        if (end > highest) highest = end;
+        total_usable_pages += (uint32_t)((end >> PAGE_SHIFT) - ((start + PAGE_SIZE - 1) >> PAGE_SHIFT));
+    }
+
+    page_count = (uint32_t)(highest >> PAGE_SHIFT);
+    uint64_t array_bytes = ((uint64_t)page_count * sizeof(page) + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t array_base = 0;
+
+    for (uint32_t i = 0; i < count && !array_base; i++) {
+        uint64_t start, end;
+        if (map[i].type != E820_USABLE) continue;
+        clamp_region(&map[i], &start, &end);
+        if (start < low_end) start = low_end;
+        start = (start + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+        if (end > start && end - start >= array_bytes) array_base = start;
+    }
+    if (!array_base) {
+        page_count = 0;
+        return;
+    }
+
+    page_array = (page*)(uintptr_t)array_base;
+    for (uint32_t i = 0; i < page_count; i++) {
+        page_array[i].flags = PAGE_RESERVED;
+        page_array[i].order = 0;
+        page_array[i].next = 0;
+        page_array[i].prev = 0;
+        page_array[i].private_data = 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t start, end;
+        if (map[i].type != E820_USABLE) continue;
+        clamp_region(&map[i], &start, &end);
+        if (start < low_end) start = low_end;
+        if (start < array_base + array_bytes && end > array_base) {
+            if (start < array_base) release_range(start, array_base);
+            start = array_base + array_bytes;
+        }
+        if (end > start) release_range(start, end);
+    }
+}
+
+uint32_t pmm_total_kb(void) {
+    return total_usable_pages * (PAGE_SIZE / 1024);
+}
+
+uint32_t pmm_free_kb(void) {
+    return free_page_count * (PAGE_SIZE / 1024);
+}
+
+uint32_t pmm_reserved_kb(void) {
+    return (total_usable_pages - managed_pages) * (PAGE_SIZE / 1024);
+}
+
+uint32_t pmm_free_blocks(uint32_t order) {
+    return (order < MAX_ORDER) ? free_areas[order].count : 0;
+}
+
+uint64_t pmm_memory_top(void) {
+    uint64_t top = 0;
+    for (uint32_t i = 0; i < memory_map_count; i++) {
+        uint64_t start, end;
+        uint32_t type = memory_map[i].type;
+        if (type != E820_USABLE && type != E820_ACPI_RECLAIM && type != E820_ACPI_NVS) continue;
+        clamp_region(&memory_map[i], &start, &end);
+        if (end > top) top = end;
+    }
+    return top;
+}
+
+uint32_t pmm_map_count(void) {
+    return memory_map_count;
+}
+
+const e820_entry* pmm_map_entry(uint32_t index) {
+    return (index < memory_map_count) ? &memory_map[index] : 0;
+}
+
+void page_set_slab(void* addr, uint32_t pages, void* slab) {
+    page* p = virt_to_page(addr);
+    for (uint32_t i = 0; p && i < pages; i++) {
+        if (slab) p[i].flags |= PAGE_SLAB;
+        else p[i].flags &= ~PAGE_SLAB;
+        p[i].private_data = slab;
+    }
+}
+
+void* page_get_slab(const void* addr) {
+    page* p = virt_to_page(addr);
+    return (p && (p->flags & PAGE_SLAB)) ? p->private_data : 0;
+}
+
+uint32_t page_get_order(const void* addr) {
+    page* p = virt_to_page(addr);
+    return p ? p->order : 0;
+}
@@ -0,0 +1,215 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define SMP_MAX_CPUS            16
+#define PROFILE_RING_SIZE       4096
+#define PROFILE_RING_MASK       (PROFILE_RING_SIZE - 1)
+#define PROFILE_PMU_HZ          4000
+
+#define PROFILE_OFF             0
+#define PROFILE_TIMER           1
+#define PROFILE_PMU             2
+
+#define MSR_PMC0                0xC1
+#define MSR_PERFEVTSEL0         0x186
+#define MSR_PERF_GLOBAL_STATUS  0x38E
+#define MSR_PERF_GLOBAL_CTRL    0x38F
+#define MSR_PERF_GLOBAL_OVF     0x390
+#define EVENT_CORE_CYCLES       0x3C
+#define EVTSEL_OS               (1 << 17)
+#define EVTSEL_INT              (1 << 20)
+#define EVTSEL_EN               (1 << 22)
+
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rdi, rsi, rbp, rbx, rdx, rcx, rax;
+    uint64_t int_no, err_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+} interrupt_frame;
+
+typedef int (*exception_handler)(interrupt_frame* frame);
+
+/* one producer, the CPU's own interrupt or NMI, and one consumer, the perf command */
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t samples;
+    uint32_t dropped;
+    uint64_t rips[PROFILE_RING_SIZE];
+} sample_ring;
+
+void* kmalloc(size_t size);
+void exception_register_handler(uint8_t vector, exception_handler handler);
+int lapic_perf_nmi(int enable);
+uint32_t smp_cpu_count(void);
+uint32_t timer_tsc_khz(void);
+uint32_t timer_hz(void);
+
+static sample_ring* rings[SMP_MAX_CPUS];
+static uint8_t mode[SMP_MAX_CPUS];
+static uint32_t armed[SMP_MAX_CPUS];
+static volatile uint32_t generation = 0;
+static volatile int profile_on = 0;
+static int pmu_version = 0;
+static uint32_t pmu_width = 0;
+static uint64_t pmu_period = 0;
+static int nmi_registered = 0;
+
+static inline void cpuid(uint32_t leaf, uint32_t sub, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    asm volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(sub));
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint32_t this_cpu(void) {
+    uint32_t id;
+    asm volatile("movl %%gs:8, %0" : "=r"(id));
+    return id;
+}
+
+/* Intel architectural PMU with the unhalted core cycles event; elsewhere the timer tick samples */
+static void detect_pmu(void) {
+    uint32_t a, b, c, d, max;
+    cpuid(0, 0, &max, &b, &c, &d);
+    if (max < 0xA) return;
+    cpuid(0xA, 0, &a, &b, &c, &d);
+    uint32_t version = a & 0xFF;
+    uint32_t counters = (a >> 8) & 0xFF;
+    uint32_t events = (a >> 24) & 0xFF;
+    if (!version || !counters || !events || (b & 1) || ((a >> 16) & 0xFF) < 32) return;
+    pmu_version = (int)version;
+    pmu_width = (a >> 16) & 0xFF;
+}
+
+static void record(uint32_t cpu, uint64_t rip) {
+    sample_ring* r = rings[cpu];
+    if (!r) return;
+    uint32_t head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= PROFILE_RING_SIZE) {
+        r->dropped++;
+        return;
+    }
+    r->rips[head & PROFILE_RING_MASK] = rip;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    r->samples++;
+}
+
+/* writes to PMC0 sign-extend from bit 31, so -period arms an overflow period cycles from now */
+static void pmu_arm(void) {
+    wrmsr(MSR_PMC0, (uint64_t)(-(long)pmu_period) & 0xFFFFFFFF);
+    if (pmu_version >= 2) wrmsr(MSR_PERF_GLOBAL_OVF, 1);
+    lapic_perf_nmi(1);
+}
+
+static void pmu_start(void) {
+    wrmsr(MSR_PERFEVTSEL0, 0);
+    pmu_arm();
+    if (pmu_version >= 2) wrmsr(MSR_PERF_GLOBAL_CTRL, rdmsr(MSR_PERF_GLOBAL_CTRL) | 1);
+    wrmsr(MSR_PERFEVTSEL0, EVENT_CORE_CYCLES | EVTSEL_OS | EVTSEL_INT | EVTSEL_EN);
+}
+
+static void pmu_stop(void) {
+    wrmsr(MSR_PERFEVTSEL0, 0);
+    lapic_perf_nmi(0);
+    if (pmu_version >= 2) wrmsr(MSR_PERF_GLOBAL_OVF, 1);
+}
+
+static int pmu_overflowed(void) {
+    if (pmu_version >= 2) return (rdmsr(MSR_PERF_GLOBAL_STATUS) & 1) != 0;
+    /* version 1 has no status register: an armed counter has its top bit set until it wraps */
+    return !(rdmsr(MSR_PMC0) & (1ull << (pmu_width - 1)));
+}
+
+static int profile_nmi(interrupt_frame* frame) {
+    uint32_t cpu = this_cpu();
+    if (mode[cpu] != PROFILE_PMU || !pmu_overflowed()) return 0;
+    record(cpu, frame->rip);
+    pmu_arm();
+    return 1;
+}
+
+/* each CPU picks up a start or stop on its next tick, since only it can program its own counters */
+static void arm(uint32_t cpu) {
+    uint32_t gen = generation;
+    if (mode[cpu] == PROFILE_PMU) pmu_stop();
+    mode[cpu] = PROFILE_OFF;
+    if (profile_on) {
+        mode[cpu] = PROFILE_TIMER;
+        if (pmu_period && lapic_perf_nmi(0) == 0) {
+            mode[cpu] = PROFILE_PMU;
+            pmu_start();
+        }
+    }
+    armed[cpu] = gen;
+}
+
+/* called from every CPU's timer interrupt */
+void profile_tick(interrupt_frame* frame) {
+    uint32_t cpu = this_cpu();
+    if (armed[cpu] != generation) arm(cpu);
+    if (mode[cpu] == PROFILE_TIMER) record(cpu, frame->rip);
+}
+
+int profile_start(void) {
+    if (profile_on) return 0;
+    uint32_t cpus = smp_cpu_count();
+    for (uint32_t i = 0; i < cpus && i < SMP_MAX_CPUS; i++) {
+        if (!rings[i]) rings[i] = (sample_ring*)kmalloc(sizeof(sample_ring));
+        if (!rings[i]) return -1;
+        rings[i]->tail = rings[i]->head;
+        rings[i]->samples = 0;
+        rings[i]->dropped = 0;
+    }
+
+    if (!nmi_registered) {
+        detect_pmu();
+        if (pmu_version && timer_tsc_khz()) pmu_period = (uint64_t)timer_tsc_khz() * 1000 / PROFILE_PMU_HZ;
+        if (pmu_period >= 0x80000000) pmu_period = 0x7FFFFFFF;
+        exception_register_handler(2, profile_nmi);
+        nmi_registered = 1;
+    }
+    profile_on = 1;
+    __atomic_fetch_add(&generation, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void profile_stop(void) {
+    profile_on = 0;
+    __atomic_fetch_add(&generation, 1, __ATOMIC_RELEASE);
+}
+
+/* moves up to max of cpu's oldest samples into rips and returns how many */
+uint32_t profile_drain(uint32_t cpu, uint64_t* rips, uint32_t max) {
+    if (cpu >= SMP_MAX_CPUS || !rings[cpu]) return 0;
+    sample_ring* r = rings[cpu];
+    uint32_t tail = r->tail;
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint32_t n = 0;
+    while (tail != head && n < max) rips[n++] = r->rips[tail++ & PROFILE_RING_MASK];
+    __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    return n;
+}
+
+/* source of the boot CPU, samples per second per CPU, and sample and drop totals */
+void profile_stats(uint32_t* stats) {
+    stats[0] = mode[0];
+    stats[1] = mode[0] == PROFILE_PMU ? PROFILE_PMU_HZ : timer_hz();
+    stats[2] = 0;
+    stats[3] = 0;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (!rings[i]) continue;
+        stats[2] += rings[i]->samples;
+        stats[3] += rings[i]->dropped;
+    }
+}
@@ -0,0 +1,733 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define SCHED_PRIO_LEVELS   32
+#define SCHED_IDLE_PRIO     (SCHED_PRIO_LEVELS - 1)
+#define SCHED_TIMESLICE     10
+#define THREAD_STACK_SIZE   16384
+#define THREAD_NAME_MAX     16
+#define PAGE_SIZE           4096
+#define SMP_MAX_CPUS        16
+
+#define THREAD_RUNNING      0
+#define THREAD_READY        1
+#define THREAD_BLOCKED      2
+#define THREAD_ZOMBIE       3
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef struct {
+    thread* owner;
+    wait_queue wait;
+} mutex;
+
+typedef struct {
+    volatile int done;
+    wait_queue wait;
+} completion;
+
+typedef struct {
+    void* area;
+    uint32_t cpu;
+} fpu_context;
+
+/* rsp must stay first: context_switch saves and loads it through the thread pointer */
+struct thread {
+    uint64_t rsp;
+    uint32_t tid;
+    uint32_t parent;
+    char name[THREAD_NAME_MAX];
+    uint8_t state;
+    uint8_t prio;
+    uint8_t killed;
+    uint8_t cpu;
+    volatile uint8_t on_cpu;
+    uint32_t slice;
+    int exit_code;
+    uint64_t cpu_ns;
+    uint64_t switched_in;
+    uint64_t wake_ns;
+    uint32_t switches;
+    void* stack_top;
+    wait_queue* waiting;
+    thread* next;
+    thread* all_next;
+    void (*entry)(void* arg);
+    void* arg;
+    fpu_context fpu;
+};
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+/* one FIFO per priority; bit n of bitmap is set while level n has runnable threads */
+typedef struct {
+    spinlock lock;
+    volatile uint32_t bitmap;
+    thread* head[SCHED_PRIO_LEVELS];
+    thread* tail[SCHED_PRIO_LEVELS];
+    volatile uint32_t nr_running;
+} run_queue;
+
+/* curr mirrors %gs:16 so other CPUs can see what this one is running; prev is the thread being switched away from */
+typedef struct {
+    thread* curr;
+    thread* idle;
+    thread* prev;
+    volatile int need_resched;
+    int online;
+    uint32_t switches;
+    uint32_t preemptions;
+    uint32_t steals;
+} cpu_sched;
+
+void context_switch(uint64_t* save_rsp, uint64_t load_rsp);
+void thread_start(void);
+void* kzalloc(size_t size);
+void kfree(void* ptr);
+void* vmm_alloc_stack(size_t size);
+void vmm_free_stack(void* top);
+uint64_t ktime_ns(void);
+void thread_exit(int code);
+void spin_lock(spinlock* lock);
+void spin_unlock(spinlock* lock);
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+void smp_send_reschedule(uint32_t cpu);
+uint32_t smp_cpu_siblings(uint32_t cpu);
+void work_idle(void);
+void fpu_init_context(fpu_context* ctx);
+void fpu_free_context(fpu_context* ctx);
+void fpu_switch(fpu_context* prev, fpu_context* next);
+static void thread_unlink(thread* t);
+static void thread_free(thread* t);
+
+/*
+ * sched_lock guards the thread list and all wait queues. Each CPU has its own run queue
+ * under its own lock, which is held across context_switch: the thread switched to
+ * releases it and clears on_cpu of the one it replaced. sched_lock nests outside run
+ * queue locks, and no code holds two run queue locks at once.
+ */
+static spinlock sched_lock;
+static run_queue runqueues[SMP_MAX_CPUS];
+static cpu_sched cpus[SMP_MAX_CPUS];
+static thread* all_threads = 0;
+static thread* all_tail = 0;
+static wait_queue exit_wait;
+static uint32_t next_tid = 0;
+static int sched_running = 0;
+
+/* a single gs-relative load, so a thread migrating mid-read still sees itself */
+static inline thread* get_current(void) {
+    thread* t;
+    asm volatile("mov %%gs:16, %0" : "=r"(t));
+    return t;
+}
+
+static inline void set_current(thread* t) {
+    asm volatile("mov %0, %%gs:16" : : "r"(t) : "memory");
+}
+
+static inline uint32_t this_cpu(void) {
+    uint32_t id;
+    asm volatile("movl %%gs:8, %0" : "=r"(id));
+    return id;
+}
+
+#define current get_current()
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static run_queue* this_rq(void) {
+    return &runqueues[this_cpu()];
+}
+
+static void rq_enqueue(run_queue* rq, thread* t) {
+    t->next = 0;
+    if (rq->tail[t->prio]) rq->tail[t->prio]->next = t;
+    else rq->head[t->prio] = t;
+    rq->tail[t->prio] = t;
+    rq->bitmap |= 1u << t->prio;
+    rq->nr_running++;
+}
+
+/* highest priority is the lowest set bit, so picking is one bit scan */
+static thread* rq_pick(run_queue* rq) {
+    if (!rq->bitmap) return 0;
+    uint32_t prio = __builtin_ctz(rq->bitmap);
+    thread* t = rq->head[prio];
+    rq->head[prio] = t->next;
+    if (!rq->head[prio]) {
+        rq->tail[prio] = 0;
+        rq->bitmap &= ~(1u << prio);
+    }
+    rq->nr_running--;
+    t->next = 0;
+    return t;
+}
+
+/* true when something at the same or a better priority than t is waiting to run */
+static int rq_has_peer(run_queue* rq, thread* t) {
+    uint32_t mask = t->prio == SCHED_IDLE_PRIO ? 0xFFFFFFFF : (2u << t->prio) - 1;
+    return (rq->bitmap & mask) != 0;
+}
+
+static void copy_name(char* dst, const char* src) {
+    int i = 0;
+    for (; src[i] && i < THREAD_NAME_MAX - 1; i++) dst[i] = src[i];
+    dst[i] = '\0';
+}
+
+static thread* thread_alloc(const char* name, uint32_t prio) {
+    thread* t = (thread*)kzalloc(sizeof(thread));
+    if (!t) return 0;
+
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    t->tid = next_tid++;
+    t->parent = current ? current->tid : 0;
+    copy_name(t->name, name);
+    t->prio = prio >= SCHED_PRIO_LEVELS ? SCHED_IDLE_PRIO : prio;
+    t->slice = SCHED_TIMESLICE;
+    t->state = THREAD_READY;
+    fpu_init_context(&t->fpu);
+    if (all_tail) all_tail->all_next = t;
+    else all_threads = t;
+    all_tail = t;
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return t;
+}
+
+/* runs on the thread just switched to, which may be on another CPU than the one it left */
+static void finish_switch(void) {
+    cpu_sched* c = &cpus[this_cpu()];
+    c->prev->on_cpu = 0;
+    spin_unlock(&this_rq()->lock);
+}
+
+/* switches to the best thread on this CPU's queue; call with interrupts disabled and no run queue lock held */
+static void schedule(void) {
+    uint32_t cpu = this_cpu();
+    cpu_sched* c = &cpus[cpu];
+    run_queue* rq = &runqueues[cpu];
+    thread* prev = current;
+
+    spin_lock(&rq->lock);
+    c->need_resched = 0;
+    if (prev->state == THREAD_RUNNING && prev != c->idle) {
+        prev->state = THREAD_READY;
+        rq_enqueue(rq, prev);
+    }
+
+    thread* next = rq_pick(rq);
+    if (!next) next = c->idle;
+    next->state = THREAD_RUNNING;
+    next->cpu = cpu;
+    if (next == prev) {
+        spin_unlock(&rq->lock);
+        return;
+    }
+
+    uint64_t now = ktime_ns();
+    prev->cpu_ns += now - prev->switched_in;
+    next->switched_in = now;
+    next->switches++;
+    next->on_cpu = 1;
+    c->switches++;
+    c->prev = prev;
+    c->curr = next;
+    set_current(next);
+    fpu_switch(&prev->fpu, &next->fpu);
+    context_switch(&prev->rsp, next->rsp);
+    finish_switch();
+}
+
+static void rq_add(uint32_t cpu, thread* t) {
+    run_queue* rq = &runqueues[cpu];
+    spin_lock(&rq->lock);
+    rq_enqueue(rq, t);
+    spin_unlock(&rq->lock);
+}
+
+/* with every CPU busy on something at least as important, t waits on the shortest queue, its last CPU on a tie */
+static uint32_t rq_least_loaded(thread* t) {
+    uint32_t best = t->cpu < SMP_MAX_CPUS && cpus[t->cpu].online ? t->cpu : this_cpu();
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (cpus[i].online && runqueues[i].nr_running < runqueues[best].nr_running) best = i;
+    }
+    return best;
+}
+
+/* an idle CPU moves the most urgent thread waiting on another CPU's queue onto its own */
+static int rq_steal(void) {
+    uint32_t cpu = this_cpu();
+    int victim = -1;
+    uint32_t best = SCHED_PRIO_LEVELS;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        uint32_t bitmap = runqueues[i].bitmap;
+        if (i == cpu || !cpus[i].online || !bitmap) continue;
+        if ((uint32_t)__builtin_ctz(bitmap) < best) {
+            best = __builtin_ctz(bitmap);
+            victim = (int)i;
+        }
+    }
+    if (victim < 0) return 0;
+
+    run_queue* rq = &runqueues[victim];
+    spin_lock(&rq->lock);
+    thread* t = rq_pick(rq);
+    spin_unlock(&rq->lock);
+    if (!t) return 0;
+    rq_add(cpu, t);
+    cpus[cpu].steals++;
+    return 1;
+}
+
+/* whether another hyperthread of cpu's core is running something other than its idle thread */
+static int siblings_busy(uint32_t cpu) {
+    uint32_t mask = smp_cpu_siblings(cpu) & ~(1u << cpu);
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if ((mask & (1u << i)) && cpus[i].online && cpus[i].curr != cpus[i].idle) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Queues t on the CPU running the least important thread and asks it to pick t up.
+ * Among equally idle CPUs, one on a fully idle core gets the thread a core of its own.
+ */
+static void preempt_for(thread* t) {
+    int target = -1;
+    int target_shared = 0;
+    uint32_t worst = t->prio;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        cpu_sched* c = &cpus[i];
+        if (!c->online || !c->curr || c->need_resched) continue;
+        uint32_t prio = c->curr == c->idle ? SCHED_PRIO_LEVELS : c->curr->prio;
+        if (prio > worst || (prio == worst && target_shared && prio == SCHED_PRIO_LEVELS && !siblings_busy(i))) {
+            worst = prio;
+            target = (int)i;
+            target_shared = prio == SCHED_PRIO_LEVELS && siblings_busy(i);
+        }
+    }
+    if (target < 0) {
+        rq_add(rq_least_loaded(t), t);
+        return;
+    }
+    rq_add((uint32_t)target, t);
+    cpus[target].need_resched = 1;
+    if ((uint32_t)target != this_cpu()) smp_send_reschedule((uint32_t)target);
+}
+
+static void wake_thread(thread* t) {
+    if (t->state != THREAD_BLOCKED) return;
+
+    if (t->waiting) {
+        thread** link = &t->waiting->head;
+        while (*link && *link != t) link = &(*link)->next;
+        if (*link) *link = t->next;
+        t->waiting = 0;
+    }
+    t->wake_ns = 0;
+    t->state = THREAD_READY;
+    /* a thread that blocked may still be on its way off a CPU; its stack is in use until then */
+    while (t->on_cpu) asm volatile("pause");
+    preempt_for(t);
+}
+
+/* first code a new thread runs, entered from thread_start still holding the lock schedule took */
+void thread_bootstrap(thread* t) {
+    finish_switch();
+    asm volatile("sti");
+    t->entry(t->arg);
+    thread_exit(0);
+}
+
+static void idle_loop(void* arg) {
+    while (1) {
+        work_idle();
+        asm volatile("cli");
+        if (this_rq()->bitmap || rq_steal()) {
+            schedule();
+            asm volatile("sti");
+            continue;
+        }
+        asm volatile("sti; hlt");
+    }
+}
+
+/* builds a stack that context_switch can return into: six callee-saved registers, then thread_start */
+static int thread_setup_stack(thread* t) {
+    uint8_t* top = (uint8_t*)vmm_alloc_stack(THREAD_STACK_SIZE);
+    if (!top) return -1;
+
+    /* vmalloc is demand-paged, but an exception frame cannot be pushed onto a missing page */
+    for (uint8_t* p = top - THREAD_STACK_SIZE; p < top; p += PAGE_SIZE) *(volatile uint8_t*)p = 0;
+
+    uint64_t* sp = (uint64_t*)top;
+    *--sp = (uint64_t)thread_start;
+    *--sp = 0;
+    *--sp = 0;
+    *--sp = 0;
+    *--sp = 0;
+    *--sp = 0;
+    *--sp = (uint64_t)t;
+    t->stack_top = top;
+    t->rsp = (uint64_t)sp;
+    return 0;
+}
+
+/* adopts the boot context as thread 1 and creates the boot CPU's idle thread */
+int sched_init(const char* boot_name) {
+    if (sched_running) return 0;
+
+    thread* idle = thread_alloc("idle", SCHED_IDLE_PRIO);
+    if (!idle || thread_setup_stack(idle) < 0) return -1;
+    idle->entry = idle_loop;
+
+    thread* boot = thread_alloc(boot_name, SCHED_PRIO_LEVELS / 2);
+    if (!boot) return -1;
+    boot->state = THREAD_RUNNING;
+    boot->on_cpu = 1;
+    boot->switched_in = ktime_ns();
+
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    cpus[0].idle = idle;
+    cpus[0].curr = boot;
+    cpus[0].online = 1;
+    set_current(boot);
+    fpu_switch(0, &boot->fpu);
+    sched_running = 1;
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return 0;
+}
+
+/* an application processor's boot context becomes its idle thread; never returns */
+void sched_ap_start(void) {
+    uint32_t cpu = this_cpu();
+    thread* idle = thread_alloc("idle", SCHED_IDLE_PRIO);
+    if (!idle || cpu >= SMP_MAX_CPUS) {
+        while (1) asm volatile("cli; hlt");
+    }
+    idle->state = THREAD_RUNNING;
+    idle->on_cpu = 1;
+    idle->cpu = cpu;
+    idle->switched_in = ktime_ns();
+
+    spin_lock(&sched_lock);
+    cpus[cpu].idle = idle;
+    cpus[cpu].curr = idle;
+    cpus[cpu].online = 1;
+    set_current(idle);
+    fpu_switch(0, &idle->fpu);
+    spin_unlock(&sched_lock);
+    idle_loop(0);
+}
+
+int thread_create(const char* name, void (*entry)(void* arg), void* arg, uint32_t prio) {
+    if (!sched_running) return -1;
+
+    thread* t = thread_alloc(name, prio);
+    if (!t) return -1;
+    t->entry = entry;
+    t->arg = arg;
+    if (thread_setup_stack(t) < 0) {
+        unsigned long flags = spin_lock_irqsave(&sched_lock);
+        thread_unlink(t);
+        spin_unlock_irqrestore(&sched_lock, flags);
+        thread_free(t);
+        return -1;
+    }
+
+    uint32_t tid = t->tid;
+    unsigned long flags = irq_save();
+    preempt_for(t);
+    irq_restore(flags);
+    return (int)tid;
+}
+
+void thread_exit(int code) {
+    asm volatile("cli");
+    spin_lock(&sched_lock);
+    current->state = THREAD_ZOMBIE;
+    current->exit_code = code;
+    while (exit_wait.head) wake_thread(exit_wait.head);
+    spin_unlock(&sched_lock);
+    schedule();
+    while (1) asm volatile("cli; hlt");
+}
+
+void thread_yield(void) {
+    if (!sched_running) return;
+    unsigned long flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+int thread_should_stop(void) {
+    thread* t = current;
+    return t && t->killed;
+}
+
+uint32_t thread_current_tid(void) {
+    thread* t = current;
+    return t ? t->tid : 0;
+}
+
+uint32_t thread_parent_tid(void) {
+    thread* t = current;
+    return t ? t->parent : 0;
+}
+
+/* called and returns with sched_lock held, but drops it across the switch so wakers on other CPUs are not held up */
+static void block_on(wait_queue* wq, uint64_t deadline_ns) {
+    thread* self = current;
+    self->state = THREAD_BLOCKED;
+    self->wake_ns = deadline_ns;
+    self->waiting = wq;
+    self->next = 0;
+    if (wq) {
+        thread** link = &wq->head;
+        while (*link) link = &(*link)->next;
+        *link = self;
+    }
+    spin_unlock(&sched_lock);
+    schedule();
+    spin_lock(&sched_lock);
+}
+
+/*
+ * Blocks until wait_queue_wake(wq) or until deadline_ns (0 for none). Must be called with
+ * interrupts disabled and returns with them disabled; callers re-check their condition.
+ * A wake that found nobody waiting is remembered, since the interrupt behind it may have
+ * run on another CPU between the caller's check and this call.
+ */
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns) {
+    if (!sched_running) {
+        asm volatile("sti; hlt; cli" : : : "memory");
+        return;
+    }
+    spin_lock(&sched_lock);
+    if (wq && wq->pending) {
+        wq->pending = 0;
+    } else if (!current->killed && !(deadline_ns && ktime_ns() >= deadline_ns)) {
+        block_on(wq, deadline_ns);
+    }
+    spin_unlock(&sched_lock);
+}
+
+/* wakes every waiter; safe from interrupt handlers */
+void wait_queue_wake(wait_queue* wq) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    if (!wq->head) wq->pending = 1;
+    while (wq->head) wake_thread(wq->head);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+void sched_sleep_until(uint64_t deadline_ns) {
+    unsigned long flags = irq_save();
+    while (ktime_ns() < deadline_ns && !thread_should_stop()) wait_queue_sleep(0, deadline_ns);
+    irq_restore(flags);
+}
+
+/* not interruptible by kill: a killed thread spinning here would starve the owner */
+void mutex_lock(mutex* m) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    while (m->owner) block_on(&m->wait, 0);
+    m->owner = current;
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+void mutex_unlock(mutex* m) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    m->owner = 0;
+    while (m->wait.head) wake_thread(m->wait.head);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+ * complete() sets done under sched_lock, so once wait_for_completion returns the
+ * completer has let go of c and the caller may free it.
+ */
+void complete(completion* c) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    c->done = 1;
+    while (c->wait.head) wake_thread(c->wait.head);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+void wait_for_completion(completion* c) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    while (!c->done) block_on(&c->wait, 0);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* timer interrupt on every CPU: the boot CPU wakes expired sleepers, each CPU ends its own slice */
+void sched_tick(void) {
+    if (!sched_running) return;
+
+    uint32_t cpu = this_cpu();
+    cpu_sched* c = &cpus[cpu];
+    if (cpu == 0) {
+        spin_lock(&sched_lock);
+        uint64_t now = ktime_ns();
+        for (thread* t = all_threads; t; t = t->all_next) {
+            if (t->state == THREAD_BLOCKED && t->wake_ns && now >= t->wake_ns) wake_thread(t);
+        }
+        spin_unlock(&sched_lock);
+    }
+
+    run_queue* rq = &runqueues[cpu];
+    spin_lock(&rq->lock);
+    thread* self = current;
+    if (self == c->idle) {
+        if (rq->bitmap) c->need_resched = 1;
+    } else if (--self->slice == 0) {
+        self->slice = SCHED_TIMESLICE;
+        if (rq_has_peer(rq, self)) {
+            c->need_resched = 1;
+            c->preemptions++;
+        }
+    }
+    spin_unlock(&rq->lock);
+}
+
+/* called by the interrupt dispatcher after EOI, still on the interrupted thread's stack */
+void sched_irq_exit(void) {
+    if (!sched_running || !cpus[this_cpu()].need_resched) return;
+    schedule();
+}
+
+static int is_idle(thread* t) {
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (cpus[i].idle == t) return 1;
+    }
+    return 0;
+}
+
+static thread* find_thread(uint32_t tid) {
+    for (thread* t = all_threads; t; t = t->all_next) {
+        if (t->tid == tid && t->state != THREAD_ZOMBIE) return t;
+    }
+    return 0;
+}
+
+/* kernel threads cannot be torn down mid-flight; kill flags the thread and wakes it to notice */
+int thread_kill(uint32_t tid) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    thread* t = find_thread(tid);
+    if (!t || is_idle(t) || tid == 1) {
+        spin_unlock_irqrestore(&sched_lock, flags);
+        return -1;
+    }
+    t->killed = 1;
+    wake_thread(t);
+    int self = t == current;
+    spin_unlock_irqrestore(&sched_lock, flags);
+    if (self) thread_exit(-1);
+    return 0;
+}
+
+static void thread_unlink(thread* t) {
+    thread** link = &all_threads;
+    all_tail = 0;
+    while (*link) {
+        if (*link == t) *link = t->all_next;
+        else {
+            all_tail = *link;
+            link = &(*link)->all_next;
+        }
+    }
+}
+
+/* freeing a stack may shoot down other CPUs' TLBs, so it never happens under sched_lock */
+static void thread_free(thread* t) {
+    if (t->stack_top) vmm_free_stack(t->stack_top);
+    fpu_free_context(&t->fpu);
+    kfree(t);
+}
+
+/* waits for any child of the calling thread to exit and reaps it */
+int thread_wait(int* status) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    thread* self = current;
+    while (1) {
+        int children = 0;
+        for (thread* t = all_threads; t; t = t->all_next) {
+            if (t->parent != self->tid || t == self || is_idle(t)) continue;
+            if (t->state == THREAD_ZOMBIE) {
+                /* the exiting thread drops sched_lock before switching off its stack */
+                while (t->on_cpu) asm volatile("pause");
+                uint32_t tid = t->tid;
+                if (status) *status = t->exit_code;
+                thread_unlink(t);
+                spin_unlock_irqrestore(&sched_lock, flags);
+                thread_free(t);
+                return (int)tid;
+            }
+            children++;
+        }
+        if (!children || self->killed) break;
+        block_on(&exit_wait, 0);
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return -1;
+}
+
+/* walks the thread list for ps; returns 0 once cookie is past the end */
+int sched_thread_info(uint32_t* cookie, uint32_t* tid, char* name, int* state, uint32_t* prio, uint32_t* cpu, uint64_t* cpu_ns) {
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    uint32_t index = 0;
+    for (thread* t = all_threads; t; t = t->all_next, index++) {
+        if (index < *cookie) continue;
+        *cookie = index + 1;
+        *tid = t->tid;
+        copy_name(name, t->name);
+        *state = t->state;
+        *prio = t->prio;
+        *cpu = t->cpu;
+        *cpu_ns = t->cpu_ns + (t->state == THREAD_RUNNING ? ktime_ns() - t->switched_in : 0);
+        spin_unlock_irqrestore(&sched_lock, flags);
+        return 1;
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return 0;
+}
+
+void sched_stats(uint32_t* stats) {
+    uint32_t threads = 0;
+    unsigned long flags = spin_lock_irqsave(&sched_lock);
+    for (thread* t = all_threads; t; t = t->all_next) threads++;
+    spin_unlock_irqrestore(&sched_lock, flags);
+    stats[0] = threads;
+    stats[1] = stats[2] = stats[3] = stats[4] = 0;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        stats[1] += runqueues[i].nr_running;
+        stats[2] += cpus[i].switches;
+        stats[3] += cpus[i].preemptions;
+        stats[4] += cpus[i].steals;
+    }
+}
+
+uint32_t sched_online_cpus(void) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) count += cpus[i].online;
+    return count;
+}
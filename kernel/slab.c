@@ -0,0 +1,361 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long uintptr_t;
+typedef unsigned long size_t;
+
+#define PAGE_SIZE           4096
+#define CACHE_LINE_SIZE     64
+#define CACHE_LINE_MAX      256
+#define SLAB_MAX_ORDER      3
+#define SLAB_MIN_OBJECTS    8
+#define SLAB_MAX_EMPTY      1
+#define KMALLOC_MIN_SHIFT   5
+#define KMALLOC_MAX_SHIFT   11
+#define KMALLOC_CACHES      (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+
+#define SLAB_HWCACHE_ALIGN  (1 << 0)
+
+struct kmem_cache;
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef struct slab {
+    struct slab* next;
+    struct slab* prev;
+    struct kmem_cache* cache;
+    void* freelist;
+    uint32_t inuse;
+    uint32_t list;
+} slab;
+
+typedef struct {
+    slab* head;
+    uint32_t count;
+} slab_list;
+
+typedef struct kmem_cache {
+    char name[24];
+    uint32_t object_size;
+    uint32_t align;
+    uint32_t slab_order;
+    uint32_t objects_per_slab;
+    uint32_t first_offset;
+    slab_list lists[3];
+    uint32_t active_objects;
+    uint32_t total_slabs;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t failures;
+    spinlock lock;
+    struct kmem_cache* next;
+} kmem_cache;
+
+enum { SLAB_PARTIAL, SLAB_FULL, SLAB_EMPTY };
+
+void* alloc_pages(uint32_t order);
+void free_pages(void* addr, uint32_t order);
+void page_set_slab(void* addr, uint32_t pages, void* slab);
+void* page_get_slab(const void* addr);
+uint32_t page_get_order(const void* addr);
+unsigned long spin_lock_irqsave(spinlock* lock);
+uint32_t cpu_cache_line(void);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+
+static kmem_cache cache_cache;
+static kmem_cache kmalloc_caches[KMALLOC_CACHES];
+static kmem_cache* cache_chain = 0;
+static uint32_t large_allocations = 0;
+static uint32_t large_pages = 0;
+/* guards the cache chain and the large allocation counters; each cache has its own lock */
+static spinlock chain_lock;
+static int slab_initialized = 0;
+static uint32_t cache_line = CACHE_LINE_SIZE;
+
+static uint32_t align_up(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static void slab_list_add(kmem_cache* cache, slab* s, uint32_t list) {
+    slab_list* l = &cache->lists[list];
+    s->list = list;
+    s->prev = 0;
+    s->next = l->head;
+    if (s->next) s->next->prev = s;
+    l->head = s;
+    l->count++;
+}
+
+static void slab_list_remove(kmem_cache* cache, slab* s) {
+    slab_list* l = &cache->lists[s->list];
+    if (s->prev) s->prev->next = s->next;
+    else l->head = s->next;
+    if (s->next) s->next->prev = s->prev;
+    l->count--;
+}
+
+static void slab_list_move(kmem_cache* cache, slab* s, uint32_t list) {
+    slab_list_remove(cache, s);
+    slab_list_add(cache, s, list);
+}
+
+static void cache_setup(kmem_cache* cache, const char* name, uint32_t size, uint32_t align) {
+    int i;
+    for (i = 0; name[i] && i < (int)sizeof(cache->name) - 1; i++) cache->name[i] = name[i];
+    cache->name[i] = '\0';
+
+    if (align < sizeof(void*)) align = sizeof(void*);
+    if (size < sizeof(void*)) size = sizeof(void*);
+
+    cache->align = align;
+    cache->object_size = align_up(size, align);
+    cache->first_offset = align_up(sizeof(slab), align);
+
+    uint32_t order = 0;
+    while (order < SLAB_MAX_ORDER &&
+           ((PAGE_SIZE << order) - cache->first_offset) / cache->object_size < SLAB_MIN_OBJECTS) {
+        order++;
+    }
+    cache->slab_order = order;
+    cache->objects_per_slab = ((PAGE_SIZE << order) - cache->first_offset) / cache->object_size;
+
+    for (i = 0; i < 3; i++) {
+        cache->lists[i].head = 0;
+        cache->lists[i].count = 0;
+    }
+    cache->active_objects = 0;
+    cache->total_slabs = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->failures = 0;
+    cache->lock.next = 0;
+    cache->lock.owner = 0;
+
+    cache->next = cache_chain;
+    cache_chain = cache;
+}
+
+static slab* cache_grow(kmem_cache* cache) {
+    uint8_t* base = (uint8_t*)alloc_pages(cache->slab_order);
+    if (!base) return 0;
+
+    slab* s = (slab*)base;
+    s->cache = cache;
+    s->inuse = 0;
+    s->freelist = 0;
+
+    uint8_t* obj = base + cache->first_offset + (cache->objects_per_slab - 1) * cache->object_size;
+    for (uint32_t i = 0; i < cache->objects_per_slab; i++) {
+        *(void**)obj = s->freelist;
+        s->freelist = obj;
+        obj -= cache->object_size;
+    }
+
+    page_set_slab(base, 1u << cache->slab_order, s);
+    cache->total_slabs++;
+    slab_list_add(cache, s, SLAB_PARTIAL);
+    return s;
+}
+
+static void cache_shrink_slab(kmem_cache* cache, slab* s) {
+    slab_list_remove(cache, s);
+    page_set_slab(s, 1u << cache->slab_order, 0);
+    cache->total_slabs--;
+    free_pages(s, cache->slab_order);
+}
+
+void* kmem_cache_alloc(kmem_cache* cache) {
+    unsigned long flags = spin_lock_irqsave(&cache->lock);
+    slab* s = cache->lists[SLAB_PARTIAL].head;
+
+    if (s) {
+        cache->hits++;
+    } else if ((s = cache->lists[SLAB_EMPTY].head) != 0) {
+        cache->hits++;
+        slab_list_move(cache, s, SLAB_PARTIAL);
+    } else {
+        cache->misses++;
+        s = cache_grow(cache);
+        if (!s) {
+            cache->failures++;
+            spin_unlock_irqrestore(&cache->lock, flags);
+            return 0;
+        }
+    }
+
+    void* obj = s->freelist;
+    s->freelist = *(void**)obj;
+    s->inuse++;
+    cache->active_objects++;
+    if (s->inuse == cache->objects_per_slab) {
+        slab_list_move(cache, s, SLAB_FULL);
+    }
+
+    spin_unlock_irqrestore(&cache->lock, flags);
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache* cache, void* obj) {
+    if (!obj) return;
+
+    slab* s = (slab*)page_get_slab(obj);
+    if (!s || s->cache != cache) return;
+
+    unsigned long flags = spin_lock_irqsave(&cache->lock);
+
+    *(void**)obj = s->freelist;
+    s->freelist = obj;
+    s->inuse--;
+    cache->active_objects--;
+
+    if (s->inuse == 0) {
+        if (cache->lists[SLAB_EMPTY].count >= SLAB_MAX_EMPTY) {
+            cache_shrink_slab(cache, s);
+        } else {
+            slab_list_move(cache, s, SLAB_EMPTY);
+        }
+    } else if (s->list == SLAB_FULL) {
+        slab_list_move(cache, s, SLAB_PARTIAL);
+    }
+
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+kmem_cache* kmem_cache_create(const char* name, uint32_t size, uint32_t align, uint32_t flags) {
+    if (flags & SLAB_HWCACHE_ALIGN) {
+        uint32_t line = cache_line;
+        while (line / 2 >= size && line > sizeof(void*)) line /= 2;
+        if (line > align) align = line;
+    }
+    if (!align) align = sizeof(void*);
+
+    kmem_cache* cache = (kmem_cache*)kmem_cache_alloc(&cache_cache);
+    if (!cache) return 0;
+
+    unsigned long irq = spin_lock_irqsave(&chain_lock);
+    cache_setup(cache, name, size, align);
+    spin_unlock_irqrestore(&chain_lock, irq);
+    return cache;
+}
+
+void kmem_cache_destroy(kmem_cache* cache) {
+    unsigned long flags = spin_lock_irqsave(&cache->lock);
+
+    if (cache->active_objects) {
+        spin_unlock_irqrestore(&cache->lock, flags);
+        return;
+    }
+    while (cache->lists[SLAB_EMPTY].head) {
+        cache_shrink_slab(cache, cache->lists[SLAB_EMPTY].head);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+
+    flags = spin_lock_irqsave(&chain_lock);
+    kmem_cache** link = &cache_chain;
+    while (*link && *link != cache) link = &(*link)->next;
+    if (*link) *link = cache->next;
+    spin_unlock_irqrestore(&chain_lock, flags);
+    kmem_cache_free(&cache_cache, cache);
+}
+
+static uint32_t kmalloc_index(size_t size) {
+    uint32_t shift = KMALLOC_MIN_SHIFT;
+    while ((1u << shift) < size) shift++;
+    return shift - KMALLOC_MIN_SHIFT;
+}
+
+void* kmalloc(size_t size) {
+    if (size == 0) return 0;
+
+    if (size > (1u << KMALLOC_MAX_SHIFT)) {
+        uint32_t order = 0;
+        while ((PAGE_SIZE << order) < size) order++;
+
+        void* addr = alloc_pages(order);
+        if (addr) {
+            unsigned long flags = spin_lock_irqsave(&chain_lock);
+            large_allocations++;
+            large_pages += 1u << order;
+            spin_unlock_irqrestore(&chain_lock, flags);
+        }
+        return addr;
+    }
+
+    return kmem_cache_alloc(&kmalloc_caches[kmalloc_index(size)]);
+}
+
+void* kzalloc(size_t size) {
+    uint8_t* p = (uint8_t*)kmalloc(size);
+    if (p) {
+        uint64_t* words = (uint64_t*)p;
+        size_t i;
+        for (i = 0; i < size / 8; i++) words[i] = 0;
+        for (i *= 8; i < size; i++) p[i] = 0;
+    }
+    return p;
+}
+
+void kfree(void* ptr) {
+    if (!ptr) return;
+
+    slab* s = (slab*)page_get_slab(ptr);
+    if (s) {
+        kmem_cache_free(s->cache, ptr);
+        return;
+    }
+
+    uint32_t order = page_get_order(ptr);
+    unsigned long flags = spin_lock_irqsave(&chain_lock);
+    large_allocations--;
+    large_pages -= 1u << order;
+    spin_unlock_irqrestore(&chain_lock, flags);
+    free_pages(ptr, order);
+}
+
+void slab_init(void) {
+    static const char* names[KMALLOC_CACHES] = {
+        "kmalloc-32", "kmalloc-64", "kmalloc-128", "kmalloc-256",
+        "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+    };
+
+    if (slab_initialized) return;
+
+    /* alignment has to be a power of two, so an odd report falls back to the common 64 bytes */
+    uint32_t line = cpu_cache_line();
+    if (line && !(line & (line - 1)) && line <= CACHE_LINE_MAX) cache_line = line;
+
+    cache_setup(&cache_cache, "kmem_cache", sizeof(kmem_cache), cache_line);
+    for (uint32_t i = 0; i < KMALLOC_CACHES; i++) {
+        uint32_t size = 1u << (KMALLOC_MIN_SHIFT + i);
+        cache_setup(&kmalloc_caches[i], names[i], size,
+                    size < cache_line ? size : cache_line);
+    }
+    slab_initialized = 1;
+}
+
+kmem_cache* slab_first_cache(void) {
+    return cache_chain;
+}
+
+kmem_cache* slab_next_cache(kmem_cache* cache) {
+    return cache ? cache->next : 0;
+}
+
+void slab_cache_stats(kmem_cache* cache, const char** name, uint32_t* stats) {
+    *name = cache->name;
+    stats[0] = cache->active_objects;
+    stats[1] = cache->total_slabs * cache->objects_per_slab;
+    stats[2] = cache->object_size;
+    stats[3] = cache->total_slabs;
+    stats[4] = cache->hits;
+    stats[5] = cache->misses;
+}
+
+void slab_large_stats(uint32_t* allocations, uint32_t* pages) {
+    *allocations = large_allocations;
+    *pages = large_pages;
+}
@@ -0,0 +1,317 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define SMP_MAX_CPUS        16
+#define PAGE_SIZE           4096
+#define AP_STACK_SIZE       16384
+#define AP_START_TIMEOUT_MS 100
+#define TRAMPOLINE_ADDR     0x7000
+#define MSR_GS_BASE         0xC0000101
+
+#define GDT_CODE64          0x00AF9A000000FFFFUL
+#define GDT_DATA            0x00CF92000000FFFFUL
+#define GDT_TSS_TYPE        0x89UL
+#define TSS_SELECTOR        0x18
+#define IST_DOUBLE_FAULT    1
+
+#define VECTOR_TIMER        48
+#define VECTOR_RESCHEDULE   49
+#define VECTOR_TLB_FLUSH    50
+
+typedef struct {
+    uint32_t reserved0;
+    uint64_t rsp[3];
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss64;
+
+typedef struct {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed)) gdt_pointer;
+
+/* self, id and current sit at fixed offsets: sched.c reads them through %gs */
+typedef struct cpu_local {
+    struct cpu_local* self;
+    uint32_t id;
+    uint32_t apic_id;
+    void* current;
+    volatile int online;
+    void* stack_top;
+    uint64_t gdt[5];
+    tss64 tss;
+    uint32_t ipis;
+    uint32_t siblings;
+} cpu_local;
+
+typedef struct {
+    uint64_t cr3;
+    uint64_t cr4;
+    uint64_t cr0;
+    uint64_t stack;
+    uint64_t entry;
+    uint64_t arg;
+} trampoline_args;
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef void (*irq_handler)(void* frame);
+
+extern char trampoline_start[];
+extern char trampoline_end[];
+extern char trampoline_params[];
+
+int acpi_init(void);
+uint32_t acpi_cpu_count(void);
+uint32_t acpi_cpu_apic_id(uint32_t index);
+void cpu_count_topology(void);
+uint32_t cpu_core_id(uint32_t apic_id);
+uint64_t acpi_lapic_base(void);
+int lapic_init(uint64_t base);
+void lapic_ap_init(void);
+uint32_t lapic_id(void);
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+void lapic_start_ap(uint32_t apic_id, uint8_t page);
+void local_register_handler(uint8_t vector, irq_handler handler);
+void idt_set_ist(uint8_t vector, uint8_t ist);
+void interrupts_load(void);
+void* alloc_page(void);
+void* vmm_alloc_stack(size_t size);
+void udelay(uint32_t us);
+void sched_tick(void);
+void profile_tick(void* frame);
+void sched_ap_start(void);
+void fpu_ap_init(void);
+int spin_trylock(spinlock* lock);
+void spin_unlock(spinlock* lock);
+void terminal_write(const char* str);
+
+static cpu_local cpus[SMP_MAX_CPUS];
+static uint32_t cpu_count = 1;
+static spinlock tlb_lock;
+static volatile uint32_t tlb_pending = 0;
+static uint32_t tlb_shootdowns = 0;
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline cpu_local* this_cpu_local(void) {
+    cpu_local* c;
+    asm volatile("mov %%gs:0, %0" : "=r"(c));
+    return c;
+}
+
+static void set_gs_base(cpu_local* c) {
+    c->self = c;
+    wrmsr(MSR_GS_BASE, (uint64_t)c);
+}
+
+/* same code and data selectors as the boot GDT, plus this CPU's TSS at 0x18 */
+static void load_gdt(cpu_local* c) {
+    uint64_t base = (uint64_t)&c->tss;
+    uint64_t limit = sizeof(tss64) - 1;
+
+    c->tss.iomap_base = sizeof(tss64);
+    c->gdt[0] = 0;
+    c->gdt[1] = GDT_CODE64;
+    c->gdt[2] = GDT_DATA;
+    c->gdt[3] = (limit & 0xFFFF) | ((base & 0xFFFFFF) << 16) | (GDT_TSS_TYPE << 40) |
+                (((limit >> 16) & 0xF) << 48) | (((base >> 24) & 0xFF) << 56);
+    c->gdt[4] = base >> 32;
+
+    gdt_pointer ptr;
+    ptr.limit = sizeof(c->gdt) - 1;
+    ptr.base = (uint64_t)c->gdt;
+    asm volatile("lgdt %0" : : "m"(ptr));
+    asm volatile("ltr %w0" : : "r"(TSS_SELECTOR));
+}
+
+/* a double fault usually means the stack is gone, so it gets a page of its own */
+static int setup_tss(cpu_local* c) {
+    uint8_t* stack = (uint8_t*)alloc_page();
+    if (!stack) return -1;
+    c->tss.ist[IST_DOUBLE_FAULT - 1] = (uint64_t)(stack + PAGE_SIZE);
+    return 0;
+}
+
+/* must run before anything reads per-CPU data */
+void smp_early_init(void) {
+    cpus[0].id = 0;
+    set_gs_base(&cpus[0]);
+}
+
+uint32_t smp_cpu_id(void) {
+    return this_cpu_local()->id;
+}
+
+uint32_t smp_cpu_count(void) {
+    return cpu_count;
+}
+
+static uint32_t online_mask(void) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (cpus[i].online) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static void flush_local(void) {
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) : : "memory");
+    __atomic_and_fetch(&tlb_pending, ~(1u << this_cpu_local()->id), __ATOMIC_RELEASE);
+}
+
+static void tlb_flush_ipi(void* frame) {
+    this_cpu_local()->ipis++;
+    flush_local();
+}
+
+static void reschedule_ipi(void* frame) {
+    this_cpu_local()->ipis++;
+}
+
+static void ap_timer_irq(void* frame) {
+    profile_tick(frame);
+    sched_tick();
+}
+
+/* returns once every other online CPU has dropped its cached translations; never call with a spinlock held */
+void smp_flush_tlb_others(void) {
+    cpu_local* self = this_cpu_local();
+    uint32_t others = online_mask() & ~(1u << self->id);
+    if (!others) return;
+
+    unsigned long flags = irq_save();
+    /* whoever holds tlb_lock waits on us, so keep answering while we wait for it */
+    while (!spin_trylock(&tlb_lock)) {
+        if (tlb_pending & (1u << self->id)) flush_local();
+        asm volatile("pause");
+    }
+    __atomic_store_n(&tlb_pending, others, __ATOMIC_RELEASE);
+    /* directed, since a broadcast would also reach an AP that timed out half-started */
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (others & (1u << i)) lapic_send_ipi(cpus[i].apic_id, VECTOR_TLB_FLUSH);
+    }
+    while (__atomic_load_n(&tlb_pending, __ATOMIC_ACQUIRE)) asm volatile("pause");
+    tlb_shootdowns++;
+    spin_unlock(&tlb_lock);
+    irq_restore(flags);
+}
+
+void smp_send_reschedule(uint32_t cpu) {
+    if (cpu < SMP_MAX_CPUS && cpus[cpu].online) lapic_send_ipi(cpus[cpu].apic_id, VECTOR_RESCHEDULE);
+}
+
+/* first C code on an application processor, entered from the trampoline with interrupts off */
+static void ap_entry(cpu_local* c) {
+    set_gs_base(c);
+    load_gdt(c);
+    fpu_ap_init();
+    interrupts_load();
+    lapic_ap_init();
+    c->online = 1;
+    sched_ap_start();
+}
+
+static int start_ap(cpu_local* c, trampoline_args* args) {
+    uint8_t* top = (uint8_t*)vmm_alloc_stack(AP_STACK_SIZE);
+    if (!top || setup_tss(c) < 0) return -1;
+    /* the AP takes interrupts on this stack before anything could demand-fault it in */
+    for (uint8_t* p = top - AP_STACK_SIZE; p < top; p += PAGE_SIZE) *(volatile uint8_t*)p = 0;
+
+    c->stack_top = top;
+    args->stack = (uint64_t)top;
+    args->arg = (uint64_t)c;
+    lapic_start_ap(c->apic_id, TRAMPOLINE_ADDR / PAGE_SIZE);
+
+    for (uint32_t ms = 0; ms < AP_START_TIMEOUT_MS && !c->online; ms++) udelay(1000);
+    return c->online ? 0 : -1;
+}
+
+/* hyperthreads of one core share execution units, so the scheduler spreads work across cores first */
+static void set_siblings(void) {
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        cpus[i].siblings = 0;
+        for (uint32_t j = 0; j < cpu_count; j++) {
+            if (cpu_core_id(cpus[j].apic_id) == cpu_core_id(cpus[i].apic_id)) cpus[i].siblings |= 1u << j;
+        }
+    }
+}
+
+/* finds the other processors in the MADT and starts them one at a time; call after timer_init */
+int smp_init(void) {
+    cpu_local* bsp = &cpus[0];
+    if (setup_tss(bsp) < 0) return -1;
+    load_gdt(bsp);
+    idt_set_ist(8, IST_DOUBLE_FAULT);
+    bsp->online = 1;
+    bsp->siblings = 1;
+
+    if (acpi_init() < 0 || lapic_init(acpi_lapic_base()) < 0) return 0;
+    bsp->apic_id = lapic_id();
+    cpu_count_topology();
+    local_register_handler(VECTOR_TIMER, ap_timer_irq);
+    local_register_handler(VECTOR_RESCHEDULE, reschedule_ipi);
+    local_register_handler(VECTOR_TLB_FLUSH, tlb_flush_ipi);
+
+    size_t size = (size_t)(trampoline_end - trampoline_start);
+    uint8_t* dst = (uint8_t*)TRAMPOLINE_ADDR;
+    for (size_t i = 0; i < size; i++) dst[i] = (uint8_t)trampoline_start[i];
+
+    trampoline_args* args = (trampoline_args*)(dst + (trampoline_params - trampoline_start));
+    asm volatile("mov %%cr3, %0" : "=r"(args->cr3));
+    asm volatile("mov %%cr4, %0" : "=r"(args->cr4));
+    asm volatile("mov %%cr0, %0" : "=r"(args->cr0));
+    args->entry = (uint64_t)ap_entry;
+
+    for (uint32_t i = 0; i < acpi_cpu_count() && cpu_count < SMP_MAX_CPUS; i++) {
+        uint32_t apic_id = acpi_cpu_apic_id(i);
+        if (apic_id == bsp->apic_id) continue;
+
+        cpu_local* c = &cpus[cpu_count];
+        c->id = cpu_count;
+        c->apic_id = apic_id;
+        /* a processor that misses its window may still wake later, so the shared parameters stop here */
+        if (start_ap(c, args) < 0) {
+            terminal_write("smp: an application processor did not start\n");
+            break;
+        }
+        cpu_count++;
+    }
+    set_siblings();
+    return 0;
+}
+
+/* mask of the online CPUs, cpu included, that share its physical core */
+uint32_t smp_cpu_siblings(uint32_t cpu) {
+    return cpu < SMP_MAX_CPUS ? cpus[cpu].siblings : 0;
+}
+
+void smp_stats(uint32_t* stats) {
+    uint32_t ipis = 0;
+    for (uint32_t i = 0; i < cpu_count; i++) ipis += cpus[i].ipis;
+    stats[0] = cpu_count;
+    stats[1] = ipis;
+    stats[2] = tlb_shootdowns;
+}
@@ -0,0 +1,42 @@
+typedef unsigned int uint32_t;
+
+/* ticket lock: CPUs are served in the order they took a ticket, so nobody starves */
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+void spin_lock(spinlock* lock) {
+    uint32_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        asm volatile("pause");
+    }
+}
+
+int spin_trylock(spinlock* lock) {
+    uint32_t owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+    uint32_t expected = owner;
+    return __atomic_compare_exchange_n(&lock->next, &expected, owner + 1, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void spin_unlock(spinlock* lock) {
+    __atomic_store_n(&lock->owner, lock->owner + 1, __ATOMIC_RELEASE);
+}
+
+int spin_is_locked(spinlock* lock) {
+    return __atomic_load_n(&lock->owner, __ATOMIC_RELAXED) != __atomic_load_n(&lock->next, __ATOMIC_RELAXED);
+}
+
+/* a lock that interrupt handlers also take must be held with interrupts off, or the CPU deadlocks on itself */
+unsigned long spin_lock_irqsave(spinlock* lock) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags) {
+    spin_unlock(lock);
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
@@ -0,0 +1,487 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define PAGE_SIZE           4096
+#define VECTOR_THRESHOLD    256
+#define SIMD_CHUNK          4096
+#define ERMS_THRESHOLD      2048
+
+#define CPUID_SSE2          (1 << 26)
+#define CPUID_SSE4_2        (1 << 20)
+#define CPUID_AVX           (1 << 28)
+#define CPUID_AVX2          (1 << 5)
+#define CPUID_ERMS          (1 << 9)
+#define CR4_OSXSAVE         (1 << 18)
+#define XCR0_SSE_AVX        0x6
+
+/*
+ * Everything else is built with -mgeneral-regs-only, so vector registers never hold
+ * compiler state and the asm below needs no clobbers for them. Each vector block runs
+ * between kernel_fpu_begin and kernel_fpu_end, at most SIMD_CHUNK bytes at a time.
+ */
+static size_t (*copy_block)(uint8_t* d, const uint8_t* s, size_t n) = 0;
+static size_t (*fill_block)(uint8_t* d, uint64_t pattern, size_t n) = 0;
+static size_t (*strlen_impl)(const char* str);
+static int (*strcmp_impl)(const char* s1, const char* s2);
+static int use_erms = 0;
+static size_t nt_threshold = 0;
+static const char* copy_name = "scalar";
+static const char* strlen_name = "scalar";
+static const char* strcmp_name = "scalar";
+
+static inline void cpuid(uint32_t leaf, uint32_t sub, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    asm volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(sub));
+}
+
+int kernel_fpu_begin(unsigned long* flags);
+void kernel_fpu_end(unsigned long flags);
+uint32_t cpu_cache_size(uint32_t level);
+
+static void copy_scalar(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t quads = n / 8;
+    size_t bytes = n % 8;
+    asm volatile("rep movsq" : "+D"(d), "+S"(s), "+c"(quads) : : "memory");
+    asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(bytes) : : "memory");
+}
+
+static void fill_scalar(uint8_t* d, uint64_t pattern, size_t n) {
+    size_t quads = n / 8;
+    size_t bytes = n % 8;
+    asm volatile("rep stosq" : "+D"(d), "+c"(quads) : "a"(pattern) : "memory");
+    asm volatile("rep stosb" : "+D"(d), "+c"(bytes) : "a"(pattern) : "memory");
+}
+
+/* the block routines move whole 64- or 128-byte blocks and return how many bytes they did */
+static size_t copy_sse2(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t blocks = n / 64;
+    asm volatile(
+        "1:\n\t"
+        "movdqu 0(%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movdqu %%xmm0, 0(%0)\n\t"
+        "movdqu %%xmm1, 16(%0)\n\t"
+        "movdqu %%xmm2, 32(%0)\n\t"
+        "movdqu %%xmm3, 48(%0)\n\t"
+        "add $64, %1\n\t"
+        "add $64, %0\n\t"
+        "dec %2\n\t"
+        "jnz 1b"
+        : "+r"(d), "+r"(s), "+r"(blocks) : : "memory", "cc");
+    return n & ~(size_t)63;
+}
+
+/* streaming stores bypass the cache; d must be 16-byte aligned and the caller fences */
+static size_t copy_nt_sse2(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t blocks = n / 64;
+    asm volatile(
+        "1:\n\t"
+        "movdqu 0(%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movntdq %%xmm0, 0(%0)\n\t"
+        "movntdq %%xmm1, 16(%0)\n\t"
+        "movntdq %%xmm2, 32(%0)\n\t"
+        "movntdq %%xmm3, 48(%0)\n\t"
+        "add $64, %1\n\t"
+        "add $64, %0\n\t"
+        "dec %2\n\t"
+        "jnz 1b"
+        : "+r"(d), "+r"(s), "+r"(blocks) : : "memory", "cc");
+    return n & ~(size_t)63;
+}
+
+static size_t copy_avx2(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t blocks = n / 128;
+    asm volatile(
+        "1:\n\t"
+        "vmovdqu 0(%1), %%ymm0\n\t"
+        "vmovdqu 32(%1), %%ymm1\n\t"
+        "vmovdqu 64(%1), %%ymm2\n\t"
+        "vmovdqu 96(%1), %%ymm3\n\t"
+        "vmovdqu %%ymm0, 0(%0)\n\t"
+        "vmovdqu %%ymm1, 32(%0)\n\t"
+        "vmovdqu %%ymm2, 64(%0)\n\t"
+        "vmovdqu %%ymm3, 96(%0)\n\t"
+        "add $128, %1\n\t"
+        "add $128, %0\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "vzeroupper"
+        : "+r"(d), "+r"(s), "+r"(blocks) : : "memory", "cc");
+    return n & ~(size_t)127;
+}
+
+static size_t fill_sse2(uint8_t* d, uint64_t pattern, size_t n) {
+    size_t blocks = n / 64;
+    asm volatile(
+        "movq %2, %%xmm0\n\t"
+        "punpcklqdq %%xmm0, %%xmm0\n\t"
+        "1:\n\t"
+        "movdqu %%xmm0, 0(%0)\n\t"
+        "movdqu %%xmm0, 16(%0)\n\t"
+        "movdqu %%xmm0, 32(%0)\n\t"
+        "movdqu %%xmm0, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b"
+        : "+r"(d), "+r"(blocks) : "r"(pattern) : "memory", "cc");
+    return n & ~(size_t)63;
+}
+
+static size_t fill_avx2(uint8_t* d, uint64_t pattern, size_t n) {
+    size_t blocks = n / 128;
+    asm volatile(
+        "vmovq %2, %%xmm0\n\t"
+        "vpbroadcastq %%xmm0, %%ymm0\n\t"
+        "1:\n\t"
+        "vmovdqu %%ymm0, 0(%0)\n\t"
+        "vmovdqu %%ymm0, 32(%0)\n\t"
+        "vmovdqu %%ymm0, 64(%0)\n\t"
+        "vmovdqu %%ymm0, 96(%0)\n\t"
+        "add $128, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "vzeroupper"
+        : "+r"(d), "+r"(blocks) : "r"(pattern) : "memory", "cc");
+    return n & ~(size_t)127;
+}
+
+static size_t strlen_scalar(const char* str) {
+    size_t len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+/*
+ * Aligned loads never cross into the next page, so reading past the terminator is safe.
+ * Each section scans up to SIMD_CHUNK bytes and stops short of end only at a terminator.
+ */
+static size_t strlen_sse2(const char* str) {
+    const char* p = str;
+    while ((uint64_t)p & 15) {
+        if (!*p) return (size_t)(p - str);
+        p++;
+    }
+    while (1) {
+        unsigned long flags;
+        if (!kernel_fpu_begin(&flags)) return (size_t)(p - str) + strlen_scalar(p);
+        const char* end = p + SIMD_CHUNK;
+        uint32_t mask;
+        asm volatile(
+            "pxor %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movdqa (%0), %%xmm1\n\t"
+            "pcmpeqb %%xmm0, %%xmm1\n\t"
+            "pmovmskb %%xmm1, %1\n\t"
+            "test %1, %1\n\t"
+            "jnz 2f\n\t"
+            "add $16, %0\n\t"
+            "cmp %2, %0\n\t"
+            "jb 1b\n\t"
+            "2:"
+            : "+r"(p), "=r"(mask) : "r"(end) : "memory", "cc");
+        kernel_fpu_end(flags);
+        if (p != end) return (size_t)(p - str) + __builtin_ctz(mask);
+    }
+}
+
+static size_t strlen_sse42(const char* str) {
+    const char* p = str;
+    while ((uint64_t)p & 15) {
+        if (!*p) return (size_t)(p - str);
+        p++;
+    }
+    while (1) {
+        unsigned long flags;
+        if (!kernel_fpu_begin(&flags)) return (size_t)(p - str) + strlen_scalar(p);
+        const char* end = p + SIMD_CHUNK;
+        uint64_t index;
+        /* equal-each against an empty string: ECX is the index of the first NUL, ZF says there was one */
+        asm volatile(
+            "pxor %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "pcmpistri $0x08, (%0), %%xmm0\n\t"
+            "jz 2f\n\t"
+            "add $16, %0\n\t"
+            "cmp %2, %0\n\t"
+            "jb 1b\n\t"
+            "2:"
+            : "+r"(p), "=c"(index) : "r"(end) : "memory", "cc");
+        kernel_fpu_end(flags);
+        if (p != end) return (size_t)(p - str) + (uint32_t)index;
+    }
+}
+
+static size_t strlen_avx2(const char* str) {
+    const char* p = str;
+    while ((uint64_t)p & 31) {
+        if (!*p) return (size_t)(p - str);
+        p++;
+    }
+    while (1) {
+        unsigned long flags;
+        if (!kernel_fpu_begin(&flags)) return (size_t)(p - str) + strlen_scalar(p);
+        const char* end = p + SIMD_CHUNK;
+        uint32_t mask;
+        asm volatile(
+            "vpxor %%ymm0, %%ymm0, %%ymm0\n\t"
+            "1:\n\t"
+            "vpcmpeqb (%0), %%ymm0, %%ymm1\n\t"
+            "vpmovmskb %%ymm1, %1\n\t"
+            "test %1, %1\n\t"
+            "jnz 2f\n\t"
+            "add $32, %0\n\t"
+            "cmp %2, %0\n\t"
+            "jb 1b\n\t"
+            "2:\n\t"
+            "vzeroupper"
+            : "+r"(p), "=r"(mask) : "r"(end) : "memory", "cc");
+        kernel_fpu_end(flags);
+        if (p != end) return (size_t)(p - str) + __builtin_ctz(mask);
+    }
+}
+
+static int strcmp_scalar(const char* s1, const char* s2) {
+    while (*s1 && (*s1 == *s2)) { s1++; s2++; }
+    return *(unsigned char*)s1 - *(unsigned char*)s2;
+}
+
+/* a 16-byte load is only safe when neither string is within 16 bytes of a page end; the section restarts every SIMD_CHUNK bytes */
+static inline int near_page_end(const uint8_t* p) {
+    return ((uint64_t)p & (PAGE_SIZE - 1)) > PAGE_SIZE - 16;
+}
+
+static int strcmp_sse2(const char* s1, const char* s2) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    unsigned long flags;
+    if (!kernel_fpu_begin(&flags)) return strcmp_scalar(s1, s2);
+
+    const uint8_t* chunk_end = a + SIMD_CHUNK;
+    while (1) {
+        if (a >= chunk_end) {
+            kernel_fpu_end(flags);
+            if (!kernel_fpu_begin(&flags)) return strcmp_scalar((const char*)a, (const char*)b);
+            chunk_end = a + SIMD_CHUNK;
+        }
+        if (near_page_end(a) || near_page_end(b)) {
+            if (*a != *b || !*a) break;
+            a++; b++;
+            continue;
+        }
+        uint32_t equal, zero;
+        asm volatile(
+            "movdqu (%2), %%xmm0\n\t"
+            "movdqu (%3), %%xmm1\n\t"
+            "pxor %%xmm2, %%xmm2\n\t"
+            "pcmpeqb %%xmm0, %%xmm2\n\t"
+            "pcmpeqb %%xmm0, %%xmm1\n\t"
+            "pmovmskb %%xmm1, %0\n\t"
+            "pmovmskb %%xmm2, %1"
+            : "=r"(equal), "=r"(zero) : "r"(a), "r"(b) : "memory");
+        uint32_t stop = (~equal & 0xFFFF) | zero;
+        if (stop) {
+            uint32_t i = __builtin_ctz(stop);
+            a += i; b += i;
+            break;
+        }
+        a += 16; b += 16;
+    }
+    kernel_fpu_end(flags);
+    return *a - *b;
+}
+
+/* equal-each, negative polarity: CF is set at the first mismatch or lone terminator, ZF at a shared end */
+static int strcmp_sse42(const char* s1, const char* s2) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    unsigned long flags;
+    if (!kernel_fpu_begin(&flags)) return strcmp_scalar(s1, s2);
+
+    const uint8_t* chunk_end = a + SIMD_CHUNK;
+    while (1) {
+        if (a >= chunk_end) {
+            kernel_fpu_end(flags);
+            if (!kernel_fpu_begin(&flags)) return strcmp_scalar((const char*)a, (const char*)b);
+            chunk_end = a + SIMD_CHUNK;
+        }
+        if (near_page_end(a) || near_page_end(b)) {
+            if (*a != *b || !*a) break;
+            a++; b++;
+            continue;
+        }
+        uint8_t differ, ended;
+        uint64_t index;
+        asm volatile(
+            "movdqu (%3), %%xmm0\n\t"
+            "pcmpistri $0x18, (%4), %%xmm0\n\t"
+            "setc %0\n\t"
+            "setz %1"
+            : "=q"(differ), "=q"(ended), "=c"(index) : "r"(a), "r"(b) : "memory", "cc");
+        if (differ) {
+            a += (uint32_t)index; b += (uint32_t)index;
+            break;
+        }
+        if (ended) {
+            kernel_fpu_end(flags);
+            return 0;
+        }
+        a += 16; b += 16;
+    }
+    kernel_fpu_end(flags);
+    return *a - *b;
+}
+
+static inline uint64_t xgetbv(uint32_t index) {
+    uint32_t lo, hi;
+    asm volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(index));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* AVX registers only work once fpu_init has turned on XSAVE and the YMM state in XCR0 */
+static int avx_enabled(uint32_t ecx1) {
+    unsigned long cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    if (!(ecx1 & CPUID_AVX) || !(cr4 & CR4_OSXSAVE)) return 0;
+    return (xgetbv(0) & XCR0_SSE_AVX) == XCR0_SSE_AVX;
+}
+
+/* picks each routine once from CPUID; call after fpu_init */
+void string_init(void) {
+    uint32_t a, b, c, d, max, ecx1, edx1, ebx7 = 0;
+    cpuid(0, 0, &max, &b, &c, &d);
+    cpuid(1, 0, &a, &b, &ecx1, &edx1);
+    if (max >= 7) cpuid(7, 0, &a, &ebx7, &c, &d);
+
+    int avx2 = (ebx7 & CPUID_AVX2) && avx_enabled(ecx1);
+    use_erms = (ebx7 & CPUID_ERMS) != 0;
+
+    if (avx2) {
+        copy_block = copy_avx2;
+        fill_block = fill_avx2;
+        strlen_impl = strlen_avx2;
+        copy_name = strlen_name = "avx2";
+    } else if (edx1 & CPUID_SSE2) {
+        copy_block = copy_sse2;
+        fill_block = fill_sse2;
+        strlen_impl = strlen_sse2;
+        copy_name = strlen_name = "sse2";
+    }
+    /* a copy larger than the last-level cache would only evict everything else on its way through */
+    if (edx1 & CPUID_SSE2) {
+        nt_threshold = cpu_cache_size(3);
+        if (!nt_threshold) nt_threshold = cpu_cache_size(2);
+    }
+    if (ecx1 & CPUID_SSE4_2) {
+        strcmp_impl = strcmp_sse42;
+        strcmp_name = "sse4.2";
+        if (!avx2) {
+            strlen_impl = strlen_sse42;
+            strlen_name = "sse4.2";
+        }
+    } else if (edx1 & CPUID_SSE2) {
+        strcmp_impl = strcmp_sse2;
+        strcmp_name = "sse2";
+    }
+}
+
+void string_impls(const char** copy, const char** len, const char** cmp, int* erms) {
+    *copy = copy_name;
+    *len = strlen_name;
+    *cmp = strcmp_name;
+    *erms = use_erms;
+}
+
+size_t string_nt_threshold(void) {
+    return nt_threshold;
+}
+
+static void copy_streaming(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t head = (16 - ((uint64_t)d & 15)) & 15;
+    copy_scalar(d, s, head);
+    d += head; s += head; n -= head;
+    while (n >= VECTOR_THRESHOLD) {
+        unsigned long flags;
+        if (!kernel_fpu_begin(&flags)) break;
+        size_t done = copy_nt_sse2(d, s, n < SIMD_CHUNK ? n : SIMD_CHUNK);
+        kernel_fpu_end(flags);
+        d += done; s += done; n -= done;
+    }
+    asm volatile("sfence" : : : "memory");
+    copy_scalar(d, s, n);
+}
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (nt_threshold && n >= nt_threshold) {
+        copy_streaming(d, s, n);
+        return dest;
+    }
+    if (use_erms && n >= ERMS_THRESHOLD) {
+        asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+        return dest;
+    }
+    while (copy_block && n >= VECTOR_THRESHOLD) {
+        unsigned long flags;
+        if (!kernel_fpu_begin(&flags)) break;
+        size_t done = copy_block(d, s, n < SIMD_CHUNK ? n : SIMD_CHUNK);
+        kernel_fpu_end(flags);
+        d += done; s += done; n -= done;
+    }
+    copy_scalar(d, s, n);
+    return dest;
+}
+
+void* memset(void* dest, int c, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    uint64_t pattern = (uint8_t)c * 0x0101010101010101ULL;
+
+    if (use_erms && n >= ERMS_THRESHOLD) {
+        asm volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(pattern) : "memory");
+        return dest;
+    }
+    while (fill_block && n >= VECTOR_THRESHOLD) {
+        unsigned long flags;
+        if (!kernel_fpu_begin(&flags)) break;
+        size_t done = fill_block(d, pattern, n < SIMD_CHUNK ? n : SIMD_CHUNK);
+        kernel_fpu_end(flags);
+        d += done; n -= done;
+    }
+    fill_scalar(d, pattern, n);
+    return dest;
+}
+
+int memcmp(const void* s1, const void* s2, size_t n) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return a[i] - b[i];
+    }
+    return 0;
+}
+
+size_t strlen(const char* str) {
+    return strlen_impl ? strlen_impl(str) : strlen_scalar(str);
+}
+
+int strcmp(const char* s1, const char* s2) {
+    return strcmp_impl ? strcmp_impl(s1, s2) : strcmp_scalar(s1, s2);
+}
+
+int strncmp(const char* s1, const char* s2, size_t n) {
+    while (n && *s1 && (*s1 == *s2)) { s1++; s2++; n--; }
+    if (n == 0) return 0;
+    return *(unsigned char*)s1 - *(unsigned char*)s2;
+}
+
+void strcpy(char* dest, const char* src) {
+    memcpy(dest, src, strlen(src) + 1);
+}
@@ -0,0 +1,196 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define PIT_FREQUENCY       1193182
+#define PIT_CHANNEL0        0x40
+#define PIT_CHANNEL2        0x42
+#define PIT_COMMAND         0x43
+#define PIT_GATE_PORT       0x61
+#define TIMER_HZ            1000
+#define TIMER_IRQ           0
+#define CALIBRATE_MS        10
+#define CALIBRATE_RUNS      3
+#define NS_SHIFT            22
+
+typedef void (*irq_handler)(void* frame);
+
+void irq_register_handler(uint8_t irq, irq_handler handler);
+void sched_tick(void);
+void profile_tick(void* frame);
+void sched_sleep_until(uint64_t deadline_ns);
+
+static volatile uint64_t timer_ticks_count = 0;
+static uint64_t tsc_hz = 0;
+static uint32_t tsc_khz = 0;
+static uint32_t tsc_per_us_q10 = 0;
+static uint32_t tsc_ns_mult = 0;
+static uint64_t tsc_boot = 0;
+static int tsc_available = 0;
+static int timer_initialized = 0;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline unsigned long save_flags_cli(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void restore_flags(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+uint64_t udiv64(uint64_t dividend, uint64_t divisor) {
+    return divisor ? dividend / divisor : 0;
+}
+
+static void timer_irq(void* frame) {
+    timer_ticks_count++;
+    profile_tick(frame);
+    sched_tick();
+}
+
+static int cpu_has_tsc(void) {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    return (edx & (1 << 4)) != 0;
+}
+
+static uint64_t calibrate_tsc_once(void) {
+    uint32_t count = PIT_FREQUENCY / (1000 / CALIBRATE_MS);
+
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+
+    uint64_t start = rdtsc();
+    uint32_t spins = 0;
+    while (!(inb(PIT_GATE_PORT) & 0x20)) {
+        if (++spins > 50000000) return 0;
+    }
+    uint64_t end = rdtsc();
+
+    outb(PIT_GATE_PORT, inb(PIT_GATE_PORT) & ~0x01);
+    return udiv64((end - start) * PIT_FREQUENCY, count);
+}
+
+static void calibrate_tsc(void) {
+    if (!cpu_has_tsc()) return;
+
+    for (int i = 0; i < CALIBRATE_RUNS; i++) {
+        uint64_t hz = calibrate_tsc_once();
+        if (hz && (tsc_hz == 0 || hz < tsc_hz)) {
+            tsc_hz = hz;
+        }
+    }
+    if (tsc_hz < 1000000) {
+        tsc_hz = 0;
+        return;
+    }
+
+    tsc_khz = (uint32_t)udiv64(tsc_hz, 1000);
+    tsc_per_us_q10 = (uint32_t)udiv64((uint64_t)tsc_khz << 10, 1000);
+    tsc_ns_mult = (uint32_t)udiv64((uint64_t)1000000000 << NS_SHIFT, tsc_hz);
+    tsc_boot = rdtsc();
+    tsc_available = 1;
+}
+
+static void pit_start_periodic(void) {
+    uint32_t divisor = PIT_FREQUENCY / TIMER_HZ;
+
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+}
+
+uint64_t timer_ticks(void) {
+    unsigned long flags = save_flags_cli();
+    uint64_t ticks = timer_ticks_count;
+    restore_flags(flags);
+    return ticks;
+}
+
+uint32_t timer_hz(void) {
+    return TIMER_HZ;
+}
+
+uint32_t timer_tsc_khz(void) {
+    return tsc_khz;
+}
+
+uint64_t ktime_ns(void) {
+    if (!tsc_available) {
+        return timer_ticks() * (1000000000 / TIMER_HZ);
+    }
+
+    uint64_t cycles = rdtsc() - tsc_boot;
+    uint64_t hi = (cycles >> 32) * tsc_ns_mult;
+    uint64_t lo = (cycles & 0xFFFFFFFF) * tsc_ns_mult;
+    return (hi << (32 - NS_SHIFT)) + (lo >> NS_SHIFT);
+}
+
+uint32_t timer_uptime_seconds(void) {
+    return (uint32_t)udiv64(timer_ticks(), TIMER_HZ);
+}
+
+void udelay(uint32_t us) {
+    if (tsc_available) {
+        uint64_t start = rdtsc();
+        uint64_t cycles = ((uint64_t)us * tsc_per_us_q10) >> 10;
+        while (rdtsc() - start < cycles) {
+            asm volatile("pause");
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < us; i++) {
+        inb(0x80);
+    }
+}
+
+void mdelay(uint32_t ms) {
+    while (ms--) {
+        udelay(1000);
+    }
+}
+
+void msleep(uint32_t ms) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0" : "=r"(flags));
+
+    if (!timer_initialized || !(flags & 0x200)) {
+        mdelay(ms);
+        return;
+    }
+
+    sched_sleep_until(ktime_ns() + (uint64_t)ms * 1000000);
+}
+
+int timer_init(void) {
+    if (timer_initialized) {
+        return 0;
+    }
+
+    calibrate_tsc();
+    pit_start_periodic();
+    irq_register_handler(TIMER_IRQ, timer_irq);
+    timer_initialized = 1;
+    return 0;
+}
@@ -0,0 +1,165 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define SMP_MAX_CPUS        16
+#define TRACE_RING_SIZE     1024
+#define TRACE_RING_MASK     (TRACE_RING_SIZE - 1)
+#define TRACE_BOOT_MAX      32
+#define TRACE_EVENT_COUNT   11
+#define TRACE_BOOT          1
+
+typedef struct {
+    uint64_t tsc;
+    uint32_t event;
+    uint32_t cpu;
+    uint64_t arg0;
+    uint64_t arg1;
+} trace_entry;
+
+/* written only by its own CPU with interrupts off; readers copy and then drop what was overwritten meanwhile */
+typedef struct {
+    volatile uint64_t head;
+    uint64_t cleared;
+    trace_entry entries[TRACE_RING_SIZE];
+} __attribute__((aligned(64))) trace_ring;
+
+typedef struct {
+    const char* name;
+    uint64_t tsc;
+} boot_phase;
+
+uint32_t timer_tsc_khz(void);
+
+static trace_ring rings[SMP_MAX_CPUS];
+static boot_phase boot_phases[TRACE_BOOT_MAX];
+static uint32_t boot_count = 0;
+static volatile int trace_on = 1;
+
+static const char* event_names[TRACE_EVENT_COUNT] = {
+    "none", "boot", "cmd_begin", "cmd_end", "ata_read", "ata_write",
+    "ata_done", "net_irq", "net_tx", "net_rx", "kbd_irq"
+};
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint32_t this_cpu(void) {
+    uint32_t id;
+    asm volatile("movl %%gs:8, %0" : "=r"(id));
+    return id;
+}
+
+/* callable from any context once smp_early_init has set up %gs */
+void trace_event(uint32_t event, uint64_t arg0, uint64_t arg1) {
+    if (!trace_on) return;
+    unsigned long flags = irq_save();
+    uint32_t cpu = this_cpu();
+    trace_ring* r = &rings[cpu];
+    uint64_t head = r->head;
+    trace_entry* e = &r->entries[head & TRACE_RING_MASK];
+    e->tsc = rdtsc();
+    e->event = event;
+    e->cpu = cpu;
+    e->arg0 = arg0;
+    e->arg1 = arg1;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+/* boot phases also go in a table of their own so the timeline survives the rings wrapping */
+void trace_boot_phase(const char* name) {
+    if (boot_count < TRACE_BOOT_MAX) {
+        boot_phases[boot_count].name = name;
+        boot_phases[boot_count].tsc = rdtsc();
+    }
+    trace_event(TRACE_BOOT, (uint64_t)name, boot_count);
+    boot_count++;
+}
+
+/* up to 8 characters of s packed little-endian, so a command name fits in one argument */
+uint64_t trace_pack_string(const char* s) {
+    uint64_t packed = 0;
+    for (int i = 0; i < 8 && s[i]; i++) packed |= (uint64_t)(uint8_t)s[i] << (i * 8);
+    return packed;
+}
+
+/* copies the newest entries of cpu's ring, at most max of them, oldest first */
+uint32_t trace_read(uint32_t cpu, trace_entry* out, uint32_t max) {
+    if (cpu >= SMP_MAX_CPUS) return 0;
+    trace_ring* r = &rings[cpu];
+    uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint64_t start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    if (start < r->cleared) start = r->cleared;
+    if (head - start > max) start = head - max;
+
+    for (uint64_t i = start; i < head; i++) out[i - start] = r->entries[i & TRACE_RING_MASK];
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    /* the writer may have lapped the oldest slots while they were copied, or be writing the next one */
+    uint64_t now = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint64_t valid = now + 1 > TRACE_RING_SIZE ? now + 1 - TRACE_RING_SIZE : 0;
+    if (valid <= start) return (uint32_t)(head - start);
+    if (valid >= head) return 0;
+    uint32_t skip = (uint32_t)(valid - start);
+    for (uint64_t i = 0; i < head - valid; i++) out[i] = out[i + skip];
+    return (uint32_t)(head - valid);
+}
+
+uint32_t trace_boot_timeline(const char** names, uint64_t* tsc, uint32_t max) {
+    uint32_t n = boot_count < TRACE_BOOT_MAX ? boot_count : TRACE_BOOT_MAX;
+    if (n > max) n = max;
+    for (uint32_t i = 0; i < n; i++) {
+        names[i] = boot_phases[i].name;
+        tsc[i] = boot_phases[i].tsc;
+    }
+    return n;
+}
+
+const char* trace_event_name(uint32_t event) {
+    return event < TRACE_EVENT_COUNT ? event_names[event] : "?";
+}
+
+/* split so a long interval does not overflow the multiplication */
+uint64_t trace_cycles_to_ns(uint64_t cycles) {
+    uint64_t khz = timer_tsc_khz();
+    if (!khz) return 0;
+    return cycles / khz * 1000000 + cycles % khz * 1000000 / khz;
+}
+
+void trace_set_enabled(int enable) {
+    trace_on = enable;
+}
+
+/* readers skip everything recorded so far; the boot timeline is kept */
+void trace_clear(void) {
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) rings[i].cleared = __atomic_load_n(&rings[i].head, __ATOMIC_ACQUIRE);
+}
+
+/* whether tracepoints were compiled in, whether recording is on, events recorded, ring size */
+void trace_stats(uint32_t* stats) {
+#ifdef CONFIG_TRACE
+    stats[0] = 1;
+#else
+    stats[0] = 0;
+#endif
+    stats[1] = trace_on;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) total += rings[i].head;
+    stats[2] = total > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)total;
+    stats[3] = TRACE_RING_SIZE;
+}
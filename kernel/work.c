@@ -0,0 +1,223 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define SMP_MAX_CPUS        16
+#define WORK_DEQUE_SIZE     256
+#define WORK_DEQUE_MASK     (WORK_DEQUE_SIZE - 1)
+#define WORKER_PRIO         6
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef struct {
+    volatile int done;
+    wait_queue wait;
+} completion;
+
+typedef struct work {
+    void (*fn)(void* arg);
+    void* arg;
+    completion done;
+} work;
+
+/*
+ * Chase-Lev deque: the owning CPU pushes and pops at bottom, other CPUs steal from top.
+ * Owner operations run with interrupts off, so whichever thread is on the CPU owns its deque.
+ */
+typedef struct {
+    volatile long top;
+    volatile long bottom;
+    work* volatile items[WORK_DEQUE_SIZE];
+} work_deque;
+
+int thread_create(const char* name, void (*entry)(void* arg), void* arg, uint32_t prio);
+int thread_should_stop(void);
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns);
+void wait_queue_wake(wait_queue* wq);
+void complete(completion* c);
+void wait_for_completion(completion* c);
+uint32_t smp_cpu_count(void);
+
+static work_deque deques[SMP_MAX_CPUS];
+static wait_queue worker_wait;
+static uint32_t worker_count = 0;
+static uint32_t work_submitted = 0;
+static uint32_t work_executed = 0;
+static uint32_t work_steals = 0;
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint32_t this_cpu(void) {
+    uint32_t id;
+    asm volatile("movl %%gs:8, %0" : "=r"(id));
+    return id;
+}
+
+static int deque_push(work_deque* d, work* w) {
+    long b = d->bottom;
+    long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    if (b - t >= WORK_DEQUE_SIZE) return -1;
+    d->items[b & WORK_DEQUE_MASK] = w;
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static work* deque_pop(work_deque* d) {
+    long b = d->bottom - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    work* w = d->items[b & WORK_DEQUE_MASK];
+    if (t == b) {
+        /* the last item: a thief may be taking it at the same moment */
+        if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) w = 0;
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return w;
+}
+
+/* returns 1 with *out set, 0 when empty, -1 when another CPU won the race for the top item */
+static int deque_steal(work_deque* d, work** out) {
+    long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) return 0;
+
+    work* w = d->items[t & WORK_DEQUE_MASK];
+    if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return -1;
+    *out = w;
+    return 1;
+}
+
+static int work_available(void) {
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (__atomic_load_n(&deques[i].top, __ATOMIC_RELAXED) < __atomic_load_n(&deques[i].bottom, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* this CPU's newest item first, then the oldest item of each other CPU in turn */
+static work* work_take(void) {
+    unsigned long flags = irq_save();
+    uint32_t self = this_cpu();
+    work* w = deque_pop(&deques[self]);
+    irq_restore(flags);
+    if (w) return w;
+
+    int contended;
+    do {
+        contended = 0;
+        for (uint32_t i = 1; i < SMP_MAX_CPUS; i++) {
+            int rc = deque_steal(&deques[(self + i) % SMP_MAX_CPUS], &w);
+            if (rc > 0) {
+                __atomic_fetch_add(&work_steals, 1, __ATOMIC_RELAXED);
+                return w;
+            }
+            if (rc < 0) contended = 1;
+        }
+    } while (contended);
+    return 0;
+}
+
+/* complete() is the last touch of w: a joiner may free it as soon as that returns */
+static void work_run(work* w) {
+    w->fn(w->arg);
+    __atomic_fetch_add(&work_executed, 1, __ATOMIC_RELAXED);
+    complete(&w->done);
+}
+
+void work_init(work* w, void (*fn)(void* arg), void* arg) {
+    w->fn = fn;
+    w->arg = arg;
+    w->done.done = 1;
+    w->done.wait.head = 0;
+    w->done.wait.pending = 0;
+}
+
+/*
+ * Queues w on this CPU; safe from interrupt handlers. Returns -1 when w is still queued
+ * or running, and -2 when the deque is full; only after -2 may the caller run it directly.
+ * done stays clear from here until the run's complete(), so no run is ever marked
+ * finished on behalf of a later submission.
+ */
+int work_submit(work* w) {
+    int finished = 1;
+    if (!__atomic_compare_exchange_n(&w->done.done, &finished, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return -1;
+
+    unsigned long flags = irq_save();
+    int rc = deque_push(&deques[this_cpu()], w);
+    irq_restore(flags);
+    if (rc < 0) {
+        __atomic_store_n(&w->done.done, 1, __ATOMIC_RELEASE);
+        return -2;
+    }
+    __atomic_fetch_add(&work_submitted, 1, __ATOMIC_RELAXED);
+    if (worker_count) wait_queue_wake(&worker_wait);
+    return 0;
+}
+
+/* helps with queued work, w's included, until w has finished; call from thread context */
+void work_join(work* w) {
+    while (!w->done.done) {
+        work* other = work_take();
+        if (!other) break;
+        work_run(other);
+    }
+    wait_for_completion(&w->done);
+}
+
+static void worker_loop(void* arg) {
+    while (!thread_should_stop()) {
+        work* w = work_take();
+        if (w) {
+            work_run(w);
+            continue;
+        }
+        unsigned long flags = irq_save();
+        if (!work_available()) wait_queue_sleep(&worker_wait, 0);
+        irq_restore(flags);
+    }
+}
+
+/* called by each CPU's idle thread before it halts */
+void work_idle(void) {
+    if (worker_count && work_available()) wait_queue_wake(&worker_wait);
+}
+
+/* one worker thread per online CPU; call after smp_init */
+int workqueue_init(void) {
+    if (worker_count) return 0;
+    uint32_t cpus = smp_cpu_count();
+    for (uint32_t i = 0; i < cpus; i++) {
+        if (thread_create("kworker", worker_loop, 0, WORKER_PRIO) >= 0) worker_count++;
+    }
+    return worker_count ? 0 : -1;
+}
+
+void work_stats(uint32_t* stats) {
+    stats[0] = worker_count;
+    stats[1] = work_submitted;
+    stats[2] = work_executed;
+    stats[3] = work_steals;
+}
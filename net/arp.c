@@ -0,0 +1,281 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define ARP_HASH_SIZE       64
+#define ARP_MAX_ENTRIES     128
+#define ARP_QUEUE_LEN       4
+#define ARP_MAX_TRIES       3
+#define ARP_TIMEOUT_NS      60000000000UL
+#define ARP_RETRY_NS        1000000000UL
+#define ARP_TICK_NS         100000000UL
+
+#define ARP_FREE            0
+#define ARP_PENDING         1
+#define ARP_RESOLVED        2
+
+#define ARP_OP_REQUEST      1
+#define ARP_OP_REPLY        2
+#define ARP_PACKET_LEN      28
+#define ETHERTYPE_IPV4      0x0800
+#define ETHERTYPE_ARP       0x0806
+#define IP_BROADCAST        0xFFFFFFFF
+
+typedef struct pbuf {
+    struct pbuf* next;
+    uint8_t* payload;
+    uint16_t len;
+    uint16_t tot_len;
+    uint16_t refcount;
+    uint16_t flags;
+    uint8_t* buffer;
+} pbuf;
+
+typedef struct {
+    uint16_t htype;
+    uint16_t ptype;
+    uint8_t hlen;
+    uint8_t plen;
+    uint16_t op;
+    uint8_t sha[6];
+    uint32_t spa;
+    uint8_t tha[6];
+    uint32_t tpa;
+} __attribute__((packed)) arp_packet;
+
+typedef struct arp_entry {
+    uint32_t ip;
+    uint8_t mac[6];
+    uint8_t state;
+    uint8_t tries;
+    uint64_t stamp;
+    pbuf* queue[ARP_QUEUE_LEN];
+    uint32_t queued;
+    struct arp_entry* hash_next;
+} arp_entry;
+
+pbuf* pbuf_alloc(uint16_t len);
+void pbuf_free(pbuf* p);
+int ethernet_output(pbuf* p, const uint8_t* dest_mac, uint16_t ethertype);
+void ethernet_get_mac(uint8_t* mac);
+uint64_t ktime_ns(void);
+uint32_t ip_local_addr(void);
+void net_lock(void);
+void net_unlock(void);
+
+static const uint8_t broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static arp_entry entries[ARP_MAX_ENTRIES];
+static arp_entry* buckets[ARP_HASH_SIZE];
+static uint64_t next_tick = 0;
+static uint32_t requests_sent = 0;
+static uint32_t replies_sent = 0;
+static uint32_t resolve_failures = 0;
+static uint32_t queue_drops = 0;
+
+static inline uint16_t htons(uint16_t v) { return __builtin_bswap16(v); }
+static inline uint32_t htonl(uint32_t v) { return __builtin_bswap32(v); }
+static inline uint32_t ntohl(uint32_t v) { return __builtin_bswap32(v); }
+
+static uint32_t hash_ip(uint32_t ip) {
+    return (ip * 0x9E3779B1u) >> 26;
+}
+
+static arp_entry* lookup(uint32_t ip) {
+    arp_entry* e = buckets[hash_ip(ip)];
+    while (e && e->ip != ip) e = e->hash_next;
+    return e;
+}
+
+static void drop_queue(arp_entry* e) {
+    for (uint32_t i = 0; i < e->queued; i++) pbuf_free(e->queue[i]);
+    e->queued = 0;
+}
+
+static void entry_release(arp_entry* e) {
+    arp_entry** link = &buckets[hash_ip(e->ip)];
+    while (*link && *link != e) link = &(*link)->hash_next;
+    if (*link) *link = e->hash_next;
+    drop_queue(e);
+    e->state = ARP_FREE;
+    e->hash_next = 0;
+}
+
+/* takes a free slot, otherwise recycles the entry that was touched longest ago */
+static arp_entry* entry_create(uint32_t ip) {
+    arp_entry* victim = 0;
+    for (uint32_t i = 0; i < ARP_MAX_ENTRIES; i++) {
+        if (entries[i].state == ARP_FREE) {
+            victim = &entries[i];
+            break;
+        }
+        if (!victim || entries[i].stamp < victim->stamp) victim = &entries[i];
+    }
+    if (victim->state != ARP_FREE) entry_release(victim);
+
+    uint32_t bucket = hash_ip(ip);
+    victim->ip = ip;
+    victim->tries = 0;
+    victim->queued = 0;
+    victim->hash_next = buckets[bucket];
+    buckets[bucket] = victim;
+    return victim;
+}
+
+static int arp_send(uint16_t op, const uint8_t* dest_mac, const uint8_t* target_mac, uint32_t target_ip) {
+    pbuf* p = pbuf_alloc(ARP_PACKET_LEN);
+    if (!p) return -1;
+
+    arp_packet* a = (arp_packet*)p->payload;
+    a->htype = htons(1);
+    a->ptype = htons(ETHERTYPE_IPV4);
+    a->hlen = 6;
+    a->plen = 4;
+    a->op = htons(op);
+    ethernet_get_mac(a->sha);
+    a->spa = htonl(ip_local_addr());
+    for (int i = 0; i < 6; i++) a->tha[i] = target_mac[i];
+    a->tpa = htonl(target_ip);
+    return ethernet_output(p, dest_mac, ETHERTYPE_ARP);
+}
+
+static void arp_request(arp_entry* e) {
+    static const uint8_t zero_mac[6] = {0};
+    e->tries++;
+    e->stamp = ktime_ns();
+    requests_sent++;
+    arp_send(ARP_OP_REQUEST, broadcast_mac, zero_mac, e->ip);
+}
+
+/* records a mapping and releases anything that was waiting on it */
+static void arp_update(arp_entry* e, const uint8_t* mac) {
+    for (int i = 0; i < 6; i++) e->mac[i] = mac[i];
+    e->state = ARP_RESOLVED;
+    e->stamp = ktime_ns();
+    e->tries = 0;
+
+    for (uint32_t i = 0; i < e->queued; i++) ethernet_output(e->queue[i], e->mac, ETHERTYPE_IPV4);
+    e->queued = 0;
+}
+
+/* p starts at the ARP header; requests for our address are answered in place */
+void arp_input(pbuf* p) {
+    if (p->len < ARP_PACKET_LEN) {
+        pbuf_free(p);
+        return;
+    }
+
+    arp_packet* a = (arp_packet*)p->payload;
+    if (a->htype != htons(1) || a->ptype != htons(ETHERTYPE_IPV4) || a->hlen != 6 || a->plen != 4) {
+        pbuf_free(p);
+        return;
+    }
+
+    uint32_t local = ip_local_addr();
+    uint32_t sender = ntohl(a->spa);
+    uint32_t target = ntohl(a->tpa);
+    arp_entry* e = lookup(sender);
+
+    /* RFC 826: refresh a known sender, learn a new one only when it is talking to us */
+    if (e) arp_update(e, a->sha);
+    else if (target == local && sender) arp_update(entry_create(sender), a->sha);
+
+    if (a->op == htons(ARP_OP_REQUEST) && target == local) {
+        uint8_t dest[6];
+        for (int i = 0; i < 6; i++) {
+            dest[i] = a->sha[i];
+            a->tha[i] = a->sha[i];
+        }
+        ethernet_get_mac(a->sha);
+        a->tpa = a->spa;
+        a->spa = htonl(local);
+        a->op = htons(ARP_OP_REPLY);
+        p->len = ARP_PACKET_LEN;
+        p->tot_len = ARP_PACKET_LEN;
+        replies_sent++;
+        ethernet_output(p, dest, ETHERTYPE_ARP);
+        return;
+    }
+    pbuf_free(p);
+}
+
+/* sends an IPv4 packet to next_hop, parking it behind an ARP request when the address is unknown */
+int arp_output(pbuf* p, uint32_t next_hop) {
+    if (next_hop == IP_BROADCAST) return ethernet_output(p, broadcast_mac, ETHERTYPE_IPV4);
+
+    arp_entry* e = lookup(next_hop);
+    if (e && e->state == ARP_RESOLVED) return ethernet_output(p, e->mac, ETHERTYPE_IPV4);
+
+    int fresh = !e;
+    if (fresh) {
+        e = entry_create(next_hop);
+        e->state = ARP_PENDING;
+    }
+    if (e->queued == ARP_QUEUE_LEN) {
+        pbuf_free(e->queue[0]);
+        for (uint32_t i = 1; i < ARP_QUEUE_LEN; i++) e->queue[i - 1] = e->queue[i];
+        e->queued--;
+        queue_drops++;
+    }
+    e->queue[e->queued++] = p;
+    if (fresh) arp_request(e);
+    return 0;
+}
+
+/* gratuitous ARP for our own address */
+void arp_announce(void) {
+    static const uint8_t zero_mac[6] = {0};
+    arp_send(ARP_OP_REQUEST, broadcast_mac, zero_mac, ip_local_addr());
+}
+
+/* ages resolved entries and retries or gives up on pending ones */
+void arp_tick(void) {
+    uint64_t now = ktime_ns();
+    if (now < next_tick) return;
+    next_tick = now + ARP_TICK_NS;
+
+    for (uint32_t i = 0; i < ARP_MAX_ENTRIES; i++) {
+        arp_entry* e = &entries[i];
+        if (e->state == ARP_RESOLVED && now - e->stamp >= ARP_TIMEOUT_NS) {
+            entry_release(e);
+        } else if (e->state == ARP_PENDING && now - e->stamp >= ARP_RETRY_NS) {
+            if (e->tries >= ARP_MAX_TRIES) {
+                resolve_failures++;
+                entry_release(e);
+            } else {
+                arp_request(e);
+            }
+        }
+    }
+}
+
+/* walks the cache for the arp command; returns 0 once cookie is past the last entry */
+int arp_get_entry(uint32_t* cookie, uint32_t* ip, uint8_t* mac, int* resolved, uint32_t* age_s) {
+    uint64_t now = ktime_ns();
+    net_lock();
+    while (*cookie < ARP_MAX_ENTRIES) {
+        arp_entry* e = &entries[(*cookie)++];
+        if (e->state == ARP_FREE) continue;
+        *ip = e->ip;
+        for (int i = 0; i < 6; i++) mac[i] = e->mac[i];
+        *resolved = e->state == ARP_RESOLVED;
+        *age_s = (uint32_t)((now - e->stamp) / 1000000000UL);
+        net_unlock();
+        return 1;
+    }
+    net_unlock();
+    return 0;
+}
+
+void arp_flush(void) {
+    for (uint32_t i = 0; i < ARP_MAX_ENTRIES; i++) {
+        if (entries[i].state != ARP_FREE) entry_release(&entries[i]);
+    }
+}
+
+void arp_stats(uint32_t* stats) {
+    stats[0] = requests_sent;
+    stats[1] = replies_sent;
+    stats[2] = resolve_failures;
+    stats[3] = queue_drops;
+}
@@ -0,0 +1,115 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+/* packet data is only 2-byte aligned once headers are stripped */
+typedef uint64_t __attribute__((may_alias, aligned(1))) load64;
+typedef uint32_t __attribute__((may_alias, aligned(1))) load32;
+typedef uint16_t __attribute__((may_alias, aligned(1))) load16;
+
+typedef struct pbuf {
+    struct pbuf* next;
+    uint8_t* payload;
+    uint16_t len;
+    uint16_t tot_len;
+    uint16_t refcount;
+    uint16_t flags;
+    uint8_t* buffer;
+} pbuf;
+
+/*
+ * Ones' complement sums are kept in memory byte order, so the folded result can be
+ * stored into a header without swapping.
+ */
+static uint64_t fold64(uint64_t sum) {
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    return sum;
+}
+
+/* adds len bytes to sum eight bytes at a time, carrying the 32-bit halves into a 64-bit accumulator */
+uint32_t csum_partial(const void* data, uint32_t len, uint32_t sum) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t acc = sum;
+
+    while (len >= 32) {
+        const load64* q = (const load64*)p;
+        uint64_t a = q[0], b = q[1], c = q[2], d = q[3];
+        acc += (a & 0xFFFFFFFF) + (a >> 32) + (b & 0xFFFFFFFF) + (b >> 32);
+        acc += (c & 0xFFFFFFFF) + (c >> 32) + (d & 0xFFFFFFFF) + (d >> 32);
+        p += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        uint64_t a = *(const load64*)p;
+        acc += (a & 0xFFFFFFFF) + (a >> 32);
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        acc += *(const load32*)p;
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        acc += *(const load16*)p;
+        p += 2;
+        len -= 2;
+    }
+    if (len) acc += *p;
+    return (uint32_t)fold64(acc);
+}
+
+uint16_t csum_fold(uint32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/* sums len bytes of a chain from offset; a segment that ends on an odd byte shifts the next one */
+uint32_t csum_pbuf(const pbuf* p, uint16_t offset, uint16_t len, uint32_t sum) {
+    int odd = 0;
+
+    for (; p && len; p = p->next) {
+        if (offset >= p->len) {
+            offset -= p->len;
+            continue;
+        }
+        uint16_t n = p->len - offset;
+        if (n > len) n = len;
+
+        uint32_t part = csum_partial(p->payload + offset, n, 0);
+        if (odd) {
+            part = (part & 0xFFFF) + (part >> 16);
+            part = (part & 0xFFFF) + (part >> 16);
+            part = ((part & 0xFF) << 8) | (part >> 8);
+        }
+        sum = (uint32_t)fold64((uint64_t)sum + part);
+        odd ^= n & 1;
+        len -= n;
+        offset = 0;
+    }
+    return sum;
+}
+
+/* pseudo-header sum for UDP/TCP; addresses are in host order, length and proto become network order */
+uint32_t csum_pseudo(uint32_t src, uint32_t dst, uint8_t proto, uint16_t len) {
+    uint64_t acc = (uint64_t)__builtin_bswap32(src) + __builtin_bswap32(dst);
+    acc += (uint32_t)proto << 8;
+    acc += __builtin_bswap16(len);
+    return (uint32_t)fold64(acc);
+}
+
+/* RFC 1624: HC' = ~(~HC + ~m + m') for a 16-bit field changing from old to new, all in memory order */
+uint16_t csum_update16(uint16_t check, uint16_t old, uint16_t new) {
+    uint32_t sum = (uint16_t)~check + (uint16_t)~old + (uint32_t)new;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+uint16_t csum_update32(uint16_t check, uint32_t old, uint32_t new) {
+    check = csum_update16(check, (uint16_t)old, (uint16_t)new);
+    return csum_update16(check, (uint16_t)(old >> 16), (uint16_t)(new >> 16));
+}
@@ -0,0 +1,340 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define ETH_HEADER_LEN      14
+#define ETHERTYPE_IPV4      0x0800
+#define ETHERTYPE_ARP       0x0806
+#define IP_HEADER_LEN       20
+#define IP_DEFAULT_TTL      64
+#define IP_FLAG_DF          0x4000
+#define IP_FRAG_MASK        0x3FFF
+#define IP_BROADCAST        0xFFFFFFFF
+#define IP_PROTO_ICMP       1
+#define IP_PROTO_UDP        17
+#define ICMP_ECHO_REPLY     0
+#define ICMP_ECHO_REQUEST   8
+#define ICMP_HEADER_LEN     8
+#define NET_POLL_BUDGET     64
+#define NET_THREAD_PRIO     8
+#define NET_IDLE_MS         100
+
+/* defaults match QEMU user-mode networking */
+#define NET_DEFAULT_ADDR    0x0A00020F
+#define NET_DEFAULT_MASK    0xFFFFFF00
+#define NET_DEFAULT_GATEWAY 0x0A000202
+
+typedef struct pbuf {
+    struct pbuf* next;
+    uint8_t* payload;
+    uint16_t len;
+    uint16_t tot_len;
+    uint16_t refcount;
+    uint16_t flags;
+    uint8_t* buffer;
+} pbuf;
+
+typedef struct {
+    uint8_t ver_ihl;
+    uint8_t tos;
+    uint16_t total_len;
+    uint16_t id;
+    uint16_t frag;
+    uint8_t ttl;
+    uint8_t proto;
+    uint16_t check;
+    uint32_t src;
+    uint32_t dst;
+} __attribute__((packed)) ip_header;
+
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t check;
+    uint16_t id;
+    uint16_t seq;
+} __attribute__((packed)) icmp_header;
+
+typedef struct {
+    uint32_t addr;
+    uint32_t netmask;
+    uint32_t gateway;
+} net_route;
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+typedef struct {
+    thread* owner;
+    wait_queue wait;
+} mutex;
+
+pbuf* pbuf_alloc(uint16_t len);
+void pbuf_free(pbuf* p);
+int pbuf_header(pbuf* p, int delta);
+void pbuf_trim(pbuf* p, uint16_t len);
+uint16_t pbuf_copy_out(const pbuf* p, uint16_t offset, void* buf, uint16_t len);
+pbuf* ethernet_recv(void);
+int ethernet_is_initialized(void);
+int ethernet_wait_rx(uint32_t timeout_ms);
+void ethernet_tx_batch_begin(void);
+void ethernet_tx_batch_end(void);
+uint64_t ktime_ns(void);
+uint32_t csum_partial(const void* data, uint32_t len, uint32_t sum);
+uint32_t csum_pbuf(const pbuf* p, uint16_t offset, uint16_t len, uint32_t sum);
+uint16_t csum_fold(uint32_t sum);
+uint16_t csum_update16(uint16_t check, uint16_t old, uint16_t new);
+void arp_input(pbuf* p);
+int arp_output(pbuf* p, uint32_t next_hop);
+void arp_tick(void);
+void arp_announce(void);
+void udp_input(pbuf* p, uint32_t src, uint32_t dst);
+int thread_create(const char* name, void (*entry)(void* arg), void* arg, uint32_t prio);
+int thread_should_stop(void);
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns);
+void wait_queue_wake(wait_queue* wq);
+void mutex_lock(mutex* m);
+void mutex_unlock(mutex* m);
+
+static net_route route = {NET_DEFAULT_ADDR, NET_DEFAULT_MASK, NET_DEFAULT_GATEWAY};
+static uint16_t next_id = 1;
+static uint32_t ip_rx = 0;
+static uint32_t ip_tx = 0;
+static uint32_t ip_bad = 0;
+static uint32_t ip_unhandled = 0;
+static uint32_t echo_replies_sent = 0;
+static mutex net_mutex;
+
+/* the one outstanding echo the ping command is waiting for */
+static volatile uint16_t echo_wait_id = 0;
+static volatile uint16_t echo_wait_seq = 0;
+static volatile int echo_done = 0;
+static uint64_t echo_rtt_ns = 0;
+static uint8_t echo_ttl = 0;
+static wait_queue echo_wait;
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint16_t htons(uint16_t v) { return __builtin_bswap16(v); }
+static inline uint16_t ntohs(uint16_t v) { return __builtin_bswap16(v); }
+static inline uint32_t htonl(uint32_t v) { return __builtin_bswap32(v); }
+static inline uint32_t ntohl(uint32_t v) { return __builtin_bswap32(v); }
+
+/* serialises the protocol state between netd and threads that send */
+void net_lock(void) {
+    mutex_lock(&net_mutex);
+}
+
+void net_unlock(void) {
+    mutex_unlock(&net_mutex);
+}
+
+uint32_t ip_local_addr(void) {
+    return route.addr;
+}
+
+void ip_get_config(uint32_t* addr, uint32_t* netmask, uint32_t* gateway) {
+    *addr = route.addr;
+    *netmask = route.netmask;
+    *gateway = route.gateway;
+}
+
+/* prepends an IPv4 header and hands the packet to ARP for the on-link next hop; takes ownership of p */
+int ip_output(pbuf* p, uint32_t dst, uint8_t proto) {
+    if (pbuf_header(p, IP_HEADER_LEN) < 0) {
+        pbuf_free(p);
+        return -1;
+    }
+
+    ip_header* h = (ip_header*)p->payload;
+    h->ver_ihl = 0x45;
+    h->tos = 0;
+    h->total_len = htons(p->tot_len);
+    h->id = htons(next_id++);
+    h->frag = htons(IP_FLAG_DF);
+    h->ttl = IP_DEFAULT_TTL;
+    h->proto = proto;
+    h->check = 0;
+    h->src = htonl(route.addr);
+    h->dst = htonl(dst);
+    h->check = csum_fold(csum_partial(h, IP_HEADER_LEN, 0));
+    ip_tx++;
+
+    uint32_t next_hop = dst;
+    if (dst == (route.addr | ~route.netmask)) next_hop = IP_BROADCAST;
+    else if (dst != IP_BROADCAST && (dst & route.netmask) != (route.addr & route.netmask)) next_hop = route.gateway;
+    return arp_output(p, next_hop);
+}
+
+/* echo requests are turned around in the receive buffer; only the type word of the checksum changes */
+static void icmp_input(pbuf* p, uint32_t src, uint8_t ttl) {
+    if (p->len < ICMP_HEADER_LEN || csum_fold(csum_pbuf(p, 0, p->tot_len, 0)) != 0) {
+        ip_bad++;
+        pbuf_free(p);
+        return;
+    }
+
+    icmp_header* h = (icmp_header*)p->payload;
+    if (h->type == ICMP_ECHO_REQUEST && h->code == 0) {
+        /* type and code form the first 16-bit word in memory order */
+        h->type = ICMP_ECHO_REPLY;
+        h->check = csum_update16(h->check, ICMP_ECHO_REQUEST, ICMP_ECHO_REPLY);
+        echo_replies_sent++;
+        ip_output(p, src, IP_PROTO_ICMP);
+        return;
+    }
+
+    if (h->type == ICMP_ECHO_REPLY && !echo_done && echo_wait_id &&
+        ntohs(h->id) == echo_wait_id && ntohs(h->seq) == echo_wait_seq) {
+        uint64_t sent = 0;
+        if (pbuf_copy_out(p, ICMP_HEADER_LEN, &sent, sizeof(sent)) == sizeof(sent)) {
+            echo_rtt_ns = ktime_ns() - sent;
+        }
+        echo_ttl = ttl;
+        echo_done = 1;
+        wait_queue_wake(&echo_wait);
+    }
+    pbuf_free(p);
+}
+
+/* p starts at the IP header; it is trimmed to the datagram length before dispatch */
+void ip_input(pbuf* p) {
+    ip_header* h = (ip_header*)p->payload;
+    uint32_t hlen = (h->ver_ihl & 0x0F) * 4;
+
+    if (p->len < IP_HEADER_LEN || (h->ver_ihl >> 4) != 4 || hlen < IP_HEADER_LEN || hlen > p->len) {
+        ip_bad++;
+        pbuf_free(p);
+        return;
+    }
+    uint16_t total = ntohs(h->total_len);
+    if (total < hlen || total > p->tot_len || csum_fold(csum_partial(h, hlen, 0)) != 0) {
+        ip_bad++;
+        pbuf_free(p);
+        return;
+    }
+
+    uint32_t dst = ntohl(h->dst);
+    /* no reassembly: fragments are dropped */
+    if ((ntohs(h->frag) & IP_FRAG_MASK) ||
+        (dst != route.addr && dst != IP_BROADCAST && dst != (route.addr | ~route.netmask))) {
+        ip_unhandled++;
+        pbuf_free(p);
+        return;
+    }
+
+    uint32_t src = ntohl(h->src);
+    uint8_t proto = h->proto;
+    uint8_t ttl = h->ttl;
+    ip_rx++;
+    pbuf_trim(p, total);
+    pbuf_header(p, -(int)hlen);
+
+    if (proto == IP_PROTO_ICMP && dst == route.addr) icmp_input(p, src, ttl);
+    else if (proto == IP_PROTO_UDP) udp_input(p, src, dst);
+    else {
+        ip_unhandled++;
+        pbuf_free(p);
+    }
+}
+
+/* drains the receive ring into the stack; replies generated on the way share tail writes */
+void net_poll(void) {
+    if (!ethernet_is_initialized()) return;
+
+    net_lock();
+    ethernet_tx_batch_begin();
+    for (int budget = NET_POLL_BUDGET; budget > 0; budget--) {
+        pbuf* p = ethernet_recv();
+        if (!p) break;
+
+        uint16_t ethertype = (uint16_t)((p->payload[12] << 8) | p->payload[13]);
+        pbuf_header(p, -ETH_HEADER_LEN);
+        if (ethertype == ETHERTYPE_IPV4) ip_input(p);
+        else if (ethertype == ETHERTYPE_ARP) arp_input(p);
+        else pbuf_free(p);
+    }
+    arp_tick();
+    ethernet_tx_batch_end();
+    net_unlock();
+}
+
+/* receive processing runs here, so packets are handled while the shell waits for input */
+static void netd(void* arg) {
+    while (!thread_should_stop()) {
+        net_poll();
+        ethernet_wait_rx(NET_IDLE_MS);
+    }
+}
+
+/* sends an echo request whose payload starts with the send timestamp */
+int icmp_echo_send(uint32_t dst, uint16_t id, uint16_t seq, uint16_t size) {
+    if (size < sizeof(uint64_t)) size = sizeof(uint64_t);
+    pbuf* p = pbuf_alloc(ICMP_HEADER_LEN + size);
+    if (!p) return -1;
+
+    icmp_header* h = (icmp_header*)p->payload;
+    uint8_t* data = p->payload + ICMP_HEADER_LEN;
+    h->type = ICMP_ECHO_REQUEST;
+    h->code = 0;
+    h->check = 0;
+    h->id = htons(id);
+    h->seq = htons(seq);
+    for (uint16_t i = sizeof(uint64_t); i < size; i++) data[i] = (uint8_t)i;
+
+    net_lock();
+    echo_wait_id = id;
+    echo_wait_seq = seq;
+    echo_done = 0;
+    uint64_t now = ktime_ns();
+    for (uint32_t i = 0; i < sizeof(now); i++) data[i] = (uint8_t)(now >> (i * 8));
+    h->check = csum_fold(csum_pbuf(p, 0, p->tot_len, 0));
+    int rc = ip_output(p, dst, IP_PROTO_ICMP);
+    net_unlock();
+    return rc;
+}
+
+/* waits for the reply to the last icmp_echo_send; returns 0 and the round trip on success */
+int icmp_echo_wait(uint32_t timeout_ms, uint64_t* rtt_ns, uint8_t* ttl) {
+    uint64_t deadline = ktime_ns() + (uint64_t)timeout_ms * 1000000;
+    unsigned long flags = irq_save();
+    while (!echo_done && ktime_ns() < deadline && !thread_should_stop()) wait_queue_sleep(&echo_wait, deadline);
+    int done = echo_done;
+    echo_wait_id = 0;
+    irq_restore(flags);
+
+    if (!done) return -1;
+    *rtt_ns = echo_rtt_ns;
+    *ttl = echo_ttl;
+    return 0;
+}
+
+/* announces the address so the gateway can reach us before we ever talk to it */
+int net_init(void) {
+    if (!ethernet_is_initialized()) return -1;
+    net_lock();
+    arp_announce();
+    net_unlock();
+    return thread_create("netd", netd, 0, NET_THREAD_PRIO) < 0 ? -1 : 0;
+}
+
+void ip_stats(uint32_t* stats) {
+    stats[0] = ip_rx;
+    stats[1] = ip_tx;
+    stats[2] = ip_bad;
+    stats[3] = ip_unhandled;
+    stats[4] = echo_replies_sent;
+}
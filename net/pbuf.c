@@ -0,0 +1,202 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define PBUF_BUFFER_SIZE    2048
+#define PBUF_HEADROOM       128
+#define PBUF_DATA_SIZE      (PBUF_BUFFER_SIZE - PBUF_HEADROOM)
+#define PBUF_POOL_ORDER     9
+#define PBUF_COUNT          ((4096 << PBUF_POOL_ORDER) / PBUF_BUFFER_SIZE)
+
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+} spinlock;
+
+typedef struct pbuf {
+    struct pbuf* next;
+    uint8_t* payload;
+    uint16_t len;
+    uint16_t tot_len;
+    uint16_t refcount;
+    uint16_t flags;
+    uint8_t* buffer;
+} pbuf;
+
+void* alloc_pages(uint32_t order);
+void* kzalloc(size_t size);
+void* memcpy(void* dest, const void* src, size_t n);
+unsigned long spin_lock_irqsave(spinlock* lock);
+void spin_unlock_irqrestore(spinlock* lock, unsigned long flags);
+
+static pbuf* pool = 0;
+static pbuf* free_list = 0;
+static uint32_t free_count = 0;
+static uint32_t low_water = 0;
+static uint32_t alloc_failures = 0;
+static uint32_t allocations = 0;
+static spinlock pool_lock;
+
+/* buffers are 2 KB slices of one physically contiguous block, so every payload is cache-line aligned */
+int pbuf_init(void) {
+    if (pool) return 0;
+
+    uint8_t* storage = (uint8_t*)alloc_pages(PBUF_POOL_ORDER);
+    pool = (pbuf*)kzalloc(PBUF_COUNT * sizeof(pbuf));
+    if (!storage || !pool) return -1;
+
+    for (int i = PBUF_COUNT - 1; i >= 0; i--) {
+        pool[i].buffer = storage + (uint64_t)i * PBUF_BUFFER_SIZE;
+        pool[i].next = free_list;
+        free_list = &pool[i];
+    }
+    free_count = PBUF_COUNT;
+    low_water = PBUF_COUNT;
+    return 0;
+}
+
+static pbuf* pbuf_take(void) {
+    pbuf* p = free_list;
+    if (!p) return 0;
+    free_list = p->next;
+    free_count--;
+    if (free_count < low_water) low_water = free_count;
+    allocations++;
+
+    p->next = 0;
+    p->payload = p->buffer + PBUF_HEADROOM;
+    p->len = 0;
+    p->tot_len = 0;
+    p->refcount = 1;
+    p->flags = 0;
+    return p;
+}
+
+void pbuf_free(pbuf* p);
+
+/* allocates len bytes after the headroom, chaining segments when one buffer is not enough */
+pbuf* pbuf_alloc(uint16_t len) {
+    unsigned long flags = spin_lock_irqsave(&pool_lock);
+    pbuf* head = pbuf_take();
+    pbuf* tail = head;
+    uint16_t remaining = len;
+
+    while (tail) {
+        tail->len = remaining > PBUF_DATA_SIZE ? PBUF_DATA_SIZE : remaining;
+        remaining -= tail->len;
+        if (!remaining) break;
+        tail->next = pbuf_take();
+        tail = tail->next;
+    }
+    if (!tail) {
+        alloc_failures++;
+        spin_unlock_irqrestore(&pool_lock, flags);
+        if (head) pbuf_free(head);
+        return 0;
+    }
+    spin_unlock_irqrestore(&pool_lock, flags);
+
+    for (pbuf* p = head; p; p = p->next) {
+        p->tot_len = len;
+        len -= p->len;
+    }
+    return head;
+}
+
+void pbuf_ref(pbuf* p) {
+    unsigned long flags = spin_lock_irqsave(&pool_lock);
+    p->refcount++;
+    spin_unlock_irqrestore(&pool_lock, flags);
+}
+
+/* drops one reference per segment, stopping at a segment that is still shared */
+void pbuf_free(pbuf* p) {
+    unsigned long flags = spin_lock_irqsave(&pool_lock);
+    while (p) {
+        if (--p->refcount) break;
+        pbuf* next = p->next;
+        p->next = free_list;
+        free_list = p;
+        free_count++;
+        p = next;
+    }
+    spin_unlock_irqrestore(&pool_lock, flags);
+}
+
+/* positive delta exposes headroom for a new header, negative delta strips one */
+int pbuf_header(pbuf* p, int delta) {
+    uint8_t* payload = p->payload - delta;
+    if (payload < p->buffer || payload > p->payload + p->len) return -1;
+
+    p->payload = payload;
+    p->len += delta;
+    p->tot_len += delta;
+    return 0;
+}
+
+/* appends tail to head; head takes over the caller's reference on tail */
+void pbuf_chain(pbuf* head, pbuf* tail) {
+    pbuf* p = head;
+    for (; p->next; p = p->next) p->tot_len += tail->tot_len;
+    p->tot_len += tail->tot_len;
+    p->next = tail;
+}
+
+/* trims a received chain to len bytes; trailing segments stay attached but empty */
+void pbuf_trim(pbuf* p, uint16_t len) {
+    for (; p; p = p->next) {
+        p->tot_len = len;
+        if (p->len > len) p->len = len;
+        len -= p->len;
+    }
+}
+
+uint16_t pbuf_copy_out(const pbuf* p, uint16_t offset, void* buf, uint16_t len) {
+    uint8_t* out = (uint8_t*)buf;
+    uint16_t done = 0;
+
+    for (; p && done < len; p = p->next) {
+        if (offset >= p->len) {
+            offset -= p->len;
+            continue;
+        }
+        uint16_t n = p->len - offset;
+        if (n > len - done) n = len - done;
+        memcpy(out + done, p->payload + offset, n);
+        done += n;
+        offset = 0;
+    }
+    return done;
+}
+
+uint16_t pbuf_copy_in(pbuf* p, uint16_t offset, const void* buf, uint16_t len) {
+    const uint8_t* in = (const uint8_t*)buf;
+    uint16_t done = 0;
+
+    for (; p && done < len; p = p->next) {
+        if (offset >= p->len) {
+            offset -= p->len;
+            continue;
+        }
+        uint16_t n = p->len - offset;
+        if (n > len - done) n = len - done;
+        memcpy(p->payload + offset, in + done, n);
+        done += n;
+        offset = 0;
+    }
+    return done;
+}
+
+uint32_t pbuf_capacity(void) {
+    return PBUF_DATA_SIZE;
+}
+
+void pbuf_pool_stats(uint32_t* stats) {
+    stats[0] = pool ? PBUF_COUNT : 0;
+    stats[1] = free_count;
+    stats[2] = pool ? PBUF_COUNT - low_water : 0;
+    stats[3] = allocations;
+    stats[4] = alloc_failures;
+}
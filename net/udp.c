@@ -0,0 +1,256 @@
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+
+#define UDP_HEADER_LEN      8
+#define UDP_MAX_SOCKETS     16
+#define UDP_QUEUE_LEN       64
+#define UDP_MAX_PAYLOAD     1472
+#define UDP_EPHEMERAL_BASE  49152
+#define UDP_ECHO_PORT       7
+#define IP_PROTO_UDP        17
+
+typedef struct pbuf {
+    struct pbuf* next;
+    uint8_t* payload;
+    uint16_t len;
+    uint16_t tot_len;
+    uint16_t refcount;
+    uint16_t flags;
+    uint8_t* buffer;
+} pbuf;
+
+typedef struct {
+    uint16_t sport;
+    uint16_t dport;
+    uint16_t len;
+    uint16_t check;
+} __attribute__((packed)) udp_header;
+
+typedef struct thread thread;
+
+typedef struct {
+    thread* head;
+    int pending;
+} wait_queue;
+
+/* received datagrams are queued with their UDP header still in front */
+typedef struct {
+    int used;
+    uint16_t port;
+    pbuf* queue[UDP_QUEUE_LEN];
+    uint32_t from[UDP_QUEUE_LEN];
+    uint32_t head;
+    uint32_t count;
+    uint32_t drops;
+    wait_queue wait;
+} udp_socket;
+
+pbuf* pbuf_alloc(uint16_t len);
+void pbuf_free(pbuf* p);
+int pbuf_header(pbuf* p, int delta);
+void pbuf_trim(pbuf* p, uint16_t len);
+uint16_t pbuf_copy_out(const pbuf* p, uint16_t offset, void* buf, uint16_t len);
+uint16_t pbuf_copy_in(pbuf* p, uint16_t offset, const void* buf, uint16_t len);
+uint32_t csum_pbuf(const pbuf* p, uint16_t offset, uint16_t len, uint32_t sum);
+uint32_t csum_pseudo(uint32_t src, uint32_t dst, uint8_t proto, uint16_t len);
+uint16_t csum_fold(uint32_t sum);
+int ip_output(pbuf* p, uint32_t dst, uint8_t proto);
+uint32_t ip_local_addr(void);
+uint64_t ktime_ns(void);
+void net_lock(void);
+void net_unlock(void);
+int thread_should_stop(void);
+void wait_queue_sleep(wait_queue* wq, uint64_t deadline_ns);
+void wait_queue_wake(wait_queue* wq);
+
+static udp_socket sockets[UDP_MAX_SOCKETS];
+static uint16_t next_ephemeral = UDP_EPHEMERAL_BASE;
+static uint32_t udp_rx = 0;
+static uint32_t udp_tx = 0;
+static uint32_t udp_bad = 0;
+static uint32_t udp_no_port = 0;
+static uint32_t udp_echoed = 0;
+
+static inline unsigned long irq_save(void) {
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned long flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint16_t htons(uint16_t v) { return __builtin_bswap16(v); }
+static inline uint16_t ntohs(uint16_t v) { return __builtin_bswap16(v); }
+
+static udp_socket* find_port(uint16_t port) {
+    for (int i = 0; i < UDP_MAX_SOCKETS; i++) {
+        if (sockets[i].used && sockets[i].port == port) return &sockets[i];
+    }
+    return 0;
+}
+
+/* binds a socket to port, or to a free ephemeral port when port is 0; returns the socket number */
+int udp_open(uint16_t port) {
+    net_lock();
+    if (port == 0) {
+        do {
+            port = next_ephemeral++;
+            if (next_ephemeral == 0) next_ephemeral = UDP_EPHEMERAL_BASE;
+        } while (find_port(port));
+    } else if (port == UDP_ECHO_PORT || find_port(port)) {
+        net_unlock();
+        return -1;
+    }
+
+    int s = -1;
+    for (int i = 0; i < UDP_MAX_SOCKETS && s < 0; i++) {
+        if (sockets[i].used) continue;
+        sockets[i].used = 1;
+        sockets[i].port = port;
+        sockets[i].head = 0;
+        sockets[i].count = 0;
+        sockets[i].drops = 0;
+        s = i;
+    }
+    net_unlock();
+    return s;
+}
+
+void udp_close(int s) {
+    if (s < 0 || s >= UDP_MAX_SOCKETS || !sockets[s].used) return;
+    udp_socket* sk = &sockets[s];
+    net_lock();
+    while (sk->count) {
+        pbuf_free(sk->queue[sk->head]);
+        sk->head = (sk->head + 1) % UDP_QUEUE_LEN;
+        sk->count--;
+    }
+    sk->used = 0;
+    net_unlock();
+}
+
+uint16_t udp_port(int s) {
+    return (s >= 0 && s < UDP_MAX_SOCKETS && sockets[s].used) ? sockets[s].port : 0;
+}
+
+static int udp_output(pbuf* p, uint16_t sport, uint32_t dst, uint16_t dport) {
+    if (pbuf_header(p, UDP_HEADER_LEN) < 0) {
+        pbuf_free(p);
+        return -1;
+    }
+
+    udp_header* h = (udp_header*)p->payload;
+    uint16_t len = p->tot_len;
+    h->sport = htons(sport);
+    h->dport = htons(dport);
+    h->len = htons(len);
+    h->check = 0;
+    uint16_t check = csum_fold(csum_pbuf(p, 0, len, csum_pseudo(ip_local_addr(), dst, IP_PROTO_UDP, len)));
+    h->check = check ? check : 0xFFFF;
+    udp_tx++;
+    return ip_output(p, dst, IP_PROTO_UDP);
+}
+
+int udp_sendto(int s, uint32_t dst, uint16_t dport, const void* data, uint16_t len) {
+    if (s < 0 || s >= UDP_MAX_SOCKETS || !sockets[s].used || len > UDP_MAX_PAYLOAD) return -1;
+
+    pbuf* p = pbuf_alloc(len);
+    if (!p) return -1;
+    pbuf_copy_in(p, 0, data, len);
+    net_lock();
+    int rc = udp_output(p, sockets[s].port, dst, dport);
+    net_unlock();
+    return rc < 0 ? -1 : len;
+}
+
+/* returns the next datagram's length, or -1 when nothing arrived within timeout_ms */
+int udp_recvfrom(int s, void* buf, uint16_t size, uint32_t* src, uint16_t* sport, uint32_t timeout_ms) {
+    if (s < 0 || s >= UDP_MAX_SOCKETS || !sockets[s].used) return -1;
+    udp_socket* sk = &sockets[s];
+    uint64_t deadline = ktime_ns() + (uint64_t)timeout_ms * 1000000;
+
+    /* netd queues datagrams and wakes the socket */
+    unsigned long flags = irq_save();
+    while (!sk->count && ktime_ns() < deadline && !thread_should_stop()) wait_queue_sleep(&sk->wait, deadline);
+    irq_restore(flags);
+
+    net_lock();
+    if (!sk->count) {
+        net_unlock();
+        return -1;
+    }
+    pbuf* p = sk->queue[sk->head];
+    uint32_t from = sk->from[sk->head];
+    sk->head = (sk->head + 1) % UDP_QUEUE_LEN;
+    sk->count--;
+    net_unlock();
+
+    udp_header* h = (udp_header*)p->payload;
+    uint16_t len = p->tot_len - UDP_HEADER_LEN;
+    if (src) *src = from;
+    if (sport) *sport = ntohs(h->sport);
+    if (len > size) len = size;
+    len = pbuf_copy_out(p, UDP_HEADER_LEN, buf, len);
+    pbuf_free(p);
+    return len;
+}
+
+/* p starts at the UDP header; the port 7 echo service answers in place */
+void udp_input(pbuf* p, uint32_t src, uint32_t dst) {
+    udp_header* h = (udp_header*)p->payload;
+    uint16_t len = p->len >= UDP_HEADER_LEN ? ntohs(h->len) : 0;
+
+    if (len < UDP_HEADER_LEN || len > p->tot_len) {
+        udp_bad++;
+        pbuf_free(p);
+        return;
+    }
+    pbuf_trim(p, len);
+    if (h->check && csum_fold(csum_pbuf(p, 0, len, csum_pseudo(src, dst, IP_PROTO_UDP, len))) != 0) {
+        udp_bad++;
+        pbuf_free(p);
+        return;
+    }
+    udp_rx++;
+
+    uint16_t dport = ntohs(h->dport);
+    if (dport == UDP_ECHO_PORT && dst == ip_local_addr()) {
+        /* swapping ports and addresses leaves the ones' complement sum unchanged */
+        uint16_t port = h->sport;
+        h->sport = h->dport;
+        h->dport = port;
+        udp_echoed++;
+        udp_tx++;
+        ip_output(p, src, IP_PROTO_UDP);
+        return;
+    }
+
+    udp_socket* sk = find_port(dport);
+    if (!sk) {
+        udp_no_port++;
+        pbuf_free(p);
+        return;
+    }
+    if (sk->count == UDP_QUEUE_LEN) {
+        sk->drops++;
+        pbuf_free(p);
+        return;
+    }
+    uint32_t slot = (sk->head + sk->count) % UDP_QUEUE_LEN;
+    sk->queue[slot] = p;
+    sk->from[slot] = src;
+    sk->count++;
+    wait_queue_wake(&sk->wait);
+}
+
+void udp_stats(uint32_t* stats) {
+    stats[0] = udp_rx;
+    stats[1] = udp_tx;
+    stats[2] = udp_bad;
+    stats[3] = udp_no_port;
+    stats[4] = udp_echoed;
+}
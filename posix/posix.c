@@ -1,39 +1,350 @@
-typedef unsigned int size_t;
-
-int posix_open(const char* path, int flags) { return -1; }
-int posix_close(int fd) { return -1; }
-int posix_read(int fd, void* buf, size_t count) { return -1; }
-int posix_write(int fd, const void* buf, size_t count) { return -1; }
-int posix_lseek(int fd, int offset, int whence) { return -1; }
-int posix_unlink(const char* path) { return -1; }
-int posix_mkdir(const char* path, int mode) { return 0; }
-int posix_rmdir(const char* path) { return -1; }
-int posix_chdir(const char* path) { return 0; }
-int posix_getpid(void) { return 1; }
-int posix_getppid(void) { return 0; }
+typedef unsigned char uint8_t;
+typedef unsigned int uint32_t;
+typedef unsigned long uint64_t;
+typedef unsigned long size_t;
+
+#define MAX_FDS         32
+#define MAX_MAPPINGS    32
+#define PATH_MAX        128
+#define PAGE_SIZE       4096
+
+#define O_ACCMODE       3
+#define O_RDONLY        0
+#define O_WRONLY        1
+#define O_RDWR          2
+#define O_CREAT         0x40
+#define O_EXCL          0x80
+#define O_TRUNC         0x200
+#define O_APPEND        0x400
+
+#define SEEK_SET        0
+#define SEEK_CUR        1
+#define SEEK_END        2
+
+#define PROT_READ       1
+#define PROT_WRITE      2
+#define MAP_SHARED      1
+#define MAP_PRIVATE     2
+#define MAP_FAILED      ((void*)-1)
+
+#define FS_TYPE_FILE    1
+#define FS_TYPE_DIR     2
+
+typedef struct fs_inode fs_inode;
+typedef struct cached_page cached_page;
+
+typedef struct {
+    fs_inode* ip;
+    uint64_t offset;
+    int flags;
+    uint32_t refcount;
+} open_file;
+
+typedef struct {
+    open_file* fds[MAX_FDS];
+} fd_table;
+
+typedef struct {
+    uint8_t* addr;
+    uint32_t count;
+    fs_inode* ip;
+    cached_page** pages;
+    int prot;
+    int flags;
+} file_mapping;
+
+void msleep(unsigned int ms);
+unsigned int rtc_epoch_seconds(void);
+void* kzalloc(size_t size);
+void kfree(void* ptr);
+void* alloc_page(void);
+void free_page(void* addr);
+void* memcpy(void* dest, const void* src, size_t n);
+size_t strlen(const char* str);
+void strcpy(char* dest, const char* src);
+fs_inode* fs_namei(const char* path);
+fs_inode* fs_iget(uint32_t ino);
+fs_inode* fs_create(const char* path, int type);
+void fs_iput(fs_inode* ip);
+uint32_t fs_ino(fs_inode* ip);
+int fs_is_dir(fs_inode* ip);
+uint64_t fs_size(fs_inode* ip);
+int fs_unlink(const char* path);
+int fs_path_resolve(const char* base, const char* path, char* out, uint32_t size);
+cached_page* pagecache_get(fs_inode* ip, uint32_t index);
+void pagecache_put(cached_page* p);
+void* pagecache_data(cached_page* p);
+long pagecache_read(fs_inode* ip, uint64_t offset, void* buf, uint64_t len);
+long pagecache_write(fs_inode* ip, uint64_t offset, const void* buf, uint64_t len);
+int pagecache_writeback(fs_inode* ip, cached_page* p);
+int pagecache_truncate(fs_inode* ip, uint64_t size);
+void* vmap_pages(const uint64_t* phys, uint32_t count, int writable);
+void vunmap(void* addr);
+uint32_t thread_current_tid(void);
+uint32_t thread_parent_tid(void);
+int thread_wait(int* status);
+int thread_kill(uint32_t tid);
+
+extern char current_directory[];
+
+static fd_table init_fds;
+static file_mapping mappings[MAX_MAPPINGS];
+
+static fd_table* current_fds(void) {
+    return &init_fds;
+}
+
+static open_file* fd_get(int fd) {
+    if(fd < 0 || fd >= MAX_FDS) return 0;
+    return current_fds()->fds[fd];
+}
+
+static int fd_install(open_file* file, int from) {
+    fd_table* table = current_fds();
+    for(int fd = from; fd < MAX_FDS; fd++) {
+        if(!table->fds[fd]) {
+            table->fds[fd] = file;
+            file->refcount++;
+            return fd;
+        }
+    }
+    return -1;
+}
+
+static void file_release(open_file* file) {
+    if(--file->refcount) return;
+    fs_iput(file->ip);
+    kfree(file);
+}
+
+static fs_inode* path_lookup(const char* path, char* resolved) {
+    if(!path || fs_path_resolve(current_directory, path, resolved, PATH_MAX) < 0) return 0;
+    return fs_namei(resolved);
+}
+
+int posix_open(const char* path, int flags) {
+    char resolved[PATH_MAX];
+    if(!path || fs_path_resolve(current_directory, path, resolved, PATH_MAX) < 0) return -1;
+    fs_inode* ip = fs_namei(resolved);
+    if(ip && (flags & O_CREAT) && (flags & O_EXCL)) { fs_iput(ip); return -1; }
+    if(!ip && (flags & O_CREAT)) ip = fs_create(resolved, FS_TYPE_FILE);
+    if(!ip) return -1;
+    if(fs_is_dir(ip) && (flags & O_ACCMODE) != O_RDONLY) { fs_iput(ip); return -1; }
+    if((flags & O_TRUNC) && (flags & O_ACCMODE) != O_RDONLY && pagecache_truncate(ip, 0) < 0) { fs_iput(ip); return -1; }
+
+    open_file* file = (open_file*)kzalloc(sizeof(open_file));
+    if(!file) { fs_iput(ip); return -1; }
+    file->ip = ip;
+    file->flags = flags;
+    int fd = fd_install(file, 0);
+    if(fd < 0) { fs_iput(ip); kfree(file); }
+    return fd;
+}
+
+int posix_close(int fd) {
+    open_file* file = fd_get(fd);
+    if(!file) return -1;
+    current_fds()->fds[fd] = 0;
+    file_release(file);
+    return 0;
+}
+
+int posix_read(int fd, void* buf, size_t count) {
+    open_file* file = fd_get(fd);
+    if(!file || (file->flags & O_ACCMODE) == O_WRONLY || fs_is_dir(file->ip)) return -1;
+    long n = pagecache_read(file->ip, file->offset, buf, count);
+    if(n > 0) file->offset += n;
+    return (int)n;
+}
+
+int posix_write(int fd, const void* buf, size_t count) {
+    open_file* file = fd_get(fd);
+    if(!file || (file->flags & O_ACCMODE) == O_RDONLY) return -1;
+    if(count == 0) return 0;
+    if(file->flags & O_APPEND) file->offset = fs_size(file->ip);
+    long n = pagecache_write(file->ip, file->offset, buf, count);
+    if(n > 0) file->offset += n;
+    return (int)n;
+}
+
+int posix_lseek(int fd, int offset, int whence) {
+    open_file* file = fd_get(fd);
+    if(!file) return -1;
+    long base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (long)file->offset :
+                whence == SEEK_END ? (long)fs_size(file->ip) : -1;
+    if(base < 0 || base + offset < 0) return -1;
+    file->offset = (uint64_t)(base + offset);
+    return (int)file->offset;
+}
+
+int posix_unlink(const char* path) {
+    char resolved[PATH_MAX];
+    fs_inode* ip = path_lookup(path, resolved);
+    if(!ip) return -1;
+    int is_dir = fs_is_dir(ip);
+    fs_iput(ip);
+    return is_dir ? -1 : fs_unlink(resolved);
+}
+
+int posix_mkdir(const char* path, int mode) {
+    char resolved[PATH_MAX];
+    if(!path || fs_path_resolve(current_directory, path, resolved, PATH_MAX) < 0) return -1;
+    fs_inode* ip = fs_create(resolved, FS_TYPE_DIR);
+    if(!ip) return -1;
+    fs_iput(ip);
+    return 0;
+}
+
+int posix_rmdir(const char* path) {
+    char resolved[PATH_MAX];
+    fs_inode* ip = path_lookup(path, resolved);
+    if(!ip) return -1;
+    int is_dir = fs_is_dir(ip);
+    fs_iput(ip);
+    return is_dir ? fs_unlink(resolved) : -1;
+}
+
+int posix_chdir(const char* path) {
+    char resolved[PATH_MAX];
+    fs_inode* ip = path_lookup(path, resolved);
+    if(!ip) return -1;
+    int is_dir = fs_is_dir(ip);
+    fs_iput(ip);
+    if(!is_dir) return -1;
+    strcpy(current_directory, resolved);
+    return 0;
+}
+
+int posix_getpid(void) { return (int)thread_current_tid(); }
+int posix_getppid(void) { return (int)thread_parent_tid(); }
 int posix_getuid(void) { return 0; }
 int posix_getgid(void) { return 0; }
+/* kernel threads share one address space, so there is nothing for fork to copy */
 int posix_fork(void) { return -1; }
-int posix_wait(int* status) { return -1; }
-int posix_kill(int pid, int sig) { return -1; }
+int posix_wait(int* status) { return thread_wait(status); }
+int posix_kill(int pid, int sig) { return pid > 0 && sig > 0 ? thread_kill((uint32_t)pid) : -1; }
 int posix_pipe(int fd[2]) { return -1; }
-int posix_dup(int fd) { return -1; }
-int posix_dup2(int old, int new) { return -1; }
-int posix_access(const char* path, int mode) { return -1; }
+
+int posix_dup(int fd) {
+    open_file* file = fd_get(fd);
+    return file ? fd_install(file, 0) : -1;
+}
+
+int posix_dup2(int old, int new) {
+    open_file* file = fd_get(old);
+    if(!file || new < 0 || new >= MAX_FDS) return -1;
+    if(old == new) return new;
+    posix_close(new);
+    current_fds()->fds[new] = file;
+    file->refcount++;
+    return new;
+}
+
+int posix_access(const char* path, int mode) {
+    char resolved[PATH_MAX];
+    fs_inode* ip = path_lookup(path, resolved);
+    if(!ip) return -1;
+    fs_iput(ip);
+    return 0;
+}
+
 int posix_chmod(const char* path, int mode) { return -1; }
 int posix_chown(const char* path, int uid, int gid) { return -1; }
-long posix_time(long* t) { long tm = 1733529600; if(t) *t = tm; return tm; }
+long posix_time(long* t) { long tm = (long)rtc_epoch_seconds(); if(t) *t = tm; return tm; }
 
 void posix_exit(int status) {
     while(1) { asm volatile("hlt"); }
 }
 
 unsigned int posix_sleep(unsigned int sec) {
-    for(volatile unsigned int i = 0; i < sec * 1000000; i++);
+    msleep(sec * 1000);
     return 0;
 }
 
 char* posix_getcwd(char* buf, size_t size) {
-    if(buf && size > 0) { buf[0] = '/'; buf[1] = '\0'; return buf; }
-    return 0;
+    if(!buf || strlen(current_directory) + 1 > size) return 0;
+    strcpy(buf, current_directory);
+    return buf;
+}
+
+/* shared and read-only mappings use the cached pages themselves; a writable private mapping gets copies */
+void* posix_mmap(void* addr, size_t length, int prot, int flags, int fd, long offset) {
+    open_file* file = fd_get(fd);
+    if(!file || length == 0 || offset < 0 || offset % PAGE_SIZE || fs_is_dir(file->ip)) return MAP_FAILED;
+    if((flags & (MAP_SHARED | MAP_PRIVATE)) == 0 || (file->flags & O_ACCMODE) == O_WRONLY) return MAP_FAILED;
+    if((flags & MAP_SHARED) && (prot & PROT_WRITE) && (file->flags & O_ACCMODE) == O_RDONLY) return MAP_FAILED;
+
+    file_mapping* m = 0;
+    for(int i = 0; i < MAX_MAPPINGS; i++) {
+        if(!mappings[i].addr) { m = &mappings[i]; break; }
+    }
+    if(!m) return MAP_FAILED;
+
+    uint32_t count = (uint32_t)((length + PAGE_SIZE - 1) / PAGE_SIZE);
+    uint32_t first = (uint32_t)(offset / PAGE_SIZE);
+    int copy = (flags & MAP_PRIVATE) && (prot & PROT_WRITE);
+    cached_page** pages = (cached_page**)kzalloc(count * sizeof(cached_page*));
+    uint64_t* phys = (uint64_t*)kzalloc(count * sizeof(uint64_t));
+    uint32_t got = 0;
+
+    for(; pages && phys && got < count; got++) {
+        pages[got] = pagecache_get(file->ip, first + got);
+        if(!pages[got]) break;
+        phys[got] = (uint64_t)pagecache_data(pages[got]);
+        if(copy) {
+            void* frame = alloc_page();
+            if(frame) memcpy(frame, pagecache_data(pages[got]), PAGE_SIZE);
+            pagecache_put(pages[got]);
+            pages[got] = 0;
+            if(!frame) break;
+            phys[got] = (uint64_t)frame;
+        }
+    }
+
+    uint8_t* base = (got == count) ? (uint8_t*)vmap_pages(phys, count, prot & PROT_WRITE) : 0;
+    if(!base) {
+        for(uint32_t i = 0; i < got; i++) {
+            if(copy) free_page((void*)phys[i]);
+            else pagecache_put(pages[i]);
+        }
+        kfree(pages);
+        kfree(phys);
+        return MAP_FAILED;
+    }
+    if(copy) {
+        for(uint32_t i = 0; i < count; i++) pages[i] = (cached_page*)phys[i];
+    }
+    kfree(phys);
+
+    m->addr = base;
+    m->count = count;
+    m->ip = fs_iget(fs_ino(file->ip));
+    m->pages = pages;
+    m->prot = prot;
+    m->flags = flags;
+    return base;
+}
+
+int posix_munmap(void* addr, size_t length) {
+    file_mapping* m = 0;
+    for(int i = 0; i < MAX_MAPPINGS; i++) {
+        if(mappings[i].addr && mappings[i].addr == (uint8_t*)addr) { m = &mappings[i]; break; }
+    }
+    if(!m) return -1;
+
+    int copy = (m->flags & MAP_PRIVATE) && (m->prot & PROT_WRITE);
+    int rc = 0;
+    vunmap(m->addr);
+    for(uint32_t i = 0; i < m->count; i++) {
+        if(copy) {
+            free_page((void*)m->pages[i]);
+            continue;
+        }
+        if((m->flags & MAP_SHARED) && (m->prot & PROT_WRITE) && pagecache_writeback(m->ip, m->pages[i]) < 0) rc = -1;
+        pagecache_put(m->pages[i]);
+    }
+    kfree(m->pages);
+    fs_iput(m->ip);
+    m->addr = 0;
+    return rc;
 }
\ No newline at end of file
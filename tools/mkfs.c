@@ -0,0 +1,252 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FS_MAGIC            0x46444C48
+#define FS_VERSION          1
+#define FS_BLOCK_SIZE       4096
+#define FS_ROOT_INO         1
+#define FS_NAME_MAX         52
+#define FS_INLINE_EXTENTS   8
+#define FS_INODE_SIZE       128
+#define FS_INODES_PER_BLOCK (FS_BLOCK_SIZE / FS_INODE_SIZE)
+#define FS_DIRENT_SIZE      64
+#define FS_DIRENTS_PER_BLOCK (FS_BLOCK_SIZE / FS_DIRENT_SIZE)
+#define FS_BITS_PER_BLOCK   (FS_BLOCK_SIZE * 8)
+
+#define FS_TYPE_FILE        1
+#define FS_TYPE_DIR         2
+#define DIRENT_USED         1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t inode_count;
+    uint32_t bitmap_start;
+    uint32_t bitmap_blocks;
+    uint32_t inode_start;
+    uint32_t inode_blocks;
+    uint32_t data_start;
+    uint32_t root_inode;
+    uint32_t free_blocks;
+    uint32_t free_inodes;
+} fs_superblock;
+
+typedef struct {
+    uint32_t start;
+    uint32_t length;
+} fs_extent;
+
+typedef struct {
+    uint16_t type;
+    uint16_t links;
+    uint32_t parent;
+    uint64_t size;
+    uint32_t mtime;
+    uint32_t extent_count;
+    fs_extent extents[FS_INLINE_EXTENTS];
+    uint32_t extent_block;
+    uint32_t dir_entries;
+    uint32_t dir_tombstones;
+    uint8_t reserved[28];
+} __attribute__((packed)) fs_inode_disk;
+
+typedef struct {
+    uint32_t ino;
+    uint32_t hash;
+    uint8_t state;
+    uint8_t type;
+    uint8_t name_len;
+    char name[FS_NAME_MAX + 1];
+} __attribute__((packed)) fs_dirent;
+
+static uint8_t* image;
+static fs_superblock* sb;
+static uint32_t next_block;
+static uint32_t next_inode = FS_ROOT_INO;
+
+static void fail(const char* msg, const char* arg) {
+    fprintf(stderr, "mkfs: %s%s%s\n", msg, arg ? ": " : "", arg ? arg : "");
+    exit(1);
+}
+
+static uint32_t name_hash(const char* name, uint32_t len) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint8_t* block_ptr(uint32_t block) {
+    return image + (uint64_t)block * FS_BLOCK_SIZE;
+}
+
+static fs_inode_disk* inode_ptr(uint32_t ino) {
+    return (fs_inode_disk*)(block_ptr(sb->inode_start + (ino - 1) / FS_INODES_PER_BLOCK) +
+                            ((ino - 1) % FS_INODES_PER_BLOCK) * FS_INODE_SIZE);
+}
+
+static void mark_used(uint32_t block) {
+    uint8_t* bitmap = block_ptr(sb->bitmap_start + block / FS_BITS_PER_BLOCK);
+    bitmap[(block % FS_BITS_PER_BLOCK) / 8] |= 1 << (block % 8);
+    sb->free_blocks--;
+}
+
+/* files are laid out as a single contiguous extent */
+static uint32_t alloc_extent(fs_inode_disk* d, uint32_t blocks, const char* path) {
+    if (blocks == 0) return 0;
+    if (next_block + blocks > sb->block_count) fail("filesystem full", path);
+
+    uint32_t start = next_block;
+    for (uint32_t i = 0; i < blocks; i++) mark_used(start + i);
+    next_block += blocks;
+    d->extents[0].start = start;
+    d->extents[0].length = blocks;
+    d->extent_count = 1;
+    return start;
+}
+
+static uint32_t alloc_inode(uint16_t type, uint32_t parent, uint32_t mtime, const char* path) {
+    if (next_inode > sb->inode_count) fail("out of inodes", path);
+
+    uint32_t ino = next_inode++;
+    fs_inode_disk* d = inode_ptr(ino);
+    d->type = type;
+    d->links = 1;
+    d->parent = parent ? parent : ino;
+    d->mtime = mtime;
+    sb->free_inodes--;
+    return ino;
+}
+
+static void dir_insert(fs_inode_disk* dir, const char* name, uint32_t ino, uint8_t type) {
+    uint32_t len = (uint32_t)strlen(name);
+    uint32_t slots = (uint32_t)(dir->size / FS_DIRENT_SIZE);
+    uint32_t hash = name_hash(name, len);
+    fs_dirent* table = (fs_dirent*)block_ptr(dir->extents[0].start);
+
+    uint32_t slot = hash & (slots - 1);
+    while (table[slot].state == DIRENT_USED) slot = (slot + 1) & (slots - 1);
+
+    table[slot].ino = ino;
+    table[slot].hash = hash;
+    table[slot].state = DIRENT_USED;
+    table[slot].type = type;
+    table[slot].name_len = (uint8_t)len;
+    memcpy(table[slot].name, name, len);
+    dir->dir_entries++;
+}
+
+static uint32_t build(const char* path, uint32_t parent, struct stat* st);
+
+static uint32_t build_dir(const char* path, uint32_t parent, struct stat* st) {
+    DIR* d = opendir(path);
+    if (!d) fail("cannot open directory", path);
+
+    uint32_t count = 0;
+    struct dirent* e;
+    while ((e = readdir(d))) {
+        if (strcmp(e->d_name, ".") && strcmp(e->d_name, "..")) count++;
+    }
+
+    uint32_t slots = FS_DIRENTS_PER_BLOCK;
+    while (slots < count * 2) slots *= 2;
+
+    uint32_t ino = alloc_inode(FS_TYPE_DIR, parent, (uint32_t)st->st_mtime, path);
+    fs_inode_disk* dir = inode_ptr(ino);
+    dir->size = (uint64_t)slots * FS_DIRENT_SIZE;
+    alloc_extent(dir, slots / FS_DIRENTS_PER_BLOCK, path);
+
+    rewinddir(d);
+    while ((e = readdir(d))) {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+        if (strlen(e->d_name) > FS_NAME_MAX) fail("name too long", e->d_name);
+
+        char child[4096];
+        struct stat cst;
+        snprintf(child, sizeof(child), "%s/%s", path, e->d_name);
+        if (stat(child, &cst) < 0) fail("cannot stat", child);
+        if (!S_ISDIR(cst.st_mode) && !S_ISREG(cst.st_mode)) continue;
+
+        uint32_t child_ino = build(child, ino, &cst);
+        dir_insert(inode_ptr(ino), e->d_name, child_ino, S_ISDIR(cst.st_mode) ? FS_TYPE_DIR : FS_TYPE_FILE);
+    }
+    closedir(d);
+    return ino;
+}
+
+static uint32_t build_file(const char* path, uint32_t parent, struct stat* st) {
+    uint32_t ino = alloc_inode(FS_TYPE_FILE, parent, (uint32_t)st->st_mtime, path);
+    fs_inode_disk* inode = inode_ptr(ino);
+    inode->size = (uint64_t)st->st_size;
+
+    uint32_t blocks = (uint32_t)((st->st_size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE);
+    uint32_t start = alloc_extent(inode, blocks, path);
+    if (!blocks) return ino;
+
+    FILE* f = fopen(path, "rb");
+    if (!f) fail("cannot open", path);
+    if (fread(block_ptr(start), 1, (size_t)st->st_size, f) != (size_t)st->st_size) fail("short read", path);
+    fclose(f);
+    return ino;
+}
+
+static uint32_t build(const char* path, uint32_t parent, struct stat* st) {
+    return S_ISDIR(st->st_mode) ? build_dir(path, parent, st) : build_file(path, parent, st);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: mkfs <image> <lba> <blocks> <rootdir>\n");
+        return 1;
+    }
+
+    uint64_t lba = strtoull(argv[2], 0, 0);
+    uint32_t blocks = (uint32_t)strtoul(argv[3], 0, 0);
+    if (blocks < 64) fail("too few blocks", argv[3]);
+
+    image = calloc(blocks, FS_BLOCK_SIZE);
+    if (!image) fail("out of memory", 0);
+
+    sb = (fs_superblock*)image;
+    sb->magic = FS_MAGIC;
+    sb->version = FS_VERSION;
+    sb->block_size = FS_BLOCK_SIZE;
+    sb->block_count = blocks;
+    sb->inode_count = (blocks / 2 + FS_INODES_PER_BLOCK - 1) / FS_INODES_PER_BLOCK * FS_INODES_PER_BLOCK;
+    sb->bitmap_start = 1;
+    sb->bitmap_blocks = (blocks + FS_BITS_PER_BLOCK - 1) / FS_BITS_PER_BLOCK;
+    sb->inode_start = sb->bitmap_start + sb->bitmap_blocks;
+    sb->inode_blocks = sb->inode_count / FS_INODES_PER_BLOCK;
+    sb->data_start = sb->inode_start + sb->inode_blocks;
+    sb->root_inode = FS_ROOT_INO;
+    sb->free_blocks = blocks;
+    sb->free_inodes = sb->inode_count;
+
+    for (uint32_t b = 0; b < sb->data_start; b++) mark_used(b);
+    next_block = sb->data_start;
+
+    struct stat st;
+    if (stat(argv[4], &st) < 0 || !S_ISDIR(st.st_mode)) fail("not a directory", argv[4]);
+    build_dir(argv[4], 0, &st);
+
+    int fd = open(argv[1], O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) fail("cannot open image", argv[1]);
+    uint64_t total = (uint64_t)blocks * FS_BLOCK_SIZE;
+    if (pwrite(fd, image, total, (off_t)(lba * 512)) != (ssize_t)total) fail("write failed", argv[1]);
+    close(fd);
+
+    printf("mkfs: %u blocks, %u inodes used, %u blocks free\n",
+           blocks, sb->inode_count - sb->free_inodes, sb->free_blocks);
+    free(image);
+    return 0;
+}
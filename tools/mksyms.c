@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAME_MAX_LEN    63
+
+typedef struct {
+    uint64_t addr;
+    char global;
+    char name[NAME_MAX_LEN + 1];
+} symbol;
+
+static symbol* symbols;
+static uint32_t count;
+static uint32_t capacity;
+
+static void fail(const char* msg) {
+    fprintf(stderr, "mksyms: %s\n", msg);
+    exit(1);
+}
+
+/* only code symbols; several names on one address keep a global one if there is one */
+static void add_symbol(uint64_t addr, char type, const char* name) {
+    if (type != 't' && type != 'T' && type != 'w' && type != 'W') return;
+    if (name[0] == '.' || name[0] == '$') return;
+
+    int global = type == 'T' || type == 'W';
+    if (count && symbols[count - 1].addr == addr) {
+        if (global && !symbols[count - 1].global) {
+            symbols[count - 1].global = 1;
+            snprintf(symbols[count - 1].name, sizeof(symbols[count - 1].name), "%s", name);
+        }
+        return;
+    }
+    if (count && addr < symbols[count - 1].addr) fail("input is not sorted, use nm -n");
+
+    if (count == capacity) {
+        capacity = capacity ? capacity * 2 : 1024;
+        symbols = realloc(symbols, capacity * sizeof(symbol));
+        if (!symbols) fail("out of memory");
+    }
+    symbols[count].addr = addr;
+    symbols[count].global = (char)global;
+    snprintf(symbols[count].name, sizeof(symbols[count].name), "%s", name);
+    count++;
+}
+
+/* reads `nm -n` output on stdin and writes the kernel's symbol table as C on stdout */
+int main(void) {
+    char line[512];
+    while (fgets(line, sizeof(line), stdin)) {
+        char name[NAME_MAX_LEN + 1];
+        char type;
+        unsigned long long addr;
+        if (sscanf(line, "%llx %c %63s", &addr, &type, name) == 3) add_symbol(addr, type, name);
+    }
+
+    printf("/* generated by tools/mksyms from nm -n output; do not edit */\n");
+    printf("typedef unsigned int uint32_t;\n");
+    printf("typedef unsigned long uint64_t;\n\n");
+    printf("const uint32_t ksym_count = %u;\n\n", count);
+
+    /* a table with no entries still needs one element to be valid C */
+    printf("const uint64_t ksym_addrs[] = {\n");
+    for (uint32_t i = 0; i < count; i++) printf("    0x%llx,\n", (unsigned long long)symbols[i].addr);
+    if (!count) printf("    0\n");
+    printf("};\n\n");
+
+    uint32_t offset = 0;
+    printf("const uint32_t ksym_name_offsets[] = {\n");
+    for (uint32_t i = 0; i < count; i++) {
+        printf("    %u,\n", offset);
+        offset += (uint32_t)strlen(symbols[i].name) + 1;
+    }
+    if (!count) printf("    0\n");
+    printf("};\n\n");
+
+    printf("const char ksym_names[] =\n");
+    for (uint32_t i = 0; i < count; i++) printf("    \"%s\\0\"\n", symbols[i].name);
+    printf("    \"\";\n");
+    return 0;
+}